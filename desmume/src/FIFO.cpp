@@ -265,8 +265,12 @@ void GFX_FIFOsend(u8 cmd, u32 param)
 	//does it expect the fifo to be running then? well, it's definitely jammed -- making it unjammed at one point did fix this bug.
 	//it's still not clear whether we're handling the immediate vs fifo commands properly at all :(
 	//anyway, here we go, similar treatment. consider this a hack.
-	if(cmd == 0x70) MMU_new.gxstat.tb = 1; //just set the flag--youre insane if you queue more than one of these anyway
-	if(cmd == 0x71) MMU_new.gxstat.tb = 1;
+	if((cmd == 0x70) || (cmd == 0x71))
+	{
+		//a test still running on the geometry thread will clear the flag when it finishes
+		gfx3d_WaitForGeometryThread();
+		MMU_new.gxstat.tb = 1; //just set the flag--youre insane if you queue more than one of these anyway
+	}
 
 	if(gxFIFO.size>=HACK_GXIFO_SIZE) {
 		printf("--FIFO FULL-- : %d\n",gxFIFO.size);
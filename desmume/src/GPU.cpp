@@ -3865,6 +3865,7 @@ void GPUEngineA::_RenderLine_DisplayCapture(const GPUEngineCompositorInfo &compI
 	const void *srcAPtr;
 	const void *srcBPtr;
 	u16 *dstNative16 = this->_VRAMNativeBlockPtr[DISPCAPCNT.VRAMWriteBlock] + dstNativeOffset;
+	MMU_VRAMPageMarkWritten( (u32)((u8 *)dstNative16 - MMU.ARM9_LCD) );
 	
 	if (!willWriteVRAMLineNative)
 	{
@@ -4623,6 +4624,9 @@ GPUSubsystem::GPUSubsystem()
 	_displayInfo.framebufferPageSize = ((GPU_FRAMEBUFFER_NATIVE_WIDTH * GPU_FRAMEBUFFER_NATIVE_HEIGHT) + (GPU_FRAMEBUFFER_NATIVE_WIDTH * GPU_FRAMEBUFFER_NATIVE_HEIGHT)) * 2 * _displayInfo.pixelBytes;
 	_displayInfo.framebufferPageCount = 1;
 	_masterFramebuffer = malloc_alignedPage(_displayInfo.framebufferPageSize * _displayInfo.framebufferPageCount);
+	_clientFramebufferMemory = NULL;
+	_clientFramebufferMemorySize = 0;
+	_isMasterFramebufferClientOwned = false;
 	_displayInfo.masterFramebufferHead = _masterFramebuffer;
 	
 	_masterWorkingNativeBuffer32 = NULL;
@@ -4697,7 +4701,11 @@ GPUSubsystem::~GPUSubsystem()
 		this->_asyncEngineBufferSetupTask = NULL;
 	}
 	
-	free_aligned(this->_masterFramebuffer);
+	if (!this->_isMasterFramebufferClientOwned)
+	{
+		free_aligned(this->_masterFramebuffer);
+	}
+	
 	free_aligned(this->_masterWorkingNativeBuffer32);
 	free_aligned(this->_customVRAM);
 	
@@ -4946,6 +4954,31 @@ void GPUSubsystem::SetFramebufferPageCount(size_t pageCount)
 	this->_displayInfo.framebufferPageCount = pageCount;
 }
 
+size_t GPUSubsystem::GetFramebufferPageSize(const NDSColorFormat outputFormat, const size_t w, const size_t h)
+{
+	const size_t pixelBytes = (outputFormat == NDSColorFormat_BGR555_Rev) ? sizeof(u16) : sizeof(FragmentColor);
+	const size_t nativeFramebufferSize = GPU_FRAMEBUFFER_NATIVE_WIDTH * GPU_FRAMEBUFFER_NATIVE_HEIGHT * sizeof(u16);
+	const size_t customFramebufferSize = w * h * pixelBytes;
+	const size_t pageSize = (nativeFramebufferSize * 2) + (customFramebufferSize * 2);
+	
+	return (pageSize + 4095) & ~(size_t)4095;
+}
+
+void GPUSubsystem::SetFramebufferClientMemory(void *clientMemory, size_t clientMemorySize)
+{
+	this->_engineMain->RenderLineClearAsyncFinish();
+	this->_engineSub->RenderLineClearAsyncFinish();
+	this->AsyncSetupEngineBuffersFinish();
+	
+	CurrentRenderer->RenderFinish();
+	CurrentRenderer->SetRenderNeedsFinish(false);
+	
+	this->_clientFramebufferMemory = clientMemory;
+	this->_clientFramebufferMemorySize = (clientMemory != NULL) ? clientMemorySize : 0;
+	
+	this->_AllocateFramebuffers(this->_displayInfo.colorFormat, this->_displayInfo.customWidth, this->_displayInfo.customHeight, this->_displayInfo.framebufferPageCount);
+}
+
 size_t GPUSubsystem::GetCustomFramebufferWidth() const
 {
 	return this->_displayInfo.customWidth;
@@ -5126,6 +5159,7 @@ void GPUSubsystem::SetColorFormat(const NDSColorFormat outputFormat)
 void GPUSubsystem::_AllocateFramebuffers(NDSColorFormat outputFormat, size_t w, size_t h, size_t pageCount)
 {
 	void *oldMasterFramebuffer = this->_masterFramebuffer;
+	const bool wasMasterFramebufferClientOwned = this->_isMasterFramebufferClientOwned;
 	void *oldCustomVRAM = this->_customVRAM;
 	
 	const size_t pixelBytes = (outputFormat == NDSColorFormat_BGR555_Rev) ? sizeof(u16) : sizeof(FragmentColor);
@@ -5137,8 +5171,16 @@ void GPUSubsystem::_AllocateFramebuffers(NDSColorFormat outputFormat, size_t w,
 	void *newCustomVRAM = NULL;
 	
 	this->_displayInfo.framebufferPageCount = pageCount;
-	this->_displayInfo.framebufferPageSize = (nativeFramebufferSize * 2) + (customFramebufferSize * 2);
-	this->_masterFramebuffer = malloc_alignedPage(this->_displayInfo.framebufferPageSize * this->_displayInfo.framebufferPageCount);
+	this->_displayInfo.framebufferPageSize = GPUSubsystem::GetFramebufferPageSize(outputFormat, w, h);
+	
+	if (this->_displayInfo.bufferIndex >= pageCount)
+	{
+		this->_displayInfo.bufferIndex = 0;
+	}
+	
+	const size_t masterFramebufferSize = this->_displayInfo.framebufferPageSize * this->_displayInfo.framebufferPageCount;
+	this->_isMasterFramebufferClientOwned = (this->_clientFramebufferMemory != NULL) && (this->_clientFramebufferMemorySize >= masterFramebufferSize);
+	this->_masterFramebuffer = (this->_isMasterFramebufferClientOwned) ? this->_clientFramebufferMemory : malloc_alignedPage(masterFramebufferSize);
 	
 	if (outputFormat != NDSColorFormat_BGR555_Rev)
 	{
@@ -5230,7 +5272,11 @@ void GPUSubsystem::_AllocateFramebuffers(NDSColorFormat outputFormat, size_t w,
 		CurrentRenderer->SetFramebufferSize(w, h);
 	}
 	
-	free_aligned(oldMasterFramebuffer);
+	if (!wasMasterFramebufferClientOwned)
+	{
+		free_aligned(oldMasterFramebuffer);
+	}
+	
 	free_aligned(oldCustomVRAM);
 }
 
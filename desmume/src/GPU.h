@@ -1840,6 +1840,7 @@ public:
 class GPUEventHandler
 {
 public:
+	virtual ~GPUEventHandler() {};
 	virtual void DidFrameBegin(const size_t line, const bool isFrameSkipRequested, const size_t pageCount, u8 &selectedBufferIndexInOut) = 0;
 	virtual void DidFrameEnd(bool isFrameSkipped, const NDSDisplayInfo &latestDisplayInfo) = 0;
 	virtual void DidRender3DBegin() = 0;
@@ -1894,6 +1895,9 @@ private:
 	
 	void *_masterFramebuffer;
 	u32 *_masterWorkingNativeBuffer32;
+	void *_clientFramebufferMemory;
+	size_t _clientFramebufferMemorySize;
+	bool _isMasterFramebufferClientOwned;
 	
 	NDSDisplayInfo _displayInfo;
 	
@@ -1930,6 +1934,17 @@ public:
 	size_t GetFramebufferPageCount() const;
 	void SetFramebufferPageCount(size_t pageCount);
 	
+	// Returns the size of a single framebuffer page for the given format and custom size. Pages are
+	// always a multiple of the host page size, so every page starts page-aligned.
+	static size_t GetFramebufferPageSize(const NDSColorFormat outputFormat, const size_t w, const size_t h);
+	
+	// Places the framebuffer pages in memory owned by the client, such as shared memory that another
+	// process reads the frames from. The memory must be page-aligned and must remain valid until it
+	// is replaced by another call. Passing NULL goes back to memory owned by the GPU. If a later
+	// change needs more memory than clientMemorySize, the GPU also falls back to its own memory.
+	// Calling this reallocates the framebuffers, which also applies a pending SetFramebufferPageCount().
+	void SetFramebufferClientMemory(void *clientMemory, size_t clientMemorySize);
+	
 	size_t GetCustomFramebufferWidth() const;
 	size_t GetCustomFramebufferHeight() const;
 	void SetCustomFramebufferSize(size_t w, size_t h);
@@ -318,6 +318,12 @@ static const TVramBankInfo vram_bank_info[VRAM_BANK_COUNT] = {
 	{40,1}
 };
 
+u8* MMU_VRAMBankMemory(const VRAMBankID bankID, size_t &outSize)
+{
+	outSize = (size_t)vram_bank_info[bankID].num_pages << 14;
+	return MMU.ARM9_LCD + ((size_t)vram_bank_info[bankID].page_addr << 14);
+}
+
 //this is to remind you that the LCDC mapping returns a strange value (not 0x06800000) as you would expect
 //in order to play nicely with the MMU address and mask tables
 #define LCDC_HACKY_LOCATION 0x06000000
@@ -756,6 +762,12 @@ unsupported_mst:
 	PROGINFO("Unsupported mst setting %d for vram bank %c\n", VRAMBankCnt.MST, 'A'+VRAMBANK);
 }
 
+void MMU_VRAMPageMarkAllWritten()
+{
+	for (size_t i = 0; i < ARRAY_SIZE(MMU.VRAMPageGeneration); i++)
+		MMU.VRAMPageGeneration[i]++;
+}
+
 void MMU_VRAM_unmap_all()
 {
 	vramConfiguration.clear();
@@ -1829,6 +1841,8 @@ static void writereg_POWCNT1(const int size, const u32 adr, const u32 val)
 	bool isGeomEnabled = !!nds.power1.gfx3d_geometry;
 	if(wasGeomEnabled && !isGeomEnabled)
 	{
+		gfx3d_WaitForGeometryThread();
+
 		//kill the geometry data when the power goes off
 		//so, so bad. we need to model this with hardware-like operations instead of c++ code
 		
@@ -1969,6 +1983,8 @@ static INLINE void write_timer(int proc, int timerIndex, u16 val)
 
 u32 TGXSTAT::read32()
 {
+	gfx3d_WaitForGeometryThread();
+
 	u32 ret = 0;
 
 	ret |= tb|(tr<<1);
@@ -2005,6 +2021,8 @@ u32 TGXSTAT::read32()
 
 void TGXSTAT::write32(const u32 val)
 {
+	gfx3d_WaitForGeometryThread();
+
 	gxfifo_irq = (val>>30)&3;
 	if(BIT15(val)) 
 	{
@@ -2026,12 +2044,14 @@ void TGXSTAT::write32(const u32 val)
 
 void TGXSTAT::savestate(EMUFILE &f)
 {
+	gfx3d_WaitForGeometryThread();
 	f.write_32LE(1); //version
 	f.write_u8(tb); f.write_u8(tr); f.write_u8(se); f.write_u8(gxfifo_irq); f.write_u8(sb);
 }
 
 bool TGXSTAT::loadstate(EMUFILE &f)
 {
+	gfx3d_WaitForGeometryThread();
 	u32 version;
 	if (f.read_32LE(version) != 1) return false;
 	if (version > 1) return false;
@@ -4464,6 +4484,9 @@ void FASTCALL _MMU_ARM9_write16(u32 adr, u16 val)
 	bool unmapped, restricted;
 	adr = MMU_LCDmap<ARMCPU_ARM9>(adr, unmapped, restricted);
 	if(unmapped) return;
+	
+	if ((adr >> 24) == 6)
+		MMU_VRAMPageMarkWritten(adr - LCDC_HACKY_LOCATION);
 
 #ifdef HAVE_JIT
 	if (JIT_MAPPED(adr, ARMCPU_ARM9))
@@ -5003,6 +5026,9 @@ void FASTCALL _MMU_ARM9_write32(u32 adr, u32 val)
 	bool unmapped, restricted;
 	adr = MMU_LCDmap<ARMCPU_ARM9>(adr, unmapped, restricted);
 	if(unmapped) return;
+	
+	if ((adr >> 24) == 6)
+		MMU_VRAMPageMarkWritten(adr - LCDC_HACKY_LOCATION);
 
 #ifdef HAVE_JIT
 	if (JIT_MAPPED(adr, ARMCPU_ARM9))
@@ -5037,6 +5063,9 @@ u8 FASTCALL _MMU_ARM9_read08(u32 adr)
 		
 		if(MMU_new.is_dma(adr)) return MMU_new.read_dma(ARMCPU_ARM9,8,adr);
 
+		//the geometry engine writes its test results straight into IO memory
+		if ((adr >= eng_3D_POS_RESULT) && (adr < eng_3D_VEC_RESULT + 6)) gfx3d_WaitForGeometryThread();
+
 		switch(adr)
 		{
 			case REG_IF: return MMU.gen_IF<ARMCPU_ARM9>();
@@ -5160,6 +5189,9 @@ u16 FASTCALL _MMU_ARM9_read16(u32 adr)
 
 		if(MMU_new.is_dma(adr)) return MMU_new.read_dma(ARMCPU_ARM9,16,adr); 
 
+		//the geometry engine writes its test results straight into IO memory
+		if ((adr >= eng_3D_POS_RESULT) && (adr < eng_3D_VEC_RESULT + 6)) gfx3d_WaitForGeometryThread();
+
 		switch(adr)
 		{
 			case REG_DISPA_DISPSTAT:
@@ -5270,6 +5302,9 @@ u32 FASTCALL _MMU_ARM9_read32(u32 adr)
 		
 		if(MMU_new.is_dma(adr)) return MMU_new.read_dma(ARMCPU_ARM9,32,adr); 
 
+		//the geometry engine writes its test results straight into IO memory
+		if ((adr >= eng_3D_POS_RESULT) && (adr < eng_3D_VEC_RESULT + 6)) gfx3d_WaitForGeometryThread();
+
 		switch(adr)
 		{
 			case REG_DSIMODE:
@@ -5498,6 +5533,9 @@ void FASTCALL _MMU_ARM7_write08(u32 adr, u8 val)
 	bool unmapped, restricted;
 	adr = MMU_LCDmap<ARMCPU_ARM7>(adr,unmapped, restricted);
 	if(unmapped) return;
+	
+	if ((adr >> 24) == 6)
+		MMU_VRAMPageMarkWritten(adr - LCDC_HACKY_LOCATION);
 
 #ifdef HAVE_JIT
 	if (JIT_MAPPED(adr, ARMCPU_ARM7))
@@ -5684,6 +5722,9 @@ void FASTCALL _MMU_ARM7_write16(u32 adr, u16 val)
 	bool unmapped, restricted;
 	adr = MMU_LCDmap<ARMCPU_ARM7>(adr,unmapped, restricted);
 	if(unmapped) return;
+	
+	if ((adr >> 24) == 6)
+		MMU_VRAMPageMarkWritten(adr - LCDC_HACKY_LOCATION);
 
 #ifdef HAVE_JIT
 	if (JIT_MAPPED(adr, ARMCPU_ARM7))
@@ -5783,6 +5824,9 @@ void FASTCALL _MMU_ARM7_write32(u32 adr, u32 val)
 	bool unmapped, restricted;
 	adr = MMU_LCDmap<ARMCPU_ARM7>(adr,unmapped, restricted);
 	if(unmapped) return;
+	
+	if ((adr >> 24) == 6)
+		MMU_VRAMPageMarkWritten(adr - LCDC_HACKY_LOCATION);
 
 #ifdef HAVE_JIT
 	if (JIT_MAPPED(adr, ARMCPU_ARM7))
@@ -391,6 +391,11 @@ struct MMU_struct
 		u8* texPalSlot[6];
 		u8* textureSlotAddr[4];
 	} texInfo;
+	
+	//write generation of each 16KB page of ARM9_LCD (including the blank pages at the end).
+	//every write into a physical vram page bumps its counter, so that the texture cache
+	//can tell which pages were touched while they were mapped somewhere else.
+	u32 VRAMPageGeneration[(0xA4000 + 0x20000) >> 14];
 
 	//ARM7 mem
 	u8 ARM7_BIOS[0x4000];
@@ -574,6 +579,9 @@ enum VRAMBankID
 	VRAM_BANK_COUNT = 9
 };
 
+//host memory backing one physical VRAM bank, in ARM9_LCD
+u8* MMU_VRAMBankMemory(const VRAMBankID bankID, size_t &outSize);
+
 #define VRAM_PAGE_ABG 0
 #define VRAM_PAGE_BBG 128
 #define VRAM_PAGE_AOBJ 256
@@ -626,6 +634,15 @@ FORCEINLINE void* MMU_gpu_map(const u32 vram_addr)
 	return MMU.ARM9_LCD + (vram_page << 14) + ofs;
 }
 
+//notes a write to physical vram, given as an offset into ARM9_LCD
+FORCEINLINE void MMU_VRAMPageMarkWritten(const u32 lcdOffset)
+{
+	MMU.VRAMPageGeneration[lcdOffset >> 14]++;
+}
+
+//notes that all of physical vram may have changed (ie. after loading a savestate)
+void MMU_VRAMPageMarkAllWritten();
+
 
 template<int PROCNUM, MMU_ACCESS_TYPE AT> u8 _MMU_read08(u32 addr);
 template<int PROCNUM, MMU_ACCESS_TYPE AT> u16 _MMU_read16(u32 addr);
@@ -21,9 +21,11 @@
 #include <stdlib.h>
 #include <algorithm>
 #include <math.h>
+#include <sys/stat.h>
 #include <zlib.h>
 
 #include <features/features_cpu.h>
+#include <rthreads/rthreads.h>
 
 #include "utils/decrypt/decrypt.h"
 #include "utils/decrypt/crc.h"
@@ -31,6 +33,7 @@
 #include "utils/advanscene.h"
 #include "utils/task.h"
 #include "utils/bits.h"
+#include "utils/fasthash.h"
 
 #include "common.h"
 #include "armcpu.h"
@@ -58,6 +61,7 @@
 #include "SPU.h"
 #include "wifi.h"
 #include "Database.h"
+#include "ROMReader.h"
 #include "frontend/modules/Disassembler.h"
 
 #if defined(HOST_WINDOWS) && !defined(TARGET_INTERFACE)
@@ -160,6 +164,13 @@ void NDS_RunAdvansceneAutoImport()
 	}
 }
 
+static u32 frameHashRegionMask = 0;
+static EMUFILE_FILE *frameHashFile = NULL;
+static std::vector<NDSFrameHashRecord> frameHashRing;
+static size_t frameHashRingHead = 0;
+static size_t frameHashRingCount = 0;
+static slock_t *frameHashRingMutex = slock_new(); // the ring can be set up before NDS_Init()
+
 int NDS_Init()
 {
 	nds.idleFrameCounter = 0;
@@ -213,8 +224,11 @@ void NDS_DeInit(void)
 	delete GPU;
 	GPU = NULL;
 	
+	MMU_new.backupDevice.syncBackup();
 	MMU_DeInit();
 	
+	NDS_FrameHashCloseFile();
+	
 	delete wifiHandler;
 	wifiHandler = NULL;
 	
@@ -678,6 +692,136 @@ static int rom_init_path(const char *filename, const char *physicalName, const c
 	return 1;
 }
 
+//CRC32 of a whole image, split across worker threads and joined with crc32_combine(),
+//so the result is the same as a single pass over the image
+#define ROM_CRC_MIN_CHUNK_SIZE (16 * 1024 * 1024)
+
+struct ROMCRCChunk
+{
+	const u8 *data;
+	size_t size;
+	u32 crc;
+};
+
+static void* ROM_CRCChunkTask(void *arg)
+{
+	ROMCRCChunk *chunk = (ROMCRCChunk *)arg;
+	chunk->crc = crc32(0, chunk->data, (uInt)chunk->size);
+	return NULL;
+}
+
+static u32 ROM_CRC32(const u8 *data, size_t size)
+{
+	size_t chunkCount = (CommonSettings.num_cores > 1) ? (size_t)CommonSettings.num_cores : 1;
+	chunkCount = std::min<size_t>(chunkCount, std::max<size_t>(1, size / ROM_CRC_MIN_CHUNK_SIZE));
+
+	std::vector<ROMCRCChunk> chunks(chunkCount);
+	const size_t chunkSize = size / chunkCount;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		chunks[i].data = data + (i * chunkSize);
+		chunks[i].size = (i == chunkCount - 1) ? (size - (i * chunkSize)) : chunkSize;
+		chunks[i].crc = 0;
+	}
+
+	Task *tasks = (chunkCount > 1) ? new Task[chunkCount - 1] : NULL;
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		tasks[i-1].start(false, 0, "rom crc");
+		tasks[i-1].execute(&ROM_CRCChunkTask, &chunks[i]);
+	}
+
+	ROM_CRCChunkTask(&chunks[0]);
+	u32 crc = chunks[0].crc;
+
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		tasks[i-1].finish();
+		tasks[i-1].shutdown();
+		crc = crc32_combine(crc, chunks[i].crc, (z_off_t)chunks[i].size);
+	}
+
+	delete [] tasks;
+	return crc;
+}
+
+//the ROM metadata sidecar (<battery path>.drc) holds what NDS_LoadROM would otherwise have to
+//read the whole image for, keyed by the ROM's path, size and modification time. the game database
+//result is kept too, as long as the database file hasn't changed.
+#define ROM_METADATA_CACHE_MAGIC 0x43524D44 // "DMRC"
+#define ROM_METADATA_CACHE_VERSION 1
+
+struct ROMMetadataCache
+{
+	std::string romPath;
+	u64 romSize;
+	s64 romModifiedTime;
+	bool romInMemory;
+	u32 crc;
+	u32 crcForCheatsDb;
+	u64 dbStamp;
+	bool dbFound;
+	char dbSerial[4];
+	u32 dbCRC;
+	u8 dbSaveType;
+	bool dbFoundAsSerial;
+	bool dbFoundAsCrc;
+};
+
+static bool ROMMetadataCache_Read(const std::string &fname, ROMMetadataCache &cache)
+{
+	EMUFILE_FILE fp(fname, "rb");
+	if (fp.fail())
+		return false;
+
+	u32 pathLength = 0;
+	if (fp.read_u32LE() != ROM_METADATA_CACHE_MAGIC || fp.read_u32LE() != ROM_METADATA_CACHE_VERSION)
+		return false;
+	if (fp.read_32LE(pathLength) != 1 || pathLength > 4096)
+		return false;
+
+	cache.romPath.resize(pathLength);
+	if (pathLength > 0 && fp.fread(&cache.romPath[0], pathLength) != pathLength)
+		return false;
+
+	fp.read_64LE(cache.romSize);
+	fp.read_64LE(cache.romModifiedTime);
+	fp.read_bool8(cache.romInMemory);
+	fp.read_32LE(cache.crc);
+	fp.read_32LE(cache.crcForCheatsDb);
+	fp.read_64LE(cache.dbStamp);
+	fp.read_bool8(cache.dbFound);
+	fp.fread(cache.dbSerial, 4);
+	fp.read_32LE(cache.dbCRC);
+	fp.read_u8(cache.dbSaveType);
+	fp.read_bool8(cache.dbFoundAsSerial);
+	return (fp.read_bool8(cache.dbFoundAsCrc) == 1);
+}
+
+static void ROMMetadataCache_Write(const std::string &fname, const ROMMetadataCache &cache)
+{
+	EMUFILE_FILE fp(fname, "wb");
+	if (fp.fail())
+		return;
+
+	fp.write_32LE((u32)ROM_METADATA_CACHE_MAGIC);
+	fp.write_32LE((u32)ROM_METADATA_CACHE_VERSION);
+	fp.write_32LE((u32)cache.romPath.size());
+	fp.fwrite(cache.romPath.data(), cache.romPath.size());
+	fp.write_64LE(cache.romSize);
+	fp.write_64LE(cache.romModifiedTime);
+	fp.write_bool8(cache.romInMemory);
+	fp.write_32LE(cache.crc);
+	fp.write_32LE(cache.crcForCheatsDb);
+	fp.write_64LE(cache.dbStamp);
+	fp.write_bool8(cache.dbFound);
+	fp.fwrite(cache.dbSerial, 4);
+	fp.write_32LE(cache.dbCRC);
+	fp.write_u8(cache.dbSaveType);
+	fp.write_bool8(cache.dbFoundAsSerial);
+	fp.write_bool8(cache.dbFoundAsCrc);
+}
+
 struct LastRom {
 	std::string filename, physicalName, logicalFilename;
 } lastRom;
@@ -710,20 +854,52 @@ int NDS_LoadROM(const char *filename, const char *physicalName, const char *logi
 	
 	gameInfo.populate();
 	
-	//run crc over the whole buffer (chunk at a time, to avoid coding a streaming crc
-	gameInfo.reader->Seek(gameInfo.fROM, 0, SEEK_SET);
-	gameInfo.crc = 0;
+	ROMMetadataCache romCache;
+	char romCachePath[MAX_PATH] = {0};
+	path.getpathnoext(path.BATTERY, romCachePath);
+	const std::string romCacheFileName = std::string(romCachePath) + ".drc";
 	
-	u8 fROMBuffer[4096];
-	bool first = true;
+	struct stat romStat;
+	const bool canCacheROM = (stat(path.path.c_str(), &romStat) == 0);
+	const bool romInMemory = (gameInfo.romdataForReader != NULL);
+	const bool romCacheHit = canCacheROM &&
+	                         ROMMetadataCache_Read(romCacheFileName, romCache) &&
+	                         (romCache.romPath == path.path) &&
+	                         (romCache.romSize == (u64)romStat.st_size) &&
+	                         (romCache.romModifiedTime == (s64)romStat.st_mtime) &&
+	                         (romCache.romInMemory == romInMemory);
 	
-	for(;;) {
-		int read = gameInfo.reader->Read(gameInfo.fROM,fROMBuffer,4096);
-		if(read == 0) break;
-		if(first && read >= 512)
-			gameInfo.crcForCheatsDb = ~crc32(0, fROMBuffer, 512);
-		first = false;
-		gameInfo.crc = crc32(gameInfo.crc, fROMBuffer, read);
+	ROMReaderImage romImage;
+	if (romCacheHit)
+	{
+		gameInfo.crc = romCache.crc;
+		gameInfo.crcForCheatsDb = romCache.crcForCheatsDb;
+	}
+	else if (ROMReaderMapImage(gameInfo.reader, gameInfo.fROM, romImage))
+	{
+		//scan the image in place, rather than pulling it through the reader
+		if (romImage.size >= 512)
+			gameInfo.crcForCheatsDb = ~crc32(0, romImage.data, 512);
+		gameInfo.crc = ROM_CRC32(romImage.data, romImage.size);
+		ROMReaderUnmapImage(romImage);
+	}
+	else
+	{
+		//run crc over the whole buffer (chunk at a time, to avoid coding a streaming crc
+		gameInfo.reader->Seek(gameInfo.fROM, 0, SEEK_SET);
+		gameInfo.crc = 0;
+		
+		u8 fROMBuffer[4096];
+		bool first = true;
+		
+		for(;;) {
+			int read = gameInfo.reader->Read(gameInfo.fROM,fROMBuffer,4096);
+			if(read == 0) break;
+			if(first && read >= 512)
+				gameInfo.crcForCheatsDb = ~crc32(0, fROMBuffer, 512);
+			first = false;
+			gameInfo.crc = crc32(gameInfo.crc, fROMBuffer, read);
+		}
 	}
 
 	gameInfo.chipID  = 0xC2;														// The Manufacturer ID is defined by JEDEC (C2h = Macronix)
@@ -765,7 +941,32 @@ int NDS_LoadROM(const char *filename, const char *physicalName, const char *logi
 	buf[2] = gameInfo.header.gameCode[2];
 	buf[3] = gameInfo.header.gameCode[3];
 	buf[4] = 0;
-	if (advsc.checkDB(buf, gameInfo.crc))
+	
+	const u64 dbStamp = advsc.getDatabaseStamp();
+	if (romCacheHit && (romCache.dbStamp == dbStamp))
+		advsc.setResult(romCache.dbFound, romCache.dbSerial, romCache.dbCRC, romCache.dbSaveType, romCache.dbFoundAsSerial, romCache.dbFoundAsCrc);
+	else
+		advsc.checkDB(buf, gameInfo.crc);
+	
+	if (canCacheROM && (!romCacheHit || (romCache.dbStamp != dbStamp)))
+	{
+		romCache.romPath = path.path;
+		romCache.romSize = (u64)romStat.st_size;
+		romCache.romModifiedTime = (s64)romStat.st_mtime;
+		romCache.romInMemory = romInMemory;
+		romCache.crc = gameInfo.crc;
+		romCache.crcForCheatsDb = gameInfo.crcForCheatsDb;
+		romCache.dbStamp = dbStamp;
+		romCache.dbFound = advsc.isLoaded();
+		memcpy(romCache.dbSerial, advsc.getSerial(), 4);
+		romCache.dbCRC = advsc.getCRC32();
+		romCache.dbSaveType = (u8)advsc.getSaveType();
+		romCache.dbFoundAsSerial = advsc.isFoundAsSerial();
+		romCache.dbFoundAsCrc = advsc.isFoundAsCrc();
+		ROMMetadataCache_Write(romCacheFileName, romCache);
+	}
+	
+	if (advsc.isLoaded())
 	{
 		u8 sv = advsc.getSaveType();
 		printf("Found in game database by %s:\n", advsc.getIdMethod());
@@ -1427,6 +1628,141 @@ static void execHardware_hblank()
 	WAV_WavSoundUpdate(SPU_core->outbuf,spu_core_samples);
 }
 
+//---------frame hashing
+void NDS_FrameHashSetRegions(u32 regionMask)
+{
+	frameHashRegionMask = regionMask & ((1U << NDSFrameHashRegionID_Count) - 1);
+}
+
+u32 NDS_FrameHashGetRegions()
+{
+	return frameHashRegionMask;
+}
+
+bool NDS_FrameHashOpenFile(const char *fileName)
+{
+	NDS_FrameHashCloseFile();
+	
+	frameHashFile = new EMUFILE_FILE(fileName, "wb");
+	if (frameHashFile->fail())
+	{
+		delete frameHashFile;
+		frameHashFile = NULL;
+		return false;
+	}
+	
+	frameHashFile->write_32LE((u32)NDSFRAMEHASH_FILE_MAGIC);
+	frameHashFile->write_32LE((u32)NDSFRAMEHASH_FILE_VERSION);
+	frameHashFile->write_32LE((u32)sizeof(NDSFrameHashRecord));
+	
+	return true;
+}
+
+void NDS_FrameHashCloseFile()
+{
+	delete frameHashFile;
+	frameHashFile = NULL;
+}
+
+void NDS_FrameHashSetRingSize(size_t recordCount)
+{
+	slock_lock(frameHashRingMutex);
+	
+	frameHashRing.resize(recordCount);
+	frameHashRingHead = 0;
+	frameHashRingCount = 0;
+	
+	slock_unlock(frameHashRingMutex);
+}
+
+size_t NDS_FrameHashReadRing(NDSFrameHashRecord *outRecords, size_t maxCount)
+{
+	slock_lock(frameHashRingMutex);
+	
+	const size_t ringSize = frameHashRing.size();
+	const size_t readCount = std::min<size_t>(maxCount, frameHashRingCount);
+	size_t tail = (frameHashRingHead + ringSize - frameHashRingCount) % std::max<size_t>(ringSize, 1);
+	
+	for (size_t i = 0; i < readCount; i++)
+	{
+		outRecords[i] = frameHashRing[tail];
+		tail = (tail + 1) % ringSize;
+	}
+	
+	frameHashRingCount -= readCount;
+	
+	slock_unlock(frameHashRingMutex);
+	return readCount;
+}
+
+static void NDS_FrameHashCapture()
+{
+	NDSFrameHashRecord record;
+	memset(&record, 0, sizeof(record));
+	
+	record.frame = (u32)currFrameCounter;
+	record.regionMask = frameHashRegionMask;
+	
+	if (frameHashRegionMask & NDSFRAMEHASH_REGIONS_DISPLAYS)
+	{
+		const NDSDisplayInfo &displayInfo = GPU->GetDisplayInfo();
+		
+		for (size_t i = 0; i < 2; i++)
+		{
+			if ( (frameHashRegionMask & NDSFRAMEHASH_REGION(NDSFrameHashRegionID_MainDisplay + i)) && (displayInfo.renderedBuffer[i] != NULL) )
+			{
+				record.hash[NDSFrameHashRegionID_MainDisplay + i] = FastHash64(displayInfo.renderedBuffer[i], displayInfo.renderedWidth[i] * displayInfo.renderedHeight[i] * displayInfo.pixelBytes);
+			}
+		}
+		
+		if (GPU->GetWillFrameSkip())
+		{
+			record.regionMask |= NDSFRAMEHASH_FLAG_FRAMESKIPPED;
+		}
+	}
+	
+	if (frameHashRegionMask & NDSFRAMEHASH_REGION(NDSFrameHashRegionID_MainRAM))
+	{
+		record.hash[NDSFrameHashRegionID_MainRAM] = FastHash64(MMU.MAIN_MEM, _MMU_MAIN_MEM_MASK + 1);
+	}
+	
+	if (frameHashRegionMask & NDSFRAMEHASH_REGIONS_VRAM)
+	{
+		for (size_t i = 0; i < VRAM_BANK_COUNT; i++)
+		{
+			const size_t regionID = NDSFrameHashRegionID_VRAM_A + i;
+			if (frameHashRegionMask & NDSFRAMEHASH_REGION(regionID))
+			{
+				size_t bankSize = 0;
+				const u8 *bankMemory = MMU_VRAMBankMemory((VRAMBankID)i, bankSize);
+				record.hash[regionID] = FastHash64(bankMemory, bankSize);
+			}
+		}
+	}
+	
+	if (frameHashFile != NULL)
+	{
+		frameHashFile->write_32LE(record.frame);
+		frameHashFile->write_32LE(record.regionMask);
+		for (size_t i = 0; i < NDSFrameHashRegionID_Count; i++)
+		{
+			frameHashFile->write_64LE(record.hash[i]);
+		}
+	}
+	
+	slock_lock(frameHashRingMutex);
+	
+	const size_t ringSize = frameHashRing.size();
+	if (ringSize > 0)
+	{
+		frameHashRing[frameHashRingHead] = record;
+		frameHashRingHead = (frameHashRingHead + 1) % ringSize;
+		frameHashRingCount = std::min<size_t>(frameHashRingCount + 1, ringSize);
+	}
+	
+	slock_unlock(frameHashRingMutex);
+}
+
 static void execHardware_hstart_vblankEnd()
 {
 	sequencer.nds_vblankEnded = true;
@@ -1444,6 +1780,10 @@ static void execHardware_hstart_vblankStart()
 {
 	//printf("--------VBLANK!!!--------\n");
 
+	//fingerprint the finished frame before the vblank handlers start changing things
+	if (frameHashRegionMask != 0)
+		NDS_FrameHashCapture();
+
 	//fire vblank interrupts if necessary
 	for(int i=0;i<2;i++)
 	{
@@ -489,6 +489,44 @@ int NDS_GetCPUCoreCount();
 void NDS_GetCPULoadAverage(u32 &outLoadAvgARM9, u32 &outLoadAvgARM7);
 void NDS_SetupDefaultFirmware();
 
+//Per-frame fingerprints for regression testing. At the start of each vblank, the enabled regions
+//are hashed (FastHash64) and the record is appended to the hash file and/or the hash ring.
+enum NDSFrameHashRegionID
+{
+	NDSFrameHashRegionID_MainDisplay	= 0,
+	NDSFrameHashRegionID_TouchDisplay	= 1,
+	NDSFrameHashRegionID_MainRAM		= 2,
+	NDSFrameHashRegionID_VRAM_A			= 3,	// VRAM banks A-I follow in order
+	NDSFrameHashRegionID_VRAM_I			= 11,
+	
+	NDSFrameHashRegionID_Count			= 12
+};
+
+#define NDSFRAMEHASH_REGION(id)				(1U << (id))
+#define NDSFRAMEHASH_REGIONS_DISPLAYS		(NDSFRAMEHASH_REGION(NDSFrameHashRegionID_MainDisplay) | NDSFRAMEHASH_REGION(NDSFrameHashRegionID_TouchDisplay))
+#define NDSFRAMEHASH_REGIONS_VRAM			(0x1FFU << NDSFrameHashRegionID_VRAM_A)
+#define NDSFRAMEHASH_FLAG_FRAMESKIPPED		(1U << 31)	// the displays were not redrawn this frame
+
+#define NDSFRAMEHASH_FILE_MAGIC				0x48465344	// "DSFH"
+#define NDSFRAMEHASH_FILE_VERSION			1
+
+struct NDSFrameHashRecord
+{
+	u32 frame;									// currFrameCounter at the vblank
+	u32 regionMask;								// Regions hashed for this frame, plus NDSFRAMEHASH_FLAG_FRAMESKIPPED.
+	u64 hash[NDSFrameHashRegionID_Count];		// Hashes of regions not in regionMask are 0.
+};
+
+void NDS_FrameHashSetRegions(u32 regionMask);
+u32 NDS_FrameHashGetRegions();
+//the file is a 12 byte header (magic, version, record size) followed by little-endian NDSFrameHashRecords
+bool NDS_FrameHashOpenFile(const char *fileName);
+void NDS_FrameHashCloseFile();
+//keeps the newest recordCount records in memory, overwriting the oldest; 0 turns the ring off
+void NDS_FrameHashSetRingSize(size_t recordCount);
+//moves up to maxCount of the oldest records out of the ring; safe to call from another thread
+size_t NDS_FrameHashReadRing(NDSFrameHashRecord *outRecords, size_t maxCount);
+
 //void execHardware_doAllDma(EDMAMode modeNum);
 
 template<bool FORCE> void NDS_exec(s32 nb = 560190<<1);
@@ -508,6 +546,7 @@ extern struct TCommonSettings
 		, GFX3D_Renderer_TextureDeposterize(false)
 		, GFX3D_Renderer_TextureSmoothing(false)
 		, GFX3D_TXTHack(false)
+		, GFX3D_GeometryThread(false)
 		, OpenGL_Emulation_ShadowPolygon(true)
 		, OpenGL_Emulation_SpecialZeroAlphaBlending(true)
 		, OpenGL_Emulation_NDSDepthCalculation(true)
@@ -542,6 +581,7 @@ extern struct TCommonSettings
 		strcpy(ARM9BIOS, "biosnds9.bin");
 		strcpy(ARM7BIOS, "biosnds7.bin");
 		strcpy(ExtFirmwarePath, "firmware.bin");
+		GFX3D_Renderer_TextureDiskCachePath[0] = '\0';
 
 		for(int i=0;i<16;i++)
 			spu_muteChannels[i] = false;
@@ -570,6 +610,8 @@ extern struct TCommonSettings
 	bool GFX3D_Renderer_TextureDeposterize;
 	bool GFX3D_Renderer_TextureSmoothing;
 	bool GFX3D_TXTHack;
+	bool GFX3D_GeometryThread; // execute GXFIFO commands on a worker thread
+	char GFX3D_Renderer_TextureDiskCachePath[MAX_PATH]; // directory for the persistent upscaled texture cache; empty to disable
 	
 	bool OpenGL_Emulation_ShadowPolygon;
 	bool OpenGL_Emulation_SpecialZeroAlphaBlending;
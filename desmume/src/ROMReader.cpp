@@ -27,6 +27,13 @@
 
 #include "utils/xstring.h"
 
+#ifdef WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
+
 #ifdef WIN32
 #define stat(...) _stat(__VA_ARGS__)
 #define S_IFMT _S_IFMT
@@ -373,3 +380,58 @@ ROMReader_struct * MemROMReaderRead_TrueInit(void* buf, int length)
 	mem.pos = 0;
 	return &MemROMReader;
 }
+
+bool ROMReaderMapImage(ROMReader_struct *reader, void *file, ROMReaderImage &outImage)
+{
+	outImage.data = NULL;
+	outImage.size = 0;
+	outImage.isMapped = false;
+
+	if (reader == &MemROMReader)
+	{
+		if (mem.buf == NULL || mem.len <= 0) return false;
+		outImage.data = (const u8 *)mem.buf;
+		outImage.size = (size_t)mem.len;
+		return true;
+	}
+
+	if (reader != &STDROMReader || file == NULL)
+		return false;
+
+	FILE *inf = ((STDROMReaderData*)file)->file;
+	const size_t size = STDROMReaderSize(file);
+	if (size == 0) return false;
+
+#ifdef WIN32
+	HANDLE mappingHandle = CreateFileMappingA((HANDLE)_get_osfhandle(_fileno(inf)), NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL) return false;
+
+	void *mappedData = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, size);
+	CloseHandle(mappingHandle);
+	if (mappedData == NULL) return false;
+#else
+	void *mappedData = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(inf), 0);
+	if (mappedData == MAP_FAILED) return false;
+#endif
+
+	outImage.data = (const u8 *)mappedData;
+	outImage.size = size;
+	outImage.isMapped = true;
+	return true;
+}
+
+void ROMReaderUnmapImage(ROMReaderImage &image)
+{
+	if (image.isMapped)
+	{
+#ifdef WIN32
+		UnmapViewOfFile((LPCVOID)image.data);
+#else
+		munmap((void *)image.data, image.size);
+#endif
+	}
+
+	image.data = NULL;
+	image.size = 0;
+	image.isMapped = false;
+}
@@ -55,4 +55,16 @@ extern ROMReader_struct ZIPROMReader;
 ROMReader_struct * ROMReaderInit(char ** filename);
 ROMReader_struct * MemROMReaderRead_TrueInit(void* buf, int length);
 
+//the whole image of a reader that sits on plain bytes (a file on disk, or memory), for scanning it in place.
+//decompressing readers can't provide one.
+typedef struct
+{
+	const u8 *data;
+	size_t size;
+	bool isMapped;
+} ROMReaderImage;
+
+bool ROMReaderMapImage(ROMReader_struct *reader, void *file, ROMReaderImage &outImage);
+void ROMReaderUnmapImage(ROMReaderImage &image);
+
 #endif // _ROMREADER_H_
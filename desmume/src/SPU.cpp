@@ -42,6 +42,9 @@
 #include "emufile.h"
 #include "matrix.h"
 #include "utils/bits.h"
+#include "utils/task.h"
+
+#include <rthreads/rthreads.h>
 
 
 static inline s16 read16(u32 addr) { return (s16)_MMU_read16<ARMCPU_ARM7,MMU_AT_DEBUG>(addr); }
@@ -75,11 +78,101 @@ static int _currentVolume = 100;
 static size_t _currentBufferSize = 0;
 static ESynchMode _currentSynchMode = ESynchMode_DualSynchAsynch;
 static ESynchMethod _currentSynchMethod = ESynchMethod_N;
+static bool _currentAudioOutputEnabled = true;
 
 static int _currentSNDCoreId = -1;
 static SoundInterface_struct *_currentSNDCore = NULL;
 extern SoundInterface_struct *SNDCoreList[];
 
+// Lock-free single-producer/single-consumer ring of stereo samples. The
+// emulation thread pushes each hline's mixed samples, and the audio thread
+// pops them when servicing the sound device.
+class SPUSampleRing
+{
+private:
+	s16 *_buffer;
+	u32 _capacity;
+	volatile s32 _writeCount;
+	volatile s32 _readCount;
+
+	u32 _LoadCount(volatile s32 *count) { return (u32)atomic_add_barrier32(count, 0); }
+
+public:
+	SPUSampleRing(u32 capacityPow2) : _capacity(capacityPow2), _writeCount(0), _readCount(0)
+	{
+		_buffer = new s16[capacityPow2 * 2];
+	}
+
+	~SPUSampleRing()
+	{
+		delete[] _buffer;
+	}
+
+	u32 Capacity() const { return _capacity; }
+	u32 Fill() { return _LoadCount(&_writeCount) - _LoadCount(&_readCount); }
+
+	// Returns the number of samples actually queued. Only call from the producer.
+	u32 Push(const s16 *samples, u32 sampleCount)
+	{
+		const u32 writeCount = _LoadCount(&_writeCount);
+		const u32 freeCount = _capacity - (writeCount - _LoadCount(&_readCount));
+		if (sampleCount > freeCount) sampleCount = freeCount;
+
+		for (u32 i = 0; i < sampleCount; i++)
+		{
+			const u32 slot = (writeCount + i) & (_capacity - 1);
+			_buffer[slot*2+0] = samples[i*2+0];
+			_buffer[slot*2+1] = samples[i*2+1];
+		}
+
+		atomic_add_barrier32(&_writeCount, (s32)sampleCount);
+		return sampleCount;
+	}
+
+	// Returns the number of samples actually dequeued. Only call from the consumer.
+	u32 Pop(s16 *samples, u32 sampleCount)
+	{
+		const u32 readCount = _LoadCount(&_readCount);
+		const u32 usedCount = _LoadCount(&_writeCount) - readCount;
+		if (sampleCount > usedCount) sampleCount = usedCount;
+
+		for (u32 i = 0; i < sampleCount; i++)
+		{
+			const u32 slot = (readCount + i) & (_capacity - 1);
+			samples[i*2+0] = _buffer[slot*2+0];
+			samples[i*2+1] = _buffer[slot*2+1];
+		}
+
+		atomic_add_barrier32(&_readCount, (s32)sampleCount);
+		return sampleCount;
+	}
+
+	// Only safe while the consumer is stopped.
+	void Reset()
+	{
+		_readCount = _writeCount;
+	}
+};
+
+#define SPU_AUDIO_RING_CAPACITY 16384 // ~370ms at 44100Hz; must be a power of two
+
+static Task *_audioThreadTask = NULL;
+static SPUSampleRing *_audioRing = NULL;
+static slock_t *_audioThreadMutex = slock_new();
+static scond_t *_audioThreadCondWork = scond_new();
+static slock_t *_audioDeviceMutex = slock_new();
+static bool _audioThreadEnabled = false;
+static bool _audioThreadIsRunning = false;
+static bool _audioThreadExit = false;
+static bool _audioThreadWorkPending = false;
+static SPUAudioThreadStats _audioThreadStats; // guarded by _audioThreadMutex
+static volatile s32 _audioThreadQueuedPending = 0; // added to by the emulation thread without locking,
+static volatile s32 _audioThreadDroppedPending = 0; // then folded into _audioThreadStats under the mutex
+
+static void SPU_StartAudioThread();
+static void SPU_StopAudioThread();
+static void SPU_ServiceSoundCore(SoundInterface_struct *soundProcessor);
+
 //const int shift = (FORMAT == 0 ? 2 : 1);
 static const int format_shift[] = { 2, 1, 3, 0 };
 static const u8 volume_shift[] = { 0, 1, 2, 4 };
@@ -142,6 +235,8 @@ int SPU_ChangeSoundCore(int coreid, int newBufferSizeBytes)
 
 	_currentBufferSize = newBufferSizeBytes;
 
+	SPU_StopAudioThread();
+
 	delete SPU_user; SPU_user = NULL;
 
 	// Make sure the old core is freed
@@ -253,10 +348,12 @@ void SPU_Pause(int pause)
 {
 	if (_currentSNDCore == NULL) return;
 
+	slock_lock(_audioDeviceMutex);
 	if (pause)
 		_currentSNDCore->MuteAudio();
 	else
 		_currentSNDCore->UnMuteAudio();
+	slock_unlock(_audioDeviceMutex);
 }
 
 void SPU_CloneUser()
@@ -270,6 +367,8 @@ void SPU_CloneUser()
 
 void SPU_SetSynchMode(int mode, int method)
 {
+	SPU_StopAudioThread();
+
 	_currentSynchMode = (ESynchMode)mode;
 	if (_currentSynchMethod != (ESynchMethod)method)
 	{
@@ -288,19 +387,185 @@ void SPU_SetSynchMode(int mode, int method)
 		SPU_user = new SPU_struct(_currentBufferSize);
 		SPU_CloneUser();
 	}
+
+	SPU_StartAudioThread();
+}
+
+int SPU_GetSynchMode()
+{
+	return (int)_currentSynchMode;
+}
+
+int SPU_GetSynchMethod()
+{
+	return (int)_currentSynchMethod;
+}
+
+void SPU_SetAudioOutputEnabled(bool theState)
+{
+	if (_currentAudioOutputEnabled == theState) return;
+	_currentAudioOutputEnabled = theState;
+
+	// SPU_user isn't advanced while output is disabled, so bring it back
+	// in line with the core before it starts producing samples again.
+	if (theState)
+		SPU_CloneUser();
+}
+
+bool SPU_IsAudioOutputEnabled()
+{
+	return _currentAudioOutputEnabled;
 }
 
 void SPU_ClearOutputBuffer()
 {
+	slock_lock(_audioDeviceMutex);
 	if (_currentSNDCore && _currentSNDCore->ClearBuffer)
 		_currentSNDCore->ClearBuffer();
+	slock_unlock(_audioDeviceMutex);
 }
 
 void SPU_SetVolume(int newVolume)
 {
 	_currentVolume = newVolume;
+	slock_lock(_audioDeviceMutex);
 	if (_currentSNDCore)
 		_currentSNDCore->SetVolume(newVolume);
+	slock_unlock(_audioDeviceMutex);
+}
+
+// Must be called with _audioThreadMutex held, so that there is only one drainer.
+static void SPU_DrainAudioThreadCounters()
+{
+	const s32 queuedCount = atomic_add_barrier32(&_audioThreadQueuedPending, 0);
+	const s32 droppedCount = atomic_add_barrier32(&_audioThreadDroppedPending, 0);
+	atomic_add_barrier32(&_audioThreadQueuedPending, -queuedCount);
+	atomic_add_barrier32(&_audioThreadDroppedPending, -droppedCount);
+
+	_audioThreadStats.queuedTotal += (u32)queuedCount;
+	_audioThreadStats.droppedSamples += (u32)droppedCount;
+}
+
+static void* SPU_AudioThreadLoop(void *arg)
+{
+	static s16 fetchBuffer[SPU_AUDIO_RING_CAPACITY * 2];
+
+	slock_lock(_audioThreadMutex);
+
+	while (!_audioThreadExit)
+	{
+		while (!_audioThreadWorkPending && !_audioThreadExit)
+			scond_wait(_audioThreadCondWork, _audioThreadMutex);
+
+		_audioThreadWorkPending = false;
+		slock_unlock(_audioThreadMutex);
+
+		SoundInterface_struct *soundProcessor = SPU_SoundCore();
+
+		slock_lock(_audioDeviceMutex);
+
+		const u32 queuedCount = _audioRing->Fill();
+		slock_lock(_audioThreadMutex);
+		SPU_DrainAudioThreadCounters();
+		_audioThreadStats.latencySamples = queuedCount;
+		if (queuedCount > _audioThreadStats.peakLatencySamples)
+			_audioThreadStats.peakLatencySamples = queuedCount;
+		slock_unlock(_audioThreadMutex);
+
+		const u32 fetchedCount = _audioRing->Pop(fetchBuffer, queuedCount);
+		if (soundProcessor != NULL && fetchedCount > 0)
+		{
+			if (soundProcessor->FetchSamples != NULL)
+				soundProcessor->FetchSamples(fetchBuffer, fetchedCount, _currentSynchMode, _currentSynchronizer);
+			else
+				SPU_DefaultFetchSamples(fetchBuffer, fetchedCount, _currentSynchMode, _currentSynchronizer);
+		}
+
+		if (soundProcessor != NULL)
+			SPU_ServiceSoundCore(soundProcessor);
+
+		slock_unlock(_audioDeviceMutex);
+
+		slock_lock(_audioThreadMutex);
+	}
+
+	slock_unlock(_audioThreadMutex);
+
+	return NULL;
+}
+
+// The audio thread owns the synchronizer, which is only used in Synchronous
+// mode. In Dual Synch/Asynch mode, SPU_user is mixed on demand and shares its
+// registers with the emulation thread, so servicing stays on the caller.
+static void SPU_StartAudioThread()
+{
+	if (!_audioThreadEnabled || _audioThreadIsRunning)
+		return;
+
+	if (_currentSynchMode != ESynchMode_Synchronous || _currentSNDCore == NULL || _currentSNDCore == &SNDDummy)
+		return;
+
+	if (_audioThreadTask == NULL)
+	{
+		_audioThreadTask = new Task();
+		_audioRing = new SPUSampleRing(SPU_AUDIO_RING_CAPACITY);
+	}
+
+	_audioRing->Reset();
+	_audioThreadExit = false;
+	_audioThreadWorkPending = false;
+
+	_audioThreadTask->start(false, 0, "SPU Output");
+	_audioThreadTask->execute(&SPU_AudioThreadLoop, NULL);
+	_audioThreadIsRunning = true;
+}
+
+static void SPU_StopAudioThread()
+{
+	if (!_audioThreadIsRunning)
+		return;
+
+	slock_lock(_audioThreadMutex);
+	_audioThreadExit = true;
+	scond_signal(_audioThreadCondWork);
+	slock_unlock(_audioThreadMutex);
+
+	_audioThreadTask->finish();
+	_audioThreadTask->shutdown();
+	_audioThreadIsRunning = false;
+}
+
+void SPU_SetAudioThreadEnabled(bool theState)
+{
+	if (_audioThreadEnabled == theState) return;
+	_audioThreadEnabled = theState;
+
+	if (theState)
+		SPU_StartAudioThread();
+	else
+		SPU_StopAudioThread();
+}
+
+bool SPU_IsAudioThreadRunning()
+{
+	return _audioThreadIsRunning;
+}
+
+void SPU_GetAudioThreadStats(SPUAudioThreadStats &outStats)
+{
+	slock_lock(_audioThreadMutex);
+	SPU_DrainAudioThreadCounters();
+	outStats = _audioThreadStats;
+	slock_unlock(_audioThreadMutex);
+	outStats.queuedSamples = (_audioRing != NULL) ? _audioRing->Fill() : 0;
+}
+
+void SPU_ResetAudioThreadStats()
+{
+	slock_lock(_audioThreadMutex);
+	SPU_DrainAudioThreadCounters();
+	_audioThreadStats = SPUAudioThreadStats();
+	slock_unlock(_audioThreadMutex);
 }
 
 
@@ -367,6 +632,8 @@ SPU_struct::~SPU_struct()
 
 void SPU_DeInit(void)
 {
+	SPU_StopAudioThread();
+
 	if (_currentSNDCore)
 		_currentSNDCore->DeInit();
 	_currentSNDCore = 0;
@@ -1298,6 +1565,79 @@ FORCEINLINE static void _SPU_ChanUpdate(const bool actuallyMix, SPU_struct* cons
 	}
 }
 
+// Advances a channel by a whole batch of output samples without generating
+// any PCM. Only the last SPUINTERPOLATION_TAPS fetched samples are observable
+// (through pcm16b), so the source position is stepped forward directly and
+// just the tail of the batch is actually fetched.
+template<int FORMAT> static void SPU_ChanSkip(SPU_struct* const SPU, channel_struct* const chan, const int length)
+{
+	const u64 sampcntFracTotal = (u64)chan->sampcntFrac + (u64)chan->sampincFrac * (u32)length;
+	const u32 nSamplesTotal = chan->sampincInt * (u32)length + (u32)(sampcntFracTotal >> 32);
+
+	if (FORMAT != 3)
+	{
+		// ADPCM has to decode every nibble to keep its predictor exact, and
+		// a channel that reaches its end inside this batch must key off on
+		// the exact output sample. Let the regular update loop handle those.
+		const s32 loopStep = chan->totlength_shifted - (chan->loopstart << format_shift[FORMAT]);
+		const bool reachesEnd = ((s64)chan->sampcntInt + nSamplesTotal) >= (s64)chan->totlength_shifted;
+		
+		if ( (FORMAT == 2) || (reachesEnd && ((chan->repeat != 1) || (loopStep <= 0))) )
+		{
+			____SPU_ChanUpdate<FORMAT,SPUInterpolation_None,-1>(SPU, chan);
+			return;
+		}
+	}
+
+	chan->sampcntFrac = (u32)sampcntFracTotal;
+
+	const u32 nSamplesToFetch = (nSamplesTotal < SPUINTERPOLATION_TAPS) ? nSamplesTotal : SPUINTERPOLATION_TAPS;
+	const u32 nSamplesToSkip = nSamplesTotal - nSamplesToFetch;
+
+	if (nSamplesToSkip > 0)
+	{
+		if (FORMAT == 3)
+		{
+			// Noise channels still need their LFSR stepped once per fetched sample.
+			if (chan->num >= 14)
+			{
+				const s64 firstFetched = (chan->sampcntInt < 0) ? -(s64)chan->sampcntInt : 0;
+				for (s64 i = firstFetched; i < (s64)nSamplesToSkip; i++)
+					chan->x = (chan->x & 0x1) ? ((chan->x >> 1) ^ 0x6000) : (chan->x >> 1);
+			}
+			chan->sampcntInt += nSamplesToSkip;
+		}
+		else
+		{
+			const s32 loopStart = chan->loopstart << format_shift[FORMAT];
+			s64 pos = (s64)chan->sampcntInt + nSamplesToSkip;
+			if (pos >= chan->totlength_shifted)
+				pos = loopStart + (pos - loopStart) % (chan->totlength_shifted - loopStart);
+			chan->sampcntInt = (s32)pos;
+		}
+
+		chan->pcm16bOffs += nSamplesToSkip;
+	}
+
+	for (u32 i = 0; i < nSamplesToFetch; i++)
+	{
+		s16 data = 0;
+		s32 pos = chan->sampcntInt;
+		switch(FORMAT)
+		{
+			case 0: data = Fetch8BitData (chan, pos); break;
+			case 1: data = Fetch16BitData(chan, pos); break;
+			case 3: data = FetchPSGData  (chan, pos); break;
+			default: break;
+		}
+		chan->pcm16bOffs++;
+		chan->pcm16b[SPUCHAN_PCM16B_AT(chan->pcm16bOffs)] = data;
+
+		chan->sampcntInt++;
+		if (FORMAT != 3) TestForLoop<FORMAT>(SPU, chan);
+	}
+}
+
 //ENTERNEW
 static void SPU_MixAudio_Advanced(bool actuallyMix, SPU_struct *SPU, int length)
 {
@@ -1512,6 +1852,47 @@ static void SPU_MixAudio_Advanced(bool actuallyMix, SPU_struct *SPU, int length)
 	SPU->sndbuf[1] = samp0[1];
 }
 
+//zero out capture buffers - effectively transform no-advanced-spu-emulation to capturing-zeroes
+//this is needed so when the option is changed (or a state with a different setting is loaded)
+//this code is bulkier and slower than it might otherwise be to reduce the chance of bugs 
+//IDEALLY the non-advanced codepath would be removed (while the advanced codepath was optimized and improved)
+//and this code would disappear, to be replaced with code more capable of emitting zeroes at the opportune time.
+static void SPU_CaptureZeroes(SPU_struct *SPU, int length)
+{
+	for (int capchan = 0; capchan < 2; capchan++)
+	{
+		SPU_struct::REGS::CAP& cap = SPU->regs.cap[capchan];
+		channel_struct& srcChan = SPU->channels[1 + 2 * capchan];
+		if (cap.runtime.running)
+		{
+			for (int samp = 0; samp < length; samp++)
+			{
+				u32 nSamplesToProcess = srcChan.sampincInt + AddAndReturnCarry(&cap.runtime.sampcntFrac, srcChan.sampincFrac);
+				cap.runtime.sampcntInt += nSamplesToProcess;
+				while (nSamplesToProcess--)
+				{
+					if (cap.bits8)
+					{
+						_MMU_write08<1,MMU_AT_DMA>(cap.runtime.curdad,0);
+						cap.runtime.curdad++;
+					}
+					else
+					{
+						_MMU_write16<1,MMU_AT_DMA>(cap.runtime.curdad,0);
+						cap.runtime.curdad+=2;
+					}
+
+					if (cap.runtime.curdad >= cap.runtime.maxdad)
+					{
+						cap.runtime.curdad = cap.dad;
+						cap.runtime.sampcntInt -= cap.len*(cap.bits8?4:2);
+					}
+				}
+			}
+		}
+	}
+}
+
 //ENTER
 static void SPU_MixAudio(bool actuallyMix, SPU_struct *SPU, int length)
 {
@@ -1553,43 +1934,7 @@ static void SPU_MixAudio(bool actuallyMix, SPU_struct *SPU, int length)
 			_SPU_ChanUpdate(!CommonSettings.spu_muteChannels[i] && actuallyMix, SPU, chan);
 		}
 
-		//zero out capture buffers - effectively transform no-advanced-spu-emulation to capturing-zeroes
-		//this is needed so when the option is changed (or a state with a different setting is loaded)
-		//this code is bulkier and slower than it might otherwise be to reduce the chance of bugs 
-		//IDEALLY the non-advanced codepath would be removed (while the advanced codepath was optimized and improved)
-		//and this code would disappear, to be replaced with code more capable of emitting zeroes at the opportune time.
-		for (int capchan = 0; capchan < 2; capchan++)
-		{
-			SPU_struct::REGS::CAP& cap = SPU->regs.cap[capchan];
-			channel_struct& srcChan = SPU->channels[1 + 2 * capchan];
-			if (cap.runtime.running)
-			{
-				for (int samp = 0; samp < length; samp++)
-				{
-					u32 nSamplesToProcess = srcChan.sampincInt + AddAndReturnCarry(&cap.runtime.sampcntFrac, srcChan.sampincFrac);
-					cap.runtime.sampcntInt += nSamplesToProcess;
-					while (nSamplesToProcess--)
-					{
-						if (cap.bits8)
-						{
-							_MMU_write08<1,MMU_AT_DMA>(cap.runtime.curdad,0);
-							cap.runtime.curdad++;
-						}
-						else
-						{
-							_MMU_write16<1,MMU_AT_DMA>(cap.runtime.curdad,0);
-							cap.runtime.curdad+=2;
-						}
-
-						if (cap.runtime.curdad >= cap.runtime.maxdad)
-						{
-							cap.runtime.curdad = cap.dad;
-							cap.runtime.sampcntInt -= cap.len*(cap.bits8?4:2);
-						}
-					}
-				}
-			}
-		}
+		SPU_CaptureZeroes(SPU, length);
 	} //non-advanced branch
 
 	//we used to bail out if speakers were disabled.
@@ -1616,6 +1961,47 @@ static void SPU_MixAudio(bool actuallyMix, SPU_struct *SPU, int length)
 
 //////////////////////////////////////////////////////////////////////////////
 
+// Advances the SPU state exactly as SPU_MixAudio(false, ...) would, but without
+// producing any PCM. Used when audio output is disabled.
+static void SPU_AdvanceAudio(SPU_struct *SPU, int length)
+{
+	if(!SPU->regs.masteren) return;
+
+	// In advanced mode, the capture units record the actual mixer output,
+	// so we can only skip mixing while neither of them is running.
+	if (CommonSettings.spu_advanced && SPU == SPU_core)
+	{
+		if (SPU->regs.cap[0].runtime.running || SPU->regs.cap[1].runtime.running)
+		{
+			SPU_MixAudio_Advanced(false, SPU, length);
+			return;
+		}
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		channel_struct *chan = &SPU->channels[i];
+
+		if (chan->status != CHANSTAT_PLAY)
+			continue;
+
+		SPU->bufpos = 0;
+		SPU->buflength = length;
+
+		switch(chan->format)
+		{
+			case 0: SPU_ChanSkip<0>(SPU, chan, length); break;
+			case 1: SPU_ChanSkip<1>(SPU, chan, length); break;
+			case 2: SPU_ChanSkip<2>(SPU, chan, length); break;
+			case 3: SPU_ChanSkip<3>(SPU, chan, length); break;
+			default: assert(false);
+		}
+	}
+
+	if (!CommonSettings.spu_advanced || SPU != SPU_core)
+		SPU_CaptureZeroes(SPU, length);
+}
+
 
 //emulates one hline of the cpu core.
 //this will produce a variable number of samples, calculated to keep a 44100hz output
@@ -1629,6 +2015,15 @@ void SPU_Emulate_core()
 	spu_core_samples = (int)(_samples);
 	_samples -= spu_core_samples;
 	
+	// With audio output disabled, nobody will ever hear these samples, so just
+	// advance the SPU state. Recording still needs the real audio, though.
+	if ( !_currentAudioOutputEnabled &&
+		!(driver->AVI_IsRecording() || driver->WAV_IsRecording()) )
+	{
+		SPU_AdvanceAudio(SPU_core, spu_core_samples);
+		return;
+	}
+	
 	// We don't need to mix audio for Dual Synch/Asynch mode since we do this
 	// later in SPU_Emulate_user(). Disable mixing here to speed up processing.
 	// However, recording still needs to mix the audio, so make sure we're also
@@ -1646,6 +2041,16 @@ void SPU_Emulate_core()
 		return;
 	}
 	
+	// Leave the synchronizer to the audio thread, which will pick up these
+	// samples the next time SPU_Emulate_user() wakes it.
+	if (_audioThreadIsRunning)
+	{
+		const u32 queuedCount = _audioRing->Push(SPU_core->outbuf, spu_core_samples);
+		atomic_add_barrier32(&_audioThreadQueuedPending, (s32)queuedCount);
+		atomic_add_barrier32(&_audioThreadDroppedPending, (s32)(spu_core_samples - queuedCount));
+		return;
+	}
+	
 	if (soundProcessor->FetchSamples != NULL)
 	{
 		soundProcessor->FetchSamples(SPU_core->outbuf, spu_core_samples, _currentSynchMode, _currentSynchronizer);
@@ -1656,18 +2061,12 @@ void SPU_Emulate_core()
 	}
 }
 
-void SPU_Emulate_user(bool mix)
+static void SPU_ServiceSoundCore(SoundInterface_struct *soundProcessor)
 {
 	static s16 *postProcessBuffer = NULL;
 	static size_t postProcessBufferSize = 0;
 	size_t freeSampleCount = 0;
 	size_t processedSampleCount = 0;
-	SoundInterface_struct *soundProcessor = SPU_SoundCore();
-	
-	if (soundProcessor == NULL)
-	{
-		return;
-	}
 	
 	// Check to see how many free samples are available.
 	// If there are some, fill up the output buffer.
@@ -1700,10 +2099,42 @@ void SPU_Emulate_user(bool mix)
 		processedSampleCount = SPU_DefaultPostProcessSamples(postProcessBuffer, freeSampleCount, _currentSynchMode, _currentSynchronizer);
 	}
 	
+	if (processedSampleCount < freeSampleCount)
+	{
+		slock_lock(_audioThreadMutex);
+		_audioThreadStats.underruns++;
+		_audioThreadStats.underrunSamples += freeSampleCount - processedSampleCount;
+		slock_unlock(_audioThreadMutex);
+	}
+	
 	soundProcessor->UpdateAudio(postProcessBuffer, processedSampleCount);
 	WAV_WavSoundUpdate(postProcessBuffer, processedSampleCount, WAVMODE_USER);
 }
 
+void SPU_Emulate_user(bool mix)
+{
+	SoundInterface_struct *soundProcessor = SPU_SoundCore();
+	
+	if (soundProcessor == NULL || !_currentAudioOutputEnabled)
+	{
+		return;
+	}
+	
+	// When the audio thread is running, all we need to do is to wake it up.
+	if (_audioThreadIsRunning)
+	{
+		slock_lock(_audioThreadMutex);
+		_audioThreadWorkPending = true;
+		scond_signal(_audioThreadCondWork);
+		slock_unlock(_audioThreadMutex);
+		return;
+	}
+	
+	slock_lock(_audioDeviceMutex);
+	SPU_ServiceSoundCore(soundProcessor);
+	slock_unlock(_audioDeviceMutex);
+}
+
 void SPU_DefaultFetchSamples(s16 *sampleBuffer, size_t sampleCount, ESynchMode synchMode, ISynchronizingAudioBuffer *theSynchronizer)
 {
 	if (synchMode == ESynchMode_Synchronous)
@@ -1872,22 +2303,30 @@ bool WavWriter::isRecording() const
 
 
 static WavWriter wavWriter;
+static slock_t *wavWriterMutex = slock_new(); // user mode WAVs are written from the audio thread
 
 void WAV_End()
 {
+	slock_lock(wavWriterMutex);
 	wavWriter.close();
+	slock_unlock(wavWriterMutex);
 }
 
 bool WAV_Begin(const char* fname, WAVMode mode)
 {
 	WAV_End();
 
+	slock_lock(wavWriterMutex);
 	if(!wavWriter.open(fname))
+	{
+		slock_unlock(wavWriterMutex);
 		return false;
+	}
 
 	if(mode == WAVMODE_ANY)
 		mode = WAVMODE_CORE;
 	wavWriter.mode = mode;
+	slock_unlock(wavWriterMutex);
 
 	driver->USR_InfoMessage("WAV recording started.");
 
@@ -1903,8 +2342,13 @@ bool WAV_IsRecording(WAVMode mode)
 
 void WAV_WavSoundUpdate(void* soundData, int numSamples, WAVMode mode)
 {
+	if(!wavWriter.isRecording())
+		return;
+
+	slock_lock(wavWriterMutex);
 	if(wavWriter.mode == mode || mode == WAVMODE_ANY)
 		wavWriter.update(soundData, numSamples);
+	slock_unlock(wavWriterMutex);
 }
 
 
@@ -222,6 +222,22 @@ public:
    void ShutUp();
 };
 
+struct SPUAudioThreadStats
+{
+	SPUAudioThreadStats()
+		: queuedTotal(0), droppedSamples(0), underruns(0), underrunSamples(0)
+		, latencySamples(0), peakLatencySamples(0), queuedSamples(0)
+	{}
+
+	u64 queuedTotal;        // samples handed from the emulation thread to the audio thread
+	u64 droppedSamples;     // samples lost because the ring was full
+	u64 underruns;          // device requests that couldn't be completely filled
+	u64 underrunSamples;
+	u32 latencySamples;     // ring fill when the audio thread last woke up
+	u32 peakLatencySamples;
+	u32 queuedSamples;      // current ring fill
+};
+
 extern SPU_struct *SPU_core, *SPU_user;
 extern int spu_core_samples;
 
@@ -233,6 +249,14 @@ int SPU_Init(int coreid, int newBufferSizeBytes);
 void SPU_Pause(int pause);
 void SPU_SetVolume(int newVolume);
 void SPU_SetSynchMode(int mode, int method);
+int SPU_GetSynchMode();
+int SPU_GetSynchMethod();
+void SPU_SetAudioOutputEnabled(bool theState);
+bool SPU_IsAudioOutputEnabled();
+void SPU_SetAudioThreadEnabled(bool theState);
+bool SPU_IsAudioThreadRunning();
+void SPU_GetAudioThreadStats(SPUAudioThreadStats &outStats);
+void SPU_ResetAudioThreadStats();
 void SPU_ClearOutputBuffer(void);
 void SPU_Reset(void);
 void SPU_DeInit(void);
@@ -95,34 +95,204 @@ BOOL CHEATS::move(u32 srcPos, u32 dstPos)
 #define CHEATLOG(...) 
 //#define CHEATLOG(...) printf(__VA_ARGS__)
 
-static void CheatWrite(int size, int proc, u32 addr, u32 val)
+//main RAM is read and written through host memory directly; everything else goes through the MMU
+static FORCEINLINE u8* CheatHostPtr(int size, int proc, u32 addr)
 {
-	bool dirty = true;
+	if ((addr & 0x0F000000) != 0x02000000)
+		return NULL;
+
+	//the DTCM takes priority over main RAM for the ARM9
+	if (proc == ARMCPU_ARM9 && (addr & ~0x3FFF) == MMU.DTCMRegion)
+		return NULL;
+
+	if (size == 8) return &MMU.MAIN_MEM[addr & _MMU_MAIN_MEM_MASK];
+	if (size == 16) return &MMU.MAIN_MEM[addr & _MMU_MAIN_MEM_MASK16];
+	return &MMU.MAIN_MEM[addr & _MMU_MAIN_MEM_MASK32];
+}
+
+static FORCEINLINE u32 CheatHostRead(int size, u8 *hostPtr)
+{
+	if (size == 8) return T1ReadByte(hostPtr, 0);
+	if (size == 16) return T1ReadWord_guaranteedAligned(hostPtr, 0);
+	return T1ReadLong_guaranteedAligned(hostPtr, 0);
+}
+
+static FORCEINLINE void CheatHostWrite(int size, u32 addr, u8 *hostPtr, u32 val)
+{
+#ifdef HAVE_JIT
+	if (size == 8) JIT_COMPILED_FUNC_KNOWNBANK(addr, MAIN_MEM, _MMU_MAIN_MEM_MASK, 0) = 0;
+	if (size == 16) JIT_COMPILED_FUNC_KNOWNBANK(addr, MAIN_MEM, _MMU_MAIN_MEM_MASK16, 0) = 0;
+	if (size == 32)
+	{
+		JIT_COMPILED_FUNC_KNOWNBANK(addr, MAIN_MEM, _MMU_MAIN_MEM_MASK32, 0) = 0;
+		JIT_COMPILED_FUNC_KNOWNBANK(addr, MAIN_MEM, _MMU_MAIN_MEM_MASK32, 1) = 0;
+	}
+#endif
 
-	bool isDangerous = false;
-	if(addr >= 0x02000000 && addr < 0x02400000)
-		isDangerous = true;
+	if (size == 8) T1WriteByte(hostPtr, 0, val);
+	if (size == 16) T1WriteWord(hostPtr, 0, val);
+	if (size == 32) T1WriteLong(hostPtr, 0, val);
 
-	if(isDangerous)
+#ifdef HAVE_LUA
+	CallRegisteredLuaMemHook(addr, size / 8, val, LUAMEMHOOK_WRITE);
+#endif
+#ifdef TARGET_INTERFACE
+	call_registered_interface_mem_hook(addr, size / 8, HOOK_WRITE);
+#endif
+}
+
+static u32 CheatRead(int size, int proc, u32 addr)
+{
+	u8 *hostPtr = CheatHostPtr(size, proc, addr);
+
+	if (hostPtr == NULL)
 	{
-		//test dirtiness
-		if(size == 8) dirty = _MMU_read08(proc, MMU_AT_DEBUG, addr) != val;
-		if(size == 16) dirty = _MMU_read16(proc, MMU_AT_DEBUG, addr) != val;
-		if(size == 32) dirty = _MMU_read32(proc, MMU_AT_DEBUG, addr) != val;
+		if(size == 8) return _MMU_read08(proc, MMU_AT_DEBUG, addr);
+		if(size == 16) return _MMU_read16(proc, MMU_AT_DEBUG, addr);
+		return _MMU_read32(proc, MMU_AT_DEBUG, addr);
 	}
 
-	if(!dirty) return;
+#ifdef HAVE_LUA
+	CallRegisteredLuaMemHook(addr, size / 8, /*FIXME*/ 0, LUAMEMHOOK_READ);
+#endif
+#ifdef TARGET_INTERFACE
+	call_registered_interface_mem_hook(addr, size / 8, HOOK_READ);
+#endif
+	return CheatHostRead(size, hostPtr);
+}
+
+static void CheatWrite(int size, int proc, u32 addr, u32 val)
+{
+	u8 *hostPtr = CheatHostPtr(size, proc, addr);
+
+	if (hostPtr == NULL)
+	{
+		if(size == 8) _MMU_write08(proc, MMU_AT_DEBUG, addr, val);
+		if(size == 16) _MMU_write16(proc, MMU_AT_DEBUG, addr, val);
+		if(size == 32) _MMU_write32(proc, MMU_AT_DEBUG, addr, val);
+		return;
+	}
 
-	if(size == 8) _MMU_write08(proc, MMU_AT_DEBUG, addr, val);
-	if(size == 16) _MMU_write16(proc, MMU_AT_DEBUG, addr, val);
-	if(size == 32) _MMU_write32(proc, MMU_AT_DEBUG, addr, val);
+	//main RAM is dangerous to the JIT, so only write (and reset it) if the value changes
+	if (size == 8) val &= 0xFF;
+	if (size == 16) val &= 0xFFFF;
+	if (CheatHostRead(size, hostPtr) == val)
+		return;
 
-	if(isDangerous)
-		cheatsResetJit = true;
+	CheatHostWrite(size, addr, hostPtr, val);
+	cheatsResetJit = true;
 }
 
+void CHEATS::ARcompile(const CHEATS_LIST& theList, CHEATS_COMPILED_CHEAT& compiledCheat)
+{
+	//every line is decoded, including E code parameters, since loops and the
+	//E code line skipping below address the code by line, same as the AR does
+	compiledCheat.opIndex = compiledOps.size();
+	compiledCheat.opCount = theList.num;
+
+	for (u32 i = 0; i < theList.num; i++)
+	{
+		const u32 hi = theList.code[i][0];
+		const u32 lo = theList.code[i][1];
+		CHEATS_COMPILED_OP op;
+
+		memset(&op, 0, sizeof(op));
+
+		//parse codes into types by kodewerx standards
+		op.type = hi >> 28;
+		//these two are broken down into subtypes
+		if(op.type == 0x0C || op.type == 0x0D)
+			op.type = hi >> 24;
+
+		switch(op.type)
+		{
+		case 0x01:
+			op.x = hi & 0x0FFFFFFF;
+			op.y = lo & 0xFFFF;
+			break;
+
+		case 0x02:
+			op.x = hi & 0x0FFFFFFF;
+			op.y = lo & 0xFF;
+			break;
+
+		case 0x07: case 0x08: case 0x09: case 0x0A:
+			op.x = hi & 0x0FFFFFFF;
+			op.y = lo & 0xFFFF;
+			op.z = lo >> 16;
+			break;
+
+		case 0x00: case 0x03: case 0x04: case 0x05: case 0x06:
+		case 0x0B: case 0x0F:
+			op.x = hi & 0x0FFFFFFF;
+			op.y = lo;
+			break;
+
+		case 0xC0: case 0xC4: case 0xC5: case 0xC6:
+		case 0xD0: case 0xD1: case 0xD2: case 0xD3: case 0xD4: case 0xD5: case 0xD6:
+		case 0xD7: case 0xD8: case 0xD9: case 0xDA: case 0xDB: case 0xDC:
+			op.x = lo;
+			op.y = lo;
+			break;
+
+		case 0xDF:
+			op.x = hi;
+			op.y = lo;
+			break;
+
+		case 0x0E:
+			{
+				//gather the YYYYYYYY parameter bytes following the code, copied as
+				//words and then the odd bytes, and the line where the parameters end
+				u32 j = i, t = 0, b = 0, ofs = 0;
+				u32 y = lo;
+
+				op.x = hi & 0x0FFFFFFF;
+				op.y = lo;
+				op.writeIndex = compiledWrites.size();
+				op.skipNext = i + (lo + 7) / 8;
+
+				if(y>0) j++; //skip over the current code
+				while(y>=4)
+				{
+					if (j == theList.num) break; //if we erroneously went off the end, bail
+					CHEATS_COMPILED_WRITE write = { 32, ofs, theList.code[j][t] };
+					compiledWrites.push_back(write);
+					if (t == 1) j++;
+					t ^= 1;
+					ofs += 4;
+					y -= 4;
+				}
+				while(y>0)
+				{
+					if (j == theList.num) break; //if we erroneously went off the end, bail
+					CHEATS_COMPILED_WRITE write = { 8, ofs, (theList.code[j][t]>>b) & 0xFF };
+					compiledWrites.push_back(write);
+					ofs += 1;
+					y -= 1;
+					b += 4;
+				}
+
+				//the main loop will increment to the next cheat, but the loop above may have gone one too far
+				if(t==0)
+					j--;
+
+				//an empty patch would otherwise be executed again forever
+				op.execNext = (j + 1 > i) ? j : i;
+				op.writeCount = compiledWrites.size() - op.writeIndex;
+			}
+			break;
+
+		default:
+			printf("AR: ERROR unknown command %08X %08X\n", hi, lo);
+			break;
+		}
+
+		compiledOps.push_back(op);
+	}
+}
 
-void CHEATS::ARparser(CHEATS_LIST& theList)
+void CHEATS::ARexecute(const CHEATS_COMPILED_CHEAT& compiledCheat)
 {
 	//primary organizational source (seems to be referenced by cheaters the most) - http://doc.kodewerx.org/hacking_nds.html
 	//secondary clarification and details (for programmers) - http://problemkaputt.de/gbatek.htm#dscartcheatactionreplayds
@@ -168,18 +338,15 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 
 	CHEATLOG("-----------------------------------\n");
 
-	for (u32 i = 0; i < theList.num; i++)
-	{
-		const u32 hi = theList.code[i][0];
-		const u32 lo = theList.code[i][1];
+	const CHEATS_COMPILED_OP *ops = &compiledOps[compiledCheat.opIndex];
+	const u32 num = compiledCheat.opCount;
 
-		CHEATLOG("executing [%02d] %08X %08X (ofs=%08X)\n",i, hi,lo, st.offset);
+	for (u32 i = 0; i < num; i++)
+	{
+		const CHEATS_COMPILED_OP &op = ops[i];
+		const u32 type = op.type;
 
-		//parse codes into types by kodewerx standards
-		u32 type = theList.code[i][0] >> 28;
-		//these two are broken down into subtypes
-		if(type == 0x0C || type == 0x0D)
-			type = theList.code[i][0] >> 24;
+		CHEATLOG("executing [%02d] type %02X (ofs=%08X)\n",i, type, st.offset);
 
 		//process current execution status:
 		u32 statusSkip = st.status & 1;
@@ -198,7 +365,7 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 		{
 			if (statusSkip) {
 				CHEATLOG(" (skip multiple lines!)\n");
-				i += (lo + 7) / 8;
+				i = op.skipNext;
 				continue;
 			}
 		}
@@ -210,9 +377,10 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			}
 		}
 
-		u32 operand,x,y,z,addr;
+		u32 operand,addr;
+		u32 x = op.x, y = op.y, z = op.z;
 
-		switch(type)
+		switch(op.type)
 		{
 		case 0x00:
 			//(hi == 0x00000000) implies: "manual hook code" -- sometimes
@@ -222,8 +390,6 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//32-bit (Constant RAM Writes)
 			//0XXXXXXX YYYYYYYY
 			//Writes word YYYYYYYY to [XXXXXXX+offset].
-			x = hi & 0x0FFFFFFF;
-			y = lo;
 			addr = x + st.offset;
 			CheatWrite(32,st.proc,addr, y);
 			break;
@@ -232,8 +398,6 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//16-bit (Constant RAM Writes)
 			//1XXXXXXX 0000YYYY
 			//Writes halfword YYYY to [XXXXXXX+offset].
-			x = hi & 0x0FFFFFFF;
-			y = lo & 0xFFFF;
 			addr = x + st.offset;
 			CheatWrite(16,st.proc,addr, y);
 			break;
@@ -242,8 +406,6 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//8-bit (Constant RAM Writes)
 			//2XXXXXXX 000000YY
 			//Writes byte YY to [XXXXXXX+offset].
-			x = hi & 0x0FFFFFFF;
-			y = lo & 0xFF;
 			addr = x + st.offset;
 			CheatWrite(8,st.proc,addr, y);
 			break;
@@ -253,10 +415,8 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//3XXXXXXX YYYYYYYY
 			//Checks if YYYYYYYY > (word at [XXXXXXX])
 			//If not, the code(s) following this one are not executed (ie. execution status is set to false) until a code type D0 or D2 is encountered, or until the end of the code list is reached.
-			x = hi & 0x0FFFFFFF;
-			y = lo;
 			if(v154) if(x == 0) x = st.offset;
-			operand = _MMU_read32(st.proc,MMU_AT_DEBUG,x);
+			operand = CheatRead(32,st.proc,x);
 			if(y > operand) st.status &= ~1;
 			break;
 
@@ -265,10 +425,8 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//4XXXXXXX YYYYYYYY
 			//Checks if YYYYYYYY < (word at [XXXXXXX])
 			//If not, the code(s) following this one are not executed (ie. execution status is set to false) until a code type D0 or D2 is encountered, or until the end of the code list is reached.
-			x = hi & 0x0FFFFFFF;
-			y = lo;
 			if(v154) if(x == 0) x = st.offset;
-			operand = _MMU_read32(st.proc,MMU_AT_DEBUG,x);
+			operand = CheatRead(32,st.proc,x);
 			if(y < operand) st.status &= ~1;
 			break;
 
@@ -277,10 +435,8 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//5XXXXXXX YYYYYYYY
 			//Checks if YYYYYYYY == (word at [XXXXXXX])
 			//If not, the code(s) following this one are not executed (ie. execution status is set to false) until a code type D0 or D2 is encountered, or until the end of the code list is reached.
-			x = hi & 0x0FFFFFFF;
-			y = lo;
 			if(v154) if(x == 0) x = st.offset;
-			operand = _MMU_read32(st.proc,MMU_AT_DEBUG,x);
+			operand = CheatRead(32,st.proc,x);
 			if(y == operand) st.status &= ~1;
 			break;
 
@@ -289,10 +445,8 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//6XXXXXXX YYYYYYYY
 			//Checks if YYYYYYYY != (word at [XXXXXXX])
 			//If not, the code(s) following this one are not executed (ie. execution status is set to false) until a code type D0 or D2 is encountered, or until the end of the code list is reached.
-			x = hi & 0x0FFFFFFF;
-			y = lo;
 			if(v154) if(x == 0) x = st.offset;
-			operand = _MMU_read32(st.proc,MMU_AT_DEBUG,x);
+			operand = CheatRead(32,st.proc,x);
 			if(y != operand) st.status &= ~1;
 			break;
 
@@ -301,11 +455,8 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//7XXXXXXX ZZZZYYYY
 			//Checks if (YYYY) > (not (ZZZZ) & halfword at [XXXX]).
 			//If not, the code(s) following this one are not executed (ie. execution status is set to false) until a code type D0 or D2 is encountered, or until the end of the code list is reached.
-			x = hi & 0x0FFFFFFF;
-			y = lo&0xFFFF;
-			z = lo>>16;
 			if(v154) if(x == 0) x = st.offset;
-			operand = _MMU_read16(st.proc,MMU_AT_DEBUG,x);
+			operand = CheatRead(16,st.proc,x);
 			if(y > (u16)( (~z) & operand) ) st.status &= ~1;
 			break;
 
@@ -314,11 +465,8 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//8XXXXXXX ZZZZYYYY
 			//Checks if (YYYY) < (not (ZZZZ) & halfword at [XXXX]).
 			//If not, the code(s) following this one are not executed (ie. execution status is set to false) until a code type D0 or D2 is encountered, or until the end of the code list is reached.
-			x = hi & 0x0FFFFFFF;
-			y = lo&0xFFFF;
-			z = lo>>16;
 			if(v154) if(x == 0) x = st.offset;
-			operand = _MMU_read16(st.proc,MMU_AT_DEBUG,x);
+			operand = CheatRead(16,st.proc,x);
 			if(y < (u16)( (~z) & operand) ) st.status &= ~1;
 			break;
 
@@ -327,11 +475,8 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//9XXXXXXX ZZZZYYYY
 			//Checks if (YYYY) == (not (ZZZZ) & halfword at [XXXX]).
 			//If not, the code(s) following this one are not executed (ie. execution status is set to false) until a code type D0 or D2 is encountered, or until the end of the code list is reached.
-			x = hi & 0x0FFFFFFF;
-			y = lo&0xFFFF;
-			z = lo>>16;
 			if(v154) if(x == 0) x = st.offset;
-			operand = _MMU_read16(st.proc,MMU_AT_DEBUG,x);
+			operand = CheatRead(16,st.proc,x);
 			if(y == (u16)( (~z) & operand) ) st.status &= ~1;
 			break;
 
@@ -340,11 +485,8 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//AXXXXXXX ZZZZYYYY
 			//Checks if (YYYY) != (not (ZZZZ) & halfword at [XXXX]).
 			//If not, the code(s) following this one are not executed (ie. execution status is set to false) until a code type D0 or D2 is encountered, or until the end of the code list is reached.
-			x = hi & 0x0FFFFFFF;
-			y = lo&0xFFFF;
-			z = lo>>16;
 			if(v154) if(x == 0) x = st.offset;
-			operand = _MMU_read16(st.proc,MMU_AT_DEBUG,x);
+			operand = CheatRead(16,st.proc,x);
 			if(y != (u16)( (~z) & operand) ) st.status &= ~1;
 			break;
 
@@ -353,9 +495,8 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//BXXXXXXX 00000000
 			//Loads the 32-bit value into the 'offset'.
 			//Offset = word at [0XXXXXXX + offset].
-			x = hi & 0x0FFFFFFF;
 			addr = x + st.offset;
-			st.offset = _MMU_read32(st.proc,MMU_AT_DEBUG,addr);
+			st.offset = CheatRead(32,st.proc,addr);
 			break;
 
 		case 0xC0:
@@ -364,7 +505,6 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//This sets the 'Dx repeat value' to YYYYYYYY and saves the 'Dx nextcode to be executed' and the 'Dx execution status'. Repeat will be executed when a D1/D2 code is encountered.
 			//When repeat is executed, the AR reloads the 'next code to be executed' and the 'execution status' from the Dx registers.
 			//<gbatek> FOR loopcount=0 to YYYYYYYY  ;execute Y+1 times
-			y = lo;
 			st.loop.idx = 0; //<gbatek> any FOR statement does forcefully terminate any prior loop
 			st.loop.iterations = y;
 			st.loop.top = i; //current instruction is saved as top for branching back up
@@ -394,7 +534,6 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//Store Offset  (trainer toolkit codes)
 			//<gbatek> C6000000 XXXXXXXX   [XXXXXXXX]=offset  
 			if(!v154) break;
-			x = lo;
 			CheatWrite(32,st.proc,x, st.offset);
 			break;
 
@@ -448,7 +587,6 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//Set offset (Offset Codes)
 			//D3000000 XXXXXXXX
 			//Sets the offset value to XXXXXXXX.
-			x = lo;
 			st.offset = x;
 			break;
 
@@ -457,7 +595,6 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//D4000000 XXXXXXXX 
 			//Adds 'XXXXXXXX' to the data register used by codetypes 0xD6 - 0xDB.
 			//<gbatek> datareg = datareg + XXXXXXXX
-			x = lo;
 			st.data += x;
 			break;
 
@@ -465,7 +602,6 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//Set Value (Data Register Codes)
 			//D5000000 XXXXXXXX 
 			//Set 'XXXXXXXX' to the data register used by code types 0xD6 - 0xD8.
-			x = lo;
 			st.data = x;
 			break;
 
@@ -474,7 +610,6 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//D6000000 XXXXXXXX 
 			//Writes the 'Dx data' word to [XXXXXXXX+offset], and increments the offset by 4.
 			//<gbatek> word[XXXXXXXX+offset]=datareg, offset=offset+4
-			x = lo;
 			addr = x + st.offset;
 			CheatWrite(32,st.proc,addr, st.data);
 			st.offset += 4;
@@ -485,7 +620,6 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//D7000000 XXXXXXXX 
 			//Writes the 'Dx data' halfword to [XXXXXXXX+offset], and increments the offset by 2.
 			//<gbatek> half[XXXXXXXX+offset]=datareg, offset=offset+2
-			x = lo;
 			addr = x + st.offset;
 			CheatWrite(16,st.proc,addr, st.data);
 			st.offset += 2;
@@ -496,7 +630,6 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//D8000000 XXXXXXXX 
 			//Writes the 'Dx data' byte to [XXXXXXXX+offset], and increments the offset by 1.
 			//<gbatek> byte[XXXXXXXX+offset]=datareg, offset=offset+1
-			x = lo;
 			addr = x + st.offset;
 			CheatWrite(8,st.proc,addr, st.data);
 			st.offset += 1;
@@ -506,18 +639,16 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//32-Bit Load (Data Register Codes)
 			//D9000000 XXXXXXXX 
 			//Loads the word at [XXXXXXXX+offset] and stores it in the'Dx data register'.
-			x = lo;
 			addr = x + st.offset;
-			st.data = _MMU_read32(st.proc,MMU_AT_DEBUG,addr);
+			st.data = CheatRead(32,st.proc,addr);
 			break;
 
 		case 0xDA:
 			//16-Bit Load (Data Register Codes)
 			//DA000000 XXXXXXXX 
 			//Loads the halfword at [XXXXXXXX+offset] and stores it in the'Dx data register'.
-			x = lo;
 			addr = x + st.offset;
-			st.data = _MMU_read16(st.proc,MMU_AT_DEBUG,addr);
+			st.data = CheatRead(16,st.proc,addr);
 			break;
 
 		case 0xDB:
@@ -525,9 +656,8 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//DB000000 XXXXXXXX 
 			//Loads the byte at [XXXXXXXX+offset] and stores it in the'Dx data register'.
 			//This is a bugged code type. Check 'AR Hack #0' for the fix. 
-			x = lo;
 			addr = x + st.offset;
-			st.data = _MMU_read08(st.proc,MMU_AT_DEBUG,addr);
+			st.data = CheatRead(8,st.proc,addr);
 			//<gbatek> Before v1.54, the DB000000 code did accidently set offset=offset+XXXXXXX after execution of the code
 			if(!v154)
 				st.offset = addr;
@@ -537,17 +667,16 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//Set offset (Offset Codes)
 			//DC000000 XXXXXXXX
 			//Adds an offset to the current offset. (Dual Offset)
-			x = lo;
 			st.offset += x;
 			break;
 
 		case 0xDF:
 			if(vEmulator)
 			{
-				if(hi == 0xDFFFFFFF) {
-					if(lo == 0x99999999)
+				if(x == 0xDFFFFFFF) {
+					if(y == 0x99999999)
 						st.proc = ARMCPU_ARM9;
-					else if(lo == 0x77777777)
+					else if(y == 0x77777777)
 						st.proc = ARMCPU_ARM7;
 				}
 			}
@@ -560,37 +689,14 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//<gbatek> Copy YYYYYYYY parameter bytes to [XXXXXXXX+offset...]
 			//<gbatek> For the COPY commands, addresses should be aligned by four (all data is copied with ldr/str, except, on odd lengths, the last 1..3 bytes do use ldrb/strb).
 			//attempting to emulate logic the way they may have implemented it, just in case
-			x = hi & 0x0FFFFFFF;
-			y = lo;
+			//the parameter bytes and the line to continue from were worked out by ARcompile
 			addr = x + st.offset;
-
+			for (u32 j = 0; j < op.writeCount; j++)
 			{
-				u32 j=0,t=0,b=0;
-				if(y>0) i++; //skip over the current code
-				while(y>=4)
-				{
-					if (i == theList.num) break; //if we erroneously went off the end, bail
-					u32 tmp = theList.code[i][t];
-					if (t == 1) i++;
-					t ^= 1;
-					CheatWrite(32,st.proc,addr,tmp);
-					addr += 4;
-					y -= 4;
-				}
-				while(y>0)
-				{
-					if (i == theList.num) break; //if we erroneously went off the end, bail
-					u32 tmp = theList.code[i][t]>>b;
-					CheatWrite(8,st.proc,addr,tmp);
-					addr += 1;
-					y -= 1;
-					b += 4;
-				}
-
-				//the main loop will increment to the next cheat, but the loop above may have gone one too far
-				if(t==0)
-					i--;
+				const CHEATS_COMPILED_WRITE &write = compiledWrites[op.writeIndex + j];
+				CheatWrite(write.size,st.proc,addr + write.ofs,write.val);
 			}
+			i = op.execNext;
 			break;
 
 		case 0x0F:
@@ -599,14 +705,12 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			//<gbatek> Copy YYYYYYYY bytes from [offset..] to [XXXXXXX...]
 			//<gbatek> For the COPY commands, addresses should be aligned by four (all data is copied with ldr/str, except, on odd lengths, the last 1..3 bytes do use ldrb/strb).
 			//attempting to emulate logic the way they may have implemented it, just in case
-			x = hi & 0x0FFFFFFF;
-			y = lo;
 			addr = st.offset;
 			operand = x; //mis-use of this variable to store dst
 			while(y>=4)
 			{
-				if (i == theList.num) break; //if we erroneously went off the end, bail
-				u32 tmp = _MMU_read32(st.proc,MMU_AT_DEBUG,addr);
+				if (i == num) break; //if we erroneously went off the end, bail
+				u32 tmp = CheatRead(32,st.proc,addr);
 				CheatWrite(32, st.proc,operand,tmp);
 				addr += 4;
 				operand += 4;
@@ -614,8 +718,8 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			}
 			while(y>0)
 			{
-				if (i == theList.num) break; //if we erroneously went off the end, bail
-				u8 tmp = _MMU_read08(st.proc,MMU_AT_DEBUG,addr);
+				if (i == num) break; //if we erroneously went off the end, bail
+				u8 tmp = CheatRead(8,st.proc,addr);
 				CheatWrite(8,st.proc,operand,tmp);
 				addr += 1;
 				operand += 1;
@@ -624,7 +728,6 @@ void CHEATS::ARparser(CHEATS_LIST& theList)
 			break;
 
 		default:
-			printf("AR: ERROR unknown command %08X %08X\n", hi, lo);
 			break;
 		}
 	}
@@ -976,20 +1079,114 @@ BOOL CHEATS::load()
 	return TRUE;
 }
 
+//the signature covers everything compile() reads from the list, so edits made
+//through getItemByIndex()/getListPtr() are noticed as well as those made here.
+//it also covers the DTCM location, since the game can move the DTCM over main RAM
+//at any time, and internal cheats resolve their host pointer past it at compile time
+bool CHEATS::isCompiledCurrent() const
+{
+	const size_t signatureSize = compiledSignature.size();
+	size_t pos = 0;
+
+	if (signatureSize < 3 || compiledSignature[pos++] != _MMU_MAIN_MEM_MASK || compiledSignature[pos++] != MMU.DTCMRegion || compiledSignature[pos++] != list.size())
+		return false;
+
+	for (size_t i = 0; i < list.size(); i++)
+	{
+		const CHEATS_LIST &cheat = list[i];
+
+		if (pos + 2 > signatureSize)
+			return false;
+		if (compiledSignature[pos++] != (u32)(cheat.type | (cheat.size << 8) | ((cheat.enabled ? 1 : 0) << 16)))
+			return false;
+		if (compiledSignature[pos++] != cheat.num)
+			return false;
+
+		if (!cheat.enabled)
+			continue;
+
+		const size_t codeSize = std::min<u32>(cheat.num, MAX_XX_CODE) * 2;
+		if (pos + codeSize > signatureSize)
+			return false;
+		if (memcmp(&compiledSignature[pos], cheat.code, codeSize * sizeof(u32)) != 0)
+			return false;
+		pos += codeSize;
+	}
+
+	return true;
+}
+
+void CHEATS::compile()
+{
+	compiledList.clear();
+	compiledOps.clear();
+	compiledWrites.clear();
+	compiledSignature.clear();
+
+	compiledSignature.push_back(_MMU_MAIN_MEM_MASK);
+	compiledSignature.push_back(MMU.DTCMRegion);
+	compiledSignature.push_back(list.size());
+
+	for (size_t i = 0; i < list.size(); i++)
+	{
+		const CHEATS_LIST &cheat = list[i];
+
+		compiledSignature.push_back(cheat.type | (cheat.size << 8) | ((cheat.enabled ? 1 : 0) << 16));
+		compiledSignature.push_back(cheat.num);
+
+		if (!cheat.enabled)
+			continue;
+
+		const u32 codeSize = std::min<u32>(cheat.num, MAX_XX_CODE) * 2;
+		compiledSignature.insert(compiledSignature.end(), &cheat.code[0][0], &cheat.code[0][0] + codeSize);
+
+		CHEATS_COMPILED_CHEAT compiledCheat;
+		memset(&compiledCheat, 0, sizeof(compiledCheat));
+		compiledCheat.type = cheat.type;
+
+		switch (cheat.type)
+		{
+			case CHEAT_TYPE_INTERNAL:
+			{
+				static const int sizeBits[4] = { 8, 16, 32, 32 };
+
+				compiledCheat.size = cheat.size;
+				compiledCheat.addr = cheat.code[0][0];
+				compiledCheat.val = cheat.code[0][1];
+				if (cheat.size <= 3)
+					compiledCheat.hostPtr = CheatHostPtr(sizeBits[cheat.size], ARMCPU_ARM9, compiledCheat.addr);
+				break;
+			}
+
+			case CHEAT_TYPE_AR:
+				ARcompile(cheat, compiledCheat);
+				break;
+
+			default:
+				continue;
+		}
+
+		compiledList.push_back(compiledCheat);
+	}
+}
+
 void CHEATS::process(int targetType)
 {
 	if (CommonSettings.cheatsDisable) return;
 
 	if (list.size() == 0) return;
 
+	if (!this->isCompiledCurrent())
+		this->compile();
+
 	cheatsResetJit = false;
 
-	size_t num = list.size();
+	size_t num = compiledList.size();
 	for (size_t i = 0; i < num; i++)
 	{
-		if (!list[i].enabled) continue;
+		const CHEATS_COMPILED_CHEAT &cheat = compiledList[i];
 
-		int type = list[i].type;
+		int type = cheat.type;
 		
 		if(type != targetType)
 		continue;
@@ -998,10 +1195,22 @@ void CHEATS::process(int targetType)
 		{
 			case 0:		// internal cheat system
 			{
-				//INFO("list at 0x0|%07X value %i (size %i)\n",list[i].code[0], list[i].lo[0], list[i].size);
-				u32 addr = list[i].code[0][0];
-				u32 val = list[i].code[0][1];
-				switch (list[i].size)
+				u32 addr = cheat.addr;
+				u32 val = cheat.val;
+
+				if (cheat.hostPtr != NULL)
+				{
+					switch (cheat.size)
+					{
+					case 0: CheatHostWrite(8, addr, cheat.hostPtr, val); break;
+					case 1: CheatHostWrite(16, addr, cheat.hostPtr, val); break;
+					case 2: CheatHostWrite(32, addr, cheat.hostPtr, (CheatHostRead(32, cheat.hostPtr) & 0xFF000000) | (val & 0x00FFFFFF)); break;
+					case 3: CheatHostWrite(32, addr, cheat.hostPtr, val); break;
+					}
+					break;
+				}
+
+				switch (cheat.size)
 				{
 				case 0: 
 					_MMU_write08<ARMCPU_ARM9,MMU_AT_DEBUG>(addr,val);
@@ -1025,9 +1234,7 @@ void CHEATS::process(int targetType)
 			} //end case 0 internal cheat system
 
 			case 1:		// Action Replay
-				ARparser(list[i]);
-				break;
-			case 2:		// Codebreaker
+				ARexecute(cheat);
 				break;
 			default: continue;
 		}
@@ -1113,243 +1320,500 @@ BOOL CHEATS::XXCodeFromString(CHEATS_LIST *cheatItem, const char *codeString)
 }
 
 // ========================================== search
-BOOL CHEATSEARCH::start(u8 type, u8 size, u8 sign)
+
+//each candidates word covers 64 elements, which the vector compares below
+//handle 64 bytes (1 byte elements) to 256 bytes (4 byte elements) at a time
+#if !defined(MSB_FIRST) && (defined(ENABLE_AVX2) || defined(ENABLE_SSE2) || defined(ENABLE_NEON_A64))
+	#define CHEATSEARCH_COMPARE_VECTOR
+#endif
+
+static FORCEINLINE u32 CheatSearchPopCount(u64 v)
 {
-	if (statMem) return FALSE;
-	if (mem) return FALSE;
+#if defined(__GNUC__)
+	return (u32)__builtin_popcountll(v);
+#else
+	v = v - ((v >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (u32)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
 
-	statMem = new u8 [ ( 4 * 1024 * 1024 ) / 8 ];
-	memset(statMem, 0xFF, ( 4 * 1024 * 1024 ) / 8);
+static FORCEINLINE u32 CheatSearchLowestBit(u64 v)
+{
+#if defined(__GNUC__)
+	return (u32)__builtin_ctzll(v);
+#else
+	u32 bit = 0;
+	while (!(v & 1))
+	{
+		v >>= 1;
+		bit++;
+	}
+	return bit;
+#endif
+}
 
-	// comparative search type (need 8Mb RAM !!! (4+4))
-	mem = new u8 [ ( 4 * 1024 * 1024 ) ];
-	memcpy(mem, MMU.MMU_MEM[0][0x20], ( 4 * 1024 * 1024 ) );
+static FORCEINLINE u32 CheatSearchReadElement(const u8 *mem, u32 step)
+{
+	switch (step)
+	{
+		case 1: return mem[0];
+		case 2: return mem[0] | (mem[1] << 8);
+		case 3: return mem[0] | (mem[1] << 8) | (mem[2] << 16);
+		default: return mem[0] | (mem[1] << 8) | (mem[2] << 16) | ((u32)mem[3] << 24);
+	}
+}
 
-	_type = type;
-	_size = size;
-	_sign = sign;
-	amount = 0;
-	lastRecord = 0;
-	
-	//INFO("Cheat search system is inited (type %s)\n", type?"comparative":"exact");
-	return TRUE;
+//comp: 0 - cur > prev, 1 - cur < prev, 2 - cur == prev, 3 - cur != prev
+static u64 CheatSearchCompareScalar(const u8 *cur, const u8 *prev, u32 step, u32 count, u8 comp)
+{
+	u64 bits = 0;
+
+	for (u32 i = 0; i < count; i++)
+	{
+		const u32 a = CheatSearchReadElement(cur + (i * step), step);
+		const u32 b = CheatSearchReadElement(prev + (i * step), step);
+		bool res;
+
+		switch (comp)
+		{
+			case 0: res = (a > b); break;
+			case 1: res = (a < b); break;
+			case 2: res = (a == b); break;
+			default: res = (a != b); break;
+		}
+
+		if (res)
+			bits |= (u64)1 << i;
+	}
+
+	return bits;
 }
 
-BOOL CHEATSEARCH::close()
+#ifdef CHEATSEARCH_COMPARE_VECTOR
+
+#if defined(ENABLE_AVX2)
+
+static FORCEINLINE v256u8 CheatSearchCompareVec(const u8 *a, const u8 *b, const u32 step, const bool gt)
 {
-	if (statMem)
+	v256u8 va = _mm256_loadu_si256((const v256u8 *)a);
+	v256u8 vb = _mm256_loadu_si256((const v256u8 *)b);
+
+	if (!gt)
 	{
-		delete [] statMem;
-		statMem = NULL;
+		if (step == 1) return _mm256_cmpeq_epi8(va, vb);
+		if (step == 2) return _mm256_cmpeq_epi16(va, vb);
+		return _mm256_cmpeq_epi32(va, vb);
 	}
 
-	if (mem)
+	//unsigned greater than, by flipping the sign bits for the signed compare
+	if (step == 1)
 	{
-		delete [] mem;
-		mem = NULL;
+		const v256u8 sign = _mm256_set1_epi8((s8)0x80);
+		return _mm256_cmpgt_epi8(_mm256_xor_si256(va, sign), _mm256_xor_si256(vb, sign));
 	}
-	amount = 0;
-	lastRecord = 0;
-	//INFO("Cheat search system is closed\n");
-	return FALSE;
+	if (step == 2)
+	{
+		const v256u16 sign = _mm256_set1_epi16((s16)0x8000);
+		return _mm256_cmpgt_epi16(_mm256_xor_si256(va, sign), _mm256_xor_si256(vb, sign));
+	}
+
+	const v256u32 sign = _mm256_set1_epi32((s32)0x80000000);
+	return _mm256_cmpgt_epi32(_mm256_xor_si256(va, sign), _mm256_xor_si256(vb, sign));
 }
 
-u32 CHEATSEARCH::search(u32 val)
+static u64 CheatSearchCompareVector(const u8 *a, const u8 *b, const u32 step, const bool gt)
 {
-	amount = 0;
+	u64 bits = 0;
 
-	switch (_size)
+	switch (step)
 	{
-		case 0:		// 1 byte
-			for (u32 i = 0; i < (4 * 1024 * 1024); i++)
+		case 1:
+			for (size_t i = 0; i < 2; i++)
 			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (1<<offs))
-				{
-					if ( T1ReadByte(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) == val )
-					{
-						statMem[addr] |= (1<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(1<<offs);
-				}
+				const v256u8 m = CheatSearchCompareVec(a + (i * 32), b + (i * 32), 1, gt);
+				bits |= (u64)(u32)_mm256_movemask_epi8(m) << (i * 32);
 			}
-		break;
+			break;
 
-		case 1:		// 2 bytes
-			for (u32 i = 0; i < (4 * 1024 * 1024); i+=2)
+		case 2:
+			for (size_t i = 0; i < 2; i++)
 			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (3<<offs))
-				{
-					if ( T1ReadWord(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) == val )
-					{
-						statMem[addr] |= (3<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(3<<offs);
-				}
+				const v256u16 m0 = CheatSearchCompareVec(a + (i * 64), b + (i * 64), 2, gt);
+				const v256u16 m1 = CheatSearchCompareVec(a + (i * 64) + 32, b + (i * 64) + 32, 2, gt);
+				//packing works per 128-bit lane, so put the quadwords back in order afterwards
+				const v256u8 m = _mm256_permute4x64_epi64(_mm256_packs_epi16(m0, m1), 0xD8);
+				bits |= (u64)(u32)_mm256_movemask_epi8(m) << (i * 32);
 			}
-		break;
+			break;
 
-		case 2:		// 3 bytes
-			for (u32 i = 0; i < (4 * 1024 * 1024); i+=3)
+		case 4:
+			for (size_t i = 0; i < 8; i++)
 			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (0x7<<offs))
-				{
-					if ( (T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) & 0x00FFFFFF) == val )
-					{
-						statMem[addr] |= (0x7<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(0x7<<offs);
-				}
+				const v256u32 m = CheatSearchCompareVec(a + (i * 32), b + (i * 32), 4, gt);
+				bits |= (u64)(u32)_mm256_movemask_ps(_mm256_castsi256_ps(m)) << (i * 8);
+			}
+			break;
+	}
+
+	return bits;
+}
+
+#elif defined(ENABLE_SSE2)
+
+static FORCEINLINE v128u8 CheatSearchCompareVec(const u8 *a, const u8 *b, const u32 step, const bool gt)
+{
+	v128u8 va = _mm_loadu_si128((const v128u8 *)a);
+	v128u8 vb = _mm_loadu_si128((const v128u8 *)b);
+
+	if (!gt)
+	{
+		if (step == 1) return _mm_cmpeq_epi8(va, vb);
+		if (step == 2) return _mm_cmpeq_epi16(va, vb);
+		return _mm_cmpeq_epi32(va, vb);
+	}
+
+	//unsigned greater than, by flipping the sign bits for the signed compare
+	if (step == 1)
+	{
+		const v128u8 sign = _mm_set1_epi8((s8)0x80);
+		return _mm_cmpgt_epi8(_mm_xor_si128(va, sign), _mm_xor_si128(vb, sign));
+	}
+	if (step == 2)
+	{
+		const v128u16 sign = _mm_set1_epi16((s16)0x8000);
+		return _mm_cmpgt_epi16(_mm_xor_si128(va, sign), _mm_xor_si128(vb, sign));
+	}
+
+	const v128u32 sign = _mm_set1_epi32((s32)0x80000000);
+	return _mm_cmpgt_epi32(_mm_xor_si128(va, sign), _mm_xor_si128(vb, sign));
+}
+
+static u64 CheatSearchCompareVector(const u8 *a, const u8 *b, const u32 step, const bool gt)
+{
+	u64 bits = 0;
+
+	switch (step)
+	{
+		case 1:
+			for (size_t i = 0; i < 4; i++)
+			{
+				const v128u8 m = CheatSearchCompareVec(a + (i * 16), b + (i * 16), 1, gt);
+				bits |= (u64)(u32)_mm_movemask_epi8(m) << (i * 16);
 			}
-		break;
+			break;
 
-		case 3:		// 4 bytes
-			for (u32 i = 0; i < (4 * 1024 * 1024); i+=4)
+		case 2:
+			for (size_t i = 0; i < 4; i++)
 			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (0xF<<offs))
-				{
-					if ( T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) == val )
-					{
-						statMem[addr] |= (0xF<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(0xF<<offs);
-				}
+				const v128u16 m0 = CheatSearchCompareVec(a + (i * 32), b + (i * 32), 2, gt);
+				const v128u16 m1 = CheatSearchCompareVec(a + (i * 32) + 16, b + (i * 32) + 16, 2, gt);
+				bits |= (u64)(u32)_mm_movemask_epi8(_mm_packs_epi16(m0, m1)) << (i * 16);
 			}
-		break;
+			break;
+
+		case 4:
+			for (size_t i = 0; i < 16; i++)
+			{
+				const v128u32 m = CheatSearchCompareVec(a + (i * 16), b + (i * 16), 4, gt);
+				bits |= (u64)(u32)_mm_movemask_ps(_mm_castsi128_ps(m)) << (i * 4);
+			}
+			break;
 	}
 
-	return (amount);
+	return bits;
 }
 
-u32 CHEATSEARCH::search(u8 comp)
+#elif defined(ENABLE_NEON_A64)
+
+//NEON has no movemask, so weight each byte lane by its bit and add them up
+static FORCEINLINE u32 CheatSearchMoveMask(const v128u8 m)
 {
-	BOOL	res = FALSE;
+	static const u8 laneBits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+	const v128u8 t = vandq_u8(m, vld1q_u8(laneBits));
+	return (u32)vaddv_u8(vget_low_u8(t)) | ((u32)vaddv_u8(vget_high_u8(t)) << 8);
+}
 
-	amount = 0;
-	
-	switch (_size)
+static u64 CheatSearchCompareVector(const u8 *a, const u8 *b, const u32 step, const bool gt)
+{
+	u64 bits = 0;
+
+	switch (step)
 	{
-		case 0:		// 1 byte
-			for (u32 i = 0; i < (4 * 1024 * 1024); i++)
+		case 1:
+			for (size_t i = 0; i < 4; i++)
 			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (1<<offs))
-				{
-					switch (comp)
-					{
-						case 0: res=(T1ReadByte(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) > T1ReadByte(mem, i)); break;
-						case 1: res=(T1ReadByte(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) < T1ReadByte(mem, i)); break;
-						case 2: res=(T1ReadByte(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) == T1ReadByte(mem, i)); break;
-						case 3: res=(T1ReadByte(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) != T1ReadByte(mem, i)); break;
-						default: res = FALSE; break;
-					}
-					if ( res )
-					{
-						statMem[addr] |= (1<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(1<<offs);
-				}
+				const v128u8 va = vld1q_u8(a + (i * 16));
+				const v128u8 vb = vld1q_u8(b + (i * 16));
+				const v128u8 m = (gt) ? vcgtq_u8(va, vb) : vceqq_u8(va, vb);
+				bits |= (u64)CheatSearchMoveMask(m) << (i * 16);
 			}
-		break;
+			break;
 
-		case 1:		// 2 bytes
-			for (u32 i = 0; i < (4 * 1024 * 1024); i+=2)
+		case 2:
+			for (size_t i = 0; i < 4; i++)
 			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (3<<offs))
+				v128u16 m[2];
+				for (size_t j = 0; j < 2; j++)
 				{
-					switch (comp)
-					{
-						case 0: res=(T1ReadWord(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) > T1ReadWord(mem, i)); break;
-						case 1: res=(T1ReadWord(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) < T1ReadWord(mem, i)); break;
-						case 2: res=(T1ReadWord(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) == T1ReadWord(mem, i)); break;
-						case 3: res=(T1ReadWord(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) != T1ReadWord(mem, i)); break;
-						default: res = FALSE; break;
-					}
-					if ( res )
-					{
-						statMem[addr] |= (3<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(3<<offs);
+					const v128u16 va = vld1q_u16((const u16 *)(a + (i * 32) + (j * 16)));
+					const v128u16 vb = vld1q_u16((const u16 *)(b + (i * 32) + (j * 16)));
+					m[j] = (gt) ? vcgtq_u16(va, vb) : vceqq_u16(va, vb);
 				}
+				bits |= (u64)CheatSearchMoveMask(vcombine_u8(vmovn_u16(m[0]), vmovn_u16(m[1]))) << (i * 16);
 			}
-		break;
+			break;
 
-		case 2:		// 3 bytes
-			for (u32 i = 0; i < (4 * 1024 * 1024); i+=3)
+		case 4:
+			for (size_t i = 0; i < 4; i++)
 			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (7<<offs))
+				v128u32 m[4];
+				for (size_t j = 0; j < 4; j++)
 				{
-					switch (comp)
-					{
-						case 0: res=((T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) & 0x00FFFFFF) > (T1ReadLong(mem, i) & 0x00FFFFFF) ); break;
-						case 1: res=((T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) & 0x00FFFFFF) < (T1ReadLong(mem, i) & 0x00FFFFFF) ); break;
-						case 2: res=((T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) & 0x00FFFFFF) == (T1ReadLong(mem, i) & 0x00FFFFFF) ); break;
-						case 3: res=((T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) & 0x00FFFFFF) != (T1ReadLong(mem, i) & 0x00FFFFFF) ); break;
-						default: res = FALSE; break;
-					}
-					if ( res )
-					{
-						statMem[addr] |= (7<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(7<<offs);
+					const v128u32 va = vld1q_u32((const u32 *)(a + (i * 64) + (j * 16)));
+					const v128u32 vb = vld1q_u32((const u32 *)(b + (i * 64) + (j * 16)));
+					m[j] = (gt) ? vcgtq_u32(va, vb) : vceqq_u32(va, vb);
 				}
+				const v128u16 m01 = vcombine_u16(vmovn_u32(m[0]), vmovn_u32(m[1]));
+				const v128u16 m23 = vcombine_u16(vmovn_u32(m[2]), vmovn_u32(m[3]));
+				bits |= (u64)CheatSearchMoveMask(vcombine_u8(vmovn_u16(m01), vmovn_u16(m23))) << (i * 16);
 			}
-		break;
+			break;
+	}
+
+	return bits;
+}
+
+#endif
+
+#endif // CHEATSEARCH_COMPARE_VECTOR
+
+static u64 CheatSearchCompare(const u8 *cur, const u8 *prev, u32 step, u32 count, u8 comp)
+{
+#ifdef CHEATSEARCH_COMPARE_VECTOR
+	if (count == 64 && step != 3)
+	{
+		switch (comp)
+		{
+			case 0: return CheatSearchCompareVector(cur, prev, step, true);
+			case 1: return CheatSearchCompareVector(prev, cur, step, true);
+			case 2: return CheatSearchCompareVector(cur, prev, step, false);
+			default: return ~CheatSearchCompareVector(cur, prev, step, false);
+		}
+	}
+#endif
+
+	return CheatSearchCompareScalar(cur, prev, step, count, comp);
+}
+
+BOOL CHEATSEARCH::start(u8 type, u8 size, u8 sign, u32 regions)
+{
+	if (candidates) return FALSE;
+	if (mem) return FALSE;
+
+	if (regions == 0)
+		regions = CHEATSEARCH_REGION_MAIN;
+
+	const u32 step = (u32)size + 1;
+	u32 wordPos = 0;
+	u32 snapshotSize = 0;
+
+	ranges.clear();
+	for (u32 i = 0; i < 4; i++)
+	{
+		CHEATSEARCH_RANGE range;
+
+		switch (regions & (1 << i))
+		{
+			case CHEATSEARCH_REGION_MAIN:
+				//all of it, including the extra RAM of debug and DSi consoles
+				range.baseAddr = 0x02000000;
+				range.hostMem = MMU.MAIN_MEM;
+				range.size = _MMU_MAIN_MEM_MASK + 1;
+				break;
+
+			case CHEATSEARCH_REGION_SHARED_WRAM:
+				range.baseAddr = 0x03000000;
+				range.hostMem = MMU.SWIRAM;
+				range.size = sizeof(MMU.SWIRAM);
+				break;
+
+			case CHEATSEARCH_REGION_ARM7_WRAM:
+				range.baseAddr = 0x03800000;
+				range.hostMem = MMU.ARM7_ERAM;
+				range.size = sizeof(MMU.ARM7_ERAM);
+				break;
 
-		case 3:		// 4 bytes
-			for (u32 i = 0; i < (4 * 1024 * 1024); i+=4)
+			case CHEATSEARCH_REGION_VRAM:
+				range.baseAddr = 0x06800000;
+				range.hostMem = MMU.ARM9_LCD;
+				range.size = 0xA4000;
+				break;
+
+			default:
+				continue;
+		}
+
+		range.elementCount = range.size / step;
+		range.firstWord = wordPos;
+		range.wordCount = (range.elementCount + 63) / 64;
+		range.snapshotOfs = snapshotSize;
+
+		wordPos += range.wordCount;
+		snapshotSize += range.size;
+		ranges.push_back(range);
+	}
+
+	candidateWords = wordPos;
+	candidates = new u64 [candidateWords];
+	memset(candidates, 0xFF, candidateWords * sizeof(u64));
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		//clear the bits past the end of each range
+		const u32 lastCount = ranges[i].elementCount & 63;
+		if (lastCount != 0)
+			candidates[ranges[i].firstWord + ranges[i].wordCount - 1] = ((u64)1 << lastCount) - 1;
+	}
+
+	candidateSummary = new u64 [(candidateWords + 63) / 64];
+	memset(candidateSummary, 0, ((candidateWords + 63) / 64) * sizeof(u64));
+	for (u32 i = 0; i < candidateWords; i++)
+	{
+		if (candidates[i] != 0)
+			candidateSummary[i >> 6] |= (u64)1 << (i & 63);
+	}
+
+	// comparative search type
+	mem = new u8 [snapshotSize];
+	for (size_t i = 0; i < ranges.size(); i++)
+		memcpy(mem + ranges[i].snapshotOfs, ranges[i].hostMem, ranges[i].size);
+
+	_type = type;
+	_size = size;
+	_sign = sign;
+	amount = 0;
+	lastRecord = 0;
+	
+	//INFO("Cheat search system is inited (type %s)\n", type?"comparative":"exact");
+	return TRUE;
+}
+
+BOOL CHEATSEARCH::close()
+{
+	if (candidates)
+	{
+		delete [] candidates;
+		candidates = NULL;
+	}
+
+	if (candidateSummary)
+	{
+		delete [] candidateSummary;
+		candidateSummary = NULL;
+	}
+
+	if (mem)
+	{
+		delete [] mem;
+		mem = NULL;
+	}
+	ranges.clear();
+	candidateWords = 0;
+	amount = 0;
+	lastRecord = 0;
+	//INFO("Cheat search system is closed\n");
+	return FALSE;
+}
+
+void CHEATSEARCH::clearCandidates()
+{
+	memset(candidates, 0, candidateWords * sizeof(u64));
+	memset(candidateSummary, 0, ((candidateWords + 63) / 64) * sizeof(u64));
+}
+
+//Compares the elements that are still candidates against either the snapshot
+//(pattern == NULL) or a block of 64 elements holding the searched value, and
+//drops those that don't match. Only non-empty candidate words are visited.
+u32 CHEATSEARCH::filter(const u8 *pattern, u8 comp)
+{
+	const u32 step = _size + 1;
+	u32 total = 0;
+
+	for (size_t r = 0; r < ranges.size(); r++)
+	{
+		const CHEATSEARCH_RANGE &range = ranges[r];
+		const u32 endWord = range.firstWord + range.wordCount;
+
+		for (u32 s = range.firstWord >> 6; s <= ((endWord - 1) >> 6); s++)
+		{
+			u64 summaryBits = candidateSummary[s];
+
+			while (summaryBits != 0)
 			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (0xF<<offs))
-				{
-					switch (comp)
-					{
-						case 0: res=(T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) > T1ReadLong(mem, i)); break;
-						case 1: res=(T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) < T1ReadLong(mem, i)); break;
-						case 2: res=(T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) == T1ReadLong(mem, i)); break;
-						case 3: res=(T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) != T1ReadLong(mem, i)); break;
-						default: res = FALSE; break;
-					}
-					if ( res )
-					{
-						statMem[addr] |= (0xF<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(0xF<<offs);
-				}
+				const u32 bit = CheatSearchLowestBit(summaryBits);
+				const u32 w = (s << 6) + bit;
+				summaryBits &= summaryBits - 1;
+
+				if (w < range.firstWord || w >= endWord)
+					continue;
+
+				const u32 elementStart = (w - range.firstWord) * 64;
+				const u32 count = std::min<u32>(64, range.elementCount - elementStart);
+				const u8 *cur = range.hostMem + (elementStart * step);
+				const u8 *prev = (pattern != NULL) ? pattern : mem + range.snapshotOfs + (elementStart * step);
+
+				candidates[w] &= CheatSearchCompare(cur, prev, step, count, comp);
+				if (candidates[w] == 0)
+					candidateSummary[s] &= ~((u64)1 << bit);
+
+				total += CheatSearchPopCount(candidates[w]);
 			}
-		break;
+		}
+	}
+
+	return total;
+}
+
+u32 CHEATSEARCH::search(u32 val)
+{
+	const u32 step = _size + 1;
+	const u32 valueMask = (step == 4) ? 0xFFFFFFFF : ((1 << (step * 8)) - 1);
+	u8 pattern[64 * 4];
+
+	amount = 0;
+	if (!candidates) return (amount);
+
+	//a value that doesn't fit in the element size never matches
+	if (val & ~valueMask)
+	{
+		clearCandidates();
+		return (amount);
+	}
+
+	for (u32 i = 0; i < 64; i++)
+	{
+		for (u32 j = 0; j < step; j++)
+			pattern[(i * step) + j] = (u8)(val >> (j * 8));
 	}
 
-	memcpy(mem, MMU.MMU_MEM[0][0x20], ( 4 * 1024 * 1024 ) );
+	amount = filter(pattern, 2);
+
+	return (amount);
+}
+
+u32 CHEATSEARCH::search(u8 comp)
+{
+	amount = 0;
+	if (!candidates) return (amount);
+
+	if (comp > 3)
+		clearCandidates();
+	else
+		amount = filter(NULL, comp);
+
+	for (size_t i = 0; i < ranges.size(); i++)
+		memcpy(mem + ranges[i].snapshotOfs, ranges[i].hostMem, ranges[i].size);
 
 	return (amount);
 }
@@ -1361,34 +1825,38 @@ u32 CHEATSEARCH::getAmount()
 
 BOOL CHEATSEARCH::getList(u32 *address, u32 *curVal)
 {
-	u8	step = (_size+1);
-	u8	stepMem = 1;
-	switch (_size)
-	{
-		case 1: stepMem = 0x3; break;
-		case 2: stepMem = 0x7; break;
-		case 3: stepMem = 0xF; break;
-	}
+	const u32 step = _size + 1;
+	const u32 elementTotal = candidateWords * 64;
+	u32 i = lastRecord;
 
-	for (u32 i = lastRecord; i < (4 * 1024 * 1024); i+=step)
+	while (i < elementTotal)
 	{
-		u32	addr = (i >> 3);
-		u32	offs = (i % 8);
-		if (statMem[addr] & (stepMem<<offs))
+		const u32 w = i >> 6;
+		const u64 bits = candidates[w] >> (i & 63);
+
+		if (bits == 0)
 		{
-			*address = i;
-			lastRecord = i+step;
-			
-			switch (_size)
-			{
-				case 0: *curVal=(u32)T1ReadByte(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i); return TRUE;
-				case 1: *curVal=(u32)T1ReadWord(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i); return TRUE;
-				case 2: *curVal=(u32)T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) & 0x00FFFFFF; return TRUE;
-				case 3: *curVal=(u32)T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i); return TRUE;
-				default: return TRUE;
-			}
+			i = (w + 1) << 6;
+			continue;
+		}
+		i += CheatSearchLowestBit(bits);
+
+		for (size_t r = 0; r < ranges.size(); r++)
+		{
+			const CHEATSEARCH_RANGE &range = ranges[r];
+			if (w < range.firstWord || w >= range.firstWord + range.wordCount)
+				continue;
+
+			const u32 ofs = (i - (range.firstWord * 64)) * step;
+			*address = range.baseAddr + ofs - 0x02000000;
+			*curVal = CheatSearchReadElement(range.hostMem + ofs, step);
+			break;
 		}
+
+		lastRecord = i + 1;
+		return TRUE;
 	}
+
 	lastRecord = 0;
 	return FALSE;
 }
@@ -53,6 +53,38 @@ struct CHEATS_LIST
 	u8		size;
 };
 
+// One line of an Action Replay code, decoded by CHEATS::compile()
+struct CHEATS_COMPILED_OP
+{
+	u32		type;				// code type, 0x00-0x0F or 0xC0-0xDF
+	u32		x;
+	u32		y;
+	u32		z;
+	u32		execNext;			// E codes: line to continue from after patching
+	u32		skipNext;			// E codes: line to continue from when skipped
+	u32		writeIndex;			// E codes: first entry in the compiled write list
+	u32		writeCount;
+};
+
+// A single write of an E code, relative to the patch address
+struct CHEATS_COMPILED_WRITE
+{
+	u32		size;
+	u32		ofs;
+	u32		val;
+};
+
+struct CHEATS_COMPILED_CHEAT
+{
+	u8		type;
+	u8		size;				// internal cheats
+	u32		addr;
+	u32		val;
+	u8		*hostPtr;			// internal cheats targeting main RAM, otherwise NULL
+	u32		opIndex;			// AR cheats
+	u32		opCount;
+};
+
 class CHEATS
 {
 private:
@@ -60,8 +92,17 @@ private:
 	u8					filename[MAX_PATH];
 	u32					currentGet;
 
+	// the enabled cheats, decoded once and re-compiled whenever the list changes
+	std::vector<CHEATS_COMPILED_CHEAT> compiledList;
+	std::vector<CHEATS_COMPILED_OP> compiledOps;
+	std::vector<CHEATS_COMPILED_WRITE> compiledWrites;
+	std::vector<u32>	compiledSignature;
+
 	void	clear();
-	void	ARparser(CHEATS_LIST& cheat);
+	void	ARcompile(const CHEATS_LIST& cheat, CHEATS_COMPILED_CHEAT& compiledCheat);
+	void	ARexecute(const CHEATS_COMPILED_CHEAT& compiledCheat);
+	void	compile();
+	bool	isCompiledCurrent() const;
 	char	*clearCode(char *s);
 
 public:
@@ -99,28 +140,55 @@ public:
 	static BOOL XXCodeFromString(CHEATS_LIST *cheatItem, const char *codeString);
 };
 
+enum CHEATSEARCH_REGION
+{
+	CHEATSEARCH_REGION_MAIN			= 0x01,
+	CHEATSEARCH_REGION_SHARED_WRAM	= 0x02,
+	CHEATSEARCH_REGION_ARM7_WRAM	= 0x04,
+	CHEATSEARCH_REGION_VRAM			= 0x08,		// all banks, as seen through the LCDC mapping
+	CHEATSEARCH_REGION_ALL			= 0x0F
+};
+
+struct CHEATSEARCH_RANGE
+{
+	u32		baseAddr;
+	u8		*hostMem;
+	u32		size;
+	u32		elementCount;
+	u32		firstWord;			// first candidate word of this range
+	u32		wordCount;
+	u32		snapshotOfs;
+};
+
 class CHEATSEARCH
 {
 private:
-	u8	*statMem;
-	u8	*mem;
+	u64	*candidates;			// one bit per element that still matches
+	u64	*candidateSummary;		// one bit per non-zero candidates word
+	u32	candidateWords;
+	u8	*mem;					// snapshot of all ranges for comparative searches
 	u32	amount;
 	u32	lastRecord;
+	std::vector<CHEATSEARCH_RANGE> ranges;
 
 	u32	_type;
 	u32	_size;
 	u32	_sign;
 
+	u32 filter(const u8 *pattern, u8 comp);
+	void clearCandidates();
+
 public:
 	CHEATSEARCH()
-			: statMem(0), mem(0), amount(0), lastRecord(0), _type(0), _size(0), _sign(0) 
+			: candidates(0), candidateSummary(0), candidateWords(0), mem(0), amount(0), lastRecord(0), _type(0), _size(0), _sign(0) 
 	{}
 	~CHEATSEARCH() { close(); }
-	BOOL start(u8 type, u8 size, u8 sign);
+	BOOL start(u8 type, u8 size, u8 sign, u32 regions = CHEATSEARCH_REGION_MAIN);
 	BOOL close();
 	u32 search(u32 val);
 	u32 search(u8 comp);
 	u32 getAmount();
+	// addresses are relative to main RAM (0x02000000), including those of the other regions
 	BOOL getList(u32 *address, u32 *curVal);
 	void getListReset();
 };
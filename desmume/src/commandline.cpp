@@ -58,6 +58,7 @@ CommandLine::CommandLine()
 , _gamehacks(-1)
 , _texture_deposterize(-1)
 , _texture_smooth(-1)
+, _texture_disk_cache(NULL)
 , _slot1(NULL)
 , _slot1_fat_dir(NULL)
 , _slot1_fat_dir_type(false)
@@ -69,6 +70,7 @@ CommandLine::CommandLine()
 , _console_type(NULL)
 , _advanscene_import(NULL)
 , load_slot(-1)
+, frame_hash_regions(-1)
 , arm9_gdb_port(0)
 , arm7_gdb_port(0)
 , start_paused(FALSE)
@@ -117,6 +119,9 @@ static const char* help_string = \
 "                            4:4x upscaling" ENDL
 " --3d-texture-smoothing-enable" ENDL
 "                            Enables smooth texture sampling while rendering." ENDL
+" --3d-texture-disk-cache DIR" ENDL
+"                            Keeps deposterized and upscaled textures in DIR so" ENDL
+"                            that later runs don't have to process them again." ENDL
 #ifdef HOST_WINDOWS
 " --gpu-resolution-multiplier N" ENDL
 "                            Increases the resolution of GPU rendering by this" ENDL
@@ -175,6 +180,9 @@ ENDL
 " --load-slot N              loads savestate from slot N (0-9)" ENDL
 " --play-movie DSM_FILE      automatically plays movie" ENDL
 " --record-movie DSM_FILE    begin recording a movie" ENDL
+" --frame-hash-file FILE     writes hashes of each frame to FILE at vblank" ENDL
+" --frame-hash-regions MASK  what to hash: 1 = main display, 2 = touch display," ENDL
+"                            4 = main RAM, 8 << N = VRAM bank N; default 7" ENDL
 ENDL
 "Arguments affecting video filters:" ENDL
 " --scanline-filter-a N      Fadeout intensity (N/16) (topleft) (default 0)" ENDL
@@ -203,6 +211,7 @@ ENDL
 #define OPT_GPU_RESOLUTION_MULTIPLIER 82
 #define OPT_FRAMESKIP 83
 #define OPT_SCALE 84
+#define OPT_3D_TEXTURE_DISK_CACHE 85
 #define OPT_JIT_SIZE 100
 
 #define OPT_CONSOLE_TYPE 200
@@ -218,6 +227,8 @@ ENDL
 #define OPT_LOAD_SLOT 400
 #define OPT_PLAY_MOVIE 410
 #define OPT_RECORD_MOVIE 411
+#define OPT_FRAME_HASH_FILE 420
+#define OPT_FRAME_HASH_REGIONS 421
 
 #define OPT_SLOT2_CFLASH_IMAGE 500
 #define OPT_SLOT2_CFLASH_DIR 501
@@ -261,6 +272,7 @@ bool CommandLine::parse(int argc,char **argv)
 			{ "3d-texture-deposterize-enable", no_argument, &_texture_deposterize, 1 },
 			{ "3d-texture-upscale", required_argument, NULL, OPT_3D_TEXTURE_UPSCALE },
 			{ "3d-texture-smoothing-enable", no_argument, &_texture_smooth, 1 },
+			{ "3d-texture-disk-cache", required_argument, NULL, OPT_3D_TEXTURE_DISK_CACHE },
 			#ifdef HOST_WINDOWS
 				{ "gpu-resolution-multiplier", required_argument, NULL, OPT_GPU_RESOLUTION_MULTIPLIER },
 				{ "windowed-fullscreen", no_argument, &windowed_fullscreen, 1 },
@@ -312,6 +324,8 @@ bool CommandLine::parse(int argc,char **argv)
 			{ "load-slot", required_argument, NULL, OPT_LOAD_SLOT},
 			{ "play-movie", required_argument, NULL, OPT_PLAY_MOVIE},
 			{ "record-movie", required_argument, NULL, OPT_RECORD_MOVIE},
+			{ "frame-hash-file", required_argument, NULL, OPT_FRAME_HASH_FILE},
+			{ "frame-hash-regions", required_argument, NULL, OPT_FRAME_HASH_REGIONS},
 
 			//video filters
 			{ "scanline-filter-a", required_argument, NULL, OPT_SCANLINES_A},
@@ -345,6 +359,7 @@ bool CommandLine::parse(int argc,char **argv)
 		case OPT_SPU_METHOD: _spu_sync_method = atoi(optarg); break;
 		case OPT_3D_RENDER: _render3d = optarg; break;
 		case OPT_3D_TEXTURE_UPSCALE: texture_upscale = atoi(optarg); break;
+		case OPT_3D_TEXTURE_DISK_CACHE: _texture_disk_cache = strdup(optarg); break;
 		case OPT_GPU_RESOLUTION_MULTIPLIER: gpu_resolution_multiplier = atoi(optarg); break;
 		case OPT_SCALE: scale = atof(optarg); break;
 		case OPT_FRAMESKIP: frameskip = atoi(optarg); break;
@@ -378,6 +393,8 @@ bool CommandLine::parse(int argc,char **argv)
 		case OPT_LOAD_SLOT: load_slot = atoi(optarg);  break;
 		case OPT_PLAY_MOVIE: play_movie_file = optarg; break;
 		case OPT_RECORD_MOVIE: record_movie_file = optarg; break;
+		case OPT_FRAME_HASH_FILE: frame_hash_file = optarg; break;
+		case OPT_FRAME_HASH_REGIONS: frame_hash_regions = (int)strtol(optarg, NULL, 0); break;
 
 		//video filters
 		case OPT_SCANLINES_A: _scanline_filter_a = atoi(optarg); break;
@@ -443,6 +460,7 @@ bool CommandLine::parse(int argc,char **argv)
 
 	if (_texture_deposterize != -1) CommonSettings.GFX3D_Renderer_TextureDeposterize = (_texture_deposterize == 1);
 	if (_texture_smooth != -1) CommonSettings.GFX3D_Renderer_TextureSmoothing = (_texture_smooth == 1);
+	if (_texture_disk_cache) strncpy(CommonSettings.GFX3D_Renderer_TextureDiskCachePath, _texture_disk_cache, MAX_PATH - 1);
 
 	if (autodetect_method != -1)
 		CommonSettings.autodetectBackupMethod = autodetect_method;
@@ -584,6 +602,14 @@ void CommandLine::process_movieCommands()
 	{
 		FCEUI_SaveMovie(record_movie_file.c_str(), L"", START_BLANK, NULL, FCEUI_MovieGetRTCDefault());
 	}
+
+	if(frame_hash_file != "")
+	{
+		if(NDS_FrameHashOpenFile(frame_hash_file.c_str()))
+			NDS_FrameHashSetRegions((frame_hash_regions != -1) ? (u32)frame_hash_regions : (NDSFRAMEHASH_REGIONS_DISPLAYS | NDSFRAMEHASH_REGION(NDSFrameHashRegionID_MainRAM)));
+		else
+			printerror("Couldn't open the frame hash file.\n");
+	}
 }
 
 void CommandLine::process_addonCommands()
@@ -53,6 +53,8 @@ public:
 	std::string nds_file;
 	std::string play_movie_file;
 	std::string record_movie_file;
+	std::string frame_hash_file;
+	int frame_hash_regions;
 	int arm9_gdb_port, arm7_gdb_port;
 	int start_paused;
 	std::string cflash_image;
@@ -106,6 +108,7 @@ private:
 	int _gamehacks;
 	int _texture_deposterize;
 	int _texture_smooth;
+	char* _texture_disk_cache;
 #ifdef HAVE_JIT
 	int _cpu_mode;
 	int _jit_size;
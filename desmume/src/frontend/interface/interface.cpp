@@ -23,22 +23,42 @@
 #include <stdio.h>
 #include "../../NDSSystem.h"
 #include "../../GPU.h"
+#include "../../gfx3d.h"
 #include "../../SPU.h"
 #include "../../MMU.h"
 #include "../../rasterize.h"
+#include "../../texcache.h"
 #include "../../saves.h"
 #include "../../movie.h"
 #include "../../mc.h"
 #include "../../firmware.h"
 #include "../../armcpu.h"
+#include "../../wifi.h"
+#include "../../common.h"
 #include "../posix/shared/sndsdl.h"
 #include "../posix/shared/ctrlssdl.h"
 #include <locale>
 #include <codecvt>
 #include <string>
 
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+#include <map>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #define SCREENS_PIXEL_SIZE 98304
 volatile bool execute = false;
+static bool headless = false;
 TieredRegion hooked_regions [HOOK_COUNT];
 std::map<unsigned int, memory_cb_fnc> hooks[HOOK_COUNT];
 
@@ -53,6 +73,7 @@ SoundInterface_struct *SNDCoreList[] = {
 GPU3DInterface *core3DList[] = {
         &gpu3DNull,
         &gpu3DRasterize,
+        &gpu3DRasterizeFixedPoint,
         NULL
 };
 
@@ -82,11 +103,27 @@ EXPORTED int desmume_init()
     return 0;
 }
 
+EXPORTED int desmume_init_headless()
+{
+    // Everything runs on the calling thread, since worker threads don't survive fork().
+    CommonSettings.num_cores = 1;
+    CommonSettings.GFX3D_GeometryThread = false;
+    NDS_Init();
+    SPU_ChangeSoundCore(SNDCORE_DUMMY, 0);
+    GPU->Change3DRendererByID(RENDERID_SOFTRASTERIZER);
+    headless = true;
+    execute = false;
+    return 0;
+}
+
 EXPORTED void desmume_free()
 {
     execute = false;
+    desmume_framebuffer_export_stop();
     NDS_DeInit();
-    SDL_Quit();
+    if (!headless)
+        SDL_Quit();
+    headless = false;
 }
 
 EXPORTED void desmume_set_language(u8 lang)
@@ -106,6 +143,16 @@ EXPORTED void desmume_set_savetype(int type) {
     backup_setManualBackupType(type);
 }
 
+EXPORTED void desmume_backup_set_flush_interval(int milliseconds)
+{
+    backup_setFlushInterval((milliseconds > 0) ? (u32)milliseconds : 0);
+}
+
+EXPORTED BOOL desmume_backup_sync()
+{
+    return MMU_new.backupDevice.syncBackup() ? TRUE : FALSE;
+}
+
 
 EXPORTED void desmume_pause()
 {
@@ -158,6 +205,161 @@ EXPORTED void desmume_cycle(BOOL with_joystick)
     SPU_Emulate_user();
 }
 
+#ifndef _WIN32
+static bool fork_server_read_job(int fd, s32 &job)
+{
+    u8 *buffer = (u8 *)&job;
+    size_t done = 0;
+
+    while (done < sizeof(job))
+    {
+        const ssize_t result = read(fd, buffer + done, sizeof(job) - done);
+        if (result > 0)
+            done += result;
+        else if (result < 0 && errno == EINTR)
+            continue;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+static void fork_server_write_event(int fd, s32 job, s32 pid, s32 type, s32 status)
+{
+    const desmume_fork_server_event event = { job, pid, type, status };
+    const u8 *buffer = (const u8 *)&event;
+    size_t done = 0;
+
+    while (done < sizeof(event))
+    {
+        const ssize_t result = write(fd, buffer + done, sizeof(event) - done);
+        if (result > 0)
+            done += result;
+        else if (result < 0 && errno == EINTR)
+            continue;
+        else
+            return;
+    }
+}
+
+static void fork_server_reap(int reply_fd, std::map<pid_t, s32> &jobs, bool wait_for_all)
+{
+    while (!jobs.empty())
+    {
+        int status = 0;
+        const pid_t pid = waitpid(-1, &status, wait_for_all ? 0 : WNOHANG);
+        if (pid < 0 && errno == EINTR)
+            continue;
+        if (pid <= 0)
+            break;
+
+        std::map<pid_t, s32>::iterator it = jobs.find(pid);
+        if (it == jobs.end())
+            continue;
+
+        fork_server_write_event(reply_fd, it->second, pid, DESMUME_FORK_SERVER_JOB_EXITED, status);
+        jobs.erase(it);
+    }
+}
+#endif
+
+EXPORTED int desmume_fork_server(int request_fd, int reply_fd)
+{
+#ifndef _WIN32
+    // A thread that is running at fork() is simply gone in the child, along with any lock it held.
+    if (!headless || CommonSettings.num_cores != 1 || gfx3d_IsGeometryThreadRunning() || SPU_IsAudioThreadRunning() || wifiHandler->IsCommThreadRunning())
+    {
+        fprintf(stderr, "desmume_fork_server: needs desmume_init_headless(), and no geometry, audio or wifi thread\n");
+        return -1;
+    }
+
+    // The disk cache writes from worker threads, and every child would append to the file
+    // through its own copy of the cache state. Children just go without it.
+    textureDiskCache.Close();
+
+    // The children share one .dsv, so from here on saves only live in memory.
+    MMU_new.backupDevice.detachBackupFile();
+    GPU->ForceRender3DFinishAndFlush(true);
+
+    std::map<pid_t, s32> jobs;
+    s32 job;
+
+    for (;;)
+    {
+        fork_server_reap(reply_fd, jobs, false);
+
+        struct pollfd request = { request_fd, POLLIN, 0 };
+        const int ready = poll(&request, 1, 100);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready < 0)
+            break;
+        if (ready == 0)
+            continue;
+
+        if (!fork_server_read_job(request_fd, job))
+            break;
+
+        // Anything still buffered would otherwise get written once per child.
+        fflush(stdout);
+        fflush(stderr);
+
+        const pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(request_fd);
+            close(reply_fd);
+            return job;
+        }
+
+        if (pid < 0)
+        {
+            fork_server_write_event(reply_fd, job, -1, DESMUME_FORK_SERVER_JOB_FAILED, errno);
+            continue;
+        }
+
+        jobs[pid] = job;
+        fork_server_write_event(reply_fd, job, pid, DESMUME_FORK_SERVER_JOB_STARTED, 0);
+    }
+
+    fork_server_reap(reply_fd, jobs, true);
+#endif
+    return -1;
+}
+
+EXPORTED void desmume_wifi_set_adhoc_link(const char *link_name, int instance_id, BOOL lockstep, int latency_usec)
+{
+    if (link_name == NULL)
+    {
+        wifiHandler->SetAdhocTransport(WifiAdhocTransport_Socket);
+        return;
+    }
+
+    wifiHandler->SetAdhocLink(link_name, (u32)instance_id, lockstep ? true : false, (latency_usec > 0) ? (u32)latency_usec : 0);
+    wifiHandler->SetAdhocTransport(WifiAdhocTransport_SharedMemory);
+    wifiHandler->SetEmulationLevel(WifiEmulationLevel_Normal);
+}
+
+EXPORTED void desmume_wifi_set_replay(const char *capture_file_name)
+{
+    wifiHandler->SetSoftAPReplayFileName(capture_file_name);
+    if (capture_file_name != NULL)
+        wifiHandler->SetEmulationLevel(WifiEmulationLevel_Normal);
+}
+
+EXPORTED void desmume_wifi_replay_status(int *tx_matched, int *tx_mismatched, int *rx_remaining)
+{
+    const ReplayCommInterface *replay = wifiHandler->GetSoftAPReplayCommInterface();
+
+    if (tx_matched != NULL)
+        *tx_matched = (int)replay->GetTXMatchCount();
+    if (tx_mismatched != NULL)
+        *tx_mismatched = (int)replay->GetTXMismatchCount();
+    if (rx_remaining != NULL)
+        *rx_remaining = (int)replay->GetRXRemainingCount();
+}
+
 EXPORTED int desmume_sdl_get_ticks()
 {
     return SDL_GetTicks();
@@ -247,6 +449,264 @@ EXPORTED void desmume_draw_raw_as_rgbx(u8 *buffer)
     }
 }
 
+// The export header is plain memory shared with other processes, so its fields go through
+// the compiler's atomic builtins instead of being cast to atomic types.
+static inline s32 framebuffer_export_load(volatile s32 *value)
+{
+#ifdef _MSC_VER
+    return (s32)InterlockedCompareExchange((volatile LONG *)value, 0, 0);
+#else
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline void framebuffer_export_store(volatile s32 *value, s32 newValue)
+{
+#ifdef _MSC_VER
+    InterlockedExchange((volatile LONG *)value, (LONG)newValue);
+#else
+    __atomic_store_n(value, newValue, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline void framebuffer_export_increment(volatile s32 *value)
+{
+#ifdef _MSC_VER
+    InterlockedIncrement((volatile LONG *)value);
+#else
+    __atomic_fetch_add(value, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Zero-copy frame export. The GPU renders straight into the exported pages, one page per frame,
+// rotating through them so that the newest complete frame and the page a consumer is reading
+// are never written to.
+class FramebufferExportEventHandler : public GPUEventHandlerDefault
+{
+public:
+    desmume_framebuffer_export_header *header;
+    int fenceFD;
+
+    FramebufferExportEventHandler() : header(NULL), fenceFD(-1) {}
+    virtual ~FramebufferExportEventHandler() {}
+
+    virtual void DidFrameBegin(const size_t line, const bool isFrameSkipRequested, const size_t pageCount, u8 &selectedBufferIndexInOut)
+    {
+        if ( (line != 0) || isFrameSkipRequested )
+            return;
+
+        const s32 readyPage = framebuffer_export_load(&header->ready_page);
+        const s32 readerPage = framebuffer_export_load(&header->reader_page);
+
+        for (size_t i = 1; i <= pageCount; i++)
+        {
+            const s32 page = (s32)((selectedBufferIndexInOut + i) % pageCount);
+            if ( (page != readyPage) && (page != readerPage) )
+            {
+                selectedBufferIndexInOut = (u8)page;
+                break;
+            }
+        }
+    }
+
+    virtual void DidFrameEnd(bool isFrameSkipped, const NDSDisplayInfo &latestDisplayInfo)
+    {
+        if (isFrameSkipped)
+            return;
+
+        header->page_sequence[latestDisplayInfo.bufferIndex] = latestDisplayInfo.sequenceNumber;
+
+        framebuffer_export_store(&header->ready_page, (s32)latestDisplayInfo.bufferIndex);
+        framebuffer_export_increment(&header->ready_sequence);
+
+#ifdef __linux__
+        if (fenceFD != -1)
+        {
+            const uint64_t one = 1;
+            if (write(fenceFD, &one, sizeof(one)) != sizeof(one)) {}
+        }
+#endif
+    }
+};
+
+static FramebufferExportEventHandler *framebufferExport = NULL;
+static GPUEventHandler *framebufferExportPreviousHandler = NULL;
+static void *framebufferExportOwnedMemory = NULL;
+static size_t framebufferExportOwnedMemorySize = 0;
+static int framebufferExportMemFD = -1;
+
+static NDSColorFormat framebuffer_export_color_format(int format)
+{
+    return (format == DESMUME_FRAMEBUFFER_FORMAT_RGBA8888) ? NDSColorFormat_BGR888_Rev : NDSColorFormat_BGR555_Rev;
+}
+
+EXPORTED size_t desmume_framebuffer_export_size(int page_count, int format)
+{
+    if (page_count < 3 || page_count > MAX_FRAMEBUFFER_PAGES)
+        return 0;
+
+    const size_t pageSize = GPUSubsystem::GetFramebufferPageSize(framebuffer_export_color_format(format), GPU->GetCustomFramebufferWidth(), GPU->GetCustomFramebufferHeight());
+    return DESMUME_FRAMEBUFFER_EXPORT_HEADER_SIZE + (pageSize * page_count);
+}
+
+EXPORTED BOOL desmume_framebuffer_export_start(int page_count, int format, void *memory, size_t memory_size)
+{
+    desmume_framebuffer_export_stop();
+
+    const size_t requiredSize = desmume_framebuffer_export_size(page_count, format);
+    if (requiredSize == 0)
+        return FALSE;
+
+    if (memory == NULL)
+    {
+        framebufferExportOwnedMemory = malloc_alignedPage(requiredSize);
+        framebufferExportOwnedMemorySize = requiredSize;
+        memory = framebufferExportOwnedMemory;
+        memory_size = requiredSize;
+    }
+
+    if ( (memory_size < requiredSize) || (((uintptr_t)memory & 4095) != 0) )
+    {
+        desmume_framebuffer_export_stop();
+        return FALSE;
+    }
+
+    const NDSColorFormat colorFormat = framebuffer_export_color_format(format);
+    const size_t w = GPU->GetCustomFramebufferWidth();
+    const size_t h = GPU->GetCustomFramebufferHeight();
+
+    desmume_framebuffer_export_header *header = (desmume_framebuffer_export_header *)memory;
+    memset(header, 0, DESMUME_FRAMEBUFFER_EXPORT_HEADER_SIZE);
+    header->magic = DESMUME_FRAMEBUFFER_EXPORT_MAGIC;
+    header->version = DESMUME_FRAMEBUFFER_EXPORT_VERSION;
+    header->page_count = page_count;
+    header->page_size = (u32)GPUSubsystem::GetFramebufferPageSize(colorFormat, w, h);
+    header->format = format;
+    header->width = (u32)w;
+    header->height = (u32)h;
+    header->display_offset = GPU_FRAMEBUFFER_NATIVE_WIDTH * GPU_FRAMEBUFFER_NATIVE_HEIGHT * sizeof(u16) * 2;
+    header->ready_page = -1;
+    header->reader_page = -1;
+
+    framebufferExport = new FramebufferExportEventHandler;
+    framebufferExport->header = header;
+#ifdef __linux__
+    framebufferExport->fenceFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#endif
+
+    framebufferExportPreviousHandler = GPU->GetEventHandler();
+    GPU->SetEventHandler(framebufferExport);
+    GPU->SetWillAutoResolveToCustomBuffer(true);
+    GPU->SetFramebufferPageCount(page_count);
+    GPU->SetColorFormat(colorFormat);
+    GPU->SetFramebufferClientMemory((u8 *)memory + DESMUME_FRAMEBUFFER_EXPORT_HEADER_SIZE, memory_size - DESMUME_FRAMEBUFFER_EXPORT_HEADER_SIZE);
+
+    return TRUE;
+}
+
+EXPORTED int desmume_framebuffer_export_start_memfd(int page_count, int format)
+{
+#ifdef __linux__
+    const size_t requiredSize = desmume_framebuffer_export_size(page_count, format);
+    if (requiredSize == 0)
+        return -1;
+
+    const int fd = memfd_create("desmume-framebuffer", MFD_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    void *memory = (ftruncate(fd, requiredSize) == 0) ? mmap(NULL, requiredSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (memory == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+
+    if (!desmume_framebuffer_export_start(page_count, format, memory, requiredSize))
+    {
+        munmap(memory, requiredSize);
+        close(fd);
+        return -1;
+    }
+
+    framebufferExportMemFD = fd;
+    framebufferExportOwnedMemory = memory;
+    framebufferExportOwnedMemorySize = requiredSize;
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+EXPORTED void desmume_framebuffer_export_stop()
+{
+    if (framebufferExport != NULL)
+    {
+        GPU->SetEventHandler(framebufferExportPreviousHandler);
+        GPU->SetFramebufferPageCount(1);
+        GPU->SetFramebufferClientMemory(NULL, 0);
+
+#ifdef __linux__
+        if (framebufferExport->fenceFD != -1)
+            close(framebufferExport->fenceFD);
+#endif
+        delete framebufferExport;
+        framebufferExport = NULL;
+        framebufferExportPreviousHandler = NULL;
+    }
+
+#ifdef __linux__
+    if (framebufferExportMemFD != -1)
+    {
+        munmap(framebufferExportOwnedMemory, framebufferExportOwnedMemorySize);
+        close(framebufferExportMemFD);
+        framebufferExportMemFD = -1;
+        framebufferExportOwnedMemory = NULL;
+    }
+#endif
+
+    free_aligned(framebufferExportOwnedMemory);
+    framebufferExportOwnedMemory = NULL;
+    framebufferExportOwnedMemorySize = 0;
+}
+
+EXPORTED desmume_framebuffer_export_header *desmume_framebuffer_export_get_header()
+{
+    return (framebufferExport != NULL) ? framebufferExport->header : NULL;
+}
+
+EXPORTED int desmume_framebuffer_export_fence_fd()
+{
+    return (framebufferExport != NULL) ? framebufferExport->fenceFD : -1;
+}
+
+EXPORTED int desmume_framebuffer_export_acquire()
+{
+    if (framebufferExport == NULL)
+        return -1;
+
+    desmume_framebuffer_export_header *header = framebufferExport->header;
+    s32 page;
+
+    // The page only counts as pinned if it is still the newest frame after reader_page was set,
+    // otherwise the emulator may already have picked it for the next frame.
+    do
+    {
+        page = framebuffer_export_load(&header->ready_page);
+        framebuffer_export_store(&header->reader_page, page);
+    } while (page != framebuffer_export_load(&header->ready_page));
+
+    return page;
+}
+
+EXPORTED void desmume_framebuffer_export_release()
+{
+    if (framebufferExport == NULL)
+        return;
+
+    framebuffer_export_store(&framebufferExport->header->reader_page, -1);
+}
+
 EXPORTED void desmume_savestate_clear()
 {
     clear_savestates();
@@ -262,6 +722,21 @@ EXPORTED BOOL desmume_savestate_save(const char *file_name)
     return savestate_save(file_name);
 }
 
+EXPORTED void *desmume_snapshot_create()
+{
+    return savestate_snapshot_create();
+}
+
+EXPORTED BOOL desmume_snapshot_restore(void *snapshot)
+{
+    return savestate_snapshot_restore((savestate_snapshot *)snapshot) ? TRUE : FALSE;
+}
+
+EXPORTED void desmume_snapshot_free(void *snapshot)
+{
+    savestate_snapshot_free((savestate_snapshot *)snapshot);
+}
+
 EXPORTED void desmume_savestate_scan()
 {
     scan_savestates();
@@ -307,6 +782,36 @@ EXPORTED void desmume_gpu_set_layer_sub_enable_state(int layer_index, BOOL the_s
     GPU->GetEngineSub()->SetLayerEnableState(layer_index, the_state);
 }
 
+// Takes effect the next time the GXFIFO runs.
+EXPORTED void desmume_geometry_thread_set(BOOL enabled)
+{
+    CommonSettings.GFX3D_GeometryThread = (enabled != FALSE);
+}
+EXPORTED BOOL desmume_geometry_thread_running()
+{
+    return gfx3d_IsGeometryThreadRunning();
+}
+
+EXPORTED BOOL desmume_set_3d_renderer(int id)
+{
+    if (id < RENDERID_NULL || id > RENDERID_SOFTRASTERIZER_FIXEDPOINT)
+        return FALSE;
+    return GPU->Change3DRendererByID(id) ? TRUE : FALSE;
+}
+
+EXPORTED unsigned long long desmume_3d_identical_frame_hits(BOOL reset)
+{
+    const RendererID id = CurrentRenderer->GetRenderID();
+    if (id != RENDERID_SOFTRASTERIZER && id != RENDERID_SOFTRASTERIZER_FIXEDPOINT)
+        return 0;
+
+    SoftRasterizerRenderer *softRasterizer = (SoftRasterizerRenderer *)CurrentRenderer;
+    const unsigned long long hits = softRasterizer->GetIdenticalFrameHitCount();
+    if (reset)
+        softRasterizer->ResetIdenticalFrameHitCount();
+    return hits;
+}
+
 EXPORTED int desmume_volume_get()
 {
     return SNDSDLGetAudioVolume();
@@ -316,6 +821,60 @@ EXPORTED void desmume_volume_set(int volume)
     SNDSDLSetAudioVolume(volume);
 }
 
+EXPORTED BOOL desmume_audio_output_get()
+{
+    return SPU_IsAudioOutputEnabled();
+}
+EXPORTED void desmume_audio_output_set(BOOL enabled)
+{
+    SPU_SetAudioOutputEnabled(enabled);
+}
+
+static bool audioThreadDidChangeSynchMode = false;
+static int audioThreadPreviousSynchMode = 0;
+static int audioThreadPreviousSynchMethod = 0;
+
+EXPORTED void desmume_audio_thread_set(BOOL enabled)
+{
+    if (enabled)
+    {
+        // The audio thread drives the synchronizer, which only exists in synchronous mode.
+        if (!audioThreadDidChangeSynchMode)
+        {
+            audioThreadPreviousSynchMode = SPU_GetSynchMode();
+            audioThreadPreviousSynchMethod = SPU_GetSynchMethod();
+            audioThreadDidChangeSynchMode = true;
+        }
+
+        SPU_SetSynchMode(ESynchMode_Synchronous, ESynchMethod_N);
+        SPU_SetAudioThreadEnabled(true);
+    }
+    else
+    {
+        SPU_SetAudioThreadEnabled(false);
+
+        if (audioThreadDidChangeSynchMode)
+        {
+            SPU_SetSynchMode(audioThreadPreviousSynchMode, audioThreadPreviousSynchMethod);
+            audioThreadDidChangeSynchMode = false;
+        }
+    }
+}
+EXPORTED BOOL desmume_audio_thread_running()
+{
+    return SPU_IsAudioThreadRunning();
+}
+EXPORTED void desmume_audio_thread_stats(unsigned int *latency_samples, unsigned int *peak_latency_samples,
+                                         unsigned long long *underruns, unsigned long long *dropped_samples)
+{
+    SPUAudioThreadStats stats;
+    SPU_GetAudioThreadStats(stats);
+    if (latency_samples) *latency_samples = stats.latencySamples;
+    if (peak_latency_samples) *peak_latency_samples = stats.peakLatencySamples;
+    if (underruns) *underruns = stats.underruns;
+    if (dropped_samples) *dropped_samples = stats.droppedSamples;
+}
+
 EXPORTED unsigned char desmume_memory_read_byte(int address)
 {
     return (unsigned char)(_MMU_read08<ARMCPU_ARM9>(address) & 0xFF);
@@ -606,7 +1165,7 @@ EXPORTED BOOL desmume_movie_is_finished()
 
 EXPORTED int desmume_movie_get_length()
 {
-    return currMovieData.records.size();
+    return currMovieData.getNumRecords();
 }
 
 EXPORTED char *desmume_movie_get_name()
@@ -672,3 +1231,77 @@ EXPORTED void desmume_movie_stop()
 {
     FCEUI_StopMovie();
 }
+EXPORTED BOOL desmume_movie_convert_to_columnar(const char *src_file_name, const char *dst_file_name)
+{
+    return FCEUI_ConvertMovieToColumnar(src_file_name, dst_file_name) ? TRUE : FALSE;
+}
+EXPORTED void desmume_movie_set_savestate_by_reference(BOOL state)
+{
+    movie_savestate_by_reference = (state != FALSE);
+}
+EXPORTED BOOL desmume_movie_verify_write(const char *sidecar_file_name, int hash_interval, int segment_frames)
+{
+    return FCEUI_MovieVerifyBeginWrite(sidecar_file_name, hash_interval, segment_frames) ? TRUE : FALSE;
+}
+EXPORTED int desmume_movie_verify_segment_count(const char *sidecar_file_name)
+{
+    return FCEUI_MovieVerifyGetSegmentCount(sidecar_file_name);
+}
+EXPORTED int desmume_movie_verify_segments(const char *movie_file_name, const char *sidecar_file_name, int first_segment, int segment_count)
+{
+    if (FCEUI_LoadMovie(movie_file_name, true, false, -1) != NULL)
+        return -2;
+    if (!FCEUI_MovieVerifyBeginCheck(sidecar_file_name, first_segment, segment_count))
+    {
+        FCEUI_StopMovie();
+        return -2;
+    }
+
+    while (movieMode == MOVIEMODE_PLAY && FCEUI_MovieVerifyGetStatus() == MOVIEVERIFY_CHECKING)
+    {
+        NDS_beginProcessingInput();
+        FCEUMOV_AddInputState();
+        NDS_endProcessingInput();
+
+        NDS_exec<false>();
+        SPU_Emulate_user();
+    }
+
+    const EMOVIEVERIFYSTATUS status = FCEUI_MovieVerifyGetStatus();
+    FCEUI_StopMovie();
+
+    if (status == MOVIEVERIFY_DIVERGED)
+        return FCEUI_MovieVerifyGetDivergedFrame();
+    return (status == MOVIEVERIFY_COMPLETE) ? -1 : -2;
+}
+EXPORTED int desmume_movie_verify_status()
+{
+    return FCEUI_MovieVerifyGetStatus();
+}
+
+EXPORTED void desmume_framehash_set_regions(unsigned int region_mask)
+{
+    NDS_FrameHashSetRegions(region_mask);
+}
+
+EXPORTED BOOL desmume_framehash_open_file(const char *file_name)
+{
+    return NDS_FrameHashOpenFile(file_name) ? TRUE : FALSE;
+}
+
+EXPORTED void desmume_framehash_close_file()
+{
+    NDS_FrameHashCloseFile();
+}
+
+EXPORTED void desmume_framehash_set_ring_size(int record_count)
+{
+    NDS_FrameHashSetRingSize((record_count > 0) ? (size_t)record_count : 0);
+}
+
+EXPORTED int desmume_framehash_read(void *out_records, int max_count)
+{
+    if (max_count <= 0)
+        return 0;
+    return (int)NDS_FrameHashReadRing((NDSFrameHashRecord *)out_records, (size_t)max_count);
+}
@@ -68,11 +68,17 @@ struct SimpleDate {
 
 EXPORTED int desmume_init(void);
 EXPORTED void desmume_free(void);
+// Like desmume_init, but without SDL, audio output or worker threads; needed for desmume_fork_server.
+EXPORTED int desmume_init_headless(void);
 
 // 0 = Japanese, 1 = English, 2 = French, 3 = German, 4 = Italian, 5 = Spanish
 EXPORTED void desmume_set_language(u8 language);
 EXPORTED int desmume_open(const char *filename);
 EXPORTED void desmume_set_savetype(int type);
+// How often pending save memory writes are written out to the .dsv in the background; 0 = only on save completion/exit.
+EXPORTED void desmume_backup_set_flush_interval(int milliseconds);
+// Write out all pending save memory writes and fsync the .dsv. Returns FALSE on a write error.
+EXPORTED BOOL desmume_backup_sync();
 EXPORTED void desmume_pause(void);
 EXPORTED void desmume_resume(void);
 EXPORTED void desmume_reset(void);
@@ -80,6 +86,39 @@ EXPORTED BOOL desmume_running(void);
 EXPORTED void desmume_skip_next_frame(void);
 EXPORTED void desmume_cycle(BOOL with_joystick);
 
+// Fork-server mode (not on Windows). Boot once with desmume_init_headless(), desmume_open() and
+// optionally a savestate, then call this: it reads job ids (one s32 each) from request_fd and
+// forks a copy-on-write child per job, so every child starts from the same warmed-up state.
+// Returns the job id in the child, which runs the job and exits (_exit() skips tearing down
+// the copied state). In the server it reports a desmume_fork_server_event per child start and
+// exit on reply_fd, and returns -1 once request_fd is closed and all children have exited.
+// Saves stop being written to the .dsv once the server starts.
+#define DESMUME_FORK_SERVER_JOB_STARTED 0
+#define DESMUME_FORK_SERVER_JOB_EXITED 1
+#define DESMUME_FORK_SERVER_JOB_FAILED 2
+
+typedef struct desmume_fork_server_event {
+    s32 job;
+    s32 pid;
+    s32 type;
+    s32 status; // waitpid() status for _EXITED, errno for _FAILED
+} desmume_fork_server_event;
+
+EXPORTED int desmume_fork_server(int request_fd, int reply_fd);
+
+// Ad-hoc wifi through a named shared-memory link instead of UDP broadcast; instances on this machine
+// with the same link_name and different instance_id (0-15) see each other. With lockstep, a packet
+// arrives latency_usec (0 = 64) of emulated time after it was sent and no instance runs ahead of the
+// others by more than that, so runs with the same inputs are reproducible. A NULL link_name goes back
+// to UDP. Also turns wifi emulation on. Takes effect at the next desmume_open()/desmume_reset().
+EXPORTED void desmume_wifi_set_adhoc_link(const char *link_name, int instance_id, BOOL lockstep, int latency_usec);
+// Replaces the network in infrastructure (Nintendo WFC) mode with an Ethernet pcap capture: received frames
+// arrive at their recorded emulated time, and frames the game sends are checked against the recorded ones.
+// Needs neither sockets nor libpcap. NULL goes back to the real network. Takes effect at the next reset.
+EXPORTED void desmume_wifi_set_replay(const char *capture_file_name);
+// Counts for the current (or last) replay.
+EXPORTED void desmume_wifi_replay_status(int *tx_matched, int *tx_mismatched, int *rx_remaining);
+
 EXPORTED int desmume_sdl_get_ticks();
 
 // Drawing is either supported manually via a custom OpenGL texture...
@@ -96,10 +135,56 @@ EXPORTED void desmume_draw_window_free();
 // ... or have fun working with the display buffer directly
 EXPORTED u16 *desmume_draw_raw();
 EXPORTED void desmume_draw_raw_as_rgbx(u8 *buffer);
+// ... or have the GPU render straight into a block of (optionally shared) memory, one page per frame.
+// Layout: a DESMUME_FRAMEBUFFER_EXPORT_HEADER_SIZE header, then page_count pages of page_size bytes each.
+// Within a page, display_offset is the start of the main display, followed by the touch display
+// (width * height pixels each).
+#define DESMUME_FRAMEBUFFER_FORMAT_BGR555 0
+#define DESMUME_FRAMEBUFFER_FORMAT_RGBA8888 1
+#define DESMUME_FRAMEBUFFER_EXPORT_MAGIC 0x58465344 // "DSFX"
+#define DESMUME_FRAMEBUFFER_EXPORT_VERSION 1
+#define DESMUME_FRAMEBUFFER_EXPORT_HEADER_SIZE 4096
+
+typedef struct desmume_framebuffer_export_header {
+    u32 magic;
+    u32 version;
+    u32 page_count;
+    u32 page_size;
+    u32 format;
+    u32 width;
+    u32 height;
+    u32 display_offset;
+    // Newest complete page, or -1. A reader stores the page it is about to read in reader_page,
+    // checks that ready_page still matches (retrying if not), and stores -1 when done.
+    volatile s32 ready_page;
+    volatile s32 reader_page;
+    // Incremented after every completed frame.
+    volatile s32 ready_sequence;
+    u32 reserved;
+    u64 page_sequence[8];
+} desmume_framebuffer_export_header;
+
+// Bytes needed for page_count (3-8) pages at the current resolution; 0 if page_count is out of range.
+EXPORTED size_t desmume_framebuffer_export_size(int page_count, int format);
+// memory must be page aligned and at least desmume_framebuffer_export_size() bytes; NULL allocates it internally.
+EXPORTED BOOL desmume_framebuffer_export_start(int page_count, int format, void *memory, size_t memory_size);
+// Linux only: exports into a memfd that another process can mmap. Returns the fd, or -1.
+EXPORTED int desmume_framebuffer_export_start_memfd(int page_count, int format);
+EXPORTED void desmume_framebuffer_export_stop();
+EXPORTED desmume_framebuffer_export_header *desmume_framebuffer_export_get_header();
+// Linux only: an eventfd that becomes readable after each completed frame, or -1.
+EXPORTED int desmume_framebuffer_export_fence_fd();
+// In-process reader side of the protocol above: pins and returns the newest page (-1 if none yet).
+EXPORTED int desmume_framebuffer_export_acquire();
+EXPORTED void desmume_framebuffer_export_release();
 
 EXPORTED void desmume_savestate_clear();
 EXPORTED BOOL desmume_savestate_load(const char *file_name);
 EXPORTED BOOL desmume_savestate_save(const char *file_name);
+// In-memory snapshots for returning to the same point many times (same ROM only); much faster than loading a savestate.
+EXPORTED void *desmume_snapshot_create();
+EXPORTED BOOL desmume_snapshot_restore(void *snapshot);
+EXPORTED void desmume_snapshot_free(void *snapshot);
 EXPORTED void desmume_savestate_scan();
 EXPORTED void desmume_savestate_slot_load(int index);
 EXPORTED void desmume_savestate_slot_save(int index);
@@ -111,8 +196,28 @@ EXPORTED BOOL desmume_gpu_get_layer_sub_enable_state(int layer_index);
 EXPORTED void desmume_gpu_set_layer_main_enable_state(int layer_index, BOOL the_state);
 EXPORTED void desmume_gpu_set_layer_sub_enable_state(int layer_index, BOOL the_state);
 
+// Executes GXFIFO commands on a worker thread. Emulation results are unchanged.
+EXPORTED void desmume_geometry_thread_set(BOOL enabled);
+EXPORTED BOOL desmume_geometry_thread_running();
+
+// Selects the 3D renderer: 0 = disabled, 1 = SoftRasterizer,
+// 2 = SoftRasterizer with the fixed-point pipeline (native resolution only).
+EXPORTED BOOL desmume_set_3d_renderer(int id);
+// Number of SoftRasterizer frames reused because the 3D scene was unchanged since the
+// last one, or 0 for other renderers. Passing reset = TRUE clears the count after reading it.
+EXPORTED unsigned long long desmume_3d_identical_frame_hits(BOOL reset);
+
 EXPORTED int desmume_volume_get();
 EXPORTED void desmume_volume_set(int volume);
+// Disabling audio output stops all sample generation while keeping the SPU state exact.
+EXPORTED BOOL desmume_audio_output_get();
+EXPORTED void desmume_audio_output_set(BOOL enabled);
+// Moves audio post-processing, device output and WAV writing off the emulation thread.
+EXPORTED void desmume_audio_thread_set(BOOL enabled);
+EXPORTED BOOL desmume_audio_thread_running();
+// Latencies are in samples at DESMUME_SAMPLE_RATE. Any pointer may be NULL.
+EXPORTED void desmume_audio_thread_stats(unsigned int *latency_samples, unsigned int *peak_latency_samples,
+                                         unsigned long long *underruns, unsigned long long *dropped_samples);
 
 EXPORTED unsigned char desmume_memory_read_byte(int address);
 EXPORTED signed char desmume_memory_read_byte_signed(int address);
@@ -174,6 +279,30 @@ EXPORTED void desmume_movie_record(const char *save_file_name, const char *autho
 EXPORTED void desmume_movie_record_from_date(const char *save_file_name, const char *author_name, START_FROM start_from, const char* sram_file_name, SimpleDate date);
 EXPORTED void desmume_movie_replay();
 EXPORTED void desmume_movie_stop();
+// Writes a movie as a columnar .dsmc file, which desmume_movie_play memory-maps for playback.
+EXPORTED BOOL desmume_movie_convert_to_columnar(const char *src_file_name, const char *dst_file_name);
+// Savestates store only the movie's guid and a hash of the frames played so far.
+EXPORTED void desmume_movie_set_savestate_by_reference(BOOL state);
+// Starts writing a verification sidecar for the movie that is playing: a state hash every
+// hash_interval frames and a savestate every segment_frames frames.
+EXPORTED BOOL desmume_movie_verify_write(const char *sidecar_file_name, int hash_interval, int segment_frames);
+EXPORTED int desmume_movie_verify_segment_count(const char *sidecar_file_name);
+// Replays segment_count segments starting at first_segment and checks them against the sidecar.
+// Returns the first frame whose state hash differs, -1 if all hashes matched, or -2 on error.
+// Run one call per process to check the segments of a movie in parallel.
+EXPORTED int desmume_movie_verify_segments(const char *movie_file_name, const char *sidecar_file_name, int first_segment, int segment_count);
+EXPORTED int desmume_movie_verify_status();
+
+// Per-frame hashes taken at vblank. region_mask bits: 0 = main display, 1 = touch display,
+// 2 = main RAM, 3-11 = VRAM banks A-I. A mask of 0 turns hashing off.
+EXPORTED void desmume_framehash_set_regions(unsigned int region_mask);
+EXPORTED BOOL desmume_framehash_open_file(const char *file_name);
+EXPORTED void desmume_framehash_close_file();
+// Keeps the newest record_count records in memory for desmume_framehash_read.
+EXPORTED void desmume_framehash_set_ring_size(int record_count);
+// Moves up to max_count of the oldest records into out_records and returns how many were moved.
+// Each record is 104 bytes: u32 frame, u32 region mask (bit 31 = frame skipped), u64 hash[12].
+EXPORTED int desmume_framehash_read(void *out_records, int max_count);
 
 };
 
@@ -103,6 +103,7 @@ SoundInterface_struct *SNDCoreList[] = {
 GPU3DInterface *core3DList[] = {
 &gpu3DNull,
 &gpu3DRasterize,
+&gpu3DRasterizeFixedPoint,
 NULL
 };
 
@@ -171,6 +172,7 @@ fill_config( class configured_features *config,
     { "3d-engine", 0, 0, G_OPTION_ARG_INT, &config->engine_3d, "Select 3d rendering engine. Available engines:\n"
         "\t\t\t\t\t\t  0 = 3d disabled\n"
         "\t\t\t\t\t\t  1 = internal rasterizer (default)\n"
+        "\t\t\t\t\t\t  2 = internal rasterizer, fixed point (native resolution only)\n"
         ,"ENGINE"},
     { "save-type", 0, 0, G_OPTION_ARG_INT, &config->savetype, "Select savetype from the following:\n"
     "\t\t\t\t\t\t  0 = Autodetect (default)\n"
@@ -208,8 +210,8 @@ fill_config( class configured_features *config,
     goto error;
   }
 
-  if (config->engine_3d != 0 && config->engine_3d != 1) {
-    g_printerr("Currently available engines: 0, 1.\n");
+  if (config->engine_3d < 0 || config->engine_3d > 2) {
+    g_printerr("Currently available engines: 0, 1, 2.\n");
     goto error;
   }
 
@@ -470,6 +472,8 @@ int main(int argc, char ** argv) {
 
   if ( !my_config.disable_sound) {
     SPU_ChangeSoundCore(SNDCORE_SDL, 735 * 4);
+  } else {
+    SPU_SetAudioOutputEnabled(false);
   }
 
   if (!GPU->Change3DRendererByID(my_config.engine_3d)) {
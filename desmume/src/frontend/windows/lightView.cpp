@@ -93,6 +93,9 @@ BOOL LightView_OnPaint(HWND hwnd, WPARAM wParam, LPARAM lParam)
 
     hdc = BeginPaint(hwnd, &ps);
     
+	// the light registers belong to the geometry thread while it has commands queued
+	gfx3d_WaitForGeometryThread();
+	
 	LightView_OnPaintLight(hwnd, 0);
 	LightView_OnPaintLight(hwnd, 1);
 	LightView_OnPaintLight(hwnd, 2);
@@ -136,6 +136,9 @@ BOOL MatrixView_OnPaint( HWND hwnd, WPARAM wParam, LPARAM lParam)
 
     hdc = BeginPaint(hwnd, &ps);
     
+	// the matrix stacks belong to the geometry thread while it has commands queued
+	gfx3d_WaitForGeometryThread();
+	
 	MatrixView_OnPaintProjectionMatrix(hwnd);
 	MatrixView_OnPaintPositionMatrix(hwnd);
 	MatrixView_OnPaintDirectionMatrix(hwnd);
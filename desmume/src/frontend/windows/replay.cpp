@@ -122,12 +122,15 @@ static char playfilename[MAX_PATH] = "";
 
 void Describe(HWND hwndDlg)
 {
-	EMUFILE_FILE fp(playfilename,"rb");
-	if(fp.fail()) return;
 	MovieData md;
-	LoadFM2(md, fp, INT_MAX, false);
+	if(!LoadMovieColumnar(md, playfilename))
+	{
+		EMUFILE_FILE fp(playfilename,"rb");
+		if(fp.fail()) return;
+		LoadFM2(md, fp, INT_MAX, false);
+	}
 
-	u32 num_frames = md.records.size();
+	u32 num_frames = md.getNumRecords();
 
 	double tempCount = (num_frames / (33513982.0/6/355/263)) + 0.005; // +0.005s for rounding
 	int num_seconds = (int)tempCount;
@@ -57,7 +57,7 @@ slock *cpu_mutex = NULL;
 #define UNUSED_PARM( parm) parm
 #endif
 
-#if 1
+#if 0
 #define DEBUG_LOG( fmt, ...) fprintf(stdout, fmt, ##__VA_ARGS__)
 #else
 #define DEBUG_LOG( fmt, ...)
@@ -391,7 +391,10 @@ step_instruction_watch( void *data, uint32_t addr, UNUSED_PARM(int thunmb)) {
 /************************************************************************/
 /* BUFMAX defines the maximum number of characters in inbound/outbound buffers*/
 /* at least NUMREGBYTES*2 are needed for register packets */
-#define BUFMAX 2048
+#define BUFMAX BUFMAX_GDB
+
+/* The largest packet body in either direction, leaving room for the '$', '#' and checksum */
+#define PACKET_SIZE_GDB (BUFMAX - 8)
 
 
 
@@ -453,26 +456,93 @@ hexToInt( const uint8_t **ptr, uint32_t *intValue)
   return (numChars);
 }
 
-/* Convert the memory pointed to by mem into hex, placing result in buf.
- * Return a pointer to the last char put in buf (null), in case of mem fault,
- * return 0.
- * If MAY_FAULT is non-zero, then we will handle memory faults by returning
- * a 0, else treat a fault like any other fault in the stub.
+/*
+ * Find the host memory behind plain RAM, so that bulk reads can copy it
+ * directly instead of going through the memory interface a byte at a time.
+ * Returns NULL if addr isn't plain RAM, otherwise the host pointer with
+ * span_len set to the number of bytes that follow it contiguously.
+ */
+static const uint8_t *
+host_read_span( struct gdb_stub_state *stub, uint32_t addr, uint32_t *span_len) {
+  const armcpu_t *cpu = (const armcpu_t *)stub->arm_cpu_object;
+  /* the DTCM can be mapped over any 16KB block, so ARM9 spans stop at each one */
+  const uint32_t block_len = 0x4000 - (addr & 0x3FFF);
+
+  if ( cpu->proc_ID == ARMCPU_ARM9) {
+    if ( (addr & ~0x3FFF) == MMU.DTCMRegion) {
+      *span_len = block_len;
+      return &MMU.ARM9_DTCM[addr & 0x3FFF];
+    }
+
+    if ( (addr & 0x0FFFFFFF) < 0x02000000) {
+      *span_len = block_len;
+      return &MMU.ARM9_ITCM[addr & 0x7FFF];
+    }
+  }
+  else if ( (addr & 0x0F800000) == 0x03800000) {
+    *span_len = 0x10000 - (addr & 0xFFFF);
+    return &MMU.ARM7_ERAM[addr & 0xFFFF];
+  }
+
+  if ( (addr & 0x0F000000) == 0x02000000) {
+    *span_len = block_len;
+    return &MMU.MAIN_MEM[addr & _MMU_MAIN_MEM_MASK];
+  }
+
+  return NULL;
+}
+
+/*
+ * Read count bytes of target memory into mem, copying plain RAM
+ * directly and using the memory interface for everything else.
+ */
+static void
+read_mem( struct gdb_stub_state *stub, uint32_t mem_addr,
+          uint8_t *mem, uint32_t count)
+{
+  while ( count > 0) {
+    uint32_t span_len;
+    const uint8_t *span = host_read_span( stub, mem_addr, &span_len);
+
+    if ( span != NULL) {
+      if ( span_len > count)
+        span_len = count;
+
+      memcpy( mem, span, span_len);
+      mem += span_len;
+      mem_addr += span_len;
+      count -= span_len;
+    }
+    else {
+      *mem++ = stub->direct_memio->read8( stub->direct_memio->data, mem_addr++);
+      count--;
+    }
+  }
+}
+
+/* Convert count bytes of target memory into hex, placing result in buf.
+ * Return a pointer to the last char put in buf (null).
  */
 
 static uint8_t *
-mem2hex ( armcpu_memory_iface *memio, uint32_t mem_addr,
+mem2hex ( struct gdb_stub_state *stub, uint32_t mem_addr,
           uint8_t *buf, int count)
 {
-  uint8_t ch;
-
-  //set_mem_fault_trap(may_fault);
+  uint8_t chunk[256];
 
-  while (count-- > 0)
+  while (count > 0)
     {
-      ch = memio->read8( memio->data, mem_addr++);
-      *buf++ = hexchars[ch >> 4];
-      *buf++ = hexchars[ch & 0xf];
+      int i;
+      int chunk_len = (count < (int)sizeof(chunk)) ? count : (int)sizeof(chunk);
+
+      read_mem( stub, mem_addr, chunk, chunk_len);
+      mem_addr += chunk_len;
+      count -= chunk_len;
+
+      for ( i = 0; i < chunk_len; i++) {
+        *buf++ = hexchars[chunk[i] >> 4];
+        *buf++ = hexchars[chunk[i] & 0xf];
+      }
     }
 
   *buf = 0;
@@ -480,6 +550,87 @@ mem2hex ( armcpu_memory_iface *memio, uint32_t mem_addr,
   return buf;
 }
 
+/* Escape binary data for a packet body: '#', '$', '}' and '*' are sent as
+ * '}' followed by the byte XOR 0x20. Stops before the output would exceed
+ * max_out bytes. Returns the number of input bytes that were encoded.
+ */
+static uint32_t
+mem2bin( const uint8_t *mem, uint32_t count, uint8_t *buf,
+         uint32_t max_out, uint32_t *out_len) {
+  uint32_t in_index = 0;
+  uint32_t out_index = 0;
+
+  for ( ; in_index < count; in_index++) {
+    uint8_t ch = mem[in_index];
+
+    if ( ch == '#' || ch == '$' || ch == '}' || ch == '*') {
+      if ( out_index + 2 > max_out)
+        break;
+      buf[out_index++] = '}';
+      buf[out_index++] = ch ^ 0x20;
+    }
+    else {
+      if ( out_index + 1 > max_out)
+        break;
+      buf[out_index++] = ch;
+    }
+  }
+
+  *out_len = out_index;
+  return in_index;
+}
+
+/* Undo the escaping of mem2bin. Returns the number of bytes decoded. */
+static uint32_t
+bin2mem( const uint8_t *buf, uint32_t buf_len, uint8_t *mem) {
+  uint32_t in_index = 0;
+  uint32_t out_index = 0;
+
+  while ( in_index < buf_len) {
+    uint8_t ch = buf[in_index++];
+
+    if ( ch == '}' && in_index < buf_len) {
+      ch = buf[in_index++] ^ 0x20;
+    }
+    mem[out_index++] = ch;
+  }
+
+  return out_index;
+}
+
+/*
+ * The target description for qXfer:memory-map:read. Everything the
+ * CPU can address is listed, since GDB refuses accesses outside the map.
+ */
+static const char arm9_memory_map[] =
+  "<?xml version=\"1.0\"?>"
+  "<!DOCTYPE memory-map PUBLIC \"+//IDN gnu.org//DTD GDB Memory Map V1.0//EN\" \"http://sourceware.org/gdb/gdb-memory-map.dtd\">"
+  "<memory-map>"
+  "<memory type=\"ram\" start=\"0x00000000\" length=\"0x02000000\"/>" /* ITCM */
+  "<memory type=\"ram\" start=\"0x02000000\" length=\"0x01000000\"/>" /* main RAM */
+  "<memory type=\"ram\" start=\"0x03000000\" length=\"0x01000000\"/>" /* shared WRAM */
+  "<memory type=\"ram\" start=\"0x04000000\" length=\"0x01000000\"/>" /* I/O */
+  "<memory type=\"ram\" start=\"0x05000000\" length=\"0x01000000\"/>" /* palettes */
+  "<memory type=\"ram\" start=\"0x06000000\" length=\"0x01000000\"/>" /* VRAM */
+  "<memory type=\"ram\" start=\"0x07000000\" length=\"0x01000000\"/>" /* OAM */
+  "<memory type=\"rom\" start=\"0x08000000\" length=\"0x02000000\"/>" /* GBA slot ROM */
+  "<memory type=\"ram\" start=\"0x0a000000\" length=\"0x06000000\"/>" /* GBA slot RAM, DTCM */
+  "<memory type=\"rom\" start=\"0xffff0000\" length=\"0x00010000\"/>" /* BIOS */
+  "</memory-map>";
+
+static const char arm7_memory_map[] =
+  "<?xml version=\"1.0\"?>"
+  "<!DOCTYPE memory-map PUBLIC \"+//IDN gnu.org//DTD GDB Memory Map V1.0//EN\" \"http://sourceware.org/gdb/gdb-memory-map.dtd\">"
+  "<memory-map>"
+  "<memory type=\"rom\" start=\"0x00000000\" length=\"0x00004000\"/>" /* BIOS */
+  "<memory type=\"ram\" start=\"0x02000000\" length=\"0x01000000\"/>" /* main RAM */
+  "<memory type=\"ram\" start=\"0x03000000\" length=\"0x01000000\"/>" /* shared and ARM7 WRAM */
+  "<memory type=\"ram\" start=\"0x04000000\" length=\"0x01000000\"/>" /* I/O, wifi */
+  "<memory type=\"ram\" start=\"0x06000000\" length=\"0x01000000\"/>" /* VRAM */
+  "<memory type=\"rom\" start=\"0x08000000\" length=\"0x02000000\"/>" /* GBA slot ROM */
+  "<memory type=\"ram\" start=\"0x0a000000\" length=\"0x01000000\"/>" /* GBA slot RAM */
+  "</memory-map>";
+
 
 
 static enum read_res_gdb
@@ -564,7 +715,8 @@ struct debug_out_packet {
 };
 
 static struct hidden_debug_out_packet the_out_packet;
-static unsigned char hidden_buffer[BUFMAX];
+/* room for the '$' and the trailing '#', checksum and null */
+static unsigned char hidden_buffer[BUFMAX + 8];
 
 
 static struct debug_out_packet *
@@ -576,9 +728,11 @@ getOutPacket( void) {
 #define CHECKSUM_PART_SIZE 3
 /**
  * send the packet in buffer.
+ * In no-ack mode the packet is sent once without waiting for GDB's '+'.
  */
 static int
-putpacket ( SOCKET_TYPE sock, struct debug_out_packet *out_packet, uint32_t size) {
+putpacket ( SOCKET_TYPE sock, struct debug_out_packet *out_packet, uint32_t size,
+            int no_ack) {
   unsigned char checksum = 0;
   uint32_t count;
   unsigned char *ch_ptr = (unsigned char *)&out_packet->start_ptr[-1];
@@ -606,8 +760,25 @@ putpacket ( SOCKET_TYPE sock, struct debug_out_packet *out_packet, uint32_t size
 
   do {
     int reply_found = 0;
+    uint32_t sent = 0;
 
-    send( sock, (char*)&out_packet->start_ptr[-1], count, 0);
+    /* large packets may need more than one send */
+    while ( sent < count) {
+      int send_res = send( sock, (char*)&out_packet->start_ptr[-1] + sent, count - sent, 0);
+
+      if ( send_res == -1) {
+        if ( errno != EAGAIN) {
+          return -1;
+        }
+      }
+      else {
+        sent += send_res;
+      }
+    }
+
+    if ( no_ack) {
+      break;
+    }
 
     do {
       int read_res = recv( sock, (char*)&reply_ch, 1, 0);
@@ -694,13 +865,15 @@ make_stop_packet( uint8_t *ptr, enum stop_type type, uint32_t stop_address) {
  * Returns -1 if there is a socket error.
  */
 static int
-processPacket_gdb( SOCKET_TYPE sock, const uint8_t *packet,
+processPacket_gdb( SOCKET_TYPE sock, const uint8_t *packet, uint32_t packet_len,
 		   struct gdb_stub_state *stub) {
   //  uint8_t remcomOutBuffer[BUFMAX_GDB];
   struct debug_out_packet *out_packet = getOutPacket();
   uint8_t *out_ptr = out_packet->start_ptr;
   int send_reply = 1;
   uint32_t send_size = 0;
+  int start_no_ack = 0;
+  int res;
 
   DEBUG_LOG("Processing packet %c\n", packet[0]);
   gdbstub_mutex_lock();
@@ -801,22 +974,151 @@ processPacket_gdb( SOCKET_TYPE sock, const uint8_t *packet,
       if ( *rx_ptr++ == ',') {
         if ( hexToInt( &rx_ptr, &length)) {
           //DEBUG_LOG("mem read from %08x (%d)\n", addr, length);
-          if ( !mem2hex( stub->direct_memio, addr, out_ptr, length)) {
-            strcpy ( (char *)out_ptr, "E03");
-            send_size = 3;
-          }
-          else {
-            send_size = length * 2;
-          }
+          /* GDB will ask again for whatever doesn't fit */
+          if ( length > PACKET_SIZE_GDB / 2)
+            length = PACKET_SIZE_GDB / 2;
+
+          mem2hex( stub, addr, out_ptr, length);
+          send_size = length * 2;
           error01 = 0;
         }
       }
     }
-    if ( error01)
+    if ( error01) {
       strcpy( (char *)out_ptr,"E01");
+      send_size = 3;
+    }
     break;
   }
 
+    /* xAA..AA,LLLL: Read LLLL bytes at address AA.AA as escaped binary */
+  case 'x': {
+    uint32_t addr = 0;
+    uint32_t length = 0;
+    int error01 = 1;
+    const uint8_t *rx_ptr = &packet[1];
+
+    if ( hexToInt( &rx_ptr, &addr)) {
+      if ( *rx_ptr++ == ',') {
+        if ( hexToInt( &rx_ptr, &length)) {
+          static uint8_t read_buffer[PACKET_SIZE_GDB];
+          uint32_t encoded_size;
+
+          /* the escaping can't make the reply more than twice the size */
+          if ( length > (PACKET_SIZE_GDB - 1) / 2)
+            length = (PACKET_SIZE_GDB - 1) / 2;
+
+          read_mem( stub, addr, read_buffer, length);
+          out_ptr[0] = 'b';
+          mem2bin( read_buffer, length, &out_ptr[1], PACKET_SIZE_GDB - 1, &encoded_size);
+          send_size = encoded_size + 1;
+          error01 = 0;
+        }
+      }
+    }
+    if ( error01) {
+      strcpy( (char *)out_ptr,"E01");
+      send_size = 3;
+    }
+    break;
+  }
+
+    /* XAA..AA,LLLL:<binary data>: Write LLLL bytes at address AA.AA return OK */
+  case 'X': {
+    const uint8_t *rx_ptr = &packet[1];
+    uint32_t addr = 0;
+    uint32_t length = 0;
+    int error01 = 1;
+
+    if ( hexToInt(&rx_ptr, &addr)) {
+      if ( *rx_ptr++ == ',') {
+        if ( hexToInt(&rx_ptr, &length)) {
+          if ( *rx_ptr++ == ':') {
+            static uint8_t write_buffer[BUFMAX];
+            uint32_t data_len = bin2mem( rx_ptr, packet_len - (rx_ptr - packet), write_buffer);
+            uint32_t i;
+
+            DEBUG_LOG("Binary memory write of %d bytes to %08x\n",
+                      length, addr);
+
+            /* a zero length write is GDB probing for 'X' support */
+            if ( data_len == length) {
+              for ( i = 0; i < length; i++) {
+                stub->direct_memio->write8( stub->direct_memio->data,
+                                           addr++, write_buffer[i]);
+              }
+
+              strcpy( (char *)out_ptr, "OK");
+              send_size = 2;
+              error01 = 0;
+            }
+          }
+        }
+      }
+    }
+
+    if ( error01) {
+      strcpy( (char *)out_ptr, "E02");
+      send_size = 3;
+    }
+    break;
+  }
+
+  case 'q':
+    if ( strncmp( (const char *)packet, "qSupported", 10) == 0) {
+      send_size = sprintf( (char *)out_ptr,
+                           "PacketSize=%x;qXfer:memory-map:read+;QStartNoAckMode+;binary-upload+",
+                           PACKET_SIZE_GDB);
+    }
+    /* qXfer:memory-map:read::OFFSET,LENGTH */
+    else if ( strncmp( (const char *)packet, "qXfer:memory-map:read::", 23) == 0) {
+      const uint8_t *rx_ptr = &packet[23];
+      uint32_t offset = 0;
+      uint32_t length = 0;
+      const armcpu_t *cpu = (const armcpu_t *)stub->arm_cpu_object;
+      const char *memory_map = (cpu->proc_ID == ARMCPU_ARM9) ? arm9_memory_map : arm7_memory_map;
+      uint32_t map_len = (uint32_t)strlen( memory_map);
+
+      if ( hexToInt( &rx_ptr, &offset) && *rx_ptr++ == ',' &&
+           hexToInt( &rx_ptr, &length)) {
+        if ( length > PACKET_SIZE_GDB - 1)
+          length = PACKET_SIZE_GDB - 1;
+
+        if ( offset >= map_len) {
+          out_ptr[0] = 'l';
+          send_size = 1;
+        }
+        else {
+          uint32_t remaining = map_len - offset;
+
+          /* 'l' marks the last chunk, 'm' says there is more to come */
+          if ( remaining <= length) {
+            out_ptr[0] = 'l';
+            length = remaining;
+          }
+          else {
+            out_ptr[0] = 'm';
+          }
+          memcpy( &out_ptr[1], &memory_map[offset], length);
+          send_size = length + 1;
+        }
+      }
+      else {
+        strcpy( (char *)out_ptr, "E01");
+        send_size = 3;
+      }
+    }
+    break;
+
+  case 'Q':
+    if ( strcmp( (const char *)packet, "QStartNoAckMode") == 0) {
+      /* the OK itself is still acknowledged */
+      strcpy( (char *)out_ptr, "OK");
+      send_size = 2;
+      start_no_ack = 1;
+    }
+    break;
+
     /* MAA..AA,LLLL: Write LLLL bytes at address AA.AA return OK */
   case 'M': {
     /* Try to read '%x,%x:'.  */
@@ -842,6 +1144,7 @@ processPacket_gdb( SOCKET_TYPE sock, const uint8_t *packet,
             }
 
             strcpy( (char *)out_ptr, "OK");
+            send_size = 2;
             error01 = 0;
           }
         }
@@ -859,6 +1162,7 @@ processPacket_gdb( SOCKET_TYPE sock, const uint8_t *packet,
 
     if ( error01) {
       strcpy( (char *)out_ptr, "E02");
+      send_size = 3;
     }
     break;
   }
@@ -1010,6 +1314,10 @@ processPacket_gdb( SOCKET_TYPE sock, const uint8_t *packet,
       cpsr = LITTLE_ENDIAN_TO_UINT32_T( tmp_mem);
       DEBUG_LOG("Setting cpsr to %08x\n", cpsr);
 
+      /* the values are only logged for now, so keep the compiler quiet when logging is off */
+      (void)reg_values;
+      (void)cpsr;
+
       strcpy( (char *)out_ptr, "OK");
       send_size = 2;
       break;
@@ -1081,7 +1389,12 @@ processPacket_gdb( SOCKET_TYPE sock, const uint8_t *packet,
   gdbstub_mutex_unlock();
 
   if ( send_reply) {
-    return putpacket( sock, out_packet, send_size);
+    res = putpacket( sock, out_packet, send_size, stub->no_ack_mode);
+
+    if ( start_no_ack) {
+      stub->no_ack_mode = 1;
+    }
+    return res;
   }
 
   return 0;
@@ -1224,7 +1537,7 @@ WINAPI listenerThread_gdb( void *data) {
 	    ptr[1] = hexchars[state->stop_reason >> 4];
 	    ptr[2] = hexchars[state->stop_reason & 0xf];*/
 
-	    putpacket( state->sock_fd, out_packet, send_size);
+	    putpacket( state->sock_fd, out_packet, send_size, state->no_ack_mode);
 	    DEBUG_LOG( "\nBreak from Emulation\n");
 	  }
 	  else {
@@ -1275,6 +1588,7 @@ WINAPI listenerThread_gdb( void *data) {
 
               FD_SET( new_conn, &main_set);
               state->sock_fd = new_conn;
+              state->no_ack_mode = 0;
             }
 
             if ( close_sock) {
@@ -1340,14 +1654,20 @@ WINAPI listenerThread_gdb( void *data) {
                 }
               }
 
-              write_res = send( gdb_sock, (char*)&reply, 1, 0);
-              
+              /* in no-ack mode GDB doesn't expect a reply, and won't resend */
+              if ( state->no_ack_mode) {
+                write_res = 1;
+              }
+              else {
+                write_res = send( gdb_sock, (char*)&reply, 1, 0);
+              }
+
               if ( write_res != 1) {
                 close_socket = 1;
               }
-              else {
+              else if ( !state->no_ack_mode || packet->read_checksum == packet->checksum) {
                 if ( processPacket_gdb( gdb_sock, state->rx_packet.buffer,
-                                        state) == -1) {
+                                        packet->pos_index, state) == -1) {
                   close_socket = 1;
                 }
               }
@@ -1581,6 +1901,7 @@ createStub_gdb( uint16_t port,
 
     stub->port_num = port;
     stub->sock_fd = -1;
+    stub->no_ack_mode = 0;
     stub->listen_fd = createSocket( port);
 
     stub->stop_type = STOP_UNKNOWN;
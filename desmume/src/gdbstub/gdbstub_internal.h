@@ -70,8 +70,9 @@ struct breakpoint_gdb {
 
 
 /*
+ * Large enough for bulk memory transfers; advertised to GDB as PacketSize.
  */
-#define BUFMAX_GDB 2048
+#define BUFMAX_GDB 0x10000
 
 struct packet_reader_gdb {
   int state;
@@ -179,6 +180,9 @@ struct gdb_stub_state {
 
   /** whether above pipe is enabled */
   int info_pipe_enabled;
+
+  /** set once GDB has asked for QStartNoAckMode on the current connection */
+  int no_ack_mode;
 };
 
 
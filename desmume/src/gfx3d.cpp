@@ -50,8 +50,11 @@
 #include "readwrite.h"
 #include "FIFO.h"
 #include "utils/bits.h"
+#include "utils/task.h"
 #include "movie.h" //only for currframecounter which really ought to be moved into the core emu....
 
+#include <rthreads/rthreads.h>
+
 //#define _SHOW_VTX_COUNTERS	// show polygon/vertex counters on screen
 #ifdef _SHOW_VTX_COUNTERS
 u32 max_polys, max_verts;
@@ -253,8 +256,169 @@ public:
 //while the fifo was full, apparently expecting the fifo not to be full by that time.
 //in general we are finding that 3d takes less time than we think....
 //although maybe the true culprit was charging the cpu less time for the dma.
-#define GFX_DELAY(x) NDS_RescheduleGXFIFO(1);
-#define GFX_DELAY_M2(x) NDS_RescheduleGXFIFO(1);
+//
+//when the geometry thread is running, the commands below execute on the worker and their delays are
+//skipped. this doesn't change timing, since gfx3d_execute3D() charges a fixed cost for every command
+//and then overwrites gfx3dCycles after each one anyway.
+#define GFX_DELAY(x) GEM_ChargeDelay();
+#define GFX_DELAY_M2(x) GEM_ChargeDelay();
+
+//Geometry thread.
+//GXFIFO commands are still popped and timed by the sequencer on the emulation thread, but their execution
+//(matrix math, lighting, polygon list building) is handed to a worker through a single-producer/single-consumer
+//queue. SWAP_BUFFERS stays on the emulation thread since the sequencer depends on it immediately.
+//Anything on the emulation thread that reads geometry engine state must call gfx3d_WaitForGeometryThread() first.
+#define GFX3D_GEOMETRY_QUEUE_SIZE 4096 //must be a power of two
+
+struct GeometryCommand
+{
+	u32 param;
+	u8 cmd;
+};
+
+static Task *_geometryThreadTask = NULL;
+static slock_t *_geometryThreadMutex = NULL;
+static scond_t *_geometryThreadCondWork = NULL;
+static scond_t *_geometryThreadCondIdle = NULL;
+static GeometryCommand _geometryQueue[GFX3D_GEOMETRY_QUEUE_SIZE];
+static volatile s32 _geometryQueueWriteCount = 0;
+static volatile s32 _geometryQueueReadCount = 0;
+static bool _geometryThreadIsRunning = false;
+static bool _geometryThreadExit = false;
+
+static void gfx3d_execute(u8 cmd, u32 param);
+
+static FORCEINLINE void GEM_ChargeDelay()
+{
+	if (!_geometryThreadIsRunning)
+	{
+		NDS_RescheduleGXFIFO(1);
+	}
+}
+
+static FORCEINLINE bool GEM_IsGeometryQueueEmpty()
+{
+	return ( atomic_add_barrier32(&_geometryQueueReadCount, 0) == atomic_add_barrier32(&_geometryQueueWriteCount, 0) );
+}
+
+static void* GFX3D_GeometryThreadLoop(void *arg)
+{
+	slock_lock(_geometryThreadMutex);
+	
+	for (;;)
+	{
+		while (GEM_IsGeometryQueueEmpty() && !_geometryThreadExit)
+			scond_wait(_geometryThreadCondWork, _geometryThreadMutex);
+		
+		if (_geometryThreadExit && GEM_IsGeometryQueueEmpty())
+			break;
+		
+		slock_unlock(_geometryThreadMutex);
+		
+		s32 readCount = atomic_add_barrier32(&_geometryQueueReadCount, 0);
+		const s32 writeCount = atomic_add_barrier32(&_geometryQueueWriteCount, 0);
+		
+		while (readCount != writeCount)
+		{
+			const GeometryCommand &command = _geometryQueue[readCount & (GFX3D_GEOMETRY_QUEUE_SIZE - 1)];
+			gfx3d_execute(command.cmd, command.param);
+			readCount = atomic_inc_barrier32(&_geometryQueueReadCount);
+		}
+		
+		slock_lock(_geometryThreadMutex);
+		scond_signal(_geometryThreadCondIdle);
+	}
+	
+	slock_unlock(_geometryThreadMutex);
+	return NULL;
+}
+
+void gfx3d_WaitForGeometryThread()
+{
+	if (!_geometryThreadIsRunning || GEM_IsGeometryQueueEmpty())
+	{
+		return;
+	}
+	
+	slock_lock(_geometryThreadMutex);
+	scond_signal(_geometryThreadCondWork);
+	while (!GEM_IsGeometryQueueEmpty())
+		scond_wait(_geometryThreadCondIdle, _geometryThreadMutex);
+	slock_unlock(_geometryThreadMutex);
+}
+
+static void GEM_QueueGeometryCommand(const u8 cmd, const u32 param)
+{
+	const s32 writeCount = atomic_add_barrier32(&_geometryQueueWriteCount, 0);
+	
+	if ( (u32)(writeCount - atomic_add_barrier32(&_geometryQueueReadCount, 0)) >= GFX3D_GEOMETRY_QUEUE_SIZE )
+	{
+		gfx3d_WaitForGeometryThread();
+	}
+	
+	GeometryCommand &command = _geometryQueue[writeCount & (GFX3D_GEOMETRY_QUEUE_SIZE - 1)];
+	command.cmd = cmd;
+	command.param = param;
+	atomic_inc_barrier32(&_geometryQueueWriteCount);
+}
+
+static void GEM_KickGeometryThread()
+{
+	if (GEM_IsGeometryQueueEmpty())
+	{
+		return;
+	}
+	
+	slock_lock(_geometryThreadMutex);
+	scond_signal(_geometryThreadCondWork);
+	slock_unlock(_geometryThreadMutex);
+}
+
+static void GFX3D_StartGeometryThread()
+{
+	if (_geometryThreadIsRunning)
+	{
+		return;
+	}
+	
+	if (_geometryThreadTask == NULL)
+	{
+		_geometryThreadTask = new Task();
+		_geometryThreadMutex = slock_new();
+		_geometryThreadCondWork = scond_new();
+		_geometryThreadCondIdle = scond_new();
+	}
+	
+	_geometryQueueWriteCount = 0;
+	_geometryQueueReadCount = 0;
+	_geometryThreadExit = false;
+	_geometryThreadIsRunning = true;
+	
+	_geometryThreadTask->start(false, 0, "Geometry Engine");
+	_geometryThreadTask->execute(&GFX3D_GeometryThreadLoop, NULL);
+}
+
+static void GFX3D_StopGeometryThread()
+{
+	if (!_geometryThreadIsRunning)
+	{
+		return;
+	}
+	
+	slock_lock(_geometryThreadMutex);
+	_geometryThreadExit = true;
+	scond_signal(_geometryThreadCondWork);
+	slock_unlock(_geometryThreadMutex);
+	
+	_geometryThreadTask->finish();
+	_geometryThreadTask->shutdown();
+	_geometryThreadIsRunning = false;
+}
+
+bool gfx3d_IsGeometryThreadRunning()
+{
+	return _geometryThreadIsRunning;
+}
 
 using std::max;
 using std::min;
@@ -356,6 +520,13 @@ static PAGE_ALIGN CPoly _clippedPolyWorkingList[POLYLIST_SIZE * 2];
 static PAGE_ALIGN CPoly _clippedPolyUnsortedList[POLYLIST_SIZE];
 
 static int polygonListCompleted = 0;
+
+//vertices waiting on GEM_FlushVertexBatch()
+#define GEM_VERTEX_BATCH_SIZE 8
+static CACHE_ALIGN s32 _pendingVertCoord[GEM_VERTEX_BATCH_SIZE][4];
+static VERT *_pendingVert[GEM_VERTEX_BATCH_SIZE];
+static size_t _pendingVertCount = 0;
+
 static u8 triStripToggle;
 
 //list-building state
@@ -514,12 +685,15 @@ void gfx3d_init()
 
 void gfx3d_deinit()
 {
+	GFX3D_StopGeometryThread();
 	Render3D_DeInit();
 	delete _clipper;
 }
 
 void gfx3d_reset()
 {
+	gfx3d_WaitForGeometryThread();
+	
 	if (CurrentRenderer->GetRenderNeedsFinish())
 	{
 		GPU->ForceRender3DFinishAndFlush(false);
@@ -533,6 +707,8 @@ void gfx3d_reset()
 
 	memset(&viewer3D, 0, sizeof(Viewer3D_State));
 	
+	_pendingVertCount = 0;
+	
 	gxf_hardware.reset();
 
 	drawPending = FALSE;
@@ -666,6 +842,32 @@ static void GEM_TransformVertex(const s32 (&__restrict mtx)[16], s32 (&__restric
 {
 	MatrixMultVec4x4(mtx, vec);
 }
+
+//Vertices are transformed in batches. SetVertex() queues the untransformed coordinate
+//along with the VERT it belongs to, and the whole queue is run through the modelview and
+//projection matrices at once. The queue must be flushed before anything changes the current
+//matrices or reads back a queued VERT's coordinates.
+static void GEM_FlushVertexBatch()
+{
+	if (_pendingVertCount == 0)
+	{
+		return;
+	}
+	
+	MatrixMultVec4x4(mtxCurrent[MATRIXMODE_POSITION], _pendingVertCoord, _pendingVertCount); //modelview
+	MatrixMultVec4x4(mtxCurrent[MATRIXMODE_PROJECTION], _pendingVertCoord, _pendingVertCount); //projection
+	
+	for (size_t i = 0; i < _pendingVertCount; i++)
+	{
+		VERT &vert = *_pendingVert[i];
+		vert.coord[0] = _pendingVertCoord[i][0]/4096.0f;
+		vert.coord[1] = _pendingVertCoord[i][1]/4096.0f;
+		vert.coord[2] = _pendingVertCoord[i][2]/4096.0f;
+		vert.coord[3] = _pendingVertCoord[i][3]/4096.0f;
+	}
+	
+	_pendingVertCount = 0;
+}
 //---------------
 
 
@@ -709,21 +911,18 @@ static void SetVertex()
 		s32 tmp[16];
 		MatrixCopy(tmp,mtxCurrent[MATRIXMODE_PROJECTION]);
 		MatrixMultiply(tmp, freelookMatrix);
+		GEM_FlushVertexBatch();
 		GEM_TransformVertex(mtxCurrent[MATRIXMODE_POSITION], coordTransformed); //modelview
 		GEM_TransformVertex(tmp, coordTransformed); //projection
 	}
 	else if(freelookMode == 3)
 	{
 		//use provided projection
+		GEM_FlushVertexBatch();
 		GEM_TransformVertex(mtxCurrent[MATRIXMODE_POSITION], coordTransformed); //modelview
 		GEM_TransformVertex(freelookMatrix, coordTransformed); //projection
 	}
-	else
-	{
-		//no freelook
-		GEM_TransformVertex(mtxCurrent[MATRIXMODE_POSITION], coordTransformed); //modelview
-		GEM_TransformVertex(mtxCurrent[MATRIXMODE_PROJECTION], coordTransformed); //projection
-	}
+	//no freelook -- the transform is deferred to GEM_FlushVertexBatch()
 
 	//TODO - culling should be done here.
 	//TODO - viewport transform?
@@ -757,10 +956,27 @@ static void SetVertex()
 
 	vert.texcoord[0] = last_s/16.0f;
 	vert.texcoord[1] = last_t/16.0f;
-	vert.coord[0] = coordTransformed[0]/4096.0f;
-	vert.coord[1] = coordTransformed[1]/4096.0f;
-	vert.coord[2] = coordTransformed[2]/4096.0f;
-	vert.coord[3] = coordTransformed[3]/4096.0f;
+	if (freelookMode == 2 || freelookMode == 3)
+	{
+		vert.coord[0] = coordTransformed[0]/4096.0f;
+		vert.coord[1] = coordTransformed[1]/4096.0f;
+		vert.coord[2] = coordTransformed[2]/4096.0f;
+		vert.coord[3] = coordTransformed[3]/4096.0f;
+	}
+	else
+	{
+		_pendingVertCoord[_pendingVertCount][0] = coordTransformed[0];
+		_pendingVertCoord[_pendingVertCount][1] = coordTransformed[1];
+		_pendingVertCoord[_pendingVertCount][2] = coordTransformed[2];
+		_pendingVertCoord[_pendingVertCount][3] = coordTransformed[3];
+		_pendingVert[_pendingVertCount] = &vert;
+		_pendingVertCount++;
+		
+		if (_pendingVertCount == GEM_VERTEX_BATCH_SIZE)
+		{
+			GEM_FlushVertexBatch();
+		}
+	}
 	vert.color[0] = GFX3D_5TO6_LOOKUP(colorRGB[0]);
 	vert.color[1] = GFX3D_5TO6_LOOKUP(colorRGB[1]);
 	vert.color[2] = GFX3D_5TO6_LOOKUP(colorRGB[2]);
@@ -857,6 +1073,8 @@ static void SetVertex()
 			// Tested" Castlevania POR - warp stone, trajectory of ricochet, "Eye of Decay"
 			if (currentPolyTexParam.PackedFormat == TEXMODE_NONE)
 			{
+				GEM_FlushVertexBatch();
+				
 				bool duplicated = false;
 				const VERT &vert0 = pendingGList.vertList[poly.vertIndexes[0]];
 				const VERT &vert1 = pendingGList.vertList[poly.vertIndexes[1]];
@@ -1919,12 +2137,16 @@ template void gfx3d_glClearImageOffset<u16, 0>(const u16 val);
 
 u32 gfx3d_GetNumPolys()
 {
+	gfx3d_WaitForGeometryThread();
+	
 	//so is this in the currently-displayed or currently-built list?
 	return (u32)(gfx3d.gList[gfx3d.pendingListIndex].polyCount);
 }
 
 u32 gfx3d_GetNumVertex()
 {
+	gfx3d_WaitForGeometryThread();
+	
 	//so is this in the currently-displayed or currently-built list?
 	return (u32)gfx3d.gList[gfx3d.pendingListIndex].vertListCount;
 }
@@ -1963,6 +2185,7 @@ template void gfx3d_UpdateToonTable<u32>(const u8 offset, const u32 val);
 s32 gfx3d_GetClipMatrix(const u32 index)
 {
 	//printf("reading clip matrix: %d\n",index);
+	gfx3d_WaitForGeometryThread();
 	return MatrixGetMultipliedIndex(index, mtxCurrent[MATRIXMODE_PROJECTION], mtxCurrent[MATRIXMODE_POSITION]);
 }
 
@@ -1970,6 +2193,7 @@ s32 gfx3d_GetDirectionalMatrix(const u32 index)
 {
 	const size_t _index = (((index / 3) * 4) + (index % 3));
 
+	gfx3d_WaitForGeometryThread();
 	//return (s32)(mtxCurrent[2][_index]*(1<<12));
 	return mtxCurrent[MATRIXMODE_POSITION_VECTOR][_index];
 }
@@ -1981,6 +2205,7 @@ void gfx3d_glAlphaFunc(u32 v)
 
 u32 gfx3d_glGetPosRes(const size_t index)
 {
+	gfx3d_WaitForGeometryThread();
 	return (u32)PTcoords[index];
 }
 
@@ -2116,6 +2341,13 @@ static void gfx3d_execute(u8 cmd, u32 param)
 	log3D(cmd, param);
 #endif
 
+	//MTX_POP through MTX_TRANS all change the current matrices, so any queued
+	//vertices need to be transformed with the old ones first.
+	if ( (cmd >= 0x12) && (cmd <= 0x1C) && (cmd != 0x13) )
+	{
+		GEM_FlushVertexBatch();
+	}
+
 	switch (cmd)
 	{
 		case 0x10:		// MTX_MODE - Set Matrix Mode (W)
@@ -2240,10 +2472,25 @@ void gfx3d_execute3D()
 	u8	cmd = 0;
 	u32	param = 0;
 
+	if (CommonSettings.GFX3D_GeometryThread != _geometryThreadIsRunning)
+	{
+		if (CommonSettings.GFX3D_GeometryThread)
+			GFX3D_StartGeometryThread();
+		else
+			GFX3D_StopGeometryThread();
+	}
+
 	//3d engine is locked up, or something.
 	//I dont think this should happen....
 	if (isSwapBuffers) return;
 
+	//freelook raises lua events from the geometry commands, so keep those on this thread.
+	const bool willHandOffCommands = _geometryThreadIsRunning && (freelookMode == 0);
+	if (!willHandOffCommands)
+	{
+		gfx3d_WaitForGeometryThread();
+	}
+
 	//this is a SPEED HACK
 	//fifo is currently emulated more accurately than it probably needs to be.
 	//without this batch size the emuloop will escape way too often to run fast.
@@ -2258,12 +2505,15 @@ void gfx3d_execute3D()
 			//since we did anything at all, incur a pipeline motion cost.
 			//also, we can't let gxfifo sequencer stall until the fifo is empty.
 			//see...
-			GFX_DELAY(1); 
+			NDS_RescheduleGXFIFO(1); //GFX_DELAY(1), but always charged here on the emulation thread
 
 			//..these guys will ordinarily set a delay, but multi-param operations won't
 			//for the earlier params.
 			//printf("%05d:%03d:%12lld: executed 3d: %02X %08X\n",currFrameCounter, nds.VCount, nds_timer , cmd, param);
-			gfx3d_execute(cmd, param);
+			if (willHandOffCommands && (cmd != 0x50))
+				GEM_QueueGeometryCommand(cmd, param);
+			else
+				gfx3d_execute(cmd, param);
 
 			//this is a COMPATIBILITY HACK.
 			//this causes 3d to take virtually no time whatsoever to execute.
@@ -2276,6 +2526,10 @@ void gfx3d_execute3D()
 		} else break;
 	}
 
+	if (willHandOffCommands)
+	{
+		GEM_KickGeometryThread();
+	}
 }
 
 void gfx3d_glFlush(u32 v)
@@ -2291,7 +2545,7 @@ void gfx3d_glFlush(u32 v)
 	
 	isSwapBuffers = TRUE;
 
-	GFX_DELAY(1);
+	NDS_RescheduleGXFIFO(1); //GFX_DELAY(1); SWAP_BUFFERS always runs on the emulation thread
 }
 
 static bool gfx3d_ysort_compare(int num1, int num2)
@@ -2317,12 +2571,82 @@ static bool gfx3d_ysort_compare(int num1, int num2)
 	return (num1 < num2);
 }
 
+//Outcode bits are ordered the same as the clipper stages:
+//bit 0 = left, 1 = right, 2 = bottom, 3 = top, 4 = front, 5 = back
+static FORCEINLINE u8 GEM_PackClipOutcode(const u32 outsideNeg, const u32 outsidePos)
+{
+	return (u8)( ((outsideNeg & 1)     ) | ((outsidePos & 1) << 1) |
+	             ((outsideNeg & 2) << 1) | ((outsidePos & 2) << 2) |
+	             ((outsideNeg & 4) << 2) | ((outsidePos & 4) << 3) );
+}
+
+static void GEM_ComputeClipOutcodes(const VERT *__restrict vertList, const size_t vertCount, u8 *__restrict outcodes)
+{
+	size_t i = 0;
+	
+#if defined(ENABLE_SSE2)
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	
+	for (; i + 4 <= vertCount; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(vertList[i+0].coord);
+		__m128 y = _mm_loadu_ps(vertList[i+1].coord);
+		__m128 z = _mm_loadu_ps(vertList[i+2].coord);
+		__m128 w = _mm_loadu_ps(vertList[i+3].coord);
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		
+		const __m128 negW = _mm_xor_ps(w, signMask);
+		const u32 outsideNeg[3] = {
+			(u32)_mm_movemask_ps( _mm_cmplt_ps(x, negW) ),
+			(u32)_mm_movemask_ps( _mm_cmplt_ps(y, negW) ),
+			(u32)_mm_movemask_ps( _mm_cmplt_ps(z, negW) )
+		};
+		const u32 outsidePos[3] = {
+			(u32)_mm_movemask_ps( _mm_cmpgt_ps(x, w) ),
+			(u32)_mm_movemask_ps( _mm_cmpgt_ps(y, w) ),
+			(u32)_mm_movemask_ps( _mm_cmpgt_ps(z, w) )
+		};
+		
+		for (size_t j = 0; j < 4; j++)
+		{
+			outcodes[i+j] = GEM_PackClipOutcode( ((outsideNeg[0] >> j) & 1) | (((outsideNeg[1] >> j) & 1) << 1) | (((outsideNeg[2] >> j) & 1) << 2),
+			                                     ((outsidePos[0] >> j) & 1) | (((outsidePos[1] >> j) & 1) << 1) | (((outsidePos[2] >> j) & 1) << 2) );
+		}
+	}
+#elif defined(ENABLE_NEON_A64)
+	static const uint32x4_t laneBit = { 1, 2, 4, 8 };
+	
+	for (; i < vertCount; i++)
+	{
+		const float32x4_t c = vld1q_f32(vertList[i].coord);
+		const float32x4_t w = vdupq_laneq_f32(c, 3);
+		const u32 outsideNeg = vaddvq_u32( vandq_u32(vcltq_f32(c, vnegq_f32(w)), laneBit) );
+		const u32 outsidePos = vaddvq_u32( vandq_u32(vcgtq_f32(c, w), laneBit) );
+		
+		outcodes[i] = GEM_PackClipOutcode(outsideNeg, outsidePos);
+	}
+#endif
+	
+	for (; i < vertCount; i++)
+	{
+		const float *c = vertList[i].coord;
+		const u32 outsideNeg = ((c[0] < -c[3]) ? 1 : 0) | ((c[1] < -c[3]) ? 2 : 0) | ((c[2] < -c[3]) ? 4 : 0);
+		const u32 outsidePos = ((c[0] >  c[3]) ? 1 : 0) | ((c[1] >  c[3]) ? 2 : 0) | ((c[2] >  c[3]) ? 4 : 0);
+		
+		outcodes[i] = GEM_PackClipOutcode(outsideNeg, outsidePos);
+	}
+}
+
+static u8 _vertClipOutcode[VERTLIST_SIZE];
+
 template <ClipperMode CLIPPERMODE>
 void gfx3d_PerformClipping(const GFX3D_GeometryList &gList)
 {
 	bool isPolyUnclipped = false;
 	_clipper->Reset();
 	
+	GEM_ComputeClipOutcodes(gList.vertList, gList.vertListCount, _vertClipOutcode);
+	
 	for (size_t polyIndex = 0, clipCount = 0; polyIndex < gList.polyCount; polyIndex++)
 	{
 		const POLY &poly = gList.polyList[polyIndex];
@@ -2334,7 +2658,14 @@ void gfx3d_PerformClipping(const GFX3D_GeometryList &gList)
 			(poly.type == POLYGON_TYPE_QUAD) ? &gList.vertList[poly.vertIndexes[3]] : NULL
 		};
 		
-		isPolyUnclipped = _clipper->ClipPoly<CLIPPERMODE>(polyIndex, poly, clipVerts);
+		const u8 clipOutcodes[4] = {
+			_vertClipOutcode[poly.vertIndexes[0]],
+			_vertClipOutcode[poly.vertIndexes[1]],
+			_vertClipOutcode[poly.vertIndexes[2]],
+			(poly.type == POLYGON_TYPE_QUAD) ? _vertClipOutcode[poly.vertIndexes[3]] : (u8)0
+		};
+		
+		isPolyUnclipped = _clipper->ClipPoly<CLIPPERMODE>(polyIndex, poly, clipVerts, clipOutcodes);
 		
 		if (CLIPPERMODE == ClipperMode_DetermineClipOnly)
 		{
@@ -2358,6 +2689,9 @@ void gfx3d_PerformClipping(const GFX3D_GeometryList &gList)
 
 void GFX3D_GenerateRenderLists(const ClipperMode clippingMode, const GFX3D_State &inState, GFX3D_GeometryList &outGList)
 {
+	//the clipper stages are shared with the box test
+	gfx3d_WaitForGeometryThread();
+	
 	const VERT *__restrict appliedVertList = outGList.vertList;
 	
 	switch (clippingMode)
@@ -2462,6 +2796,9 @@ void GFX3D_GenerateRenderLists(const ClipperMode clippingMode, const GFX3D_State
 
 static void gfx3d_doFlush()
 {
+	gfx3d_WaitForGeometryThread();
+	GEM_FlushVertexBatch();
+	
 	//latch the current renderer and geometry engine states
 	//NOTE: the geometry lists are copied elsewhere by another operation.
 	//that's pretty annoying.
@@ -2511,7 +2848,7 @@ void gfx3d_VBlankSignal()
 	if (isSwapBuffers)
 	{
 		gfx3d_doFlush();
-		GFX_DELAY(392);
+		NDS_RescheduleGXFIFO(1); //GFX_DELAY(392)
 		isSwapBuffers = FALSE;
 		
 		//let's consider this the beginning of the next 3d frame.
@@ -2922,6 +3259,9 @@ void gfx3d_savestate(EMUFILE &os)
 	//version
 	os.write_32LE(4);
 
+	gfx3d_WaitForGeometryThread();
+	GEM_FlushVertexBatch();
+
 	//dump the render lists
 	os.write_32LE((u32)gfx3d.gList[gfx3d.pendingListIndex].vertListCount);
 	for (size_t i = 0; i < gfx3d.gList[gfx3d.pendingListIndex].vertListCount; i++)
@@ -2997,6 +3337,9 @@ bool gfx3d_loadstate(EMUFILE &is, int size)
 		GPU->ForceRender3DFinishAndFlush(false);
 	}
 
+	gfx3d_WaitForGeometryThread();
+	_pendingVertCount = 0;
+
 	gfx3d_glPolygonAttrib_cache();
 	gfx3d_glTexImage_cache();
 	gfx3d_glLightDirection_cache(0);
@@ -3102,6 +3445,7 @@ void gfx3d_FinishLoadStateBufferRead()
 			break;
 			
 		case RENDERID_SOFTRASTERIZER:
+		case RENDERID_SOFTRASTERIZER_FIXEDPOINT:
 		{
 			const size_t w = CurrentRenderer->GetFramebufferWidth();
 			const size_t h = CurrentRenderer->GetFramebufferHeight();
@@ -3494,6 +3838,45 @@ void GFX3D_Clipper::Reset()
 	this->_clippedPolyCounter = 0;
 }
 
+template <ClipperMode CLIPPERMODE>
+bool GFX3D_Clipper::ClipPoly(const u16 polyIndex, const POLY &poly, const VERT **verts, const u8 *vertOutcodes)
+{
+	const PolygonType polyType = poly.type;
+	u8 outcodeOR = 0;
+	u8 outcodeAND = 0x3F;
+	
+	for (size_t i = 0; i < (size_t)polyType; i++)
+	{
+		outcodeOR |= vertOutcodes[i];
+		outcodeAND &= vertOutcodes[i];
+	}
+	
+	if (outcodeOR == 0)
+	{
+		//trivially inside. every clipper stage passes its verts through rotated by one,
+		//so reproduce the order the stages would have output.
+		CPoly &thePoly = this->_clippedPolyList[this->_clippedPolyCounter];
+		for (size_t i = 0; i < (size_t)polyType; i++)
+			thePoly.clipVerts[i] = *verts[(i + 6) % (size_t)polyType];
+		
+		thePoly.index = polyIndex;
+		thePoly.type = polyType;
+		thePoly.poly = (POLY *)&poly;
+		
+		this->_clippedPolyCounter++;
+		return true;
+	}
+	
+	//trivially outside. only taken when the first stage that sees any vert outside sees
+	//all of them outside, since that stage still works on the original verts.
+	if ( (outcodeOR & (~outcodeOR + 1)) & outcodeAND )
+	{
+		return false;
+	}
+	
+	return this->ClipPoly<CLIPPERMODE>(polyIndex, poly, verts);
+}
+
 template <ClipperMode CLIPPERMODE>
 bool GFX3D_Clipper::ClipPoly(const u16 polyIndex, const POLY &poly, const VERT **verts)
 {
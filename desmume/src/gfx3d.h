@@ -656,6 +656,7 @@ public:
 	
 	void Reset();
 	template<ClipperMode CLIPPERMODE> bool ClipPoly(const u16 polyIndex, const POLY &poly, const VERT **verts); // the entry point for poly clipping
+	template<ClipperMode CLIPPERMODE> bool ClipPoly(const u16 polyIndex, const POLY &poly, const VERT **verts, const u8 *vertOutcodes); // same as above, but uses precomputed outcodes to skip the clipper when possible
 };
 
 //used to communicate state to the renderer
@@ -775,6 +776,12 @@ void gfx3d_glFogOffset (u32 v);
 template<typename T, size_t ADDROFFSET> void gfx3d_glClearDepth(const T val);
 template<typename T, size_t ADDROFFSET> void gfx3d_glClearImageOffset(const T val);
 void gfx3d_glSwapScreen(u32 screen);
+
+//Only needed when CommonSettings.GFX3D_GeometryThread is set. Blocks the emulation thread until every
+//GXFIFO command handed to the geometry thread has executed.
+void gfx3d_WaitForGeometryThread();
+bool gfx3d_IsGeometryThreadRunning();
+
 u32 gfx3d_GetNumPolys();
 u32 gfx3d_GetNumVertex();
 template<typename T> void gfx3d_UpdateEdgeMarkColorTable(const u8 offset, const T val);
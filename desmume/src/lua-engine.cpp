@@ -123,6 +123,27 @@ struct LuaMenuData
 
 static const char* menuCallbackIDString = "menuhandlers";
 
+// a range of memory hooked by a script, [start, end)
+struct LuaMemHook
+{
+	unsigned int start;
+	unsigned int end;
+	int funcID; // index of the callback in the registry table for the hook type
+	bool batched; // hits are collected and passed to the callback once per frame
+};
+
+struct LuaMemHookBatch
+{
+	std::vector<unsigned int> addresses;
+	std::vector<unsigned int> sizes;
+	std::vector<unsigned int> values;
+	unsigned int dropped; // hits past LUAMEMHOOK_BATCH_MAX
+	LuaMemHookBatch() : dropped(0) {}
+};
+
+// the most hits a batched memory hook collects in one frame
+#define LUAMEMHOOK_BATCH_MAX 0x10000
+
 struct LuaContextInfo {
 	lua_State* L; // the Lua state
 	bool started; // script has been started and hasn't yet been terminated, although it may not be currently running
@@ -149,7 +170,10 @@ struct LuaContextInfo {
 	bool rerecordCountingDisabled; // true if this script has disabled rerecord counting for the savestates it loads
 	std::vector<std::string> persistVars; // names of the global variables to persist, kept here so their associated values can be output when the script exits
 	LuaSaveData newDefaultData; // data about the default state of persisted global variables, which we save on script exit so we can detect when the default value has changed to make it easier to reset persisted variables
-	unsigned int numMemHooks; // number of registered memory functions (1 per hooked byte)
+	unsigned int numMemHooks; // number of hooked memory ranges
+	std::vector<LuaMemHook> memHooks [LUAMEMHOOK_COUNT]; // sorted by address, never overlapping
+	std::map<int, LuaMemHookBatch> memHookBatches [LUAMEMHOOK_COUNT]; // hits waiting for the end of the frame, by funcID
+	int lastMemHookID; // the funcID of the last callback registered
 	LuaGUIData guiData;
 	LuaMenuData menuData;
 	// callbacks into the lua window... these don't need to exist per context the way I'm using them, but whatever
@@ -279,36 +303,87 @@ static int memory_registerHook(lua_State* L, LuaMemHookType hookType, int defaul
 		funcIdx++;
 	}
 
-	// check last argument: callback function
+	// check last argument: callback function, optionally followed by whether to batch its calls
 	bool clearing = lua_isnil(L,funcIdx);
 	if(!clearing)
 		luaL_checktype(L, funcIdx, LUA_TFUNCTION);
+	bool batched = lua_toboolean(L,funcIdx+1) != 0;
 	lua_settop(L,funcIdx);
 
-	// get the address-to-callback table for this hook type of the current script
-	lua_getfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[hookType]);
+	unsigned int end = addr + size;
+	if(end < addr)
+		end = ~0U;
+
+	LuaContextInfo& info = GetCurrentInfo();
+	std::vector<LuaMemHook>& hooks = info.memHooks[hookType];
 
-	// count how many callback functions we'll be displacing
-	int numFuncsAfter = clearing ? 0 : size;
-	int numFuncsBefore = 0;
-	for(unsigned int i = addr; i != addr+size; i++)
+	// cut the range out of the existing hooks, displacing their callbacks for those bytes
+	std::vector<LuaMemHook> remaining;
+	for(size_t i = 0; i < hooks.size(); i++)
 	{
-		lua_rawgeti(L, -1, i);
-		if(lua_isfunction(L, -1))
-			numFuncsBefore++;
-		lua_pop(L,1);
+		const LuaMemHook& hook = hooks[i];
+		if(hook.end <= addr || hook.start >= end)
+		{
+			remaining.push_back(hook);
+			continue;
+		}
+		if(hook.start < addr)
+		{
+			remaining.push_back(hook);
+			remaining.back().end = addr;
+		}
+		if(hook.end > end)
+		{
+			remaining.push_back(hook);
+			remaining.back().start = end;
+		}
 	}
 
-	// put the callback function in the address slots
-	for(unsigned int i = addr; i != addr+size; i++)
+	lua_getfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[hookType]);
+
+	// put the callback function in a new range
+	if(!clearing && addr < end)
 	{
+		LuaMemHook hook;
+		hook.start = addr;
+		hook.end = end;
+		hook.funcID = ++info.lastMemHookID;
+		hook.batched = batched;
+
 		lua_pushvalue(L, -2);
-		lua_rawseti(L, -2, i);
+		lua_rawseti(L, -2, hook.funcID);
+
+		std::vector<LuaMemHook>::iterator pos = remaining.begin();
+		while(pos != remaining.end() && pos->start < hook.start)
+			++pos;
+		remaining.insert(pos, hook);
+	}
+	hooks.swap(remaining);
+
+	// release the callbacks that no longer have any range, along with their pending hits
+	std::vector<int> unusedIDs;
+	lua_pushnil(L);
+	while(lua_next(L, -2))
+	{
+		int funcID = lua_tointeger(L, -2);
+		bool used = false;
+		for(size_t i = 0; i < hooks.size() && !used; i++)
+			used = (hooks[i].funcID == funcID);
+		if(!used)
+			unusedIDs.push_back(funcID);
+		lua_pop(L, 1);
+	}
+	for(size_t i = 0; i < unusedIDs.size(); i++)
+	{
+		lua_pushnil(L);
+		lua_rawseti(L, -2, unusedIDs[i]);
+		info.memHookBatches[hookType].erase(unusedIDs[i]);
 	}
 
 	// adjust the count of active hooks
-	LuaContextInfo& info = GetCurrentInfo();
-	info.numMemHooks += numFuncsAfter - numFuncsBefore;
+	info.numMemHooks = 0;
+	for(int i = 0; i < LUAMEMHOOK_COUNT; i++)
+		info.numMemHooks += info.memHooks[i].size();
 
 	// re-cache regions of hooked memory across all scripts
 	CalculateMemHookRegions(hookType);
@@ -351,21 +426,21 @@ LuaMemHookType MatchHookTypeToCPU(lua_State* L, LuaMemHookType hookType)
 	return hookType;
 }
 
-DEFINE_LUA_FUNCTION(memory_registerwrite, "address,[size=1,][cpuname=\"main\",]func")
+DEFINE_LUA_FUNCTION(memory_registerwrite, "address,[size=1,][cpuname=\"main\",]func[,batched=false]")
 {
 #ifndef HAVE_LUA
 	luaL_error(L, "memory.registerwrite failed: function is not available in this build.");
 #endif
 	return memory_registerHook(L, MatchHookTypeToCPU(L,LUAMEMHOOK_WRITE), 1);
 }
-DEFINE_LUA_FUNCTION(memory_registerread, "address,[size=1,][cpuname=\"main\",]func")
+DEFINE_LUA_FUNCTION(memory_registerread, "address,[size=1,][cpuname=\"main\",]func[,batched=false]")
 {
 #ifndef HAVE_LUA
 	luaL_error(L, "memory.registerread failed: function is not available in this build.");
 #endif
 	return memory_registerHook(L, MatchHookTypeToCPU(L,LUAMEMHOOK_READ), 1);
 }
-DEFINE_LUA_FUNCTION(memory_registerexec, "address,[size=2,][cpuname=\"main\",]func")
+DEFINE_LUA_FUNCTION(memory_registerexec, "address,[size=2,][cpuname=\"main\",]func[,batched=false]")
 {
 #ifndef HAVE_LUA
 	luaL_error(L, "memory.registerexec failed: function is not available in this build.");
@@ -1890,6 +1965,7 @@ DEFINE_LUA_FUNCTION(vram_writeword, "address,value")
 	int address = luaL_checkinteger(L,1);
 	u16 value = (u16)(luaL_checkinteger(L,2) & 0xFFFF);
 	T1WriteWord(MMU.ARM9_LCD,address,value);
+	MMU_VRAMPageMarkWritten((u32)address);
 	return 0;
 }
 DEFINE_LUA_FUNCTION(memory_writedword, "address,value")
@@ -1929,6 +2005,159 @@ DEFINE_LUA_FUNCTION(memory_readbyterange, "address,length")
 	return 1;
 }
 
+// host memory of [address, address+length) if the ARM9 sees it as one contiguous run of main RAM, else NULL
+static u8* GetMainMemRange(u32 address, u32 length)
+{
+	if(length == 0 || (address & 0x0F000000) != 0x02000000)
+		return NULL;
+
+	u32 offset = address & _MMU_MAIN_MEM_MASK;
+	if(length > _MMU_MAIN_MEM_MASK + 1 - offset)
+		return NULL;
+
+	// the DTCM takes priority over main RAM for the ARM9
+	if(address < MMU.DTCMRegion + 0x4000 && address + length > MMU.DTCMRegion)
+		return NULL;
+
+	return &MMU.MAIN_MEM[offset];
+}
+
+// copies memory into dst, with a single memcpy and hook call for main RAM,
+// or byte by byte through the MMU otherwise (unmapped bytes read as 0)
+static void ReadMemoryRange(u32 address, u8* dst, u32 length)
+{
+	const u8* src = GetMainMemRange(address, length);
+	if(src)
+	{
+		CallRegisteredLuaMemHook(address, length, /*FIXME*/ 0, LUAMEMHOOK_READ);
+		memcpy(dst, src, length);
+		return;
+	}
+
+	for(u32 i = 0; i < length; i++)
+	{
+		u32 a = address + i;
+		dst[i] = IsHardwareAddressValid(a) ? (u8)_MMU_read08<ARMCPU_ARM9>(a) : 0;
+	}
+}
+
+static void WriteMemoryRange(u32 address, const u8* src, u32 length)
+{
+	u8* dst = GetMainMemRange(address, length);
+	if(dst)
+	{
+#ifdef HAVE_JIT
+		for(u32 i = 0; i < length + (address & 1); i += 2)
+			JIT_COMPILED_FUNC_KNOWNBANK(address + i, MAIN_MEM, _MMU_MAIN_MEM_MASK, 0) = 0;
+#endif
+		memcpy(dst, src, length);
+		CallRegisteredLuaMemHook(address, length, /*FIXME*/ 0, LUAMEMHOOK_WRITE);
+		return;
+	}
+
+	for(u32 i = 0; i < length; i++)
+		_MMU_write08<ARMCPU_ARM9>(address + i, src[i]);
+}
+
+// returns the bytes as a string, much faster than readbyterange for large blocks
+DEFINE_LUA_FUNCTION(memory_readrange, "address,length")
+{
+	u32 address = (u32)luaL_checkinteger(L,1);
+	int length = luaL_checkinteger(L,2);
+	luaL_argcheck(L, length >= 0, 2, "length must not be negative");
+	luaL_argcheck(L, length <= 0x01000000, 2, "length is too large");
+
+	std::vector<u8> buf(length);
+	if(length)
+		ReadMemoryRange(address, &buf[0], length);
+
+	lua_settop(L,0);
+	lua_pushlstring(L, length ? (const char*)&buf[0] : "", length);
+	return 1;
+}
+
+// writes the bytes of a string, such as one returned by readrange
+DEFINE_LUA_FUNCTION(memory_writerange, "address,str")
+{
+	u32 address = (u32)luaL_checkinteger(L,1);
+	size_t length;
+	const char* str = luaL_checklstring(L, 2, &length);
+
+	WriteMemoryRange(address, (const u8*)str, (u32)length);
+	return 0;
+}
+
+// reads a packed little-endian structure and returns its fields in an array.
+// format characters: b/B = signed/unsigned byte, h/H = word, i/I = dword, x = skip a byte,
+// each optionally preceded by a repeat count (e.g. "2H4x10B")
+DEFINE_LUA_FUNCTION(memory_readstruct, "address,format")
+{
+	u32 address = (u32)luaL_checkinteger(L,1);
+	const char* format = luaL_checkstring(L,2);
+
+	// first pass: validate the format and measure the structure
+	u32 structSize = 0;
+	int numFields = 0;
+	for(const char* f = format; *f; )
+	{
+		u32 count = 1;
+		if(isdigit((unsigned char)*f))
+		{
+			count = strtoul(f, (char**)&f, 10);
+			if(!*f)
+				luaL_error(L, "memory.readstruct: repeat count without a field type in \"%s\"", format);
+			if(count > 0x01000000)
+				luaL_error(L, "memory.readstruct: structure is too large");
+		}
+		switch(*f)
+		{
+			case 'b': case 'B': structSize += count; numFields += count; break;
+			case 'h': case 'H': structSize += count*2; numFields += count; break;
+			case 'i': case 'I': structSize += count*4; numFields += count; break;
+			case 'x': structSize += count; break;
+			case ' ': break;
+			default: luaL_error(L, "memory.readstruct: unknown field type '%c' in \"%s\"", *f, format);
+		}
+		if(structSize > 0x01000000)
+			luaL_error(L, "memory.readstruct: structure is too large");
+		f++;
+	}
+
+	std::vector<u8> buf(structSize);
+	if(structSize)
+		ReadMemoryRange(address, &buf[0], structSize);
+
+	lua_settop(L,0);
+	lua_createtable(L, numFields, 0);
+
+	// second pass: decode the fields
+	u8* src = structSize ? &buf[0] : NULL;
+	int n = 1;
+	for(const char* f = format; *f; f++)
+	{
+		u32 count = 1;
+		if(isdigit((unsigned char)*f))
+			count = strtoul(f, (char**)&f, 10);
+		for(u32 i = 0; i < count; i++)
+		{
+			switch(*f)
+			{
+				case 'b': lua_pushinteger(L, (s8)src[0]); src += 1; break;
+				case 'B': lua_pushinteger(L, src[0]); src += 1; break;
+				case 'h': lua_pushinteger(L, (s16)T1ReadWord(src, 0)); src += 2; break;
+				case 'H': lua_pushinteger(L, T1ReadWord(src, 0)); src += 2; break;
+				case 'i': lua_pushinteger(L, (s32)T1ReadLong(src, 0)); src += 4; break;
+				case 'I': lua_pushnumber(L, T1ReadLong(src, 0)); src += 4; break; // can't use pushinteger in this case (out of range)
+				case 'x': src += 1; continue;
+				default: continue;
+			}
+			lua_rawseti(L, -2, n++);
+		}
+	}
+
+	return 1;
+}
+
 DEFINE_LUA_FUNCTION(memory_isvalid, "address")
 {
 	int address = luaL_checkinteger(L,1);
@@ -3359,6 +3588,128 @@ DEFINE_LUA_FUNCTION(gui_gdscreenshot, "[whichScreen='both']")
 	return 1;
 }
 
+// a view of one display's rendered framebuffer, looked up on every access
+// so that it stays valid across frames, page flips and framebuffer resizes
+struct LuaFramebuffer
+{
+	NDSDisplayID displayID;
+};
+
+static const char* framebufferTypeName = "NDSFramebuffer";
+
+static const NDSDisplayInfo& checkframebuffer(lua_State* L, int idx, NDSDisplayID& displayID)
+{
+	LuaFramebuffer* fb = (LuaFramebuffer*)luaL_checkudata(L, idx, framebufferTypeName);
+	const NDSDisplayInfo& dispInfo = GPU->GetDisplayInfo();
+	if(dispInfo.renderedBuffer[fb->displayID] == NULL)
+		luaL_error(L, "framebuffer is not available");
+	displayID = fb->displayID;
+	return dispInfo;
+}
+
+static u8* framebuffer_pixelptr(lua_State* L, const NDSDisplayInfo& dispInfo, NDSDisplayID displayID, int x, int y)
+{
+	const int width = dispInfo.renderedWidth[displayID];
+	const int height = dispInfo.renderedHeight[displayID];
+	if(x < 0 || x >= width || y < 0 || y >= height)
+		luaL_error(L, "pixel %d,%d is outside the %dx%d framebuffer", x, y, width, height);
+	return (u8*)dispInfo.renderedBuffer[displayID] + (y*width + x) * dispInfo.pixelBytes;
+}
+
+// returns the framebuffer of a screen as userdata, without copying it.
+// example: local fb = gui.getframebuffer("bottom"); local r,g,b = fb:getpixel(10,20)
+DEFINE_LUA_FUNCTION(gui_getframebuffer, "[whichScreen='top']")
+{
+	NDSDisplayID displayID = NDSDisplayID_Main;
+	if(lua_isboolean(L, 1))
+		displayID = lua_toboolean(L, 1) ? NDSDisplayID_Touch : NDSDisplayID_Main;
+	else if(lua_isnumber(L, 1))
+		displayID = (lua_tointeger(L, 1) > 0) ? NDSDisplayID_Touch : NDSDisplayID_Main;
+	else if(lua_isstring(L, 1))
+	{
+		const char* str = lua_tostring(L, 1);
+		if(!stricmp(str,"bottom"))
+			displayID = NDSDisplayID_Touch;
+	}
+
+	LuaFramebuffer* fb = (LuaFramebuffer*)lua_newuserdata(L, sizeof(LuaFramebuffer));
+	fb->displayID = displayID;
+	luaL_getmetatable(L, framebufferTypeName);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+// returns width,height,bytes per pixel
+static int framebuffer_size(lua_State* L)
+{
+	NDSDisplayID displayID;
+	const NDSDisplayInfo& dispInfo = checkframebuffer(L, 1, displayID);
+	lua_pushinteger(L, dispInfo.renderedWidth[displayID]);
+	lua_pushinteger(L, dispInfo.renderedHeight[displayID]);
+	lua_pushinteger(L, dispInfo.pixelBytes);
+	return 3;
+}
+
+// returns the pixel as stored, in the GPU's output color format
+static int framebuffer_getraw(lua_State* L)
+{
+	NDSDisplayID displayID;
+	const NDSDisplayInfo& dispInfo = checkframebuffer(L, 1, displayID);
+	u8* src = framebuffer_pixelptr(L, dispInfo, displayID, luaL_checkinteger(L,2), luaL_checkinteger(L,3));
+	if(dispInfo.pixelBytes == 2)
+		lua_pushinteger(L, T1ReadWord(src, 0));
+	else
+		lua_pushnumber(L, T1ReadLong(src, 0));
+	return 1;
+}
+
+// returns r,g,b like gui.getpixel, but read from the GPU output (before master brightness when it hasn't been applied yet)
+static int framebuffer_getpixel(lua_State* L)
+{
+	NDSDisplayID displayID;
+	const NDSDisplayInfo& dispInfo = checkframebuffer(L, 1, displayID);
+	u8* src = framebuffer_pixelptr(L, dispInfo, displayID, luaL_checkinteger(L,2), luaL_checkinteger(L,3));
+
+	FragmentColor color;
+	if(dispInfo.pixelBytes == 2)
+		color.color = ColorspaceConvert555To8888Opaque<false>(T1ReadWord(src, 0));
+	else if(dispInfo.colorFormat == NDSColorFormat_BGR666_Rev || dispInfo.needConvertColorFormat[displayID])
+		color.color = ColorspaceConvert6665To8888<false>(T1ReadLong(src, 0) & 0x003F3F3F);
+	else
+		color.color = T1ReadLong(src, 0);
+
+	lua_pushinteger(L, color.r);
+	lua_pushinteger(L, color.g);
+	lua_pushinteger(L, color.b);
+	return 3;
+}
+
+// returns the raw bytes of some lines as a string
+static int framebuffer_tostring(lua_State* L)
+{
+	NDSDisplayID displayID;
+	const NDSDisplayInfo& dispInfo = checkframebuffer(L, 1, displayID);
+	const int height = dispInfo.renderedHeight[displayID];
+	const size_t lineBytes = dispInfo.renderedWidth[displayID] * dispInfo.pixelBytes;
+
+	int y = luaL_optinteger(L, 2, 0);
+	int lines = luaL_optinteger(L, 3, height - y);
+	if(y < 0 || y > height || lines < 0 || lines > height - y)
+		luaL_error(L, "%d lines from line %d are outside the framebuffer", lines, y);
+
+	lua_pushlstring(L, (const char*)dispInfo.renderedBuffer[displayID] + y*lineBytes, lines*lineBytes);
+	return 1;
+}
+
+static const struct luaL_reg framebuffermethods [] =
+{
+	{"size", framebuffer_size},
+	{"getraw", framebuffer_getraw},
+	{"getpixel", framebuffer_getpixel},
+	{"tostring", framebuffer_tostring},
+	{NULL, NULL}
+};
+
 // draws a gd image that's in gdstr format to the screen
 // example: gui.gdoverlay(gd.createFromPng("myimage.png"):gdStr())
 DEFINE_LUA_FUNCTION(gui_gdoverlay, "[dx=0,dy=0,]gdimage[,sx=0,sy=0,width,height][,alphamul]")
@@ -3942,7 +4293,7 @@ DEFINE_LUA_FUNCTION(emu_atframeboundary, "")
 }
 DEFINE_LUA_FUNCTION(movie_getlength, "")
 {
-	lua_pushinteger(L, currMovieData.records.size());
+	lua_pushinteger(L, currMovieData.getNumRecords());
 	return 1;
 }
 DEFINE_LUA_FUNCTION(movie_isactive, "")
@@ -4882,6 +5233,7 @@ static const struct luaL_reg guilib [] =
 	{"line", gui_line},
 	{"pixel", gui_pixel},
 	{"getpixel", gui_getpixel},
+	{"getframebuffer", gui_getframebuffer},
 	{"opacity", gui_setopacity},
 	{"transparency", gui_settransparency},
 	{"popup", gui_popup},
@@ -4929,6 +5281,9 @@ static const struct luaL_reg memorylib [] =
 	{"readdword", memory_readdword},
 	{"readdwordsigned", memory_readdwordsigned},
 	{"readbyterange", memory_readbyterange},
+	{"readrange", memory_readrange},
+	{"writerange", memory_writerange},
+	{"readstruct", memory_readstruct},
 	{"writebyte", memory_writebyte},
 	{"writeword", memory_writeword},
 	{"writedword", memory_writedword},
@@ -5273,6 +5628,12 @@ void registerLibs(lua_State* L)
 	lua_pushcfunction(L, gcEMUFILE_MEMORY);
 	lua_setfield(L, -2, "__gc");
 	lua_pop(L, 1);
+
+	luaL_newmetatable(L, framebufferTypeName);
+	lua_newtable(L);
+	luaL_register(L, NULL, framebuffermethods);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
 }
 
 void ResetInfo(LuaContextInfo& info)
@@ -5298,6 +5659,12 @@ void ResetInfo(LuaContextInfo& info)
 	info.dataSaveLoadKeySet = false;
 	info.rerecordCountingDisabled = false;
 	info.numMemHooks = 0;
+	for(int i = 0; i < LUAMEMHOOK_COUNT; i++)
+	{
+		info.memHooks[i].clear();
+		info.memHookBatches[i].clear();
+	}
+	info.lastMemHookID = 0;
 	info.persistVars.clear();
 	info.newDefaultData.ClearRecords();
 #ifdef HAVE_LIBAGG
@@ -5677,7 +6044,11 @@ void StopLuaScript(int uid)
 			
 			info.numMemHooks = 0;
 			for(int i = 0; i < LUAMEMHOOK_COUNT; i++)
+			{
+				info.memHooks[i].clear();
+				info.memHookBatches[i].clear();
 				CalculateMemHookRegions((LuaMemHookType)i);
+			}
 
 #if defined(WIN32_FRONTEND)
 			// remove items
@@ -5728,7 +6099,7 @@ void CloseLuaContext(int uid)
 }
 
 
-TieredRegion hookedRegions [LUAMEMHOOK_COUNT];
+HookedRanges hookedRegions [LUAMEMHOOK_COUNT];
 
 
 // currently disabled for desmume,
@@ -5737,39 +6108,42 @@ TieredRegion hookedRegions [LUAMEMHOOK_COUNT];
 // that has this callback enabled.
 static void CalculateMemHookRegions(LuaMemHookType hookType)
 {
-	std::vector<unsigned int> hookedBytes;
+	std::vector<HookedRanges::Range> hookedRanges;
 	std::map<int, LuaContextInfo*>::iterator iter = luaContextInfo.begin();
 	std::map<int, LuaContextInfo*>::iterator end = luaContextInfo.end();
 	while(iter != end)
 	{
 		LuaContextInfo& info = *iter->second;
-		if(info.numMemHooks)
+		if(info.numMemHooks && info.L)
 		{
-			lua_State* L = info.L;
-			if(L)
+			const std::vector<LuaMemHook>& hooks = info.memHooks[hookType];
+			for(size_t i = 0; i < hooks.size(); i++)
 			{
-				int top = lua_gettop(L);
-				lua_getfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[hookType]);
-				lua_pushnil(L);
-				while(lua_next(L, -2))
-				{
-					if(lua_isfunction(L, -1))
-					{
-						unsigned int addr = lua_tointeger(L, -2);
-						hookedBytes.push_back(addr);
-					}
-					lua_pop(L, 1);
-				}
-				if(!info.crashed)
-					lua_settop(L, top);
+				HookedRanges::Range range = { hooks[i].start, hooks[i].end };
+				hookedRanges.push_back(range);
 			}
 		}
 		++iter;
 	}
-	hookedRegions[hookType].Calculate(hookedBytes);
+	hookedRegions[hookType].Calculate(hookedRanges);
 }
 
-
+// returns the script's hook covering any of the bytes, or NULL
+static const LuaMemHook* FindMemHook(const std::vector<LuaMemHook>& hooks, unsigned int address, int size)
+{
+	size_t lo = 0, hi = hooks.size();
+	while(lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		if(hooks[mid].end <= address)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if(lo < hooks.size() && hooks[lo].start < address+size)
+		return &hooks[lo];
+	return NULL;
+}
 
 
 
@@ -5783,37 +6157,46 @@ void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, unsigned
 		if(info.numMemHooks)
 		{
 			lua_State* L = info.L;
-			if(L && !info.panic)
+			const LuaMemHook* hook = FindMemHook(info.memHooks[hookType], address, size);
+			if(L && !info.panic && hook)
 			{
+				if(hook->batched)
+				{
+					// stay out of the interpreter, the hit is delivered at the end of the frame
+					LuaMemHookBatch& batch = info.memHookBatches[hookType][hook->funcID];
+					if(batch.addresses.size() < LUAMEMHOOK_BATCH_MAX)
+					{
+						batch.addresses.push_back(address);
+						batch.sizes.push_back(size);
+						batch.values.push_back(value);
+					}
+					else
+						batch.dropped++;
+					++iter;
+					continue;
+				}
+
 #ifdef USE_INFO_STACK
 				infoStack.insert(infoStack.begin(), &info);
 				struct Scope { ~Scope(){ infoStack.erase(infoStack.begin()); } } scope;
 #endif
 				int top = lua_gettop(L);
 				lua_getfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[hookType]);
-				for(int i = address; i != address+size; i++)
+				lua_rawgeti(L, -1, hook->funcID);
+				if (lua_isfunction(L, -1))
 				{
-					lua_rawgeti(L, -1, i);
-					if (lua_isfunction(L, -1))
+					bool wasRunning = info.running;
+					info.running = true;
+					RefreshScriptSpeedStatus();
+					lua_pushinteger(L, address);
+					lua_pushinteger(L, size);
+					int errorcode = lua_pcall(L, 2, 0, 0);
+					info.running = wasRunning;
+					RefreshScriptSpeedStatus();
+					if (errorcode)
 					{
-						bool wasRunning = info.running;
-						info.running = true;
-						RefreshScriptSpeedStatus();
-						lua_pushinteger(L, address);
-						lua_pushinteger(L, size);
-						int errorcode = lua_pcall(L, 2, 0, 0);
-						info.running = wasRunning;
-						RefreshScriptSpeedStatus();
-						if (errorcode)
-						{
-							int uid = iter->first;
-							HandleCallbackError(L,info,uid,true);
-						}
-						break;
-					}
-					else
-					{
-						lua_pop(L,1);
+						int uid = iter->first;
+						HandleCallbackError(L,info,uid,true);
 					}
 				}
 				if(!info.crashed)
@@ -5824,6 +6207,57 @@ void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, unsigned
 	}
 }
 
+// calls each batched memory hook with the hits it collected during the frame:
+// func(addresses, sizes, values, dropped), where the first three are arrays of the same length
+static void CallMemHookBatches(lua_State* L, LuaContextInfo& info, int uid)
+{
+	for(int hookType = 0; hookType < LUAMEMHOOK_COUNT; hookType++)
+	{
+		// the callbacks may register hooks or trigger new hits, so work on the current batches only
+		std::map<int, LuaMemHookBatch> batches;
+		batches.swap(info.memHookBatches[hookType]);
+
+		std::map<int, LuaMemHookBatch>::const_iterator iter = batches.begin();
+		std::map<int, LuaMemHookBatch>::const_iterator end = batches.end();
+		for(; iter != end; ++iter)
+		{
+			const LuaMemHookBatch& batch = iter->second;
+			if(batch.addresses.empty() && !batch.dropped)
+				continue;
+
+			int top = lua_gettop(L);
+			lua_getfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[hookType]);
+			lua_rawgeti(L, -1, iter->first);
+			if (lua_isfunction(L, -1))
+			{
+				const std::vector<unsigned int>* lists[3] = { &batch.addresses, &batch.sizes, &batch.values };
+				for(int i = 0; i < 3; i++)
+				{
+					lua_createtable(L, lists[i]->size(), 0);
+					for(size_t j = 0; j < lists[i]->size(); j++)
+					{
+						lua_pushinteger(L, (*lists[i])[j]);
+						lua_rawseti(L, -2, j+1);
+					}
+				}
+				lua_pushinteger(L, batch.dropped);
+
+				bool wasRunning = info.running;
+				info.running = true;
+				RefreshScriptSpeedStatus();
+				int errorcode = lua_pcall(L, 4, 0, 0);
+				info.running = wasRunning;
+				RefreshScriptSpeedStatus();
+				if (errorcode)
+					HandleCallbackError(L,info,uid,true);
+			}
+			if(info.crashed)
+				return;
+			lua_settop(L, top);
+		}
+	}
+}
+
 
 void CallRegisteredLuaMenuHandlers(PlatformMenuItem menuItem)
 {
@@ -5906,6 +6340,15 @@ void _CallRegisteredLuaFunctions(LuaCallID calltype, int (*beforeCallback)(lua_S
 				info.guiFuncsNeedDeferring = false;
 			if(calltype == LUACALL_AFTEREMULATIONGUI)
 				CallDeferredFunctions(L, deferredGUIIDString);
+			if(calltype == LUACALL_AFTEREMULATION && info.numMemHooks)
+			{
+				CallMemHookBatches(L, info, uid);
+				if(info.crashed)
+				{
+					++iter;
+					continue;
+				}
+			}
 			if(calltype == LUACALL_BEFOREEMULATION)
 			{
 				assert(NDS_isProcessingUserInput());
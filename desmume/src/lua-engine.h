@@ -124,86 +124,71 @@ void DontWorryLua();
 // with a bias toward fast rejection because the majority of addresses will not be hooked.
 // (it must not use any part of Lua or perform any per-script operations,
 //  otherwise it would definitely be too slow.)
-// calculating the regions when a hook is added/removed may be slow,
+// the hooked ranges of all scripts are merged into sorted, disjoint intervals:
+// anything outside of [lowest, highest) is rejected by two compares, everything else
+// takes a binary search, no matter how many bytes are hooked.
+// calculating the intervals when a hook is added/removed may be slow,
 // but this is an intentional tradeoff to obtain a high speed of checking during later execution
-struct TieredRegion
+struct HookedRanges
 {
-	template<unsigned int maxGap>
-	struct Region
+	struct Range
 	{
-		struct Island
-		{
-			unsigned int start;
-			unsigned int end;
-			FORCEINLINE bool Contains(unsigned int address, int size) const { return address < end && address+size > start; }
-		};
-		std::vector<Island> islands;
-
-		void Calculate(const std::vector<unsigned int>& bytes)
-		{
-			islands.clear();
-
-			unsigned int lastEnd = ~0;
-
-			std::vector<unsigned int>::const_iterator iter = bytes.begin();
-			std::vector<unsigned int>::const_iterator end = bytes.end();
-			for(; iter != end; ++iter)
-			{
-				unsigned int addr = *iter;
-				if(addr < lastEnd || addr > lastEnd + (long long)maxGap)
-				{
-					islands.push_back(Island());
-					islands.back().start = addr;
-				}
-				islands.back().end = addr+1;
-				lastEnd = addr+1;
-			}
-		}
-
-		bool Contains(unsigned int address, int size) const
-		{
-			typename std::vector<Island>::const_iterator iter = islands.begin();
-			typename std::vector<Island>::const_iterator end = islands.end();
-			for(; iter != end; ++iter)
-				if(iter->Contains(address, size))
-					return true;
-			return false;
-		}
+		unsigned int start;
+		unsigned int end; // exclusive
 	};
+	std::vector<Range> ranges;
+	unsigned int lowest;
+	unsigned int highest;
 
-	Region<0xFFFFFFFF> broad;
-	Region<0x1000> mid;
-	Region<0> narrow;
+	static bool StartsBefore(const Range& a, const Range& b) { return a.start < b.start; }
 
-	void Calculate(std::vector<unsigned int>& bytes)
+	void Calculate(std::vector<Range>& hooked)
 	{
-		std::sort(bytes.begin(), bytes.end());
+		std::sort(hooked.begin(), hooked.end(), StartsBefore);
 
-		broad.Calculate(bytes);
-		mid.Calculate(bytes);
-		narrow.Calculate(bytes);
-	}
+		ranges.clear();
+		std::vector<Range>::const_iterator iter = hooked.begin();
+		std::vector<Range>::const_iterator end = hooked.end();
+		for(; iter != end; ++iter)
+		{
+			if(iter->start >= iter->end)
+				continue;
+			if(!ranges.empty() && iter->start <= ranges.back().end)
+				ranges.back().end = std::max(ranges.back().end, iter->end);
+			else
+				ranges.push_back(*iter);
+		}
 
-	TieredRegion()
-	{
-		std::vector<unsigned int> somevector;
-		Calculate(somevector);
+		lowest = ranges.empty() ? ~0U : ranges.front().start;
+		highest = ranges.empty() ? 0 : ranges.back().end;
 	}
 
-	FORCEINLINE int NotEmpty()
+	HookedRanges() : lowest(~0U), highest(0) {}
+
+	FORCEINLINE int NotEmpty() const
 	{
-		return broad.islands.size();
+		return ranges.size();
 	}
 
-	// note: it is illegal to call this if NotEmpty() returns 0
-	FORCEINLINE bool Contains(unsigned int address, int size)
+	FORCEINLINE bool Contains(unsigned int address, int size) const
 	{
-		return broad.islands[0].Contains(address,size) &&
-		       mid.Contains(address,size) &&
-			   narrow.Contains(address,size);
+		if(address >= highest || address+size <= lowest)
+			return false;
+
+		// find the first range that ends after the address
+		size_t lo = 0, hi = ranges.size();
+		while(lo < hi)
+		{
+			size_t mid = (lo + hi) / 2;
+			if(ranges[mid].end <= address)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo < ranges.size() && ranges[lo].start < address+size;
 	}
 };
-extern TieredRegion hookedRegions [LUAMEMHOOK_COUNT];
+extern HookedRanges hookedRegions [LUAMEMHOOK_COUNT];
 
 void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, unsigned int value, LuaMemHookType hookType);
 
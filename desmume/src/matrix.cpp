@@ -665,6 +665,14 @@ static FORCEINLINE void __mtx4_translate_vec3_fixed(s32 (&__restrict inoutMtx)[1
 	inoutMtx[15] = ___s32_saturate_shiftdown_accum64_fixed( fx32_mul(inoutMtx[3], inVec[0]) + fx32_mul(inoutMtx[7], inVec[1]) + fx32_mul(inoutMtx[11], inVec[2]) + fx32_shiftup(inoutMtx[15]) );
 }
 
+static FORCEINLINE void __vec4list_multiply_mtx4_fixed(s32 (*__restrict inoutVecList)[4], const size_t vecCount, const s32 (&__restrict inMtx)[16])
+{
+	for (size_t i = 0; i < vecCount; i++)
+	{
+		__vec4_multiply_mtx4_fixed(inoutVecList[i], inMtx);
+	}
+}
+
 #ifdef ENABLE_SSE4_1
 
 static FORCEINLINE void ___s32_saturate_shiftdown_accum64_fixed_SSE4(__m128i &inoutAccum)
@@ -741,6 +749,78 @@ static FORCEINLINE void __vec4_multiply_mtx4_fixed_SSE4(s32 (&__restrict inoutVe
 	_mm_store_si128( (v128s32 *)inoutVec, _mm_unpacklo_epi64(outVecLo, outVecHi) );
 }
 
+static FORCEINLINE void __vec4x4_transpose_SSE2(v128s32 &v0, v128s32 &v1, v128s32 &v2, v128s32 &v3)
+{
+	const v128s32 t0 = _mm_unpacklo_epi32(v0, v1);
+	const v128s32 t1 = _mm_unpacklo_epi32(v2, v3);
+	const v128s32 t2 = _mm_unpackhi_epi32(v0, v1);
+	const v128s32 t3 = _mm_unpackhi_epi32(v2, v3);
+	
+	v0 = _mm_unpacklo_epi64(t0, t1);
+	v1 = _mm_unpackhi_epi64(t0, t1);
+	v2 = _mm_unpacklo_epi64(t2, t3);
+	v3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+// Transforms four vectors at once. The vectors are transposed so that each
+// register holds one component of all four vectors, which lets every matrix
+// element be broadcast once instead of shuffling the matrix for each vector.
+// The accumulation and saturation are the same as __vec4_multiply_mtx4_fixed_SSE4(),
+// so the results are bit-identical.
+static FORCEINLINE void __vec4x4_multiply_mtx4_fixed_SSE4(s32 (*__restrict inoutVecList)[4], const s32 (&__restrict inMtx)[16])
+{
+	v128s32 inVec[4] = {
+		_mm_loadu_si128((v128s32 *)inoutVecList[0]),
+		_mm_loadu_si128((v128s32 *)inoutVecList[1]),
+		_mm_loadu_si128((v128s32 *)inoutVecList[2]),
+		_mm_loadu_si128((v128s32 *)inoutVecList[3])
+	};
+	
+	__vec4x4_transpose_SSE2(inVec[0], inVec[1], inVec[2], inVec[3]);
+	
+	// _mm_mul_epi32() only multiplies the even lanes, so keep a copy of the
+	// odd lanes shifted down into the even positions.
+	const v128s32 inVecOdd[4] = {
+		_mm_shuffle_epi32(inVec[0], 0xF5),
+		_mm_shuffle_epi32(inVec[1], 0xF5),
+		_mm_shuffle_epi32(inVec[2], 0xF5),
+		_mm_shuffle_epi32(inVec[3], 0xF5)
+	};
+	
+	v128s32 outVec[4];
+	
+	for (size_t i = 0; i < 4; i++)
+	{
+		const v128s32 m[4] = {
+			_mm_set1_epi32(inMtx[i+ 0]),
+			_mm_set1_epi32(inMtx[i+ 4]),
+			_mm_set1_epi32(inMtx[i+ 8]),
+			_mm_set1_epi32(inMtx[i+12])
+		};
+		
+		v128s32 outEven =                 _mm_mul_epi32(m[0], inVec[0]);
+		outEven = _mm_add_epi64( outEven, _mm_mul_epi32(m[1], inVec[1]) );
+		outEven = _mm_add_epi64( outEven, _mm_mul_epi32(m[2], inVec[2]) );
+		outEven = _mm_add_epi64( outEven, _mm_mul_epi32(m[3], inVec[3]) );
+		___s32_saturate_shiftdown_accum64_fixed_SSE4(outEven);
+		
+		v128s32 outOdd =                _mm_mul_epi32(m[0], inVecOdd[0]);
+		outOdd = _mm_add_epi64( outOdd, _mm_mul_epi32(m[1], inVecOdd[1]) );
+		outOdd = _mm_add_epi64( outOdd, _mm_mul_epi32(m[2], inVecOdd[2]) );
+		outOdd = _mm_add_epi64( outOdd, _mm_mul_epi32(m[3], inVecOdd[3]) );
+		___s32_saturate_shiftdown_accum64_fixed_SSE4(outOdd);
+		
+		outVec[i] = _mm_unpacklo_epi32(outEven, outOdd);
+	}
+	
+	__vec4x4_transpose_SSE2(outVec[0], outVec[1], outVec[2], outVec[3]);
+	
+	_mm_storeu_si128((v128s32 *)inoutVecList[0], outVec[0]);
+	_mm_storeu_si128((v128s32 *)inoutVecList[1], outVec[1]);
+	_mm_storeu_si128((v128s32 *)inoutVecList[2], outVec[2]);
+	_mm_storeu_si128((v128s32 *)inoutVecList[3], outVec[3]);
+}
+
 static FORCEINLINE void __vec3_multiply_mtx3_fixed_SSE4(s32 (&__restrict inoutVec)[4], const s32 (&__restrict inMtx)[16])
 {
 	const v128s32 inVec = _mm_load_si128((v128s32 *)inoutVec);
@@ -954,6 +1034,97 @@ static FORCEINLINE void __mtx4_translate_vec3_fixed_SSE4(s32 (&__restrict inoutM
 
 #endif // ENABLE_SSE4_1
 
+#ifdef ENABLE_AVX2
+
+static FORCEINLINE void ___s32_saturate_shiftdown_accum64_fixed_AVX2(v256s32 &inoutAccum)
+{
+	v256u8 outVecMask;
+	
+	outVecMask = _mm256_cmpgt_epi64( inoutAccum, _mm256_set1_epi64x((s64)0x000007FFFFFFFFFFULL) );
+	inoutAccum = _mm256_blendv_epi8( inoutAccum, _mm256_set1_epi64x((s64)0x000007FFFFFFFFFFULL), outVecMask );
+	
+	outVecMask = _mm256_cmpgt_epi64( _mm256_set1_epi64x((s64)0xFFFFF80000000000ULL), inoutAccum );
+	inoutAccum = _mm256_blendv_epi8( inoutAccum, _mm256_set1_epi64x((s64)0xFFFFF80000000000ULL), outVecMask );
+	
+	inoutAccum = _mm256_srli_epi64(inoutAccum, 12);
+	inoutAccum = _mm256_shuffle_epi32(inoutAccum, 0xD8);
+}
+
+// Same as __vec4x4_multiply_mtx4_fixed_SSE4(), but for eight vectors at once.
+static FORCEINLINE void __vec4x8_multiply_mtx4_fixed_AVX2(s32 (*__restrict inoutVecList)[4], const s32 (&__restrict inMtx)[16])
+{
+	v128s32 inLo[4] = {
+		_mm_loadu_si128((v128s32 *)inoutVecList[0]),
+		_mm_loadu_si128((v128s32 *)inoutVecList[1]),
+		_mm_loadu_si128((v128s32 *)inoutVecList[2]),
+		_mm_loadu_si128((v128s32 *)inoutVecList[3])
+	};
+	
+	v128s32 inHi[4] = {
+		_mm_loadu_si128((v128s32 *)inoutVecList[4]),
+		_mm_loadu_si128((v128s32 *)inoutVecList[5]),
+		_mm_loadu_si128((v128s32 *)inoutVecList[6]),
+		_mm_loadu_si128((v128s32 *)inoutVecList[7])
+	};
+	
+	__vec4x4_transpose_SSE2(inLo[0], inLo[1], inLo[2], inLo[3]);
+	__vec4x4_transpose_SSE2(inHi[0], inHi[1], inHi[2], inHi[3]);
+	
+	const v256s32 inVec[4] = {
+		_mm256_inserti128_si256(_mm256_castsi128_si256(inLo[0]), inHi[0], 1),
+		_mm256_inserti128_si256(_mm256_castsi128_si256(inLo[1]), inHi[1], 1),
+		_mm256_inserti128_si256(_mm256_castsi128_si256(inLo[2]), inHi[2], 1),
+		_mm256_inserti128_si256(_mm256_castsi128_si256(inLo[3]), inHi[3], 1)
+	};
+	
+	const v256s32 inVecOdd[4] = {
+		_mm256_shuffle_epi32(inVec[0], 0xF5),
+		_mm256_shuffle_epi32(inVec[1], 0xF5),
+		_mm256_shuffle_epi32(inVec[2], 0xF5),
+		_mm256_shuffle_epi32(inVec[3], 0xF5)
+	};
+	
+	v128s32 outLo[4];
+	v128s32 outHi[4];
+	
+	for (size_t i = 0; i < 4; i++)
+	{
+		const v256s32 m[4] = {
+			_mm256_set1_epi32(inMtx[i+ 0]),
+			_mm256_set1_epi32(inMtx[i+ 4]),
+			_mm256_set1_epi32(inMtx[i+ 8]),
+			_mm256_set1_epi32(inMtx[i+12])
+		};
+		
+		v256s32 outEven =                    _mm256_mul_epi32(m[0], inVec[0]);
+		outEven = _mm256_add_epi64( outEven, _mm256_mul_epi32(m[1], inVec[1]) );
+		outEven = _mm256_add_epi64( outEven, _mm256_mul_epi32(m[2], inVec[2]) );
+		outEven = _mm256_add_epi64( outEven, _mm256_mul_epi32(m[3], inVec[3]) );
+		___s32_saturate_shiftdown_accum64_fixed_AVX2(outEven);
+		
+		v256s32 outOdd =                   _mm256_mul_epi32(m[0], inVecOdd[0]);
+		outOdd = _mm256_add_epi64( outOdd, _mm256_mul_epi32(m[1], inVecOdd[1]) );
+		outOdd = _mm256_add_epi64( outOdd, _mm256_mul_epi32(m[2], inVecOdd[2]) );
+		outOdd = _mm256_add_epi64( outOdd, _mm256_mul_epi32(m[3], inVecOdd[3]) );
+		___s32_saturate_shiftdown_accum64_fixed_AVX2(outOdd);
+		
+		const v256s32 outVec = _mm256_unpacklo_epi32(outEven, outOdd);
+		outLo[i] = _mm256_castsi256_si128(outVec);
+		outHi[i] = _mm256_extracti128_si256(outVec, 1);
+	}
+	
+	__vec4x4_transpose_SSE2(outLo[0], outLo[1], outLo[2], outLo[3]);
+	__vec4x4_transpose_SSE2(outHi[0], outHi[1], outHi[2], outHi[3]);
+	
+	for (size_t i = 0; i < 4; i++)
+	{
+		_mm_storeu_si128((v128s32 *)inoutVecList[i+0], outLo[i]);
+		_mm_storeu_si128((v128s32 *)inoutVecList[i+4], outHi[i]);
+	}
+}
+
+#endif // ENABLE_AVX2
+
 #if defined(ENABLE_NEON_A64)
 
 static FORCEINLINE void ___s32_saturate_shiftdown_accum64_fixed_NEON(int64x2_t &inoutAccum)
@@ -1009,6 +1180,33 @@ static FORCEINLINE void __vec4_multiply_mtx4_fixed_NEON(s32 (&__restrict inoutVe
 	vst1q_s32( inoutVec, vreinterpretq_s32_s64(vzip1q_s64(outVecLo, outVecHi)) );
 }
 
+// Transforms four vectors at once, with each register holding one component
+// of all four vectors. Bit-identical to __vec4_multiply_mtx4_fixed_NEON().
+static FORCEINLINE void __vec4x4_multiply_mtx4_fixed_NEON(s32 (*__restrict inoutVecList)[4], const s32 (&__restrict inMtx)[16])
+{
+	const int32x4x4_t inVec = vld4q_s32(inoutVecList[0]);
+	int32x4x4_t outVec;
+	
+	for (size_t i = 0; i < 4; i++)
+	{
+		int64x2_t outVecLo = vmull_n_s32( vget_low_s32(inVec.val[0]), inMtx[i+0] );
+		outVecLo = vmlal_n_s32( outVecLo, vget_low_s32(inVec.val[1]), inMtx[i+ 4] );
+		outVecLo = vmlal_n_s32( outVecLo, vget_low_s32(inVec.val[2]), inMtx[i+ 8] );
+		outVecLo = vmlal_n_s32( outVecLo, vget_low_s32(inVec.val[3]), inMtx[i+12] );
+		___s32_saturate_shiftdown_accum64_fixed_NEON(outVecLo);
+		
+		int64x2_t outVecHi = vmull_high_n_s32( inVec.val[0], inMtx[i+0] );
+		outVecHi = vmlal_high_n_s32( outVecHi, inVec.val[1], inMtx[i+ 4] );
+		outVecHi = vmlal_high_n_s32( outVecHi, inVec.val[2], inMtx[i+ 8] );
+		outVecHi = vmlal_high_n_s32( outVecHi, inVec.val[3], inMtx[i+12] );
+		___s32_saturate_shiftdown_accum64_fixed_NEON(outVecHi);
+		
+		outVec.val[i] = vreinterpretq_s32_s64( vzip1q_s64(outVecLo, outVecHi) );
+	}
+	
+	vst4q_s32(inoutVecList[0], outVec);
+}
+
 static FORCEINLINE void __vec3_multiply_mtx3_fixed_NEON(s32 (&__restrict inoutVec)[4], const s32 (&__restrict inMtx)[16])
 {
 	const v128s32 inVec = vld1q_s32(inoutVec);
@@ -1363,6 +1561,30 @@ void MatrixMultVec4x4(const s32 (&__restrict mtx)[16], s32 (&__restrict vec)[4])
 #endif
 }
 
+void MatrixMultVec4x4(const s32 (&__restrict mtx)[16], s32 (*__restrict vecList)[4], const size_t vecCount)
+{
+	size_t i = 0;
+	
+#if defined(ENABLE_AVX2)
+	for (; i + 8 <= vecCount; i += 8)
+		__vec4x8_multiply_mtx4_fixed_AVX2(vecList + i, mtx);
+#endif
+	
+#if defined(ENABLE_SSE4_1)
+	for (; i + 4 <= vecCount; i += 4)
+		__vec4x4_multiply_mtx4_fixed_SSE4(vecList + i, mtx);
+	for (; i < vecCount; i++)
+		__vec4_multiply_mtx4_fixed_SSE4(vecList[i], mtx);
+#elif defined(ENABLE_NEON_A64)
+	for (; i + 4 <= vecCount; i += 4)
+		__vec4x4_multiply_mtx4_fixed_NEON(vecList + i, mtx);
+	for (; i < vecCount; i++)
+		__vec4_multiply_mtx4_fixed_NEON(vecList[i], mtx);
+#else
+	__vec4list_multiply_mtx4_fixed(vecList + i, vecCount - i, mtx);
+#endif
+}
+
 void MatrixMultVec4x4(const s32 (&__restrict mtx)[16], float (&__restrict vec)[4])
 {
 #if defined(ENABLE_SSE)
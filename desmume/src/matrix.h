@@ -37,6 +37,10 @@
 #include <smmintrin.h>
 #endif
 
+#ifdef ENABLE_AVX2
+#include <immintrin.h>
+#endif
+
 enum MatrixMode
 {
 	MATRIXMODE_PROJECTION		= 0,
@@ -96,6 +100,7 @@ void MatrixScale(float (&__restrict mtx)[16], const float (&__restrict vec)[4]);
 void MatrixMultiply(float (&__restrict mtxA)[16], const s32 (&__restrict mtxB)[16]);
 
 void MatrixMultVec4x4(const s32 (&__restrict mtx)[16], s32 (&__restrict vec)[4]);
+void MatrixMultVec4x4(const s32 (&__restrict mtx)[16], s32 (*__restrict vecList)[4], const size_t vecCount); // Same results as transforming each vector in turn
 void MatrixMultVec3x3(const s32 (&__restrict mtx)[16], s32 (&__restrict vec)[4]);
 void MatrixTranslate(s32 (&__restrict mtx)[16], const s32 (&__restrict vec)[4]);
 void MatrixScale(s32 (&__restrict mtx)[16], const s32 (&__restrict vec)[4]);
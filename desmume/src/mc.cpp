@@ -33,6 +33,15 @@
 #include "utils/advanscene.h"
 #include "utils/xstring.h"
 #include "emufile.h"
+#include "utils/task.h"
+
+#include <rthreads/rthreads.h>
+
+#ifdef HOST_WINDOWS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 //#define _DONT_SAVE_BACKUP
 //#define _MCLOG
@@ -88,6 +97,59 @@ static const u32 saveSizes[] = {512,			// 4k
 								0xFFFFFFFF};
 static const u32 saveSizes_count = ARRAY_SIZE(saveSizes);
 
+//how often the write-behind worker writes out dirty backup memory on its own; 0 only flushes on request
+static u32 backupFlushIntervalMS = 1000;
+
+#define BACKUP_DIRTY_BLOCK_SHIFT	9
+#define BACKUP_DIRTY_BLOCK_SIZE		(1 << BACKUP_DIRTY_BLOCK_SHIFT)
+
+struct BackupDirtyRun
+{
+	u32 offset;
+	u32 size;
+};
+
+class BackupMemoryFile : public EMUFILE_MEMORY
+{
+private:
+	FILE *_fp;
+	std::vector<u8> _dirtyBlock;
+	size_t _dirtyCount;
+	s32 _fileLength;
+	
+	u32 _requestGeneration;
+	u32 _completeGeneration;
+	bool _willSync;
+	bool _lastFlushSucceeded;
+	bool _workerExit;
+	
+	Task *_workerTask;
+	slock_t *_mutex;
+	scond_t *_condWork;
+	scond_t *_condIdle;
+	
+	void _MarkDirty(s32 start, size_t bytes);
+	
+public:
+	BackupMemoryFile();
+	~BackupMemoryFile();
+	
+	bool Open(const std::string &fileName, bool fileExists);
+	void Close();
+	
+	virtual size_t fwrite(const void *ptr, size_t bytes);
+	virtual int fseek(int offset, int origin);
+	virtual void truncate(s32 length);
+	
+	// Requests that the worker write out the dirty blocks, without waiting for it.
+	virtual void fflush();
+	
+	// Writes out the dirty blocks and waits until they are on disk. Returns false on a write error.
+	bool Sync();
+	
+	void WorkerLoop();
+};
+
 //the lookup table from user save types to save parameters
 const SAVE_TYPE save_types[] = {
 	{"Autodetect",		MC_TYPE_AUTODETECT,	1, 0},
@@ -119,6 +181,333 @@ void backup_setManualBackupType(int type)
 	CommonSettings.manualBackupType = type;
 }
 
+void backup_setFlushInterval(u32 milliseconds)
+{
+	backupFlushIntervalMS = milliseconds;
+}
+
+//The backup memory image is held entirely in memory and written behind to the .dsv file.
+//Games write their saves over AUXSPI one byte at a time, and writing each of those bytes through
+//stdio made the emulation thread do thousands of tiny writes for every save. Now a write only
+//marks its block dirty, and a worker thread writes out the dirty blocks when a save command
+//completes (fflush), every backupFlushIntervalMS milliseconds, or when the file is closed.
+static void* BackupMemoryFile_RunWorker(void *arg)
+{
+	BackupMemoryFile *backupFile = (BackupMemoryFile *)arg;
+	backupFile->WorkerLoop();
+	
+	return NULL;
+}
+
+BackupMemoryFile::BackupMemoryFile()
+{
+	_fp = NULL;
+	_dirtyCount = 0;
+	_fileLength = 0;
+	
+	_requestGeneration = 0;
+	_completeGeneration = 0;
+	_willSync = false;
+	_lastFlushSucceeded = true;
+	_workerExit = false;
+	_workerTask = NULL;
+	
+	_mutex = slock_new();
+	_condWork = scond_new();
+	_condIdle = scond_new();
+}
+
+BackupMemoryFile::~BackupMemoryFile()
+{
+	this->Close();
+	
+	scond_free(this->_condIdle);
+	scond_free(this->_condWork);
+	slock_free(this->_mutex);
+}
+
+bool BackupMemoryFile::Open(const std::string &fileName, bool fileExists)
+{
+	this->_fp = fopen(fileName.c_str(), (fileExists) ? "rb+" : "wb+");
+	if (this->_fp == NULL)
+	{
+		return false;
+	}
+	
+	::fseek(this->_fp, 0, SEEK_END);
+	const s32 fileLength = (s32)::ftell(this->_fp);
+	::fseek(this->_fp, 0, SEEK_SET);
+	
+	this->vec->resize(fileLength);
+	if ( (fileLength > 0) && (::fread(&(*this->vec)[0], 1, fileLength, this->_fp) != (size_t)fileLength) )
+	{
+		fclose(this->_fp);
+		this->_fp = NULL;
+		this->vec->clear();
+		return false;
+	}
+	
+	this->len = fileLength;
+	this->pos = 0;
+	this->_fileLength = fileLength;
+	this->_dirtyBlock.assign((fileLength + BACKUP_DIRTY_BLOCK_SIZE - 1) >> BACKUP_DIRTY_BLOCK_SHIFT, 0);
+	
+	this->_workerExit = false;
+	this->_workerTask = new Task();
+	this->_workerTask->start(false, 0, "Backup Memory Writer");
+	this->_workerTask->execute(&BackupMemoryFile_RunWorker, this);
+	
+	return true;
+}
+
+void BackupMemoryFile::Close()
+{
+	if (this->_workerTask != NULL)
+	{
+		//the worker writes out anything still dirty before it leaves
+		slock_lock(this->_mutex);
+		this->_requestGeneration++;
+		this->_willSync = true;
+		this->_workerExit = true;
+		scond_signal(this->_condWork);
+		slock_unlock(this->_mutex);
+		
+		this->_workerTask->finish();
+		this->_workerTask->shutdown();
+		delete this->_workerTask;
+		this->_workerTask = NULL;
+	}
+	
+	if (this->_fp != NULL)
+	{
+		fclose(this->_fp);
+		this->_fp = NULL;
+	}
+}
+
+void BackupMemoryFile::_MarkDirty(s32 start, size_t bytes)
+{
+	if (bytes == 0)
+	{
+		return;
+	}
+	
+	const size_t firstBlock = (size_t)start >> BACKUP_DIRTY_BLOCK_SHIFT;
+	const size_t lastBlock = ((size_t)start + bytes - 1) >> BACKUP_DIRTY_BLOCK_SHIFT;
+	
+	if (lastBlock >= this->_dirtyBlock.size())
+	{
+		this->_dirtyBlock.resize(lastBlock + 1, 0);
+	}
+	
+	for (size_t i = firstBlock; i <= lastBlock; i++)
+	{
+		if (this->_dirtyBlock[i] == 0)
+		{
+			this->_dirtyBlock[i] = 1;
+			this->_dirtyCount++;
+		}
+	}
+}
+
+size_t BackupMemoryFile::fwrite(const void *ptr, size_t bytes)
+{
+	slock_lock(this->_mutex);
+	
+	const s32 writePos = this->pos;
+	const size_t result = EMUFILE_MEMORY::fwrite(ptr, bytes);
+	this->_MarkDirty(writePos, result);
+	
+	slock_unlock(this->_mutex);
+	return result;
+}
+
+int BackupMemoryFile::fseek(int offset, int origin)
+{
+	//seeking can grow the underlying vector, so keep it away from a worker that is copying out of it
+	slock_lock(this->_mutex);
+	const int result = EMUFILE_MEMORY::fseek(offset, origin);
+	slock_unlock(this->_mutex);
+	
+	return result;
+}
+
+void BackupMemoryFile::truncate(s32 length)
+{
+	slock_lock(this->_mutex);
+	EMUFILE_MEMORY::truncate(length);
+	this->_requestGeneration++;
+	scond_signal(this->_condWork);
+	slock_unlock(this->_mutex);
+}
+
+void BackupMemoryFile::fflush()
+{
+	slock_lock(this->_mutex);
+	
+	if (this->_dirtyCount > 0)
+	{
+		this->_requestGeneration++;
+		scond_signal(this->_condWork);
+	}
+	
+	slock_unlock(this->_mutex);
+}
+
+bool BackupMemoryFile::Sync()
+{
+	if (this->_workerTask == NULL)
+	{
+		//closed (or detached), so the last flush was the final one
+		return this->_lastFlushSucceeded;
+	}
+	
+	slock_lock(this->_mutex);
+	
+	const u32 generation = ++this->_requestGeneration;
+	this->_willSync = true;
+	scond_signal(this->_condWork);
+	
+	while ((s32)(this->_completeGeneration - generation) < 0)
+	{
+		scond_wait(this->_condIdle, this->_mutex);
+	}
+	
+	const bool didSucceed = this->_lastFlushSucceeded;
+	slock_unlock(this->_mutex);
+	
+	return didSucceed;
+}
+
+void BackupMemoryFile::WorkerLoop()
+{
+	std::vector<u8> scratch;
+	std::vector<BackupDirtyRun> runList;
+	
+	slock_lock(this->_mutex);
+	
+	do
+	{
+		while ((this->_requestGeneration == this->_completeGeneration) && !this->_workerExit)
+		{
+			if (backupFlushIntervalMS == 0)
+			{
+				scond_wait(this->_condWork, this->_mutex);
+			}
+			else if (!scond_wait_timeout(this->_condWork, this->_mutex, (int64_t)backupFlushIntervalMS * 1000) && (this->_dirtyCount > 0))
+			{
+				this->_requestGeneration++;
+			}
+		}
+		
+		if (this->_requestGeneration == this->_completeGeneration)
+		{
+			break;
+		}
+		
+		const u32 generation = this->_requestGeneration;
+		const bool willSync = this->_willSync;
+		this->_willSync = false;
+		
+		//copy out the dirty blocks while the lock is held, then do the slow part without it
+		scratch.clear();
+		runList.clear();
+		
+		const size_t blockCount = std::min<size_t>(this->_dirtyBlock.size(), ((size_t)this->len + BACKUP_DIRTY_BLOCK_SIZE - 1) >> BACKUP_DIRTY_BLOCK_SHIFT);
+		for (size_t i = 0; i < blockCount; )
+		{
+			if (this->_dirtyBlock[i] == 0)
+			{
+				i++;
+				continue;
+			}
+			
+			size_t runEnd = i;
+			while ( (runEnd < blockCount) && (this->_dirtyBlock[runEnd] != 0) )
+			{
+				runEnd++;
+			}
+			
+			BackupDirtyRun run;
+			run.offset = (u32)(i << BACKUP_DIRTY_BLOCK_SHIFT);
+			run.size = (u32)std::min<size_t>(runEnd << BACKUP_DIRTY_BLOCK_SHIFT, (size_t)this->len) - run.offset;
+			scratch.insert(scratch.end(), this->vec->begin() + run.offset, this->vec->begin() + run.offset + run.size);
+			runList.push_back(run);
+			
+			i = runEnd;
+		}
+		
+		std::fill(this->_dirtyBlock.begin(), this->_dirtyBlock.end(), 0);
+		this->_dirtyCount = 0;
+		
+		const s32 imageLength = this->len;
+		const s32 fileLength = this->_fileLength;
+		
+		slock_unlock(this->_mutex);
+		
+		bool didSucceed = true;
+		const u8 *src = (scratch.empty()) ? NULL : &scratch[0];
+		
+		for (size_t i = 0; i < runList.size(); i++)
+		{
+			didSucceed = didSucceed && (::fseek(this->_fp, runList[i].offset, SEEK_SET) == 0);
+			didSucceed = didSucceed && (::fwrite(src, 1, runList[i].size, this->_fp) == runList[i].size);
+			src += runList[i].size;
+		}
+		
+		didSucceed = didSucceed && (::fflush(this->_fp) == 0);
+		
+		if (imageLength < fileLength)
+		{
+#ifdef HOST_WINDOWS
+			didSucceed = didSucceed && (_chsize(_fileno(this->_fp), imageLength) == 0);
+#else
+			didSucceed = didSucceed && (ftruncate(fileno(this->_fp), imageLength) == 0);
+#endif
+		}
+		
+		if (willSync)
+		{
+#ifdef HOST_WINDOWS
+			didSucceed = didSucceed && (_commit(_fileno(this->_fp)) == 0);
+#else
+			didSucceed = didSucceed && (fsync(fileno(this->_fp)) == 0);
+#endif
+		}
+		
+		if (!didSucceed)
+		{
+			printf("BackupDevice: WARNING! Failed to write the save file to disk.\n");
+		}
+		
+		slock_lock(this->_mutex);
+		
+		if (didSucceed)
+		{
+			this->_fileLength = imageLength;
+		}
+		else
+		{
+			//stdio buffering hides which of the runs actually made it to the file, so write all of
+			//them again next time. Since nothing is dropped, the error sticks until a flush that
+			//covers everything goes through.
+			for (size_t i = 0; i < runList.size(); i++)
+			{
+				if ((s32)runList[i].offset < this->len)
+				{
+					this->_MarkDirty(runList[i].offset, std::min<size_t>(runList[i].size, (size_t)(this->len - runList[i].offset)));
+				}
+			}
+		}
+		
+		this->_lastFlushSucceeded = didSucceed;
+		this->_completeGeneration = generation;
+		scond_broadcast(this->_condIdle);
+	} while (true);
+	
+	slock_unlock(this->_mutex);
+}
+
 bool BackupDevice::save_state(EMUFILE &os)
 {
 	u32 savePos = this->_fpMC->ftell();
@@ -214,6 +603,7 @@ bool BackupDevice::load_state(EMUFILE &is)
 BackupDevice::BackupDevice()
 {
 	_fpMC = NULL;
+	_writeBehind = NULL;
 	_fsize = 0;
 	_addr_size = 0;
 
@@ -326,11 +716,16 @@ BackupDevice::BackupDevice()
 		}
 	}
 
-	_fpMC = new EMUFILE_FILE(_fileName, fexists?"rb+" : "wb+");
-	const bool fileCanReadWrite = (_fpMC->get_fp() != NULL);
-	if (!fileCanReadWrite)
+	_writeBehind = new BackupMemoryFile();
+	const bool fileCanReadWrite = _writeBehind->Open(_fileName, fexists);
+	if (fileCanReadWrite)
+	{
+		_fpMC = _writeBehind;
+	}
+	else
 	{
-		delete _fpMC;
+		delete _writeBehind;
+		_writeBehind = NULL;
 		_fpMC = new EMUFILE_MEMORY();
 		printf("BackupDevice: WARNING! Failed to get read/write access to the save file! Will operate in RAM instead.\n");
 	}
@@ -411,6 +806,7 @@ BackupDevice::~BackupDevice()
 {
 	delete this->_fpMC;
 	this->_fpMC = NULL;
+	this->_writeBehind = NULL;
 }
 
 int BackupDevice::readFooter()
@@ -565,6 +961,24 @@ void BackupDevice::flushBackup()
 	this->_fpMC->fflush();
 }
 
+bool BackupDevice::syncBackup()
+{
+	if (this->_writeBehind == NULL)
+	{
+		return true;
+	}
+	
+	return this->_writeBehind->Sync();
+}
+
+void BackupDevice::detachBackupFile()
+{
+	if (this->_writeBehind != NULL)
+	{
+		this->_writeBehind->Close();
+	}
+}
+
 bool BackupDevice::saveBuffer(u8 *data, u32 size, bool willRewind, bool willTruncate)
 {
 	if (willRewind)
@@ -633,6 +1047,7 @@ void BackupDevice::close_rom()
 	this->_fpMC->fflush();
 	delete this->_fpMC;
 	this->_fpMC = NULL;
+	this->_writeBehind = NULL;
 }
 
 //todo - this function is horrible. it's only needed due to our big disorganization between save types and sizes.
@@ -1661,6 +2076,7 @@ bool BackupDevice::load_movie(EMUFILE *is)
 {
 	delete this->_fpMC;
 	this->_fpMC = is;
+	this->_writeBehind = NULL;
 	
 	int ok = readFooter();
 	// TODO - in case we ever change the format again (and we should probably entirely rewrite this if we do) we'd need to detect the old versions
@@ -1684,6 +2100,7 @@ void BackupDevice::load_movie_blank()
 {
 	delete this->_fpMC;
 	this->_fpMC = new EMUFILE_MEMORY();
+	this->_writeBehind = NULL;
 
 	this->_state = DETECTING;
 	this->_fsize = 0;
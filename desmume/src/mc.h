@@ -49,6 +49,7 @@
 #define MC_SIZE_512MBITS                0x4000000
 
 class EMUFILE;
+class BackupMemoryFile;
 
 struct BackupDeviceFileInfo
 {
@@ -104,7 +105,13 @@ public:
 
 	void seek(u32 pos);
 
+	//writes to the save file happen behind the emulator's back; this asks for them to start now
 	void flushBackup();
+	//writes out everything the game has saved so far and waits for it to reach the disk
+	bool syncBackup();
+	//like syncBackup, then stops writing to the .dsv and the worker thread exits; the game's
+	//saves keep working, but only in memory. for processes that are about to fork().
+	void detachBackupFile();
 	
 	u8 searchFileSaveType(u32 size);
 
@@ -164,6 +171,7 @@ public:
 
 private:
 	EMUFILE *_fpMC;
+	BackupMemoryFile *_writeBehind; //same object as _fpMC when the save file is written behind, otherwise NULL
 	std::string _fileName;
 	u32	_fsize;
 	BackupDeviceFileInfo _info;
@@ -207,6 +215,7 @@ private:
 
 void backup_setManualBackupType(int type);
 void backup_forceManualBackupType();
+void backup_setFlushInterval(u32 milliseconds);
 
 struct SAVE_TYPE
 {
@@ -40,6 +40,18 @@
 #include "path.h"
 #include "emufile.h"
 #include "saves.h"
+#include "GPU.h"
+#include "armcpu.h"
+#include "utils/fasthash.h"
+
+#ifdef HOST_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 bool freshMovie = false;	  //True when a movie loads, false when movie is altered.  Used to determine if a movie has been altered since opening
@@ -66,6 +78,9 @@ int currFrameCounter;
 u32 cur_input_display = 0;
 int pauseframe = -1;
 bool movie_readonly = true;
+//store only the movie guid and a hash of the frames played so far in savestates, instead of the whole movie.
+//this is always done for movies played from a columnar file.
+bool movie_savestate_by_reference = false;
 
 char curMovieFilename[512] = {0};
 MovieData currMovieData;
@@ -80,12 +95,14 @@ bool movie_reset_command = false;
 
 void MovieData::clearRecordRange(int start, int len)
 {
+	materializeRecords();
 	for(int i=0;i<len;i++)
 		records[i+start].clear();
 }
 
 void MovieData::insertEmpty(int at, int frames)
 {
+	materializeRecords();
 	if(at == -1) 
 	{
 		int currcount = records.size();
@@ -291,10 +308,64 @@ MovieData::MovieData(bool fromCurrentSettings)
 
 void MovieData::truncateAt(int frame)
 {
+	materializeRecords();
 	if((int)records.size() > frame)
 		records.resize(frame);
 }
 
+int MovieData::getNumRecords() const
+{
+	if (columnar)
+		return (int)columnar->GetFrameCount();
+	
+	return (int)records.size();
+}
+
+bool MovieData::getRecord(int frame, MovieRecord &outRecord) const
+{
+	if (frame < 0 || frame >= getNumRecords())
+		return false;
+	
+	if (columnar)
+		return columnar->GetRecord((u32)frame, outRecord);
+	
+	outRecord = records[frame];
+	return true;
+}
+
+//decodes a columnar movie into records so that it can be edited
+void MovieData::materializeRecords()
+{
+	if (!columnar)
+		return;
+	
+	const int numRecords = (int)columnar->GetFrameCount();
+	records.resize(numRecords);
+	for (int i = 0; i < numRecords; i++)
+	{
+		if (!columnar->GetRecord((u32)i, records[i]))
+		{
+			FCEU_PrintError("Columnar movie is damaged at frame %d; truncating it there.\n", i);
+			records.resize(i);
+			break;
+		}
+	}
+	
+	columnar.reset();
+}
+
+u64 MovieData::computePrefixHash(int frameCount) const
+{
+	if (columnar)
+		return columnar->GetPrefixHash((u32)frameCount);
+	
+	u64 hash = 0;
+	for (int i = 0; i < frameCount && i < (int)records.size(); i++)
+		hash = MovieRecord_HashStep(hash, records[i]);
+	
+	return hash;
+}
+
 void MovieData::installRomChecksum(std::string& key, std::string& val)
 {
 	// TODO: The current implementation of reading the checksum doesn't work correctly, and can
@@ -353,6 +424,34 @@ void MovieData::installValue(std::string& key, std::string& val)
 
 
 int MovieData::dump(EMUFILE &fp, bool binary)
+{
+	int start = fp.ftell();
+	dumpHeader(fp, binary);
+
+	const int numRecords = getNumRecords();
+	MovieRecord rec;
+	if (binary)
+	{
+		//put one | to start the binary dump
+		fp.fputc('|');
+		for (int i = 0; i < numRecords; i++)
+		{
+			getRecord(i, rec);
+			rec.dumpBinary(fp);
+		}
+	}
+	else
+		for (int i = 0; i < numRecords; i++)
+		{
+			getRecord(i, rec);
+			rec.dump(fp);
+		}
+
+	int end = fp.ftell();
+	return end-start;
+}
+
+int MovieData::dumpHeader(EMUFILE &fp, bool binary)
 {
 	int start = fp.ftell();
 	fp.fprintf("version %d\n", version);
@@ -416,17 +515,6 @@ int MovieData::dump(EMUFILE &fp, bool binary)
 		}
 	}
 
-	if (binary)
-	{
-		//put one | to start the binary dump
-		fp.fputc('|');
-		for (int i = 0; i < (int)records.size(); i++)
-			records[i].dumpBinary(fp);
-	}
-	else
-		for (int i = 0; i < (int)records.size(); i++)
-			records[i].dump(fp);
-
 	int end = fp.ftell();
 	return end-start;
 }
@@ -591,10 +679,22 @@ void FCEUI_StopMovie()
 	else if(movieMode == MOVIEMODE_RECORD)
 		StopRecording();
 
+	FCEUI_MovieVerifyStop();
 	curMovieFilename[0] = 0;
 	freshMovie = false;
 }
 
+static std::string MovieSavestateFilename(const char *fname)
+{
+	// .dsm and .dsmc movies both use a .dst savestate
+	std::string ssName = fname;
+	const size_t dot = ssName.find_last_of('.');
+	if (dot != std::string::npos)
+		ssName.erase(dot + 1);
+	ssName.append("dst");
+	return ssName;
+}
+
 static void LoadSettingsFromMovie(MovieData movieData)
 {
 	if (movieData.useExtBios != -1)
@@ -679,10 +779,13 @@ const char* _CDECL_ FCEUI_LoadMovie(const char *fname, bool _read_only, bool tas
 	
 	strcpy(curMovieFilename, fname);
 	
-	bool loadedfm2 = false;
-	EMUFILE *fp = new EMUFILE_FILE(fname, "rb");
-	loadedfm2 = LoadFM2(currMovieData, *fp, INT_MAX, false);
-	delete fp;
+	bool loadedfm2 = LoadMovieColumnar(currMovieData, fname);
+	if (!loadedfm2)
+	{
+		EMUFILE *fp = new EMUFILE_FILE(fname, "rb");
+		loadedfm2 = LoadFM2(currMovieData, *fp, INT_MAX, false);
+		delete fp;
+	}
 
 	if(!loadedfm2)
 		return "failed to load movie";
@@ -698,9 +801,7 @@ const char* _CDECL_ FCEUI_LoadMovie(const char *fname, bool _read_only, bool tas
 	if (currMovieData.savestate)
 	{
 		// SS file name should be the same as the movie file name, except for extension
-		std::string ssName = fname;
-		ssName.erase(ssName.length() - 3, 3);
-		ssName.append("dst");
+		std::string ssName = MovieSavestateFilename(fname);
 		if (!savestate_load(ssName.c_str()))
 			return "Could not load movie's savestate. There should be a .dst file with the same name as the movie, in the same folder.";
 	}
@@ -830,9 +931,7 @@ void FCEUI_SaveMovie(const char *fname, std::wstring author, START_FROM startFro
 	if (startFrom == START_SAVESTATE)
 	{
 		// SS file name should be the same as the movie file name, except for extension
-		std::string ssName = fname;
-		ssName.erase(ssName.length() - 3, 3);
-		ssName.append("dst");
+		std::string ssName = MovieSavestateFilename(fname);
 		savestate_save(ssName.c_str());
 		currMovieData.savestate = true;
 	}
@@ -871,6 +970,278 @@ void FCEUI_SaveMovie(const char *fname, std::wstring author, START_FROM startFro
 }
 
 
+//----movie verification
+
+static const u32 kDSMV = 0x564D5344; // "DSMV"
+static const u32 kVHSH = 0x48534856; // "VHSH"
+static const u32 kVSTA = 0x41545356; // "VSTA"
+
+//version 1 - state hash covers main RAM, the ARM9/ARM7 registers and both displays
+#define MOVIE_VERIFY_VERSION 1
+
+struct MovieVerifySegment
+{
+	int frame;
+	s64 offset;
+	u32 size;
+};
+
+static EMOVIEVERIFYSTATUS verifyStatus = MOVIEVERIFY_INACTIVE;
+static EMUFILE_FILE *verifySidecar = NULL;
+static int verifyHashInterval = 0;
+static int verifySegmentLength = 0;
+static std::vector< std::pair<int,u64> > verifyHashes;
+static size_t verifyHashCursor = 0;
+static int verifyStartFrame = 0;
+static int verifyEndFrame = 0;
+static int verifyDivergedFrame = -1;
+
+u64 FCEUMOV_ComputeStateHash()
+{
+	u64 hash = FastHash64(MMU.MAIN_MEM, _MMU_MAIN_MEM_MASK + 1);
+	
+	u32 regs[34];
+	for (int i = 0; i < 16; i++)
+	{
+		regs[i] = LOCAL_TO_LE_32(NDS_ARM9.R[i]);
+		regs[17 + i] = LOCAL_TO_LE_32(NDS_ARM7.R[i]);
+	}
+	regs[16] = LOCAL_TO_LE_32(NDS_ARM9.CPSR.val);
+	regs[33] = LOCAL_TO_LE_32(NDS_ARM7.CPSR.val);
+	hash = FastHash64(regs, sizeof(regs), hash);
+	
+	const NDSDisplayInfo &displayInfo = GPU->GetDisplayInfo();
+	for (size_t i = 0; i < 2; i++)
+	{
+		if (displayInfo.renderedBuffer[i] != NULL)
+			hash = FastHash64(displayInfo.renderedBuffer[i], displayInfo.renderedWidth[i] * displayInfo.renderedHeight[i] * displayInfo.pixelBytes, hash);
+	}
+	
+	return hash;
+}
+
+//reads the hash list and the segment table of a sidecar. the savestates themselves are left in the file.
+static bool MovieVerify_ReadSidecar(const char *sidecarName, Desmume_Guid &outGuid, std::vector< std::pair<int,u64> > &outHashes, std::vector<MovieVerifySegment> &outSegments)
+{
+	EMUFILE_FILE fp(sidecarName, "rb");
+	if (fp.fail())
+		return false;
+	
+	u32 magic, version, hashInterval, segmentLength;
+	if (fp.read_32LE(magic) != 1 || magic != kDSMV) return false;
+	if (fp.read_32LE(version) != 1 || version != MOVIE_VERIFY_VERSION) return false;
+	if (fp.fread(outGuid.data, Desmume_Guid::size) != (size_t)Desmume_Guid::size) return false;
+	if (fp.read_32LE(hashInterval) != 1 || fp.read_32LE(segmentLength) != 1) return false;
+	
+	outHashes.clear();
+	outSegments.clear();
+	
+	//a sidecar cut short by a crash is still usable up to its last complete entry
+	u32 kind, frame;
+	while (fp.read_32LE(kind) == 1 && fp.read_32LE(frame) == 1)
+	{
+		if (kind == kVHSH)
+		{
+			u64 hash;
+			if (fp.read_64LE(hash) != 1)
+				break;
+			outHashes.push_back(std::make_pair((int)frame, hash));
+		}
+		else if (kind == kVSTA)
+		{
+			MovieVerifySegment segment;
+			if (fp.read_32LE(segment.size) != 1)
+				break;
+			segment.frame = (int)frame;
+			segment.offset = fp.ftell();
+			//EMUFILE seeks with an int, so the segment has to end within the first 2GB
+			if (segment.offset < 0 || segment.offset + segment.size > (s64)INT_MAX || segment.offset + segment.size > fp.size())
+				break;
+			fp.fseek(segment.size, SEEK_CUR);
+			outSegments.push_back(segment);
+		}
+		else
+		{
+			break;
+		}
+	}
+	
+	return true;
+}
+
+static void MovieVerify_CloseSidecar()
+{
+	if (verifySidecar != NULL)
+	{
+		delete verifySidecar;
+		verifySidecar = NULL;
+	}
+}
+
+bool FCEUI_MovieVerifyBeginWrite(const char *sidecarName, int hashInterval, int segmentLength)
+{
+	if (movieMode != MOVIEMODE_PLAY || hashInterval <= 0 || segmentLength <= 0)
+		return false;
+	
+	FCEUI_MovieVerifyStop();
+	
+	verifySidecar = new EMUFILE_FILE(sidecarName, "wb");
+	if (verifySidecar->fail())
+	{
+		MovieVerify_CloseSidecar();
+		return false;
+	}
+	
+	verifySidecar->write_32LE(kDSMV);
+	verifySidecar->write_32LE((u32)MOVIE_VERIFY_VERSION);
+	verifySidecar->fwrite(currMovieData.guid.data, Desmume_Guid::size);
+	verifySidecar->write_32LE((u32)hashInterval);
+	verifySidecar->write_32LE((u32)segmentLength);
+	
+	verifyHashInterval = hashInterval;
+	verifySegmentLength = segmentLength;
+	verifyDivergedFrame = -1;
+	verifyStatus = MOVIEVERIFY_WRITING;
+	return true;
+}
+
+bool FCEUI_MovieVerifyBeginCheck(const char *sidecarName, int firstSegment, int segmentCount)
+{
+	if (movieMode != MOVIEMODE_PLAY || firstSegment < 0 || segmentCount <= 0)
+		return false;
+	
+	FCEUI_MovieVerifyStop();
+	
+	Desmume_Guid guid;
+	std::vector<MovieVerifySegment> segments;
+	if (!MovieVerify_ReadSidecar(sidecarName, guid, verifyHashes, segments))
+		return false;
+	
+	if (guid != currMovieData.guid)
+	{
+		FCEU_PrintError("Verification sidecar was made for a different movie.\n");
+		return false;
+	}
+	
+	if (firstSegment >= (int)segments.size())
+		return false;
+	
+	//start from the segment's savestate. the movie stays in playback mode, so the
+	//savestate's movie reference is checked against the frames of this movie.
+	const MovieVerifySegment &segment = segments[firstSegment];
+	std::vector<u8> stateData(segment.size);
+	{
+		EMUFILE_FILE fp(sidecarName, "rb");
+		fp.fseek((int)segment.offset, SEEK_SET);
+		if (segment.size == 0 || fp.fread(&stateData[0], segment.size) != segment.size)
+			return false;
+	}
+	
+	EMUFILE_MEMORY ms(&stateData);
+	if (!savestate_load(ms) || currFrameCounter != segment.frame)
+	{
+		verifyStatus = MOVIEVERIFY_FAILED;
+		return false;
+	}
+	
+	verifyStartFrame = segment.frame;
+	verifyEndFrame = (firstSegment + segmentCount < (int)segments.size()) ? segments[firstSegment + segmentCount].frame : INT_MAX;
+	verifyHashCursor = 0;
+	verifyDivergedFrame = -1;
+	verifyStatus = MOVIEVERIFY_CHECKING;
+	return true;
+}
+
+int FCEUI_MovieVerifyGetSegmentCount(const char *sidecarName)
+{
+	Desmume_Guid guid;
+	std::vector< std::pair<int,u64> > hashes;
+	std::vector<MovieVerifySegment> segments;
+	if (!MovieVerify_ReadSidecar(sidecarName, guid, hashes, segments))
+		return -1;
+	
+	return (int)segments.size();
+}
+
+void FCEUI_MovieVerifyStop()
+{
+	MovieVerify_CloseSidecar();
+	verifyHashes.clear();
+	
+	if (verifyStatus == MOVIEVERIFY_WRITING || verifyStatus == MOVIEVERIFY_CHECKING)
+		verifyStatus = MOVIEVERIFY_INACTIVE;
+}
+
+EMOVIEVERIFYSTATUS FCEUI_MovieVerifyGetStatus()
+{
+	return verifyStatus;
+}
+
+int FCEUI_MovieVerifyGetDivergedFrame()
+{
+	return verifyDivergedFrame;
+}
+
+//called at the start of every played frame, before its input is applied
+static void MovieVerify_FrameBoundary()
+{
+	if (verifyStatus == MOVIEVERIFY_WRITING)
+	{
+		if ((currFrameCounter % verifySegmentLength) == 0)
+		{
+			//segment savestates refer to the movie instead of carrying a copy of it
+			EMUFILE_MEMORY ms;
+			const bool wasByReference = movie_savestate_by_reference;
+			movie_savestate_by_reference = true;
+			savestate_save(ms);
+			movie_savestate_by_reference = wasByReference;
+			
+			verifySidecar->write_32LE(kVSTA);
+			verifySidecar->write_32LE((u32)currFrameCounter);
+			verifySidecar->write_32LE((u32)ms.size());
+			verifySidecar->fwrite(ms.buf(), ms.size());
+		}
+		
+		if ((currFrameCounter % verifyHashInterval) == 0)
+		{
+			verifySidecar->write_32LE(kVHSH);
+			verifySidecar->write_32LE((u32)currFrameCounter);
+			verifySidecar->write_64LE(FCEUMOV_ComputeStateHash());
+		}
+	}
+	else if (verifyStatus == MOVIEVERIFY_CHECKING)
+	{
+		while (verifyHashCursor < verifyHashes.size() && verifyHashes[verifyHashCursor].first < currFrameCounter)
+			verifyHashCursor++;
+		
+		//the displays aren't part of a savestate, so the first hash after loading one can't match
+		if (currFrameCounter != verifyStartFrame &&
+		    verifyHashCursor < verifyHashes.size() &&
+		    verifyHashes[verifyHashCursor].first == currFrameCounter &&
+		    verifyHashes[verifyHashCursor].second != FCEUMOV_ComputeStateHash())
+		{
+			verifyDivergedFrame = currFrameCounter;
+			verifyStatus = MOVIEVERIFY_DIVERGED;
+			FCEU_PrintError("Movie verification: state diverged by frame %d.\n", currFrameCounter);
+			return;
+		}
+		
+		if (currFrameCounter >= verifyEndFrame)
+			verifyStatus = MOVIEVERIFY_COMPLETE;
+	}
+}
+
+//the movie ran out of frames
+static void MovieVerify_Finish()
+{
+	if (verifyStatus == MOVIEVERIFY_WRITING || verifyStatus == MOVIEVERIFY_CHECKING)
+	{
+		MovieVerify_CloseSidecar();
+		verifyStatus = MOVIEVERIFY_COMPLETE;
+	}
+}
+
+
  //the main interaction point between the emulator and the movie system.
  //either dumps the current joystick state or loads one state from the movie.
  //deprecated, should use the two functions it has been split into directly
@@ -884,19 +1255,26 @@ void FCEUI_SaveMovie(const char *fname, std::wstring author, START_FROM startFro
  {
 	 if(movieMode == MOVIEMODE_PLAY)
 	 {
+		 MovieVerify_FrameBoundary();
+
 		 //stop when we run out of frames
-		 if(currFrameCounter == (int)currMovieData.records.size())
+		 if(currFrameCounter == currMovieData.getNumRecords())
 		 {
 			 FinishPlayback();
+			 MovieVerify_Finish();
 		 }
 		 else
 		 {
+			 MovieRecord mr;
+			 if (!currMovieData.getRecord(currFrameCounter, mr))
+				 FCEU_PrintError("Columnar movie is damaged at frame %d.\n", currFrameCounter);
+
 			 UserInput &input = NDS_getProcessingUserInput();
-			 ReplayRecToDesmumeInput(currMovieData.records[currFrameCounter], input);
+			 ReplayRecToDesmumeInput(mr, input);
 		 }
 
 		 //if we are on the last frame, then pause the emulator if the player requested it
-		 if(currFrameCounter == (int)currMovieData.records.size()-1)
+		 if(currFrameCounter == currMovieData.getNumRecords()-1)
 		 {
 			 /*if(FCEUD_PauseAfterPlayback())
 			 {
@@ -934,6 +1312,7 @@ void FCEUI_SaveMovie(const char *fname, std::wstring author, START_FROM startFro
 		 //assert((mr.touch.x << 4) == nds.touchX && (mr.touch.y << 4) == nds.touchY);
 
 		 mr.dump(*osRecordingMovie);
+		 currMovieData.materializeRecords();
 		 currMovieData.records.push_back(mr);
 
 		 // it's apparently un-threadsafe to do this here
@@ -965,6 +1344,11 @@ static void FCEUMOV_AddCommand(int cmd)
 //little endian 4-byte cookies
 static const u32 kMOVI = 0x49564F4D;
 static const u32 kNOMO = 0x4F4D4F4E;
+static const u32 kMOVR = 0x52564F4D;
+
+//a movie reference names the movie by guid, along with the length and hash of the
+//part of it that had been played when the state was saved
+#define MOVIE_REFERENCE_VERSION 1
 
 void mov_savestate(EMUFILE &fp)
 {
@@ -972,7 +1356,16 @@ void mov_savestate(EMUFILE &fp)
 	//if(movieMode == MOVIEMODE_RECORD || movieMode == MOVIEMODE_PLAY)
 	//	return currMovieData.dump(os, true);
 	//else return 0;
-	if(movieMode != MOVIEMODE_INACTIVE)
+	if(movieMode != MOVIEMODE_INACTIVE && (movie_savestate_by_reference || currMovieData.columnar))
+	{
+		const int length = std::min(currFrameCounter, currMovieData.getNumRecords());
+		fp.write_32LE(kMOVR);
+		fp.write_32LE((u32)MOVIE_REFERENCE_VERSION);
+		fp.fwrite(currMovieData.guid.data, Desmume_Guid::size);
+		fp.write_32LE((u32)length);
+		fp.write_64LE(currMovieData.computePrefixHash(length));
+	}
+	else if(movieMode != MOVIEMODE_INACTIVE)
 	{
 		fp.write_32LE(kMOVI);
 		currMovieData.dump(fp, true);
@@ -997,9 +1390,12 @@ bool CheckTimelines(MovieData& stateMovie, MovieData& currMovie, int& errorFr)
 	else
 		length = stateMovie.getNumRecords();
 
+	MovieRecord stateRec, currRec;
 	for (int x = 0; x < length; x++)
 	{
-		if (!stateMovie.records[x].Compare(currMovie.records[x]))
+		stateMovie.getRecord(x, stateRec);
+		currMovie.getRecord(x, currRec);
+		if (!stateRec.Compare(currRec))
 		{
 			isInTimeline = false;
 			errorFr = x;
@@ -1025,7 +1421,7 @@ bool mov_loadstate(EMUFILE &fp, int size)
 			FinishPlayback();
 		return true;
 	}
-	else if (cookie != kMOVI)
+	else if (cookie != kMOVI && cookie != kMOVR)
 		return false;
 
 	size -= 4;
@@ -1045,8 +1441,19 @@ bool mov_loadstate(EMUFILE &fp, int size)
 //	}
 
 	MovieData tempMovieData = MovieData();
+	int stateMovieLength = -1;
+	u64 stateMovieHash = 0;
+	if (cookie == kMOVR)
+	{
+		u32 version, length;
+		if (fp.read_32LE(version) != 1 || version != MOVIE_REFERENCE_VERSION) return false;
+		if (fp.fread(tempMovieData.guid.data, Desmume_Guid::size) != (size_t)Desmume_Guid::size) return false;
+		if (fp.read_32LE(length) != 1) return false;
+		if (fp.read_64LE(stateMovieHash) != 1) return false;
+		stateMovieLength = (int)length;
+	}
 	//int curr = fp->ftell();
-	if(!LoadFM2(tempMovieData, fp, size, false)) {
+	else if(!LoadFM2(tempMovieData, fp, size, false)) {
 		
 	//	is->seekg((u32)curr+size);
 	/*	extern bool FCEU_state_loading_old_format;
@@ -1126,15 +1533,26 @@ bool mov_loadstate(EMUFILE &fp, int size)
 			#endif
 		}
 
+		//a referenced movie is only usable if this movie still starts with the frames the state was made on
+		if (stateMovieLength >= 0 && (stateMovieLength > currMovieData.getNumRecords() || currMovieData.computePrefixHash(stateMovieLength) != stateMovieHash))
+		{
+			FCEU_PrintError("Savestate's movie timeline is not part of the current movie (it was overwritten after the savestate was made).\n");
+			return false;
+		}
+
 		closeRecordingMovie();
 
 		if(!movie_readonly)
 		{
-			currMovieData = tempMovieData;
+			//the savestate's movie is the first stateMovieLength frames of this one
+			if (stateMovieLength >= 0)
+				currMovieData.truncateAt(stateMovieLength);
+			else
+				currMovieData = tempMovieData;
 			currMovieData.rerecordCount = currRerecordCount;
 		}
 
-		if(currFrameCounter > (int)currMovieData.records.size())
+		if(currFrameCounter > currMovieData.getNumRecords())
 		{
 			// if the frame counter is longer than our current movie,
 			// switch to "finished" mode.
@@ -1279,6 +1697,454 @@ void LoadFM2_binarychunk(MovieData &movieData, EMUFILE &fp, int size)
 	}
 }
 
+//----columnar movie files
+
+#define MOVIE_COLUMNAR_FILE_HEADER_SIZE		32
+#define MOVIE_COLUMNAR_INDEX_ENTRY_SIZE		24
+#define MOVIE_COLUMNAR_MAX_FILE_SIZE		0x7FFFFFFF
+
+enum MovieColumnarColumn
+{
+	MOVIECOLUMN_PAD      = 0,
+	MOVIECOLUMN_TOUCH    = 1,
+	MOVIECOLUMN_COMMANDS = 2
+};
+
+u64 MovieRecord_HashStep(u64 hash, const MovieRecord &rec)
+{
+	const u64 value = (u64)rec.pad | ((u64)rec.packTouch() << 16) | ((u64)rec.commands << 48);
+	hash = (hash ^ value) * 0x9E3779B97F4A7C15ULL;
+	return hash ^ (hash >> 29);
+}
+
+static u32 MovieColumnar_Read32(const u8 *p)
+{
+	return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static u64 MovieColumnar_Read64(const u8 *p)
+{
+	return (u64)MovieColumnar_Read32(p) | ((u64)MovieColumnar_Read32(p + 4) << 32);
+}
+
+static bool MovieColumnar_ReadVarint(const u8 *&p, const u8 *end, u32 &outValue)
+{
+	outValue = 0;
+	for (u32 shift = 0; shift < 35; shift += 7)
+	{
+		if (p >= end)
+			return false;
+		
+		const u8 b = *p++;
+		outValue |= (u32)(b & 0x7F) << shift;
+		if ((b & 0x80) == 0)
+			return true;
+	}
+	
+	return false;
+}
+
+static void MovieColumnar_WriteVarint(std::vector<u8> &out, u32 value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((u8)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((u8)value);
+}
+
+static void MovieColumnar_EncodeColumn(std::vector<u8> &out, const u32 *values, u32 count)
+{
+	u32 prevValue = 0;
+	u32 i = 0;
+	
+	while (i < count)
+	{
+		u32 runLength = 1;
+		while ((i + runLength < count) && (values[i + runLength] == values[i]))
+			runLength++;
+		
+		MovieColumnar_WriteVarint(out, runLength);
+		MovieColumnar_WriteVarint(out, values[i] ^ prevValue);
+		prevValue = values[i];
+		i += runLength;
+	}
+}
+
+MovieColumnarFile::MovieColumnarFile()
+{
+	_mappedData = NULL;
+	_mappedSize = 0;
+	_frameCount = 0;
+	_blockFrames = 0;
+	_blockCount = 0;
+	_headerText = NULL;
+	_headerTextSize = 0;
+	_blockIndex = NULL;
+	_decodedBlock = 0xFFFFFFFF;
+	_decodedFrames = 0;
+}
+
+MovieColumnarFile::~MovieColumnarFile()
+{
+	this->_UnmapFile();
+}
+
+MovieColumnarFile* MovieColumnarFile::Open(const char *fname)
+{
+	MovieColumnarFile *file = new MovieColumnarFile;
+	if (!file->_MapFile(fname))
+	{
+		delete file;
+		return NULL;
+	}
+	
+	return file;
+}
+
+bool MovieColumnarFile::_MapFile(const char *fname)
+{
+#ifdef HOST_WINDOWS
+	HANDLE fileHandle = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	
+	LARGE_INTEGER fileSize;
+	if ( !GetFileSizeEx(fileHandle, &fileSize) || (fileSize.QuadPart < MOVIE_COLUMNAR_FILE_HEADER_SIZE) || (fileSize.QuadPart > MOVIE_COLUMNAR_MAX_FILE_SIZE) )
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+	
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(fileHandle);
+	
+	if (mappingHandle == NULL)
+	{
+		return false;
+	}
+	
+	void *mappedData = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mappingHandle);
+	
+	if (mappedData == NULL)
+	{
+		return false;
+	}
+	
+	this->_mappedData = (u8 *)mappedData;
+	this->_mappedSize = (size_t)fileSize.QuadPart;
+#else
+	const int fd = open(fname, O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	
+	struct stat fileStat;
+	if ( (fstat(fd, &fileStat) != 0) || (fileStat.st_size < MOVIE_COLUMNAR_FILE_HEADER_SIZE) || (fileStat.st_size > MOVIE_COLUMNAR_MAX_FILE_SIZE) )
+	{
+		close(fd);
+		return false;
+	}
+	
+	void *mappedData = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	
+	if (mappedData == MAP_FAILED)
+	{
+		return false;
+	}
+	
+	this->_mappedData = (u8 *)mappedData;
+	this->_mappedSize = (size_t)fileStat.st_size;
+#endif
+	
+	//file header: magic, version, frame count, frames per block, block count,
+	//text header offset and size, block index offset
+	const u8 *h = this->_mappedData;
+	const u32 magic = MovieColumnar_Read32(h + 0);
+	const u32 version = MovieColumnar_Read32(h + 4);
+	this->_frameCount = MovieColumnar_Read32(h + 8);
+	this->_blockFrames = MovieColumnar_Read32(h + 12);
+	this->_blockCount = MovieColumnar_Read32(h + 16);
+	const u32 headerTextOffset = MovieColumnar_Read32(h + 20);
+	const u32 headerTextSize = MovieColumnar_Read32(h + 24);
+	const u32 blockIndexOffset = MovieColumnar_Read32(h + 28);
+	
+	const u64 blockIndexSize = (u64)this->_blockCount * MOVIE_COLUMNAR_INDEX_ENTRY_SIZE;
+	
+	if ( (magic != MOVIE_COLUMNAR_MAGIC) ||
+	     (version != MOVIE_COLUMNAR_VERSION) ||
+	     (this->_blockFrames == 0) ||
+	     (this->_blockFrames > MOVIE_COLUMNAR_BLOCK_FRAMES) ||
+	     ((u64)this->_blockCount * this->_blockFrames < this->_frameCount) ||
+	     ((u64)headerTextOffset + headerTextSize > this->_mappedSize) ||
+	     ((u64)blockIndexOffset + blockIndexSize > this->_mappedSize) )
+	{
+		this->_UnmapFile();
+		return false;
+	}
+	
+	this->_headerText = this->_mappedData + headerTextOffset;
+	this->_headerTextSize = headerTextSize;
+	this->_blockIndex = this->_mappedData + blockIndexOffset;
+	
+	//check the column extents up front, so decoding only has to worry about the stream contents
+	for (u32 i = 0; i < this->_blockCount; i++)
+	{
+		const u8 *entry = this->_blockIndex + (i * MOVIE_COLUMNAR_INDEX_ENTRY_SIZE);
+		const u32 padOffset = MovieColumnar_Read32(entry + 8);
+		const u32 touchOffset = MovieColumnar_Read32(entry + 12);
+		const u32 commandsOffset = MovieColumnar_Read32(entry + 16);
+		const u32 endOffset = MovieColumnar_Read32(entry + 20);
+		
+		if ( (padOffset > touchOffset) || (touchOffset > commandsOffset) || (commandsOffset > endOffset) || (endOffset > this->_mappedSize) )
+		{
+			this->_UnmapFile();
+			return false;
+		}
+	}
+	
+	for (size_t c = 0; c < 3; c++)
+		this->_decodedColumn[c].resize(this->_blockFrames);
+	
+	return true;
+}
+
+void MovieColumnarFile::_UnmapFile()
+{
+	if (this->_mappedData == NULL)
+	{
+		return;
+	}
+	
+#ifdef HOST_WINDOWS
+	UnmapViewOfFile(this->_mappedData);
+#else
+	munmap(this->_mappedData, this->_mappedSize);
+#endif
+	
+	this->_mappedData = NULL;
+	this->_mappedSize = 0;
+	this->_decodedBlock = 0xFFFFFFFF;
+}
+
+bool MovieColumnarFile::_DecodeBlock(u32 blockIndex)
+{
+	if (blockIndex == this->_decodedBlock)
+		return true;
+	
+	this->_decodedBlock = 0xFFFFFFFF;
+	
+	const u8 *entry = this->_blockIndex + (blockIndex * MOVIE_COLUMNAR_INDEX_ENTRY_SIZE);
+	const u32 offsets[4] = {
+		MovieColumnar_Read32(entry + 8),
+		MovieColumnar_Read32(entry + 12),
+		MovieColumnar_Read32(entry + 16),
+		MovieColumnar_Read32(entry + 20)
+	};
+	
+	const u32 firstFrame = blockIndex * this->_blockFrames;
+	const u32 frameCount = std::min<u32>(this->_blockFrames, this->_frameCount - firstFrame);
+	
+	for (size_t c = 0; c < 3; c++)
+	{
+		const u8 *p = this->_mappedData + offsets[c];
+		const u8 *end = this->_mappedData + offsets[c + 1];
+		u32 *out = &this->_decodedColumn[c][0];
+		u32 value = 0;
+		u32 i = 0;
+		
+		while (i < frameCount)
+		{
+			u32 runLength;
+			u32 delta;
+			if ( !MovieColumnar_ReadVarint(p, end, runLength) || !MovieColumnar_ReadVarint(p, end, delta) || (runLength == 0) || (runLength > frameCount - i) )
+				return false;
+			
+			value ^= delta;
+			for (u32 j = 0; j < runLength; j++)
+				out[i++] = value;
+		}
+	}
+	
+	this->_decodedBlock = blockIndex;
+	this->_decodedFrames = frameCount;
+	return true;
+}
+
+bool MovieColumnarFile::GetRecord(u32 frame, MovieRecord &outRecord)
+{
+	if (frame >= this->_frameCount || !this->_DecodeBlock(frame / this->_blockFrames))
+	{
+		outRecord.clear();
+		return false;
+	}
+	
+	const u32 i = frame % this->_blockFrames;
+	outRecord.pad = (u16)this->_decodedColumn[MOVIECOLUMN_PAD][i];
+	outRecord.unpackTouch(this->_decodedColumn[MOVIECOLUMN_TOUCH][i]);
+	outRecord.commands = (u8)this->_decodedColumn[MOVIECOLUMN_COMMANDS][i];
+	return true;
+}
+
+u64 MovieColumnarFile::GetPrefixHash(u32 frameCount)
+{
+	frameCount = std::min<u32>(frameCount, this->_frameCount);
+	if (frameCount == 0)
+		return 0;
+	
+	//start from the hash stored for the block the prefix ends in and only walk that block
+	const u32 blockIndex = (frameCount - 1) / this->_blockFrames;
+	u64 hash = MovieColumnar_Read64(this->_blockIndex + (blockIndex * MOVIE_COLUMNAR_INDEX_ENTRY_SIZE));
+	
+	MovieRecord rec;
+	for (u32 i = blockIndex * this->_blockFrames; i < frameCount; i++)
+	{
+		this->GetRecord(i, rec);
+		hash = MovieRecord_HashStep(hash, rec);
+	}
+	
+	return hash;
+}
+
+bool MovieData::dumpColumnar(EMUFILE &fp)
+{
+	EMUFILE_MEMORY headerText;
+	dumpHeader(headerText, false);
+	
+	const u32 frameCount = (u32)getNumRecords();
+	const u32 blockFrames = MOVIE_COLUMNAR_BLOCK_FRAMES;
+	const u32 blockCount = (frameCount + blockFrames - 1) / blockFrames;
+	const u32 headerTextOffset = MOVIE_COLUMNAR_FILE_HEADER_SIZE;
+	const u32 headerTextSize = (u32)headerText.size();
+	const u32 blockIndexOffset = headerTextOffset + headerTextSize;
+	const u32 columnsOffset = blockIndexOffset + (blockCount * MOVIE_COLUMNAR_INDEX_ENTRY_SIZE);
+	
+	std::vector<u8> blockIndex;
+	std::vector<u8> columns;
+	std::vector<u32> values[3];
+	for (size_t c = 0; c < 3; c++)
+		values[c].resize(blockFrames);
+	
+	u64 hash = 0;
+	MovieRecord rec;
+	
+	for (u32 b = 0; b < blockCount; b++)
+	{
+		const u32 firstFrame = b * blockFrames;
+		const u32 count = std::min<u32>(blockFrames, frameCount - firstFrame);
+		u32 offsets[4];
+		
+		//the index stores the hash of everything before the block
+		for (int k = 0; k < 8; k++)
+			blockIndex.push_back((u8)(hash >> (k * 8)));
+		
+		for (u32 i = 0; i < count; i++)
+		{
+			getRecord(firstFrame + i, rec);
+			values[MOVIECOLUMN_PAD][i] = rec.pad;
+			values[MOVIECOLUMN_TOUCH][i] = rec.packTouch();
+			values[MOVIECOLUMN_COMMANDS][i] = rec.commands;
+			hash = MovieRecord_HashStep(hash, rec);
+		}
+		
+		for (size_t c = 0; c < 3; c++)
+		{
+			offsets[c] = columnsOffset + (u32)columns.size();
+			MovieColumnar_EncodeColumn(columns, &values[c][0], count);
+		}
+		offsets[3] = columnsOffset + (u32)columns.size();
+		
+		for (size_t c = 0; c < 4; c++)
+			for (int k = 0; k < 4; k++)
+				blockIndex.push_back((u8)(offsets[c] >> (k * 8)));
+	}
+	
+	fp.write_32LE((u32)MOVIE_COLUMNAR_MAGIC);
+	fp.write_32LE((u32)MOVIE_COLUMNAR_VERSION);
+	fp.write_32LE(frameCount);
+	fp.write_32LE(blockFrames);
+	fp.write_32LE(blockCount);
+	fp.write_32LE(headerTextOffset);
+	fp.write_32LE(headerTextSize);
+	fp.write_32LE(blockIndexOffset);
+	
+	if (headerTextSize != 0)
+		fp.fwrite(headerText.buf(), headerTextSize);
+	if (!blockIndex.empty())
+		fp.fwrite(&blockIndex[0], blockIndex.size());
+	if (!columns.empty())
+		fp.fwrite(&columns[0], columns.size());
+	
+	return !fp.fail();
+}
+
+//opens a columnar movie for playback. the frames stay in the mapped file.
+bool LoadMovieColumnar(MovieData &movieData, const char *fname)
+{
+	MovieColumnarFile *file = MovieColumnarFile::Open(fname);
+	if (file == NULL)
+		return false;
+	
+	std::shared_ptr<MovieColumnarFile> columnar(file);
+	
+	EMUFILE_MEMORY headerText((void *)columnar->GetHeaderText(), (s32)columnar->GetHeaderTextSize());
+	if (!LoadFM2(movieData, headerText, INT_MAX, true))
+		return false;
+	
+	movieData.records.clear();
+	movieData.columnar = columnar;
+	return true;
+}
+
+bool FCEUI_ConvertMovieToColumnar(const char *srcName, const char *dstName)
+{
+	MovieData movieData;
+	
+	if (!LoadMovieColumnar(movieData, srcName))
+	{
+		EMUFILE_FILE src(srcName, "rb");
+		if (src.fail() || !LoadFM2(movieData, src, INT_MAX, false))
+			return false;
+	}
+	
+	// The source may still be mapped, and the destination may be the source itself. Writing
+	// over it in place would pull the frames out from under the mapping, so write the new file
+	// next to it and swap it in afterwards.
+	const std::string tempName = std::string(dstName) + ".tmp";
+	bool didWrite = false;
+	
+	{
+		EMUFILE_FILE dst(tempName.c_str(), "wb");
+		if (dst.fail())
+			return false;
+		
+		didWrite = movieData.dumpColumnar(dst);
+	}
+	
+	movieData.columnar.reset();
+	
+	if (!didWrite)
+	{
+		remove(tempName.c_str());
+		return false;
+	}
+	
+	// Windows won't rename over an existing file.
+	if ( (rename(tempName.c_str(), dstName) != 0) && ((remove(dstName) != 0) || (rename(tempName.c_str(), dstName) != 0)) )
+	{
+		remove(tempName.c_str());
+		return false;
+	}
+	
+	return true;
+}
+
 #include <sstream>
 
 static bool CheckFileExists(const char* filename)
@@ -20,6 +20,7 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 #include <string>
 #include <stdlib.h>
 #include <time.h>
@@ -61,6 +62,16 @@ enum EMOVIEMODE
 	MOVIEMODE_FINISHED = 3
 };
 
+enum EMOVIEVERIFYSTATUS
+{
+	MOVIEVERIFY_INACTIVE = 0,
+	MOVIEVERIFY_WRITING  = 1,
+	MOVIEVERIFY_CHECKING = 2,
+	MOVIEVERIFY_COMPLETE = 3,
+	MOVIEVERIFY_DIVERGED = 4,
+	MOVIEVERIFY_FAILED   = 5
+};
+
 enum EMOVIECMD
 {
 	MOVIECMD_MIC   = 1,
@@ -71,6 +82,7 @@ enum EMOVIECMD
 //RLDUTSBAYXWEG
 
 class MovieData;
+class MovieColumnarFile;
 class MovieRecord
 {
 
@@ -131,6 +143,9 @@ public:
 	void parsePad(EMUFILE &fp, u16 &outPad);
 	void dumpPad(EMUFILE &fp, u16 inPad);
 	
+	u32 packTouch() const { return (u32)touch.x | ((u32)touch.y << 8) | ((u32)touch.touch << 16) | ((u32)touch.micsample << 24); }
+	void unpackTouch(u32 packedTouch) { touch.x = packedTouch & 0xFF; touch.y = (packedTouch >> 8) & 0xFF; touch.touch = (packedTouch >> 16) & 0xFF; touch.micsample = packedTouch >> 24; }
+	
 	static const char mnemonics[13];
 
 private:
@@ -179,7 +194,14 @@ public:
 	int advancedTiming;
 	int jitBlockSize;
 
-	int getNumRecords() { return records.size(); }
+	//when set, the frames are read straight out of a memory-mapped columnar movie file
+	//and records stays empty. anything that edits the movie decodes it into records first.
+	std::shared_ptr<MovieColumnarFile> columnar;
+
+	int getNumRecords() const;
+	bool getRecord(int frame, MovieRecord &outRecord) const;
+	void materializeRecords();
+	u64 computePrefixHash(int frameCount) const;
 
 	class TDictionary : public std::map<std::string,std::string>
 	{
@@ -212,6 +234,8 @@ public:
 	void truncateAt(int frame);
 	void installValue(std::string& key, std::string& val);
 	int dump(EMUFILE &fp, bool binary);
+	int dumpHeader(EMUFILE &fp, bool binary);
+	bool dumpColumnar(EMUFILE &fp);
 	void clearRecordRange(int start, int len);
 	void insertEmpty(int at, int frames);
 	
@@ -251,6 +275,55 @@ private:
 	std::map<std::string, ivm> installValueMap;
 };
 
+//Columnar movie files (.dsmc) hold the same text header as a .dsm file, followed by
+//the pad, touch and command columns split into blocks of MOVIE_COLUMNAR_BLOCK_FRAMES
+//frames. Each column of a block is a run-length list of values XOR'd against the
+//previous run, so a block can be decoded on its own. The block index also stores the
+//movie hash up to the start of each block, which lets savestates refer to a prefix of
+//the movie without walking it.
+#define MOVIE_COLUMNAR_MAGIC			0x434D5344 // "DSMC"
+#define MOVIE_COLUMNAR_VERSION			1
+#define MOVIE_COLUMNAR_BLOCK_FRAMES		4096
+
+class MovieColumnarFile
+{
+private:
+	u8 *_mappedData;
+	size_t _mappedSize;
+	
+	u32 _frameCount;
+	u32 _blockFrames;
+	u32 _blockCount;
+	const u8 *_headerText;
+	u32 _headerTextSize;
+	const u8 *_blockIndex;
+	
+	u32 _decodedBlock;
+	u32 _decodedFrames;
+	std::vector<u32> _decodedColumn[3];
+	
+	MovieColumnarFile();
+	
+	bool _MapFile(const char *fname);
+	void _UnmapFile();
+	bool _DecodeBlock(u32 blockIndex);
+	
+public:
+	~MovieColumnarFile();
+	
+	// Returns NULL if the file can't be mapped or isn't a columnar movie.
+	static MovieColumnarFile* Open(const char *fname);
+	
+	u32 GetFrameCount() const { return this->_frameCount; }
+	const u8* GetHeaderText() const { return this->_headerText; }
+	u32 GetHeaderTextSize() const { return this->_headerTextSize; }
+	
+	bool GetRecord(u32 frame, MovieRecord &outRecord);
+	u64 GetPrefixHash(u32 frameCount);
+};
+
+u64 MovieRecord_HashStep(u64 hash, const MovieRecord &rec);
+
 extern int currFrameCounter;
 extern EMOVIEMODE movieMode;		//adelikat: main needs this for frame counter display
 extern MovieData currMovieData;		//adelikat: main needs this for frame counter display
@@ -270,12 +343,27 @@ void mov_savestate(EMUFILE &fp);
 bool mov_loadstate(EMUFILE &fp, int size);
 void LoadFM2_binarychunk(MovieData& movieData, EMUFILE &fp, int size);
 bool LoadFM2(MovieData &movieData, EMUFILE &fp, int size, bool stopAfterHeader);
+bool LoadMovieColumnar(MovieData &movieData, const char *fname);
+bool FCEUI_ConvertMovieToColumnar(const char *srcName, const char *dstName);
 extern bool movie_readonly;
+extern bool movie_savestate_by_reference;
 extern bool ShowInputDisplay;
 void FCEUI_MakeBackupMovie(bool dispMessage);
 DateTime FCEUI_MovieGetRTCDefault();
 void BinaryDataFromString(std::string &inStringData, std::vector<u8> *outBinaryData);
 void ReplayRecToDesmumeInput(const MovieRecord &inRecord, UserInput &outInput);
+
+//Movie verification. A verification sidecar (.dsmv) is written while a movie plays and holds
+//a hash of the emulator state every hashInterval frames, plus a savestate every segmentLength
+//frames. A later run can start from any segment's savestate and check that segment's hashes,
+//so separate processes can check the segments of one movie in parallel.
+u64 FCEUMOV_ComputeStateHash();
+bool FCEUI_MovieVerifyBeginWrite(const char *sidecarName, int hashInterval, int segmentLength);
+bool FCEUI_MovieVerifyBeginCheck(const char *sidecarName, int firstSegment, int segmentCount);
+int FCEUI_MovieVerifyGetSegmentCount(const char *sidecarName);
+void FCEUI_MovieVerifyStop();
+EMOVIEVERIFYSTATUS FCEUI_MovieVerifyGetStatus();
+int FCEUI_MovieVerifyGetDivergedFrame();
 void DesmumeInputToReplayRec(const UserInput &inInput, MovieRecord &outRecord);
 
 #endif
@@ -311,6 +311,156 @@ FORCEINLINE int edge_fx_fl::Step() {
 	return Height;
 }	
 
+// Vertex data for the fixed-point pipeline. Only used at the native framebuffer size, where
+// every screen coordinate fits comfortably into integer math.
+struct SoftRasterizerFixedVertex
+{
+	s32 x, y;			// Screen position in 28.4 fixed point
+	s32 w;				// W normalized to 16 bits, used for the perspective-correct weights
+	s32 wShift;			// How far w was shifted right to normalize it (negative means left)
+	s64 depth;			// Z-buffer value (only valid when not W-buffering)
+	s32 u, v;			// Texture coordinates in 1/16 texels, the same as the NDS
+	s32 color[3];		// Vertex color in 6.8 fixed point
+};
+
+// Interpolates between two values using a weight of (factor / (1 << shift)). The interpolation
+// always runs from the smaller value to the larger one, so that the result doesn't depend on
+// which edge or span direction the value was reached from.
+static FORCEINLINE s32 SoftRasterizer_InterpolateFixed(const s32 a0, const s32 a1, const s32 factor, const u32 shift)
+{
+	if (a0 <= a1)
+	{
+		return a0 + (s32)( ((s64)(a1 - a0) * factor) >> shift );
+	}
+	
+	return a1 + (s32)( ((s64)(a0 - a1) * ((1 << shift) - factor)) >> shift );
+}
+
+// The NDS calculates its perspective-correct weights using 9 bits of precision along the
+// polygon edges and 8 bits of precision along each span.
+#define SOFTRASTERIZER_FIXED_EDGE_SHIFT 9
+#define SOFTRASTERIZER_FIXED_SPAN_SHIFT 8
+
+struct edge_fx_fx {
+	edge_fx_fx() {}
+	edge_fx_fx(int Top, int Bottom, const SoftRasterizerFixedVertex *verts, bool& failure);
+	FORCEINLINE int Step();
+	FORCEINLINE void Interpolate();
+	
+	const SoftRasterizerFixedVertex *top, *bottom;
+	long X, XStep, Numerator, Denominator;			// DDA info for x
+	long ErrorTerm;
+	int Y, Height;					// current y and vertical count
+	s32 dY;							// edge height in 28.4 fixed point
+	
+	// Attributes at the current y
+	s32 w;
+	s64 depth;
+	s32 u, v;
+	s32 color[3];
+};
+
+FORCEINLINE edge_fx_fx::edge_fx_fx(int Top, int Bottom, const SoftRasterizerFixedVertex *verts, bool& failure) {
+	top = &verts[Top];
+	bottom = &verts[Bottom];
+	Y = Ceil28_4(top->y);
+	int YEnd = Ceil28_4(bottom->y);
+	Height = YEnd - Y;
+	X = Ceil28_4(top->x);
+	int XEnd = Ceil28_4(bottom->x);
+	int Width = XEnd - X; // can be negative
+	dY = bottom->y - top->y;
+	
+	// even if Height == 0, give some info for horizontal line poly
+	if(Height != 0 || Width != 0)
+	{
+		long dN = long(bottom->y - top->y);
+		long dM = long(bottom->x - top->x);
+		if (dN != 0)
+		{
+			long InitialNumerator = (long)(dM*16*Y - dM*top->y + dN*top->x - 1 + dN*16);
+			FloorDivMod(InitialNumerator,dN*16,X,ErrorTerm,failure);
+			FloorDivMod(dM*16,dN*16,XStep,Numerator,failure);
+			Denominator = dN*16;
+		}
+		else
+		{
+			XStep = Width;
+			Numerator = 0;
+			ErrorTerm = 0;
+			Denominator = 1;
+		}
+	}
+	else
+	{
+		// even if Width == 0 && Height == 0, give some info for pixel poly
+		XStep = 1;
+		Numerator = 0;
+		Denominator = 1;
+		ErrorTerm = 0;
+	}
+	
+	Interpolate();
+}
+
+FORCEINLINE void edge_fx_fx::Interpolate() {
+	s32 pos = (Y * 16) - top->y;
+	if (pos <= 0 || dY <= 0)
+	{
+		w = top->w;
+		depth = top->depth;
+		u = top->u;
+		v = top->v;
+		color[0] = top->color[0];
+		color[1] = top->color[1];
+		color[2] = top->color[2];
+		return;
+	}
+	
+	if (pos > dY)
+	{
+		pos = dY;
+	}
+	
+	// Z is interpolated linearly in screen space.
+	depth = top->depth + ((bottom->depth - top->depth) * pos) / dY;
+	
+	if (top->w == bottom->w)
+	{
+		// Both ends have the same w, so perspective correction has no effect.
+		w = top->w;
+		u = top->u + (s32)( ((s64)(bottom->u - top->u) * pos) / dY );
+		v = top->v + (s32)( ((s64)(bottom->v - top->v) * pos) / dY );
+		for (size_t i = 0; i < 3; i++)
+			color[i] = top->color[i] + (s32)( ((s64)(bottom->color[i] - top->color[i]) * pos) / dY );
+		
+		return;
+	}
+	
+	const s64 num = (s64)pos * top->w;
+	const s64 den = num + ((s64)(dY - pos) * bottom->w);
+	const s32 factor = (s32)( (num << SOFTRASTERIZER_FIXED_EDGE_SHIFT) / den );
+	
+	w = (s32)( ((s64)top->w * bottom->w * dY) / den );
+	u = SoftRasterizer_InterpolateFixed(top->u, bottom->u, factor, SOFTRASTERIZER_FIXED_EDGE_SHIFT);
+	v = SoftRasterizer_InterpolateFixed(top->v, bottom->v, factor, SOFTRASTERIZER_FIXED_EDGE_SHIFT);
+	for (size_t i = 0; i < 3; i++)
+		color[i] = SoftRasterizer_InterpolateFixed(top->color[i], bottom->color[i], factor, SOFTRASTERIZER_FIXED_EDGE_SHIFT);
+}
+
+FORCEINLINE int edge_fx_fx::Step() {
+	X += XStep; Y++; Height--;
+	
+	ErrorTerm += Numerator;
+	if(ErrorTerm >= Denominator) {
+		X++;
+		ErrorTerm -= Denominator;
+	}
+	
+	Interpolate();
+	return Height;
+}
+
 
 
 static FORCEINLINE void alphaBlend(const bool isAlphaBlendingEnabled, const FragmentColor inSrc, FragmentColor &outDst)
@@ -363,6 +513,7 @@ Render3DError RasterizerUnit<RENDERER>::_SetupTexture(const POLY &thePoly, size_
 		return RENDER3DERROR_NOERR;
 	}
 	
+	this->_softRender->WaitForTextureLoad(theTexture);
 	this->_textureWrapMode = thePoly.texParam.TextureWrapMode;
 	
 	theTexture->ResetCacheAge();
@@ -415,6 +566,37 @@ FORCEINLINE float RasterizerUnit<RENDERER>::_round_s(double val)
 	}
 }
 
+// Samples the current texture using texture coordinates in 1/16 texels.
+template<bool RENDERER>
+FORCEINLINE FragmentColor RasterizerUnit<RENDERER>::_sampleFixed(const s32 u, const s32 v)
+{
+	// The render size of a texture is always a power-of-two multiple of its actual size.
+	const s32 scaleU = this->_currentTexture->GetRenderWidth()  / (s32)this->_currentTexture->GetWidth();
+	const s32 scaleV = this->_currentTexture->GetRenderHeight() / (s32)this->_currentTexture->GetHeight();
+	s32 iu;
+	s32 iv;
+	
+	if (!this->_softRender->_enableFragmentSamplingHack)
+	{
+		iu = (u * scaleU) >> 4;
+		iv = (v * scaleV) >> 4;
+	}
+	else
+	{
+		// The sampling hack rounds toward zero instead of toward negative infinity.
+		iu = (u * scaleU) / 16;
+		iv = (v * scaleV) / 16;
+	}
+	
+	const u32 *textureData = this->_currentTexture->GetRenderData();
+	this->_currentTexture->GetRenderSamplerCoordinates(this->_textureWrapMode, iu, iv);
+	
+	FragmentColor color;
+	color.color = textureData[( iv << this->_currentTexture->GetRenderWidthShift() ) + iu];
+	
+	return color;
+}
+
 template<bool RENDERER> template<bool ISSHADOWPOLYGON>
 FORCEINLINE void RasterizerUnit<RENDERER>::_shade(const PolygonMode polygonMode, const FragmentColor src, FragmentColor &dst, const float texCoordU, const float texCoordV)
 {
@@ -424,11 +606,23 @@ FORCEINLINE void RasterizerUnit<RENDERER>::_shade(const PolygonMode polygonMode,
 		return;
 	}
 	
-	const GFX3D_State &renderState = *this->_softRender->currentRenderState;
-	
 	static const FragmentColor colorWhite = MakeFragmentColor(0x3F, 0x3F, 0x3F, 0x1F);
 	const FragmentColor mainTexColor = (this->_currentTexture->IsSamplingEnabled()) ? this->_sample(texCoordU, texCoordV) : colorWhite;
 	
+	this->_shadeTexel<ISSHADOWPOLYGON>(polygonMode, src, mainTexColor, dst);
+}
+
+template<bool RENDERER> template<bool ISSHADOWPOLYGON>
+FORCEINLINE void RasterizerUnit<RENDERER>::_shadeTexel(const PolygonMode polygonMode, const FragmentColor src, const FragmentColor mainTexColor, FragmentColor &dst)
+{
+	if (ISSHADOWPOLYGON)
+	{
+		dst = src;
+		return;
+	}
+	
+	const GFX3D_State &renderState = *this->_softRender->currentRenderState;
+	
 	switch (polygonMode)
 	{
 		case POLYGON_MODE_MODULATE:
@@ -777,6 +971,121 @@ FORCEINLINE void RasterizerUnit<RENDERER>::_drawscanline(const POLYGON_ATTR poly
 	}
 }
 
+// Runs the depth test, shading and framebuffer write for a fragment whose color, texel and
+// depth have already been set up.
+template<bool RENDERER> template<bool ISFRONTFACING, bool ISSHADOWPOLYGON>
+FORCEINLINE void RasterizerUnit<RENDERER>::_pixelFragment(const POLYGON_ATTR polyAttr, const bool isTranslucent, const size_t fragmentIndex, FragmentColor &dstColor, const FragmentColor srcColor, const FragmentColor texColor, const u32 newDepth)
+{
+	const GFX3D_State &renderState = *this->_softRender->currentRenderState;
+	FragmentColor shaderOutput;
+	bool isOpaquePixel;
+	
+	u32 &dstAttributeDepth				= this->_softRender->_framebufferAttributes->depth[fragmentIndex];
+	u8 &dstAttributeOpaquePolyID		= this->_softRender->_framebufferAttributes->opaquePolyID[fragmentIndex];
+	u8 &dstAttributeTranslucentPolyID	= this->_softRender->_framebufferAttributes->translucentPolyID[fragmentIndex];
+	u8 &dstAttributeStencil				= this->_softRender->_framebufferAttributes->stencil[fragmentIndex];
+	u8 &dstAttributeIsFogged			= this->_softRender->_framebufferAttributes->isFogged[fragmentIndex];
+	u8 &dstAttributeIsTranslucentPoly	= this->_softRender->_framebufferAttributes->isTranslucentPoly[fragmentIndex];
+	u8 &dstAttributePolyFacing			= this->_softRender->_framebufferAttributes->polyFacing[fragmentIndex];
+	
+	// run the depth test
+	bool depthFail = false;
+	
+	if (polyAttr.DepthEqualTest_Enable)
+	{
+		const u32 minDepth = (u32)max<s32>(0x00000000, (s32)dstAttributeDepth - DEPTH_EQUALS_TEST_TOLERANCE);
+		const u32 maxDepth = min<u32>(0x00FFFFFF, dstAttributeDepth + DEPTH_EQUALS_TEST_TOLERANCE);
+		
+		if (newDepth < minDepth || newDepth > maxDepth)
+		{
+			depthFail = true;
+		}
+	}
+	else if ( (ISFRONTFACING && (dstAttributePolyFacing == PolyFacing_Back)) && (dstColor.a == 0x1F))
+	{
+		if (newDepth > dstAttributeDepth)
+		{
+			depthFail = true;
+		}
+	}
+	else
+	{
+		if (newDepth >= dstAttributeDepth)
+		{
+			depthFail = true;
+		}
+	}
+	
+	if (depthFail)
+	{
+		//shadow mask polygons set stencil bit here
+		if (ISSHADOWPOLYGON && polyAttr.PolygonID == 0)
+			dstAttributeStencil=1;
+		return;
+	}
+	
+	//handle shadow polys
+	if (ISSHADOWPOLYGON)
+	{
+		if (polyAttr.PolygonID == 0)
+		{
+			return;
+		}
+		else
+		{
+			if (dstAttributeStencil == 0)
+			{
+				return;
+			}
+			if (dstAttributeOpaquePolyID == polyAttr.PolygonID)
+			{
+				return;
+			}
+			
+			dstAttributeStencil = 0;
+		}
+	}
+	
+	//pixel shader
+	this->_shadeTexel<ISSHADOWPOLYGON>((PolygonMode)polyAttr.Mode, srcColor, texColor, shaderOutput);
+	
+	// handle alpha test
+	if ( shaderOutput.a == 0 ||
+	    (renderState.DISP3DCNT.EnableAlphaTest && (shaderOutput.a < renderState.alphaTestRef)) )
+	{
+		return;
+	}
+	
+	// write pixel values to the framebuffer
+	isOpaquePixel = (shaderOutput.a == 0x1F);
+	if (isOpaquePixel)
+	{
+		dstAttributeOpaquePolyID = polyAttr.PolygonID;
+		dstAttributeIsTranslucentPoly = isTranslucent;
+		dstAttributeIsFogged = polyAttr.Fog_Enable;
+		dstColor = shaderOutput;
+	}
+	else
+	{
+		//dont overwrite pixels on translucent polys with the same polyids
+		if (dstAttributeTranslucentPolyID == polyAttr.PolygonID)
+			return;
+		
+		dstAttributeTranslucentPolyID = polyAttr.PolygonID;
+		
+		//alpha blending and write color
+		alphaBlend((renderState.DISP3DCNT.EnableAlphaBlending != 0), shaderOutput, dstColor);
+		
+		dstAttributeIsFogged = (dstAttributeIsFogged && polyAttr.Fog_Enable);
+	}
+	
+	dstAttributePolyFacing = (ISFRONTFACING) ? PolyFacing_Front : PolyFacing_Back;
+	
+	//depth writing
+	if (isOpaquePixel || polyAttr.TranslucentDepthWrite_Enable)
+		dstAttributeDepth = newDepth;
+}
+
 #ifdef ENABLE_SSE2
 
 template<bool RENDERER> template<bool ISFRONTFACING, bool ISSHADOWPOLYGON>
@@ -994,10 +1303,447 @@ FORCEINLINE void RasterizerUnit<RENDERER>::_drawscanline_SSE2(const POLYGON_ATTR
 			return;
 		}
 		
-		const __m128 negativeX = _mm_cvtepi32_ps(_mm_set1_epi32(-x));
-		coord = _mm_add_ps(coord, _mm_mul_ps(coord_dx, negativeX));
-		color = _mm_add_ps(color, _mm_mul_ps(color_dx, negativeX));
-		
+		const __m128 negativeX = _mm_cvtepi32_ps(_mm_set1_epi32(-x));
+		coord = _mm_add_ps(coord, _mm_mul_ps(coord_dx, negativeX));
+		color = _mm_add_ps(color, _mm_mul_ps(color_dx, negativeX));
+		
+		adr += -x;
+		width -= -x;
+		x = 0;
+	}
+	if (x+width > framebufferWidth)
+	{
+		if (RENDERER && !USELINEHACK && framebufferWidth == GPU_FRAMEBUFFER_NATIVE_WIDTH)
+		{
+			printf("rasterizer rendering at x=%d! oops!\n",x+width-1);
+			return;
+		}
+		width = framebufferWidth - x;
+	}
+	
+	CACHE_ALIGN float coord_s[4];
+	
+	while (width-- > 0)
+	{
+		_mm_store_ps(coord_s, coord);
+		
+		this->_pixel_SSE2<ISFRONTFACING, ISSHADOWPOLYGON>(polyAttr, isTranslucent, adr, dstColor[adr], color, coord_s[0], coord_s[1], coord_s[2], 1.0f/coord_s[3]);
+		adr++;
+		x++;
+		
+		coord = _mm_add_ps(coord, coord_dx);
+		color = _mm_add_ps(color, color_dx);
+	}
+}
+
+#endif // ENABLE_SSE2
+
+#ifdef SOFTRASTERIZER_SPAN_LANES
+
+#if defined(ENABLE_AVX512_1)
+
+static FORCEINLINE v512s32 __rasterizer_wrap_texcoord_AVX512(v512s32 c, const bool isRepeat, const bool isFlip, const s32 size, const s32 sizemask)
+{
+	if (!isRepeat)
+	{
+		return _mm512_min_epi32( _mm512_max_epi32(c, _mm512_setzero_si512()), _mm512_set1_epi32(sizemask) );
+	}
+	
+	if (!isFlip)
+	{
+		return _mm512_and_si512(c, _mm512_set1_epi32(sizemask));
+	}
+	
+	const v512s32 flipMask = _mm512_set1_epi32((size << 1) - 1);
+	c = _mm512_and_si512(c, flipMask);
+	return _mm512_mask_sub_epi32(c, _mm512_cmpge_epi32_mask(c, _mm512_set1_epi32(size)), flipMask, c);
+}
+
+#else
+
+static FORCEINLINE v256s32 __rasterizer_wrap_texcoord_AVX2(v256s32 c, const bool isRepeat, const bool isFlip, const s32 size, const s32 sizemask)
+{
+	if (!isRepeat)
+	{
+		return _mm256_min_epi32( _mm256_max_epi32(c, _mm256_setzero_si256()), _mm256_set1_epi32(sizemask) );
+	}
+	
+	if (!isFlip)
+	{
+		return _mm256_and_si256(c, _mm256_set1_epi32(sizemask));
+	}
+	
+	const v256s32 flipMask = _mm256_set1_epi32((size << 1) - 1);
+	c = _mm256_and_si256(c, flipMask);
+	return _mm256_blendv_epi8( c, _mm256_sub_epi32(flipMask, c), _mm256_cmpgt_epi32(c, _mm256_set1_epi32(size - 1)) );
+}
+
+#endif
+
+// Computes the depth, vertex color, and texel of a group of fragments. The interpolated
+// values are passed in AoS form in the same order that _drawscanline_SSE2() steps through
+// them, and every conversion here matches the one done by _pixel_SSE2() and _sample(), so
+// that the results are bit-for-bit the same.
+template<bool RENDERER>
+FORCEINLINE void RasterizerUnit<RENDERER>::_setupSpanFragments_AVX2(const size_t fragCount, const float *__restrict coordAoS, const float *__restrict colorAoS, const u8 srcAlpha, u32 *__restrict outDepth, FragmentColor *__restrict outColor, FragmentColor *__restrict outTexel)
+{
+	const GFX3D_State &renderState = *this->_softRender->currentRenderState;
+	const bool isSamplingEnabled = this->_currentTexture->IsSamplingEnabled();
+	const bool useSamplingHack = this->_softRender->_enableFragmentSamplingHack;
+	CACHE_ALIGN float texCoordU[SOFTRASTERIZER_SPAN_LANES];
+	CACHE_ALIGN float texCoordV[SOFTRASTERIZER_SPAN_LANES];
+	
+#if defined(ENABLE_AVX512_1)
+	const v512s32 idx = _mm512_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 44, 48, 52, 56, 60);
+	const __mmask16 laneMask = (__mmask16)((1 << fragCount) - 1);
+	
+	const __m512 u    = _mm512_i32gather_ps(idx, coordAoS + 0, 4);
+	const __m512 v    = _mm512_i32gather_ps(idx, coordAoS + 1, 4);
+	const __m512 z    = _mm512_i32gather_ps(idx, coordAoS + 2, 4);
+	const __m512 invw = _mm512_i32gather_ps(idx, coordAoS + 3, 4);
+	const __m512 w    = _mm512_div_ps(_mm512_set1_ps(1.0f), invw);
+	
+	const v512u32 depth = (renderState.SWAP_BUFFERS.DepthMode) ? _mm512_cvttps_epi32( _mm512_mul_ps(w, _mm512_set1_ps(4096.0f)) ) : _mm512_slli_epi32( _mm512_cvttps_epi32(_mm512_mul_ps(z, _mm512_set1_ps(4194303.0f))), 2 );
+	_mm512_storeu_si512(outDepth, depth);
+	
+	v512u32 color = _mm512_set1_epi32((u32)srcAlpha << 24);
+	for (size_t c = 0; c < 3; c++)
+	{
+		const __m512 colorf = _mm512_max_ps( _mm512_add_ps(_mm512_mul_ps(_mm512_i32gather_ps(idx, colorAoS + c, 4), w), _mm512_set1_ps(0.5f)), _mm512_setzero_ps() );
+		v512u32 colorComponent = _mm512_and_si512(_mm512_cvttps_epi32(colorf), _mm512_set1_epi32(0xFF));
+		colorComponent = _mm512_min_epi32(colorComponent, _mm512_set1_epi32(0x3F));
+		color = _mm512_or_si512( color, _mm512_sll_epi32(colorComponent, _mm_cvtsi32_si128(c * 8)) );
+	}
+	_mm512_storeu_si512(outColor, color);
+	
+	const __m512 tu = _mm512_mul_ps(u, w);
+	const __m512 tv = _mm512_mul_ps(v, w);
+#else
+	const v256s32 idx = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+	const v256s32 laneMask = _mm256_cmpgt_epi32(_mm256_set1_epi32(fragCount), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	
+	const __m256 u    = _mm256_i32gather_ps(coordAoS + 0, idx, 4);
+	const __m256 v    = _mm256_i32gather_ps(coordAoS + 1, idx, 4);
+	const __m256 z    = _mm256_i32gather_ps(coordAoS + 2, idx, 4);
+	const __m256 invw = _mm256_i32gather_ps(coordAoS + 3, idx, 4);
+	const __m256 w    = _mm256_div_ps(_mm256_set1_ps(1.0f), invw);
+	
+	const v256u32 depth = (renderState.SWAP_BUFFERS.DepthMode) ? _mm256_cvttps_epi32( _mm256_mul_ps(w, _mm256_set1_ps(4096.0f)) ) : _mm256_slli_epi32( _mm256_cvttps_epi32(_mm256_mul_ps(z, _mm256_set1_ps(4194303.0f))), 2 );
+	_mm256_store_si256((v256u32 *)outDepth, depth);
+	
+	// _pixel_SSE2() clamps each color component with _mm_min_epu8() before packing it, which
+	// amounts to taking the low byte of the truncated value and then clamping it to 0x3F.
+	v256u32 color = _mm256_set1_epi32((u32)srcAlpha << 24);
+	for (size_t c = 0; c < 3; c++)
+	{
+		const __m256 colorf = _mm256_max_ps( _mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(colorAoS + c, idx, 4), w), _mm256_set1_ps(0.5f)), _mm256_setzero_ps() );
+		v256u32 colorComponent = _mm256_and_si256(_mm256_cvttps_epi32(colorf), _mm256_set1_epi32(0xFF));
+		colorComponent = _mm256_min_epi32(colorComponent, _mm256_set1_epi32(0x3F));
+		color = _mm256_or_si256( color, _mm256_sll_epi32(colorComponent, _mm_cvtsi32_si128(c * 8)) );
+	}
+	_mm256_store_si256((v256u32 *)outColor, color);
+	
+	const __m256 tu = _mm256_mul_ps(u, w);
+	const __m256 tv = _mm256_mul_ps(v, w);
+#endif
+	
+	if (!isSamplingEnabled)
+	{
+		static const FragmentColor colorWhite = MakeFragmentColor(0x3F, 0x3F, 0x3F, 0x1F);
+		for (size_t i = 0; i < SOFTRASTERIZER_SPAN_LANES; i++)
+		{
+			outTexel[i] = colorWhite;
+		}
+		return;
+	}
+	
+	if (useSamplingHack)
+	{
+		// The rounding done by _round_s() goes through double precision, so just sample these one at a time.
+#if defined(ENABLE_AVX512_1)
+		_mm512_storeu_ps(texCoordU, tu);
+		_mm512_storeu_ps(texCoordV, tv);
+#else
+		_mm256_store_ps(texCoordU, tu);
+		_mm256_store_ps(texCoordV, tv);
+#endif
+		for (size_t i = 0; i < fragCount; i++)
+		{
+			outTexel[i] = this->_sample(texCoordU[i], texCoordV[i]);
+		}
+		return;
+	}
+	
+	const u8 wrapMode = this->_textureWrapMode;
+	const s32 renderWidth = this->_currentTexture->GetRenderWidth();
+	const s32 renderHeight = this->_currentTexture->GetRenderHeight();
+	const float scaleWidth = (float)renderWidth;
+	const float scaleHeight = (float)renderHeight;
+	const float texWidth = (float)this->_currentTexture->GetWidth();
+	const float texHeight = (float)this->_currentTexture->GetHeight();
+	const u32 *textureData = this->_currentTexture->GetRenderData();
+	
+	// Same as s32floor(), which rounds (2*f - 0.5) to nearest and then halves the result.
+#if defined(ENABLE_AVX512_1)
+	const __m512 fu = _mm512_div_ps(_mm512_mul_ps(tu, _mm512_set1_ps(scaleWidth)), _mm512_set1_ps(texWidth));
+	const __m512 fv = _mm512_div_ps(_mm512_mul_ps(tv, _mm512_set1_ps(scaleHeight)), _mm512_set1_ps(texHeight));
+	v512s32 iu = _mm512_srai_epi32( _mm512_cvtps_epi32(_mm512_add_ps(_mm512_add_ps(fu, fu), _mm512_set1_ps(-0.5f))), 1 );
+	v512s32 iv = _mm512_srai_epi32( _mm512_cvtps_epi32(_mm512_add_ps(_mm512_add_ps(fv, fv), _mm512_set1_ps(-0.5f))), 1 );
+	
+	iu = __rasterizer_wrap_texcoord_AVX512(iu, (wrapMode & 0x1) != 0, (wrapMode & 0x5) == 0x5, renderWidth, this->_currentTexture->GetRenderWidthMask());
+	iv = __rasterizer_wrap_texcoord_AVX512(iv, (wrapMode & 0x2) != 0, (wrapMode & 0xA) == 0xA, renderHeight, this->_currentTexture->GetRenderHeightMask());
+	
+	const v512s32 texelIndex = _mm512_add_epi32( _mm512_sll_epi32(iv, _mm_cvtsi32_si128(this->_currentTexture->GetRenderWidthShift())), iu );
+	_mm512_storeu_si512( outTexel, _mm512_mask_i32gather_epi32(_mm512_set1_epi32(0), laneMask, texelIndex, textureData, 4) );
+#else
+	const __m256 fu = _mm256_div_ps(_mm256_mul_ps(tu, _mm256_set1_ps(scaleWidth)), _mm256_set1_ps(texWidth));
+	const __m256 fv = _mm256_div_ps(_mm256_mul_ps(tv, _mm256_set1_ps(scaleHeight)), _mm256_set1_ps(texHeight));
+	v256s32 iu = _mm256_srai_epi32( _mm256_cvtps_epi32(_mm256_add_ps(_mm256_add_ps(fu, fu), _mm256_set1_ps(-0.5f))), 1 );
+	v256s32 iv = _mm256_srai_epi32( _mm256_cvtps_epi32(_mm256_add_ps(_mm256_add_ps(fv, fv), _mm256_set1_ps(-0.5f))), 1 );
+	
+	iu = __rasterizer_wrap_texcoord_AVX2(iu, (wrapMode & 0x1) != 0, (wrapMode & 0x5) == 0x5, renderWidth, this->_currentTexture->GetRenderWidthMask());
+	iv = __rasterizer_wrap_texcoord_AVX2(iv, (wrapMode & 0x2) != 0, (wrapMode & 0xA) == 0xA, renderHeight, this->_currentTexture->GetRenderHeightMask());
+	
+	const v256s32 texelIndex = _mm256_add_epi32( _mm256_sll_epi32(iv, _mm_cvtsi32_si128(this->_currentTexture->GetRenderWidthShift())), iu );
+	_mm256_store_si256( (v256u32 *)outTexel, _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int *)textureData, texelIndex, laneMask, 4) );
+#endif
+}
+
+// Runs the LESS/LEQUAL depth test on a group of fragments and returns a bitmask of the
+// fragments that passed. This is only used to skip fragments early -- _pixelFragment() still
+// runs the full depth test on every fragment that is let through.
+template<bool RENDERER> template<bool ISFRONTFACING, bool ISSHADOWPOLYGON>
+FORCEINLINE u32 RasterizerUnit<RENDERER>::_spanDepthPassMask_AVX2(const POLYGON_ATTR polyAttr, const size_t fragmentIndex, const size_t fragCount, const FragmentColor *dstColor, const u32 *newDepth)
+{
+	const u32 laneMask = (u32)((1 << fragCount) - 1);
+	
+	// Shadow mask polygons write to the stencil buffer when the depth test fails, and the
+	// EQUAL depth test has a tolerance window, so leave those for the per-fragment test.
+	if (ISSHADOWPOLYGON || polyAttr.DepthEqualTest_Enable || (fragCount < SOFTRASTERIZER_SPAN_LANES))
+	{
+		return laneMask;
+	}
+	
+	const FragmentAttributesBuffer &dstAttributes = *this->_softRender->_framebufferAttributes;
+	
+#if defined(ENABLE_AVX512_1)
+	const v512u32 newDepthVec = _mm512_loadu_si512(newDepth);
+	const v512u32 dstDepthVec = _mm512_loadu_si512(dstAttributes.depth + fragmentIndex);
+	__mmask16 passMask = _mm512_cmplt_epu32_mask(newDepthVec, dstDepthVec);
+	
+	if (ISFRONTFACING)
+	{
+		const v512u32 dstFacing = _mm512_cvtepu8_epi32( _mm_loadu_si128((v128u8 *)(dstAttributes.polyFacing + fragmentIndex)) );
+		const v512u32 dstAlpha = _mm512_srli_epi32( _mm512_loadu_si512(dstColor + fragmentIndex), 24 );
+		const __mmask16 useLEqual = _mm512_cmpeq_epi32_mask(dstFacing, _mm512_set1_epi32(PolyFacing_Back)) & _mm512_cmpeq_epi32_mask(dstAlpha, _mm512_set1_epi32(0x1F));
+		passMask = (useLEqual & _mm512_cmple_epu32_mask(newDepthVec, dstDepthVec)) | (~useLEqual & passMask);
+	}
+	
+	return (u32)passMask & laneMask;
+#else
+	const v256u32 signBit = _mm256_set1_epi32(0x80000000);
+	const v256s32 newDepthVec = _mm256_xor_si256( _mm256_load_si256((v256u32 *)newDepth), signBit );
+	const v256s32 dstDepthVec = _mm256_xor_si256( _mm256_loadu_si256((v256u32 *)(dstAttributes.depth + fragmentIndex)), signBit );
+	v256u32 passMask = _mm256_cmpgt_epi32(dstDepthVec, newDepthVec);
+	
+	if (ISFRONTFACING)
+	{
+		const v256u32 dstFacing = _mm256_cvtepu8_epi32( _mm_loadl_epi64((v128u8 *)(dstAttributes.polyFacing + fragmentIndex)) );
+		const v256u32 dstAlpha = _mm256_srli_epi32( _mm256_loadu_si256((v256u32 *)(dstColor + fragmentIndex)), 24 );
+		const v256u32 useLEqual = _mm256_and_si256( _mm256_cmpeq_epi32(dstFacing, _mm256_set1_epi32(PolyFacing_Back)), _mm256_cmpeq_epi32(dstAlpha, _mm256_set1_epi32(0x1F)) );
+		const v256u32 passLEqual = _mm256_xor_si256( _mm256_cmpgt_epi32(newDepthVec, dstDepthVec), _mm256_set1_epi32(0xFFFFFFFF) );
+		passMask = _mm256_blendv_epi8(passMask, passLEqual, useLEqual);
+	}
+	
+	return (u32)_mm256_movemask_ps(_mm256_castsi256_ps(passMask)) & laneMask;
+#endif
+}
+
+//draws a single scanline, setting up SOFTRASTERIZER_SPAN_LANES fragments at a time
+template<bool RENDERER> template<bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK>
+FORCEINLINE void RasterizerUnit<RENDERER>::_drawscanline_AVX2(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, edge_fx_fl *pLeft, edge_fx_fl *pRight)
+{
+	const int XStart = pLeft->X;
+	int width = pRight->X - XStart;
+	
+	// HACK: workaround for vertical/slant line poly
+	if (USELINEHACK && width == 0)
+	{
+		int leftWidth = pLeft->XStep;
+		if (pLeft->ErrorTerm + pLeft->Numerator >= pLeft->Denominator)
+			leftWidth++;
+		int rightWidth = pRight->XStep;
+		if (pRight->ErrorTerm + pRight->Numerator >= pRight->Denominator)
+			rightWidth++;
+		width = max(1, max(abs(leftWidth), abs(rightWidth)));
+	}
+	
+	//these are the starting values, taken from the left edge
+	__m128 coord = _mm_setr_ps(pLeft->u.curr,
+							   pLeft->v.curr,
+							   pLeft->z.curr,
+							   pLeft->invw.curr);
+	
+	__m128 color = _mm_setr_ps(pLeft->color[0].curr,
+							   pLeft->color[1].curr,
+							   pLeft->color[2].curr,
+							   (float)polyAttr.Alpha / 31.0f);
+	
+	//our dx values are taken from the steps up until the right edge
+	const __m128 invWidth = _mm_set1_ps(1.0f / (float)width);
+	const __m128 coord_dx = _mm_mul_ps(_mm_setr_ps(pRight->u.curr - pLeft->u.curr, pRight->v.curr - pLeft->v.curr, pRight->z.curr - pLeft->z.curr, pRight->invw.curr - pLeft->invw.curr), invWidth);
+	const __m128 color_dx = _mm_mul_ps(_mm_setr_ps(pRight->color[0].curr - pLeft->color[0].curr, pRight->color[1].curr - pLeft->color[1].curr, pRight->color[2].curr - pLeft->color[2].curr, 0.0f), invWidth);
+	
+	size_t adr = (pLeft->Y*framebufferWidth)+XStart;
+	
+	//CONSIDER: in case some other math is wrong (shouldve been clipped OK), we might go out of bounds here.
+	//better check the Y value.
+	if (RENDERER && (pLeft->Y < 0 || pLeft->Y > (framebufferHeight - 1)))
+	{
+		printf("rasterizer rendering at y=%d! oops!\n",pLeft->Y);
+		return;
+	}
+	if (!RENDERER && (pLeft->Y < 0 || pLeft->Y >= framebufferHeight))
+	{
+		printf("rasterizer rendering at y=%d! oops!\n",pLeft->Y);
+		return;
+	}
+	
+	int x = XStart;
+	
+	if (x < 0)
+	{
+		if (RENDERER && !USELINEHACK)
+		{
+			printf("rasterizer rendering at x=%d! oops!\n",x);
+			return;
+		}
+		
+		const __m128 negativeX = _mm_cvtepi32_ps(_mm_set1_epi32(-x));
+		coord = _mm_add_ps(coord, _mm_mul_ps(coord_dx, negativeX));
+		color = _mm_add_ps(color, _mm_mul_ps(color_dx, negativeX));
+		
+		adr += -x;
+		width -= -x;
+		x = 0;
+	}
+	if (x+width > framebufferWidth)
+	{
+		if (RENDERER && !USELINEHACK && framebufferWidth == GPU_FRAMEBUFFER_NATIVE_WIDTH)
+		{
+			printf("rasterizer rendering at x=%d! oops!\n",x+width-1);
+			return;
+		}
+		width = framebufferWidth - x;
+	}
+	
+	if (width <= 0)
+	{
+		return;
+	}
+	
+	// The alpha never changes across the scanline, so convert it once in the same way as _pixel_SSE2().
+	v128s32 cvtAlpha = _mm_cvttps_epi32( _mm_max_ps(_mm_add_ps(_mm_mul_ps(color, _mm_set1_ps(31.0f)), _mm_set1_ps(0.5f)), _mm_setzero_ps()) );
+	cvtAlpha = _mm_min_epu8(cvtAlpha, _mm_set1_epi32(0x1F));
+	const u8 srcAlpha = (u8)_mm_extract_epi16(cvtAlpha, 6);
+	
+	CACHE_ALIGN float coordAoS[SOFTRASTERIZER_SPAN_LANES * 4];
+	CACHE_ALIGN float colorAoS[SOFTRASTERIZER_SPAN_LANES * 4];
+	CACHE_ALIGN u32 fragDepth[SOFTRASTERIZER_SPAN_LANES];
+	CACHE_ALIGN FragmentColor fragColor[SOFTRASTERIZER_SPAN_LANES];
+	CACHE_ALIGN FragmentColor fragTexel[SOFTRASTERIZER_SPAN_LANES];
+	memset(coordAoS, 0, sizeof(coordAoS));
+	memset(colorAoS, 0, sizeof(colorAoS));
+	
+	while (width > 0)
+	{
+		const size_t fragCount = min<size_t>(width, SOFTRASTERIZER_SPAN_LANES);
+		
+		// Step the interpolants one fragment at a time, exactly like _drawscanline_SSE2() does,
+		// so that every fragment sees the same rounding as it would in the 1-wide loop.
+		for (size_t i = 0; i < fragCount; i++)
+		{
+			_mm_store_ps(coordAoS + (i * 4), coord);
+			_mm_store_ps(colorAoS + (i * 4), color);
+			coord = _mm_add_ps(coord, coord_dx);
+			color = _mm_add_ps(color, color_dx);
+		}
+		
+		this->_setupSpanFragments_AVX2(fragCount, coordAoS, colorAoS, srcAlpha, fragDepth, fragColor, fragTexel);
+		
+		const u32 passMask = this->_spanDepthPassMask_AVX2<ISFRONTFACING, ISSHADOWPOLYGON>(polyAttr, adr, fragCount, dstColor, fragDepth);
+		for (size_t i = 0; i < fragCount; i++)
+		{
+			if ( (passMask & (1 << i)) != 0 )
+			{
+				this->_pixelFragment<ISFRONTFACING, ISSHADOWPOLYGON>(polyAttr, isTranslucent, adr + i, dstColor[adr + i], fragColor[i], fragTexel[i], fragDepth[i]);
+			}
+		}
+		
+		adr += fragCount;
+		width -= (int)fragCount;
+	}
+}
+
+#endif // SOFTRASTERIZER_SPAN_LANES
+
+//draws a single scanline using only integer math
+template<bool RENDERER> template<bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK>
+FORCEINLINE void RasterizerUnit<RENDERER>::_drawscanline_fixed(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, edge_fx_fx *pLeft, edge_fx_fx *pRight)
+{
+	static const FragmentColor colorWhite = MakeFragmentColor(0x3F, 0x3F, 0x3F, 0x1F);
+	const GFX3D_State &renderState = *this->_softRender->currentRenderState;
+	const bool isWBuffer = (renderState.SWAP_BUFFERS.DepthMode != 0);
+	const bool isSamplingEnabled = !ISSHADOWPOLYGON && this->_currentTexture->IsSamplingEnabled();
+	
+	const int XStart = pLeft->X;
+	int width = pRight->X - XStart;
+
+	// HACK: workaround for vertical/slant line poly
+	if (USELINEHACK && width == 0)
+	{
+		int leftWidth = pLeft->XStep;
+		if (pLeft->ErrorTerm + pLeft->Numerator >= pLeft->Denominator)
+			leftWidth++;
+		int rightWidth = pRight->XStep;
+		if (pRight->ErrorTerm + pRight->Numerator >= pRight->Denominator)
+			rightWidth++;
+		width = max(1, max(abs(leftWidth), abs(rightWidth)));
+	}
+	
+	if (width <= 0)
+	{
+		return;
+	}
+	
+	// The attributes are spread across the whole span, even the parts that get clipped.
+	const s32 spanWidth = width;
+
+	size_t adr = (pLeft->Y*framebufferWidth)+XStart;
+
+	if (RENDERER && (pLeft->Y < 0 || pLeft->Y > (framebufferHeight - 1)))
+	{
+		printf("rasterizer rendering at y=%d! oops!\n",pLeft->Y);
+		return;
+	}
+	if (!RENDERER && (pLeft->Y < 0 || pLeft->Y >= framebufferHeight))
+	{
+		printf("rasterizer rendering at y=%d! oops!\n",pLeft->Y);
+		return;
+	}
+
+	int x = XStart;
+	s32 pos = 0;
+
+	if (x < 0)
+	{
+		if (RENDERER && !USELINEHACK)
+		{
+			printf("rasterizer rendering at x=%d! oops!\n",x);
+			return;
+		}
+		
+		pos = -x;
 		adr += -x;
 		width -= -x;
 		x = 0;
@@ -1012,26 +1758,98 @@ FORCEINLINE void RasterizerUnit<RENDERER>::_drawscanline_SSE2(const POLYGON_ATTR
 		width = framebufferWidth - x;
 	}
 	
-	CACHE_ALIGN float coord_s[4];
+	// Values that change linearly across the span are stepped in 16.16 fixed point.
+	const s64 depthStep = ((pRight->depth - pLeft->depth) * 0x10000) / spanWidth;
+	s64 depth = (pLeft->depth << 16) + (depthStep * pos);
+	
+	const bool isLinear = (pLeft->w == pRight->w);
+	const s32 wShift = pLeft->top->wShift;
+	s64 linearStep[5] = {0, 0, 0, 0, 0};
+	s64 linearValue[5] = {0, 0, 0, 0, 0};
+	
+	if (isLinear)
+	{
+		const s32 attrLeft[5]  = { pLeft->u,  pLeft->v,  pLeft->color[0],  pLeft->color[1],  pLeft->color[2]  };
+		const s32 attrRight[5] = { pRight->u, pRight->v, pRight->color[0], pRight->color[1], pRight->color[2] };
+		
+		for (size_t i = 0; i < 5; i++)
+		{
+			linearStep[i] = ((s64)(attrRight[i] - attrLeft[i]) * 0x10000) / spanWidth;
+			linearValue[i] = ((s64)attrLeft[i] * 0x10000) + (linearStep[i] * pos);
+		}
+	}
 	
 	while (width-- > 0)
 	{
-		_mm_store_ps(coord_s, coord);
+		s32 u, v, r, g, b;
+		s32 w = pLeft->w;
 		
-		this->_pixel_SSE2<ISFRONTFACING, ISSHADOWPOLYGON>(polyAttr, isTranslucent, adr, dstColor[adr], color, coord_s[0], coord_s[1], coord_s[2], 1.0f/coord_s[3]);
-		adr++;
-		x++;
+		if (isLinear)
+		{
+			u = (s32)(linearValue[0] >> 16);
+			v = (s32)(linearValue[1] >> 16);
+			r = (s32)(linearValue[2] >> 16);
+			g = (s32)(linearValue[3] >> 16);
+			b = (s32)(linearValue[4] >> 16);
+			
+			for (size_t i = 0; i < 5; i++)
+				linearValue[i] += linearStep[i];
+		}
+		else
+		{
+			const s64 num = (s64)pos * pLeft->w;
+			const s64 den = num + ((s64)(spanWidth - pos) * pRight->w);
+			const s32 factor = (s32)( (num << SOFTRASTERIZER_FIXED_SPAN_SHIFT) / den );
+			
+			u = SoftRasterizer_InterpolateFixed(pLeft->u, pRight->u, factor, SOFTRASTERIZER_FIXED_SPAN_SHIFT);
+			v = SoftRasterizer_InterpolateFixed(pLeft->v, pRight->v, factor, SOFTRASTERIZER_FIXED_SPAN_SHIFT);
+			r = SoftRasterizer_InterpolateFixed(pLeft->color[0], pRight->color[0], factor, SOFTRASTERIZER_FIXED_SPAN_SHIFT);
+			g = SoftRasterizer_InterpolateFixed(pLeft->color[1], pRight->color[1], factor, SOFTRASTERIZER_FIXED_SPAN_SHIFT);
+			b = SoftRasterizer_InterpolateFixed(pLeft->color[2], pRight->color[2], factor, SOFTRASTERIZER_FIXED_SPAN_SHIFT);
+			
+			if (isWBuffer)
+			{
+				w = (s32)( ((s64)pLeft->w * pRight->w * spanWidth) / den );
+			}
+		}
 		
-		coord = _mm_add_ps(coord, coord_dx);
-		color = _mm_add_ps(color, color_dx);
+		// W-buffer values are w in 20.12 fixed point, so undo the normalization first.
+		const u32 newDepth = (isWBuffer) ? (u32)( (wShift >= 0) ? ((s64)w << wShift) : ((s64)w >> -wShift) ) : (u32)(depth >> 16);
+		
+		const FragmentColor srcColor = MakeFragmentColor((u8)max<s32>(0x00, min<s32>(0x3F, (r + 0x80) >> 8)),
+		                                                 (u8)max<s32>(0x00, min<s32>(0x3F, (g + 0x80) >> 8)),
+		                                                 (u8)max<s32>(0x00, min<s32>(0x3F, (b + 0x80) >> 8)),
+		                                                 polyAttr.Alpha);
+		const FragmentColor texColor = (isSamplingEnabled) ? this->_sampleFixed(u, v) : colorWhite;
+		
+		this->_pixelFragment<ISFRONTFACING, ISSHADOWPOLYGON>(polyAttr, isTranslucent, adr, dstColor[adr], srcColor, texColor, newDepth);
+		adr++;
+		pos++;
+		depth += depthStep;
 	}
 }
 
-#endif // ENABLE_SSE2
+template<bool RENDERER> template<bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK>
+FORCEINLINE void RasterizerUnit<RENDERER>::_drawscanline_select(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, edge_fx_fl *pLeft, edge_fx_fl *pRight)
+{
+#if defined(SOFTRASTERIZER_SPAN_LANES)
+	this->_drawscanline_AVX2<ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, pLeft, pRight);
+#elif defined(ENABLE_SSE2)
+	this->_drawscanline_SSE2<ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, pLeft, pRight);
+#else
+	this->_drawscanline<ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, pLeft, pRight);
+#endif
+}
+
+template<bool RENDERER> template<bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK>
+FORCEINLINE void RasterizerUnit<RENDERER>::_drawscanline_select(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, edge_fx_fx *pLeft, edge_fx_fx *pRight)
+{
+	this->_drawscanline_fixed<ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, pLeft, pRight);
+}
 
 //runs several scanlines, until an edge is finished
-template<bool RENDERER> template<bool SLI, bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK>
-void RasterizerUnit<RENDERER>::_runscanlines(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, const bool isHorizontal, edge_fx_fl *left, edge_fx_fl *right)
+template<bool RENDERER> template<bool SLI, bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK, typename EDGETYPE>
+void RasterizerUnit<RENDERER>::_runscanlines(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, const bool isHorizontal, EDGETYPE *left, EDGETYPE *right)
 {
 	//oh lord, hack city for edge drawing
 
@@ -1045,11 +1863,7 @@ void RasterizerUnit<RENDERER>::_runscanlines(const POLYGON_ATTR polyAttr, const
 		const bool draw = ( !SLI || ((left->Y >= this->_SLI_startLine) && (left->Y < this->_SLI_endLine)) );
 		if (draw)
 		{
-#ifdef ENABLE_SSE2
-			this->_drawscanline_SSE2<ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, left, right);
-#else
-			this->_drawscanline<ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, left, right);
-#endif
+			this->_drawscanline_select<ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, left, right);
 		}
 	}
 
@@ -1058,11 +1872,7 @@ void RasterizerUnit<RENDERER>::_runscanlines(const POLYGON_ATTR polyAttr, const
 		const bool draw = ( !SLI || ((left->Y >= this->_SLI_startLine) && (left->Y < this->_SLI_endLine)) );
 		if (draw)
 		{
-#ifdef ENABLE_SSE2
-			this->_drawscanline_SSE2<ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, left, right);
-#else
-			this->_drawscanline<ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, left, right);
-#endif
+			this->_drawscanline_select<ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, left, right);
 		}
 		
 		const int xl = left->X;
@@ -1185,15 +1995,63 @@ void RasterizerUnit<RENDERER>::_sort_verts()
 	
 }
 
+// Converts the sorted vertices of the current polygon for the fixed-point pipeline.
+template<bool RENDERER>
+void RasterizerUnit<RENDERER>::_setupFixedVertices(SoftRasterizerFixedVertex *fixedVerts, const int type)
+{
+	const bool isWBuffer = (this->_softRender->currentRenderState->SWAP_BUFFERS.DepthMode != 0);
+	s64 wList[MAX_CLIPPED_VERTS];
+	s64 wMax = 1;
+	
+	for (int i = 0; i < type; i++)
+	{
+		// W is 20.12 fixed point on the NDS.
+		wList[i] = (s64)(this->_verts[i]->coord[3] * 4096.0f);
+		if (wList[i] < 1)
+		{
+			wList[i] = 1;
+		}
+		
+		wMax = max<s64>(wMax, wList[i]);
+	}
+	
+	// Like the NDS, normalize w across the whole polygon so that the largest w has 16 bits.
+	s32 wShift = 0;
+	while ( (wMax >> wShift) > 0xFFFF )
+	{
+		wShift++;
+	}
+	while ( (wShift > -16) && ((wMax << -wShift) < 0x8000) )
+	{
+		wShift--;
+	}
+	
+	for (int i = 0; i < type; i++)
+	{
+		const VERT &vert = *this->_verts[i];
+		SoftRasterizerFixedVertex &fv = fixedVerts[i];
+		
+		fv.x = (s32)vert.x;
+		fv.y = (s32)vert.y;
+		fv.w = (s32)( (wShift >= 0) ? (wList[i] >> wShift) : (wList[i] << -wShift) );
+		fv.w = max<s32>(1, fv.w);
+		fv.wShift = wShift;
+		fv.depth = (isWBuffer) ? 0 : (s64)(u32floor(vert.z * 4194303.0f) << 2);
+		fv.u = s32floor(vert.u * 16.0f);
+		fv.v = s32floor(vert.v * 16.0f);
+		fv.color[0] = s32floor(vert.fcolor[0] * 256.0f);
+		fv.color[1] = s32floor(vert.fcolor[1] * 256.0f);
+		fv.color[2] = s32floor(vert.fcolor[2] * 256.0f);
+	}
+}
+
 //This function can handle any convex N-gon up to octagons
 //verts must be clockwise.
 //I didnt reference anything for this algorithm but it seems like I've seen it somewhere before.
 //Maybe it is like crow's algorithm
-template<bool RENDERER> template<bool SLI, bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK>
+template<bool RENDERER> template<bool SLI, bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK, bool FIXEDPOINT>
 void RasterizerUnit<RENDERER>::_shape_engine(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, int type)
 {
-	bool failure = false;
-
 	switch (type)
 	{
 		case 3: this->_sort_verts<ISFRONTFACING, 3>(); break;
@@ -1206,6 +2064,23 @@ void RasterizerUnit<RENDERER>::_shape_engine(const POLYGON_ATTR polyAttr, const
 		case 10: this->_sort_verts<ISFRONTFACING, 10>(); break;
 		default: printf("skipping type %d\n", type); return;
 	}
+	
+	if (FIXEDPOINT)
+	{
+		SoftRasterizerFixedVertex fixedVerts[MAX_CLIPPED_VERTS];
+		this->_setupFixedVertices(fixedVerts, type);
+		this->_walk_edges<SLI, ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK, edge_fx_fx>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, (const SoftRasterizerFixedVertex *)fixedVerts, type);
+	}
+	else
+	{
+		this->_walk_edges<SLI, ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK, edge_fx_fl>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, (VERT **)&this->_verts, type);
+	}
+}
+
+template<bool RENDERER> template<bool SLI, bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK, typename EDGETYPE, typename VERTLIST>
+void RasterizerUnit<RENDERER>::_walk_edges(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, VERTLIST verts, int type)
+{
+	bool failure = false;
 
 	//we are going to step around the polygon in both directions starting from vert 0.
 	//right edges will be stepped over clockwise and left edges stepped over counterclockwise.
@@ -1213,7 +2088,7 @@ void RasterizerUnit<RENDERER>::_shape_engine(const POLYGON_ATTR polyAttr, const
 	//for the counter we're decrementing.
 	int lv = type, rv = 0;
 
-	edge_fx_fl left, right;
+	EDGETYPE left, right;
 	bool step_left = true, step_right = true;
 	for (;;)
 	{
@@ -1221,8 +2096,8 @@ void RasterizerUnit<RENDERER>::_shape_engine(const POLYGON_ATTR polyAttr, const
 		//so that they can be continued on down the shape
 		assert(rv != type);
 		int _lv = (lv == type) ? 0 : lv; //make sure that we ask for vert 0 when the variable contains the starting value
-		if (step_left) left = edge_fx_fl(_lv,lv-1,(VERT**)&this->_verts, failure);
-		if (step_right) right = edge_fx_fl(rv,rv+1,(VERT**)&this->_verts, failure);
+		if (step_left) left = EDGETYPE(_lv,lv-1,verts, failure);
+		if (step_right) right = EDGETYPE(rv,rv+1,verts, failure);
 		step_left = step_right = false;
 
 		//handle a failure in the edge setup due to nutty polys
@@ -1230,7 +2105,7 @@ void RasterizerUnit<RENDERER>::_shape_engine(const POLYGON_ATTR polyAttr, const
 			return;
 
 		const bool isHorizontal = (left.Y == right.Y);
-		this->_runscanlines<SLI, ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, isHorizontal, &left, &right);
+		this->_runscanlines<SLI, ISFRONTFACING, ISSHADOWPOLYGON, USELINEHACK, EDGETYPE>(polyAttr, isTranslucent, dstColor, framebufferWidth, framebufferHeight, isHorizontal, &left, &right);
 		
 		//if we ran out of an edge, step to the next one
 		if (right.Height == 0)
@@ -1263,7 +2138,7 @@ void RasterizerUnit<RENDERER>::SetRenderer(SoftRasterizerRenderer *theRenderer)
 	this->_softRender = theRenderer;
 }
 
-template<bool RENDERER> template <bool SLI, bool USELINEHACK>
+template<bool RENDERER> template <bool SLI, bool USELINEHACK, bool FIXEDPOINT>
 FORCEINLINE void RasterizerUnit<RENDERER>::Render()
 {
 	const size_t polyCount = this->_softRender->GetClippedPolyCount();
@@ -1317,22 +2192,22 @@ FORCEINLINE void RasterizerUnit<RENDERER>::Render()
 			{
 				if (useLineHack)
 				{
-					this->_shape_engine<SLI, true, true, true>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
+					this->_shape_engine<SLI, true, true, true, FIXEDPOINT>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
 				}
 				else
 				{
-					this->_shape_engine<SLI, true, true, false>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
+					this->_shape_engine<SLI, true, true, false, FIXEDPOINT>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
 				}
 			}
 			else
 			{
 				if (useLineHack)
 				{
-					this->_shape_engine<SLI, true, false, true>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
+					this->_shape_engine<SLI, true, false, true, FIXEDPOINT>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
 				}
 				else
 				{
-					this->_shape_engine<SLI, true, false, false>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
+					this->_shape_engine<SLI, true, false, false, FIXEDPOINT>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
 				}
 			}
 		}
@@ -1342,42 +2217,46 @@ FORCEINLINE void RasterizerUnit<RENDERER>::Render()
 			{
 				if (useLineHack)
 				{
-					this->_shape_engine<SLI, false, true, true>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
+					this->_shape_engine<SLI, false, true, true, FIXEDPOINT>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
 				}
 				else
 				{
-					this->_shape_engine<SLI, false, true, false>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
+					this->_shape_engine<SLI, false, true, false, FIXEDPOINT>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
 				}
 			}
 			else
 			{
 				if (useLineHack)
 				{
-					this->_shape_engine<SLI, false, false, true>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
+					this->_shape_engine<SLI, false, false, true, FIXEDPOINT>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
 				}
 				else
 				{
-					this->_shape_engine<SLI, false, false, false>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
+					this->_shape_engine<SLI, false, false, false, FIXEDPOINT>(polyAttr, isTranslucent, dstColor, dstWidth, dstHeight, vertCount);
 				}
 			}
 		}
 	}
+	
+	// Textures of polygons that never reached this thread's lines may still be queued.
+	// Make sure that they're all loaded by the time the rasterizer threads finish.
+	this->_softRender->LoadQueuedTextures();
 }
 
 template <bool USELINEHACK>
 void* _HACK_Viewer_ExecUnit(void *arg)
 {
 	RasterizerUnit<false> *unit = (RasterizerUnit<false> *)arg;
-	unit->Render<false, USELINEHACK>();
+	unit->Render<false, USELINEHACK, false>();
 	
 	return 0;
 }
 
-template <bool USELINEHACK>
+template <bool USELINEHACK, bool FIXEDPOINT>
 void* SoftRasterizer_RunRasterizerUnit(void *arg)
 {
 	RasterizerUnit<true> *unit = (RasterizerUnit<true> *)arg;
-	unit->Render<true, USELINEHACK>();
+	unit->Render<true, USELINEHACK, FIXEDPOINT>();
 	
 	return 0;
 }
@@ -1437,6 +2316,14 @@ static Render3D* SoftRasterizerRendererCreate()
 #endif
 }
 
+static Render3D* SoftRasterizerRendererCreateFixedPoint()
+{
+	SoftRasterizerRenderer *newRenderer = (SoftRasterizerRenderer *)SoftRasterizerRendererCreate();
+	newRenderer->SetFixedPointPipelineEnabled(true);
+	
+	return newRenderer;
+}
+
 static void SoftRasterizerRendererDestroy()
 {
 	if (CurrentRenderer != BaseRenderer)
@@ -1474,6 +2361,9 @@ SoftRasterizerTexture::SoftRasterizerTexture(TEXIMAGE_PARAM texAttributes, u32 p
 	
 	_deposterizeSrcSurface.Surface = (unsigned char *)_unpackData;
 	
+	_loadClaimCount = 0;
+	_isLoadPending = 0;
+	
 	u32 tempWidth = _renderWidth;
 	while ( (tempWidth & 1) == 0)
 	{
@@ -1548,6 +2438,21 @@ void SoftRasterizerTexture::Load()
 		
 		this->Unpack<TexFormat_32bpp>(textureSrc);
 		
+		// Deposterizing and upscaling are expensive, so try to get the finished texture
+		// from the disk cache first.
+		const bool useDiskCache = textureDiskCache.IsOpen();
+		TextureDiskCacheKey diskCacheKey;
+		
+		if (useDiskCache)
+		{
+			diskCacheKey = TextureDiskCache::MakeKey(this->_unpackData, this->_sizeS * this->_sizeT, this->_sizeS, this->_sizeT, this->_packFormat, this->_scalingFactor, this->_useDeposterize);
+			if (textureDiskCache.Read(diskCacheKey, this->_renderWidth, this->_renderHeight, this->_renderData))
+			{
+				this->_isLoadNeeded = false;
+				return;
+			}
+		}
+		
 		if (this->_useDeposterize)
 		{
 			RenderDeposterize(this->_deposterizeSrcSurface, this->_deposterizeDstSurface);
@@ -1569,6 +2474,11 @@ void SoftRasterizerTexture::Load()
 		}
 		
 		ColorspaceConvertBuffer8888To6665<false, false>(this->_renderData, this->_renderData, this->_renderWidth * this->_renderHeight);
+		
+		if (useDiskCache)
+		{
+			textureDiskCache.Write(diskCacheKey, this->_renderWidth, this->_renderHeight, this->_renderData);
+		}
 	}
 	
 	this->_isLoadNeeded = false;
@@ -1716,12 +2626,39 @@ void SoftRasterizerTexture::SetScalingFactor(size_t scalingFactor)
 	}
 }
 
+void SoftRasterizerTexture::QueueLoad()
+{
+	this->_loadClaimCount = 0;
+	atomic_add_barrier32(&this->_isLoadPending, 1);
+}
+
+bool SoftRasterizerTexture::IsLoadPending() const
+{
+	return (atomic_add_barrier32((volatile s32 *)&this->_isLoadPending, 0) != 0);
+}
+
+bool SoftRasterizerTexture::ClaimLoad()
+{
+	return (atomic_inc_barrier32(&this->_loadClaimCount) == 1);
+}
+
+void SoftRasterizerTexture::FinishLoad()
+{
+	atomic_and_barrier32(&this->_isLoadPending, 0);
+}
+
 GPU3DInterface gpu3DRasterize = {
 	"SoftRasterizer",
 	SoftRasterizerRendererCreate,
 	SoftRasterizerRendererDestroy
 };
 
+GPU3DInterface gpu3DRasterizeFixedPoint = {
+	"SoftRasterizer (Fixed Point)",
+	SoftRasterizerRendererCreateFixedPoint,
+	SoftRasterizerRendererDestroy
+};
+
 SoftRasterizerRenderer::SoftRasterizerRenderer()
 {
 	_deviceInfo.renderID = RENDERID_SOFTRASTERIZER;
@@ -1742,6 +2679,18 @@ SoftRasterizerRenderer::SoftRasterizerRenderer()
 	_renderGeometryNeedsFinish = false;
 	_framebufferAttributes = NULL;
 	
+	_frameFingerprint = 0;
+	_isFrameFingerprintValid = false;
+	_identicalFrameHitCount = 0;
+	
+	_textureLoadQueueCount = 0;
+	_textureLoadQueueNext = 0;
+	_textureLoadMutex = slock_new();
+	_textureLoadCondDone = scond_new();
+	
+	_enableFixedPointPipeline = false;
+	_isFixedPointPipelineActive = false;
+	
 	_enableHighPrecisionColorInterpolation = CommonSettings.GFX3D_HighResolutionInterpolateColor;
 	_enableLineHack = CommonSettings.GFX3D_LineHack;
 	_enableFragmentSamplingHack = CommonSettings.GFX3D_TXTHack;
@@ -1848,6 +2797,9 @@ SoftRasterizerRenderer::~SoftRasterizerRenderer()
 	
 	free_aligned(this->_clippedPolyList);
 	this->_clippedPolyList = NULL;
+	
+	scond_free(this->_textureLoadCondDone);
+	slock_free(this->_textureLoadMutex);
 }
 
 void SoftRasterizerRenderer::__InitTables()
@@ -1901,18 +2853,24 @@ void SoftRasterizerRenderer::_TransformVertices()
 			vert.coord[0] = (vert.coord[0]+vertw) / (2*vertw);
 			vert.coord[1] = (vert.coord[1]+vertw) / (2*vertw);
 			vert.coord[2] = (vert.coord[2]+vertw) / (2*vertw);
-			vert.texcoord[0] /= vertw;
-			vert.texcoord[1] /= vertw;
 			
 			//CONSIDER: do we need to guarantee that these are in bounds? perhaps not.
 			//vert.coord[0] = max(0.0f,min(1.0f,vert.coord[0]));
 			//vert.coord[1] = max(0.0f,min(1.0f,vert.coord[1]));
 			//vert.coord[2] = max(0.0f,min(1.0f,vert.coord[2]));
 			
-			//perspective-correct the colors
-			vert.fcolor[0] /= vertw;
-			vert.fcolor[1] /= vertw;
-			vert.fcolor[2] /= vertw;
+			// The fixed-point pipeline does its own perspective correction from w, so it
+			// needs the texture coordinates and colors as they are.
+			if (!this->_isFixedPointPipelineActive)
+			{
+				vert.texcoord[0] /= vertw;
+				vert.texcoord[1] /= vertw;
+				
+				//perspective-correct the colors
+				vert.fcolor[0] /= vertw;
+				vert.fcolor[1] /= vertw;
+				vert.fcolor[2] /= vertw;
+			}
 			
 			//viewport transformation
 			vert.coord[0] *= poly.poly->viewport.width;
@@ -1979,6 +2937,9 @@ void SoftRasterizerRenderer::_GetPolygonStates()
 
 void SoftRasterizerRenderer::GetAndLoadAllTextures()
 {
+	this->_textureLoadQueueCount = 0;
+	this->_textureLoadQueueNext = 0;
+	
 	for (size_t i = 0; i < this->_clippedPolyCount; i++)
 	{
 		const CPoly &clippedPoly = this->_clippedPolyList[i];
@@ -1998,12 +2959,119 @@ void SoftRasterizerRenderer::ProcessAllVertices()
 	this->_GetPolygonStates();
 }
 
+static FORCEINLINE void SoftRasterizer_FingerprintAdd(u64 &h, const u64 value)
+{
+	h ^= value;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 32;
+}
+
+static FORCEINLINE void SoftRasterizer_FingerprintAddBuffer(u64 &h, const void *buffer, const size_t len)
+{
+	const u8 *src = (const u8 *)buffer;
+	size_t i = 0;
+	
+	for (; i + sizeof(u64) <= len; i += sizeof(u64))
+	{
+		u64 value;
+		memcpy(&value, src + i, sizeof(u64));
+		SoftRasterizer_FingerprintAdd(h, value);
+	}
+	
+	for (; i < len; i++)
+	{
+		SoftRasterizer_FingerprintAdd(h, src[i]);
+	}
+}
+
+u64 SoftRasterizerRenderer::_ComputeFrameFingerprint(const GFX3D_State &renderState, const GFX3D_GeometryList &renderGList) const
+{
+	u64 h = 0xCBF29CE484222325ULL;
+	
+	// Renderer settings and framebuffer geometry
+	SoftRasterizer_FingerprintAdd(h, this->_framebufferWidth);
+	SoftRasterizer_FingerprintAdd(h, this->_framebufferHeight);
+	SoftRasterizer_FingerprintAdd(h, this->_outputFormat);
+	SoftRasterizer_FingerprintAdd(h, this->_textureScalingFactor);
+	SoftRasterizer_FingerprintAdd(h, (u64)this->_debug_drawClippedUserPoly);
+	SoftRasterizer_FingerprintAdd(h, ((u64)this->_enableEdgeMark                         <<  0) |
+	                                 ((u64)this->_enableFog                              <<  1) |
+	                                 ((u64)this->_enableTextureSampling                  <<  2) |
+	                                 ((u64)this->_enableTextureDeposterize               <<  3) |
+	                                 ((u64)this->_enableTextureSmoothing                 <<  4) |
+	                                 ((u64)this->_enableHighPrecisionColorInterpolation  <<  5) |
+	                                 ((u64)this->_enableLineHack                         <<  6) |
+	                                 ((u64)this->_enableFragmentSamplingHack             <<  7) );
+	
+	// Render states, including the clear values and the toon, fog and edge mark tables
+	SoftRasterizer_FingerprintAdd(h, renderState.DISP3DCNT.value);
+	SoftRasterizer_FingerprintAdd(h, ((u64)renderState.fogShift << 8) | (u64)renderState.alphaTestRef);
+	SoftRasterizer_FingerprintAdd(h, ((u64)renderState.clearColor << 32) | (u64)renderState.clearDepth);
+	SoftRasterizer_FingerprintAdd(h, renderState.clearImageOffset.value);
+	SoftRasterizer_FingerprintAdd(h, ((u64)renderState.fogColor << 32) | (u64)renderState.fogOffset);
+	SoftRasterizer_FingerprintAdd(h, renderState.SWAP_BUFFERS.value);
+	SoftRasterizer_FingerprintAddBuffer(h, renderState.edgeMarkColorTable, sizeof(renderState.edgeMarkColorTable));
+	SoftRasterizer_FingerprintAddBuffer(h, renderState.fogDensityTable, sizeof(renderState.fogDensityTable));
+	SoftRasterizer_FingerprintAddBuffer(h, renderState.toonTable16, sizeof(renderState.toonTable16));
+	
+	// Texture and palette memory, which also holds the rear-plane clear image. Texture
+	// banks can only change while mapped elsewhere, so the slot mappings together with the
+	// write generations of their VRAM pages cover every texel that this frame could read.
+	for (size_t i = 0; i < 4; i++)
+	{
+		const size_t lcdOffset = (size_t)(MMU.texInfo.textureSlotAddr[i] - MMU.ARM9_LCD);
+		SoftRasterizer_FingerprintAdd(h, lcdOffset);
+		
+		for (size_t page = (lcdOffset >> 14); page < (lcdOffset >> 14) + 8; page++)
+		{
+			SoftRasterizer_FingerprintAdd(h, MMU.VRAMPageGeneration[page]);
+		}
+	}
+	
+	for (size_t i = 0; i < 6; i++)
+	{
+		const size_t lcdOffset = (size_t)(MMU.texInfo.texPalSlot[i] - MMU.ARM9_LCD);
+		SoftRasterizer_FingerprintAdd(h, lcdOffset);
+		SoftRasterizer_FingerprintAdd(h, MMU.VRAMPageGeneration[lcdOffset >> 14]);
+	}
+	
+	// Clipped polygon list
+	SoftRasterizer_FingerprintAdd(h, renderGList.clippedPolyCount);
+	SoftRasterizer_FingerprintAdd(h, renderGList.clippedPolyOpaqueCount);
+	
+	for (size_t i = 0; i < renderGList.clippedPolyCount; i++)
+	{
+		const CPoly &clippedPoly = renderGList.clippedPolyList[i];
+		const POLY &thePoly = *clippedPoly.poly;
+		
+		SoftRasterizer_FingerprintAdd(h, ((u64)clippedPoly.index << 32) | (u64)clippedPoly.type);
+		SoftRasterizer_FingerprintAdd(h, ((u64)thePoly.type << 32) | (u64)thePoly.vtxFormat);
+		SoftRasterizer_FingerprintAdd(h, ((u64)thePoly.attribute.value << 32) | (u64)thePoly.texParam.value);
+		SoftRasterizer_FingerprintAdd(h, thePoly.texPalette);
+		SoftRasterizer_FingerprintAdd(h, thePoly.viewport.value);
+		
+		for (size_t j = 0; j < (size_t)clippedPoly.type; j++)
+		{
+			// Only hash the components that the rasterizer reads, since the padding may be stale.
+			const VERT &vert = clippedPoly.clipVerts[j];
+			SoftRasterizer_FingerprintAddBuffer(h, vert.coord, sizeof(vert.coord));
+			SoftRasterizer_FingerprintAddBuffer(h, vert.texcoord, sizeof(float) * 2);
+			SoftRasterizer_FingerprintAddBuffer(h, vert.fcolor, sizeof(float) * 3);
+			SoftRasterizer_FingerprintAdd(h, vert.color32 & LE_TO_LOCAL_32(0x00FFFFFF));
+		}
+	}
+	
+	return h;
+}
+
 Render3DError SoftRasterizerRenderer::ApplyRenderingSettings(const GFX3D_State &renderState)
 {
 	this->_enableHighPrecisionColorInterpolation = CommonSettings.GFX3D_HighResolutionInterpolateColor;
 	this->_enableLineHack = CommonSettings.GFX3D_LineHack;
 	this->_enableFragmentSamplingHack = CommonSettings.GFX3D_TXTHack;
 	
+	textureDiskCache.SetDirectory(CommonSettings.GFX3D_Renderer_TextureDiskCachePath);
+	
 	return Render3D::ApplyRenderingSettings(renderState);
 }
 
@@ -2021,6 +3089,10 @@ Render3DError SoftRasterizerRenderer::BeginRender(const GFX3D_State &renderState
 	this->_clippedPolyOpaqueCount = renderGList.clippedPolyOpaqueCount;
 	memcpy(this->_clippedPolyList, renderGList.clippedPolyList, this->_clippedPolyCount * sizeof(CPoly));
 	
+	this->_isFixedPointPipelineActive = this->_enableFixedPointPipeline &&
+	                                    (this->_framebufferWidth == GPU_FRAMEBUFFER_NATIVE_WIDTH) &&
+	                                    (this->_framebufferHeight == GPU_FRAMEBUFFER_NATIVE_HEIGHT);
+	
 	const bool doMultithreadedStateSetup = (this->_threadCount >= 2);
 	
 	if (doMultithreadedStateSetup)
@@ -2056,38 +3128,72 @@ Render3DError SoftRasterizerRenderer::BeginRender(const GFX3D_State &renderState
 	return RENDER3DERROR_NOERR;
 }
 
+Render3DError SoftRasterizerRenderer::Render(const GFX3D_State &renderState, const GFX3D_GeometryList &renderGList)
+{
+	// If the previous frame never went through RenderFinish(), then its post-processing was
+	// skipped and the framebuffers can't be reused.
+	if (this->_renderGeometryNeedsFinish)
+	{
+		this->_isFrameFingerprintValid = false;
+	}
+	
+	// Make sure that no thread is still touching the framebuffers from the previous frame.
+	for (size_t i = 0; i < this->_threadCount; i++)
+	{
+		this->_task[i].finish();
+	}
+	
+	// With 888 output, RenderFlush() converts the color buffer to 8888 in place, since it is
+	// shared with the GPU. The buffer no longer holds the 6665 result, so it can't be reused.
+	const bool canReuseFrame = (this->_outputFormat != NDSColorFormat_BGR888_Rev);
+	const u64 fingerprint = (canReuseFrame) ? this->_ComputeFrameFingerprint(renderState, renderGList) : 0;
+	
+	// If the renderer was powered off, then the framebuffers no longer hold the last frame.
+	if (canReuseFrame && this->_isPoweredOn && this->_isFrameFingerprintValid && (fingerprint == this->_frameFingerprint))
+	{
+		// Nothing that feeds the rasterizer has changed since the last frame, so the color
+		// and attribute buffers already hold the result. Just let RenderFinish() flush them.
+		this->currentRenderState = (GFX3D_State *)&renderState;
+		this->_renderGeometryNeedsFinish = false;
+		this->_identicalFrameHitCount++;
+		
+		return RENDER3DERROR_NOERR;
+	}
+	
+	const Render3DError error = Render3D::Render(renderState, renderGList);
+	
+	this->_frameFingerprint = fingerprint;
+	this->_isFrameFingerprintValid = canReuseFrame && (error == RENDER3DERROR_NOERR);
+	
+	return error;
+}
+
 Render3DError SoftRasterizerRenderer::RenderGeometry()
 {
+	Task::TWork runRasterizerUnit = NULL;
+	
+	if (this->_isFixedPointPipelineActive)
+	{
+		runRasterizerUnit = (this->_enableLineHack) ? &SoftRasterizer_RunRasterizerUnit<true, true> : &SoftRasterizer_RunRasterizerUnit<false, true>;
+	}
+	else
+	{
+		runRasterizerUnit = (this->_enableLineHack) ? &SoftRasterizer_RunRasterizerUnit<true, false> : &SoftRasterizer_RunRasterizerUnit<false, false>;
+	}
+	
 	// Render the geometry
 	if (this->_threadCount > 0)
 	{
-		if (this->_enableLineHack)
-		{
-			for (size_t i = 0; i < this->_threadCount; i++)
-			{
-				this->_task[i].execute(&SoftRasterizer_RunRasterizerUnit<true>, &this->_rasterizerUnit[i]);
-			}
-		}
-		else
+		for (size_t i = 0; i < this->_threadCount; i++)
 		{
-			for (size_t i = 0; i < this->_threadCount; i++)
-			{
-				this->_task[i].execute(&SoftRasterizer_RunRasterizerUnit<false>, &this->_rasterizerUnit[i]);
-			}
+			this->_task[i].execute(runRasterizerUnit, &this->_rasterizerUnit[i]);
 		}
 		
 		this->_renderGeometryNeedsFinish = true;
 	}
 	else
 	{
-		if (this->_enableLineHack)
-		{
-			SoftRasterizer_RunRasterizerUnit<true>(&this->_rasterizerUnit[0]);
-		}
-		else
-		{
-			SoftRasterizer_RunRasterizerUnit<false>(&this->_rasterizerUnit[0]);
-		}
+		runRasterizerUnit(&this->_rasterizerUnit[0]);
 		
 		this->_renderGeometryNeedsFinish = false;
 		texCache.Evict(); // Since we're finishing geometry rendering here and now, also check the texture cache now.
@@ -2287,16 +3393,99 @@ SoftRasterizerTexture* SoftRasterizerRenderer::GetLoadedTextureFromPolygon(const
 	
 	theTexture->SetSamplingEnabled(isTextureEnabled);
 	
-	if (theTexture->IsLoadNeeded() && isTextureEnabled)
+	if (theTexture->IsLoadNeeded() && isTextureEnabled && !theTexture->IsLoadPending())
 	{
 		theTexture->SetUseDeposterize(this->_enableTextureDeposterize);
 		theTexture->SetScalingFactor(this->_textureScalingFactor);
-		theTexture->Load();
+		
+		if (packFormat == TEXMODE_4X4)
+		{
+			// 4x4 textures read their palette straight out of VRAM while unpacking. The
+			// rasterizer threads keep running while the next frame is emulated, so unpack
+			// these now, before the game gets a chance to rewrite the palette.
+			theTexture->Load();
+		}
+		else
+		{
+			// Don't unpack the texture here. The texture cache lookup has to stay on one thread,
+			// but the unpacking itself is left to the rasterizer threads. Every other format
+			// already holds a copy of its texels and palette.
+			theTexture->QueueLoad();
+			this->_textureLoadQueue[this->_textureLoadQueueCount++] = theTexture;
+		}
 	}
 	
 	return theTexture;
 }
 
+bool SoftRasterizerRenderer::LoadNextQueuedTexture()
+{
+	if ((size_t)atomic_add_barrier32(&this->_textureLoadQueueNext, 0) >= this->_textureLoadQueueCount)
+	{
+		return false;
+	}
+	
+	const size_t queueIndex = (size_t)atomic_inc_barrier32(&this->_textureLoadQueueNext) - 1;
+	if (queueIndex >= this->_textureLoadQueueCount)
+	{
+		return false;
+	}
+	
+	SoftRasterizerTexture *theTexture = this->_textureLoadQueue[queueIndex];
+	if (theTexture->ClaimLoad())
+	{
+		this->_LoadClaimedTexture(theTexture);
+	}
+	
+	return true;
+}
+
+void SoftRasterizerRenderer::_LoadClaimedTexture(SoftRasterizerTexture *theTexture)
+{
+	theTexture->Load();
+	
+	slock_lock(this->_textureLoadMutex);
+	theTexture->FinishLoad();
+	scond_broadcast(this->_textureLoadCondDone);
+	slock_unlock(this->_textureLoadMutex);
+}
+
+void SoftRasterizerRenderer::LoadQueuedTextures()
+{
+	while (this->LoadNextQueuedTexture())
+	{
+		// Keep going until every queued texture has been handed out.
+	}
+}
+
+void SoftRasterizerRenderer::WaitForTextureLoad(SoftRasterizerTexture *theTexture)
+{
+	if (!theTexture->IsLoadPending())
+	{
+		return;
+	}
+	
+	if (theTexture->ClaimLoad())
+	{
+		this->_LoadClaimedTexture(theTexture);
+		return;
+	}
+	
+	// Another thread is already unpacking this texture. Rather than sitting idle,
+	// help out with the rest of the queue while waiting for it.
+	while (theTexture->IsLoadPending() && this->LoadNextQueuedTexture())
+	{
+		// Keep going until either the texture is done or the queue runs dry.
+	}
+	
+	slock_lock(this->_textureLoadMutex);
+	while (theTexture->IsLoadPending())
+	{
+		scond_wait(this->_textureLoadCondDone, this->_textureLoadMutex);
+	}
+	slock_unlock(this->_textureLoadMutex);
+}
+
 Render3DError SoftRasterizerRenderer::ClearUsingImage(const u16 *__restrict colorBuffer, const u32 *__restrict depthBuffer, const u8 *__restrict fogBuffer, const u8 opaquePolyID)
 {
 	const size_t xRatio = (size_t)((GPU_FRAMEBUFFER_NATIVE_WIDTH << 16) / this->_framebufferWidth) + 1;
@@ -2371,6 +3560,7 @@ Render3DError SoftRasterizerRenderer::Reset()
 	}
 	
 	this->_renderGeometryNeedsFinish = false;
+	this->_isFrameFingerprintValid = false;
 	
 	texCache.Reset();
 	
@@ -2466,6 +3656,7 @@ Render3DError SoftRasterizerRenderer::SetFramebufferSize(size_t w, size_t h)
 	
 	delete this->_framebufferAttributes;
 	this->_framebufferAttributes = new FragmentAttributesBuffer(w * h);
+	this->_isFrameFingerprintValid = false;
 	
 	const size_t pixCount = (this->_framebufferSIMDPixCount > 0) ? this->_framebufferSIMDPixCount : this->_framebufferPixCount;
 	
@@ -2502,6 +3693,28 @@ Render3DError SoftRasterizerRenderer::SetFramebufferSize(size_t w, size_t h)
 	return RENDER3DERROR_NOERR;
 }
 
+size_t SoftRasterizerRenderer::GetIdenticalFrameHitCount() const
+{
+	return this->_identicalFrameHitCount;
+}
+
+void SoftRasterizerRenderer::ResetIdenticalFrameHitCount()
+{
+	this->_identicalFrameHitCount = 0;
+}
+
+void SoftRasterizerRenderer::SetFixedPointPipelineEnabled(bool enable)
+{
+	this->_enableFixedPointPipeline = enable;
+	this->_deviceInfo.renderID = (enable) ? RENDERID_SOFTRASTERIZER_FIXEDPOINT : RENDERID_SOFTRASTERIZER;
+	this->_deviceInfo.renderName = (enable) ? "SoftRasterizer (Fixed Point)" : "SoftRasterizer";
+}
+
+bool SoftRasterizerRenderer::IsFixedPointPipelineEnabled() const
+{
+	return this->_enableFixedPointPipeline;
+}
+
 #if defined(ENABLE_AVX) || defined(ENABLE_SSE2) || defined(ENABLE_NEON_A64) || defined(ENABLE_ALTIVEC)
 
 template <size_t SIMDBYTES>
@@ -2574,6 +3787,7 @@ Render3DError SoftRasterizer_SIMD<SIMDBYTES>::SetFramebufferSize(size_t w, size_
 	
 	delete this->_framebufferAttributes;
 	this->_framebufferAttributes = new FragmentAttributesBuffer(w * h);
+	this->_isFrameFingerprintValid = false;
 	
 	const size_t pixCount = (this->_framebufferSIMDPixCount > 0) ? this->_framebufferSIMDPixCount : this->_framebufferPixCount;
 	
@@ -18,17 +18,29 @@
 #ifndef _RASTERIZE_H_
 #define _RASTERIZE_H_
 
+#include <rthreads/rthreads.h>
+
 #include "render3D.h"
 #include "gfx3d.h"
 
 
 #define SOFTRASTERIZER_MAX_THREADS 32
 
+// Number of fragments that the SIMD scanline path sets up at once.
+#if defined(ENABLE_AVX512_1)
+	#define SOFTRASTERIZER_SPAN_LANES 16
+#elif defined(ENABLE_AVX2)
+	#define SOFTRASTERIZER_SPAN_LANES 8
+#endif
+
 extern GPU3DInterface gpu3DRasterize;
+extern GPU3DInterface gpu3DRasterizeFixedPoint;
 
 class Task;
 class SoftRasterizerRenderer;
 struct edge_fx_fl;
+struct edge_fx_fx;
+struct SoftRasterizerFixedVertex;
 
 struct SoftRasterizerClearParam
 {
@@ -72,6 +84,9 @@ protected:
 	s32 _renderHeightMask;
 	u32 _renderWidthShift;
 	
+	volatile s32 _loadClaimCount;
+	volatile s32 _isLoadPending;
+	
 public:
 	SoftRasterizerTexture(TEXIMAGE_PARAM texAttributes, u32 palAttributes);
 	virtual ~SoftRasterizerTexture();
@@ -91,6 +106,12 @@ public:
 	
 	void SetUseDeposterize(bool willDeposterize);
 	void SetScalingFactor(size_t scalingFactor);
+	
+	// A texture queued for loading is unpacked by whichever rasterizer thread claims it first.
+	void QueueLoad();
+	bool IsLoadPending() const;
+	bool ClaimLoad();
+	void FinishLoad();
 };
 
 template <bool RENDERER>
@@ -109,26 +130,40 @@ protected:
 	
 	Render3DError _SetupTexture(const POLY &thePoly, size_t polyRenderIndex);
 	FORCEINLINE FragmentColor _sample(const float u, const float v);
+	FORCEINLINE FragmentColor _sampleFixed(const s32 u, const s32 v);
 	FORCEINLINE float _round_s(double val);
 	
 	template<bool ISSHADOWPOLYGON> FORCEINLINE void _shade(const PolygonMode polygonMode, const FragmentColor src, FragmentColor &dst, const float texCoordU, const float texCoordV);
+	template<bool ISSHADOWPOLYGON> FORCEINLINE void _shadeTexel(const PolygonMode polygonMode, const FragmentColor src, const FragmentColor mainTexColor, FragmentColor &dst);
 	template<bool ISFRONTFACING, bool ISSHADOWPOLYGON> FORCEINLINE void _pixel(const POLYGON_ATTR polyAttr, const bool isTranslucent, const size_t fragmentIndex, FragmentColor &dstColor, float r, float g, float b, float invu, float invv, float z, float w);
+	template<bool ISFRONTFACING, bool ISSHADOWPOLYGON> FORCEINLINE void _pixelFragment(const POLYGON_ATTR polyAttr, const bool isTranslucent, const size_t fragmentIndex, FragmentColor &dstColor, const FragmentColor srcColor, const FragmentColor texColor, const u32 newDepth);
 	template<bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK> FORCEINLINE void _drawscanline(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, edge_fx_fl *pLeft, edge_fx_fl *pRight);
-	template<bool SLI, bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK> void _runscanlines(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, const bool isHorizontal, edge_fx_fl *left, edge_fx_fl *right);
+	template<bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK> FORCEINLINE void _drawscanline_fixed(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, edge_fx_fx *pLeft, edge_fx_fx *pRight);
+	template<bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK> FORCEINLINE void _drawscanline_select(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, edge_fx_fl *pLeft, edge_fx_fl *pRight);
+	template<bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK> FORCEINLINE void _drawscanline_select(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, edge_fx_fx *pLeft, edge_fx_fx *pRight);
+	template<bool SLI, bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK, typename EDGETYPE> void _runscanlines(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, const bool isHorizontal, EDGETYPE *left, EDGETYPE *right);
 	
 #ifdef ENABLE_SSE2
 	template<bool ISFRONTFACING, bool ISSHADOWPOLYGON> FORCEINLINE void _pixel_SSE2(const POLYGON_ATTR polyAttr, const bool isTranslucent, const size_t fragmentIndex, FragmentColor &dstColor, const __m128 &srcColorf, float invu, float invv, float z, float w);
 	template<bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK> FORCEINLINE void _drawscanline_SSE2(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, edge_fx_fl *pLeft, edge_fx_fl *pRight);
 #endif
 	
+#ifdef SOFTRASTERIZER_SPAN_LANES
+	FORCEINLINE void _setupSpanFragments_AVX2(const size_t fragCount, const float *__restrict coordAoS, const float *__restrict colorAoS, const u8 srcAlpha, u32 *__restrict outDepth, FragmentColor *__restrict outColor, FragmentColor *__restrict outTexel);
+	template<bool ISFRONTFACING, bool ISSHADOWPOLYGON> FORCEINLINE u32 _spanDepthPassMask_AVX2(const POLYGON_ATTR polyAttr, const size_t fragmentIndex, const size_t fragCount, const FragmentColor *dstColor, const u32 *newDepth);
+	template<bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK> FORCEINLINE void _drawscanline_AVX2(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, edge_fx_fl *pLeft, edge_fx_fl *pRight);
+#endif
+	
 	template<int TYPE> FORCEINLINE void _rot_verts();
 	template<bool ISFRONTFACING, int TYPE> void _sort_verts();
-	template<bool SLI, bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK> void _shape_engine(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, int type);
+	void _setupFixedVertices(SoftRasterizerFixedVertex *fixedVerts, const int type);
+	template<bool SLI, bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK, typename EDGETYPE, typename VERTLIST> void _walk_edges(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, VERTLIST verts, int type);
+	template<bool SLI, bool ISFRONTFACING, bool ISSHADOWPOLYGON, bool USELINEHACK, bool FIXEDPOINT> void _shape_engine(const POLYGON_ATTR polyAttr, const bool isTranslucent, FragmentColor *dstColor, const size_t framebufferWidth, const size_t framebufferHeight, int type);
 	
 public:
 	void SetSLI(u32 startLine, u32 endLine, bool debug);
 	void SetRenderer(SoftRasterizerRenderer *theRenderer);
-	template<bool SLI, bool USELINEHACK> FORCEINLINE void Render();
+	template<bool SLI, bool USELINEHACK, bool FIXEDPOINT> FORCEINLINE void Render();
 };
 
 #if defined(ENABLE_AVX2)
@@ -166,14 +201,35 @@ protected:
 	
 	bool _renderGeometryNeedsFinish;
 	
+	// Textures that need unpacking for the current frame. The rasterizer threads pull jobs
+	// from this list, so polygons whose textures are already loaded can be drawn right away.
+	SoftRasterizerTexture *_textureLoadQueue[POLYLIST_SIZE];
+	size_t _textureLoadQueueCount;
+	volatile s32 _textureLoadQueueNext;
+	slock_t *_textureLoadMutex;
+	scond_t *_textureLoadCondDone;
+	
 	bool _enableHighPrecisionColorInterpolation;
 	bool _enableLineHack;
 	
+	// The fixed-point pipeline only runs at the native framebuffer size. At any other size,
+	// the renderer falls back to the floating-point pipeline.
+	bool _enableFixedPointPipeline;
+	bool _isFixedPointPipelineActive;
+	
+	// Fingerprint of everything that went into the last rendered frame. If the next frame
+	// produces the same fingerprint, the existing color and attribute buffers are reused.
+	u64 _frameFingerprint;
+	bool _isFrameFingerprintValid;
+	size_t _identicalFrameHitCount;
+	
 	// SoftRasterizer-specific methods
 	void _UpdateEdgeMarkColorTable(const u16 *edgeMarkColorTable);
 	void _UpdateFogTable(const u8 *fogDensityTable);
 	void _TransformVertices();
 	void _GetPolygonStates();
+	u64 _ComputeFrameFingerprint(const GFX3D_State &renderState, const GFX3D_GeometryList &renderGList) const;
+	void _LoadClaimedTexture(SoftRasterizerTexture *theTexture);
 	
 	// Base rendering methods
 	virtual Render3DError BeginRender(const GFX3D_State &renderState, const GFX3D_GeometryList &renderGList);
@@ -203,14 +259,24 @@ public:
 	Render3DError RenderEdgeMarkingAndFog(const SoftRasterizerPostProcessParams &param);
 	
 	SoftRasterizerTexture* GetLoadedTextureFromPolygon(const POLY &thePoly, bool enableTexturing);
+	bool LoadNextQueuedTexture();
+	void LoadQueuedTextures();
+	void WaitForTextureLoad(SoftRasterizerTexture *theTexture);
 	
 	// Base rendering methods
 	virtual Render3DError Reset();
 	virtual Render3DError ApplyRenderingSettings(const GFX3D_State &renderState);
+	virtual Render3DError Render(const GFX3D_State &renderState, const GFX3D_GeometryList &renderGList);
 	virtual Render3DError RenderFinish();
 	virtual Render3DError RenderFlush(bool willFlushBuffer32, bool willFlushBuffer16);
 	virtual void ClearUsingValues_Execute(const size_t startPixel, const size_t endPixel);
 	virtual Render3DError SetFramebufferSize(size_t w, size_t h);
+	
+	size_t GetIdenticalFrameHitCount() const;
+	void ResetIdenticalFrameHitCount();
+	
+	void SetFixedPointPipelineEnabled(bool enable);
+	bool IsFixedPointPipelineEnabled() const;
 };
 
 template <size_t SIMDBYTES>
@@ -60,6 +60,7 @@ enum RendererID
 {
 	RENDERID_NULL				= 0,
 	RENDERID_SOFTRASTERIZER		= 1,
+	RENDERID_SOFTRASTERIZER_FIXEDPOINT	= 2,
 	RENDERID_OPENGL_AUTO		= 1000,
 	RENDERID_OPENGL_LEGACY		= 1001,
 	RENDERID_OPENGL_3_2			= 1002,
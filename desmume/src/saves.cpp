@@ -1047,6 +1047,8 @@ bool savestate_save(EMUFILE &outstream, int compressionLevel)
 #ifdef HAVE_JIT 
 	arm_jit_sync();
 #endif
+	//the geometry thread writes the test results into ARM9 I/O and the gfx3d state
+	gfx3d_WaitForGeometryThread();
 	#ifndef HAVE_LIBZ
 	compressionLevel = Z_NO_COMPRESSION;
 	#endif
@@ -1284,7 +1286,7 @@ static bool ReadStateChunks(EMUFILE &is, s32 totalsize)
 	return ret;
 }
 
-static void loadstate()
+static void loadstate_regenerate()
 {
     // This should regenerate the vram banks
     for (int i = 0; i < 0xA; i++)
@@ -1314,8 +1316,18 @@ static void loadstate()
 	execute = !driver->EMU_IsEmulationPaused();
 }
 
+static void loadstate()
+{
+	// The whole of VRAM was just replaced, so let anything tracking VRAM writes know about it
+	MMU_VRAMPageMarkAllWritten();
+	
+	loadstate_regenerate();
+}
+
 bool savestate_load(EMUFILE &is)
 {
+	gfx3d_WaitForGeometryThread();
+
 	SAV_silent_fail_flag = false;
 	char header[16];
 	is.fread(header,16);
@@ -1400,6 +1412,185 @@ bool savestate_load(EMUFILE &is)
 	return true;
 }
 
+//A snapshot keeps raw copies of everything that a savestate describes with SFORMAT tables: the
+//CPU registers, the memory arrays and the small MMU/NDS/3D/RTC state. Restoring compares each
+//4KB page with the copy and only writes back (and drops JIT blocks for) the pages that differ,
+//so the code the JIT compiled from untouched pages stays around. The state that the savestate
+//keeps in per-module chunks (cp15, GPU, SPU, 3D lists, wifi, slots) is small, and still goes
+//through those modules' own save/load functions. Restoring skips the NDS_Reset() that
+//savestate_load() does, so a snapshot is only valid for the ROM it was taken with.
+#define SNAPSHOT_PAGE_SIZE 4096
+
+struct SnapshotRegion
+{
+	u8 *mem;
+	size_t size;
+	std::vector<u8> copy;
+};
+
+struct savestate_snapshot
+{
+	u32 romCRC;
+	u32 romSize;
+	std::vector<SnapshotRegion> regions;
+	std::vector<u8> moduleState;
+};
+
+static const SFORMAT* const snapshotTables[] = { SF_ARM9, SF_ARM7, SF_MEM, SF_NDS, SF_MMU, SF_GFX3D, SF_RTC, NULL };
+
+static void snapshot_writechunks(EMUFILE &os)
+{
+	savestate_WriteChunk(os,3,cp15_savestate);
+	savestate_WriteChunk(os,51,nds_savestate);
+	savestate_WriteChunk(os,61,mmu_savestate);
+	savestate_WriteChunk(os,7,gpu_savestate);
+	savestate_WriteChunk(os,8,spu_savestate);
+	savestate_WriteChunk(os,81,mic_savestate);
+	savestate_WriteChunk(os,91,gfx3d_savestate);
+	savestate_WriteChunk(os,111,&wifi_savestate);
+	savestate_WriteChunk(os,140,s_slot1_savestate);
+	savestate_WriteChunk(os,150,s_slot2_savestate);
+	savestate_WriteChunk(os,0xFFFFFFFF,(SFORMAT*)0);
+}
+
+#ifdef HAVE_JIT
+#ifdef MAPPED_JIT_FUNCS
+static void snapshot_jit_clear(uintptr_t *entries, size_t entryCount, size_t ofs, size_t size)
+{
+	const size_t first = std::min(ofs >> 1, entryCount);
+	const size_t last = std::min((ofs + size + 1) >> 1, entryCount);
+	memset(entries + first, 0, (last - first) * sizeof(uintptr_t));
+}
+#endif
+
+//drops the compiled blocks whose code came from [mem, mem+size).
+//returns false if that can't be done without resetting the whole JIT.
+static bool snapshot_jit_invalidate(const u8 *mem, size_t size)
+{
+	#define SNAPSHOT_IN(bank) ((mem >= MMU.bank) && (mem < MMU.bank + sizeof(MMU.bank)))
+	#define SNAPSHOT_OFS(bank) ((size_t)(mem - MMU.bank))
+
+	if (SNAPSHOT_IN(MAIN_MEM))
+	{
+		const size_t ofs = SNAPSHOT_OFS(MAIN_MEM) & _MMU_MAIN_MEM_MASK;
+#ifdef MAPPED_JIT_FUNCS
+		snapshot_jit_clear(JIT.MAIN_MEM, ARRAY_SIZE(JIT.MAIN_MEM), ofs, size);
+#else
+		//every mirror of main memory has its own entries
+		for (u32 mirror = 0x02000000; mirror < 0x03000000; mirror += _MMU_MAIN_MEM_MASK + 1)
+			memset(&JIT_COMPILED_FUNC(mirror + ofs, 0), 0, ((size + 1) >> 1) * sizeof(uintptr_t));
+#endif
+		return true;
+	}
+
+#ifdef MAPPED_JIT_FUNCS
+	if (SNAPSHOT_IN(ARM9_ITCM)) { snapshot_jit_clear(JIT.ARM9_ITCM, ARRAY_SIZE(JIT.ARM9_ITCM), SNAPSHOT_OFS(ARM9_ITCM), size); return true; }
+	if (SNAPSHOT_IN(SWIRAM)) { snapshot_jit_clear(JIT.SWIRAM, ARRAY_SIZE(JIT.SWIRAM), SNAPSHOT_OFS(SWIRAM), size); return true; }
+	if (SNAPSHOT_IN(ARM7_BIOS)) { snapshot_jit_clear(JIT.ARM7_BIOS, ARRAY_SIZE(JIT.ARM7_BIOS), SNAPSHOT_OFS(ARM7_BIOS), size); return true; }
+	if (SNAPSHOT_IN(ARM7_ERAM)) { snapshot_jit_clear(JIT.ARM7_ERAM, ARRAY_SIZE(JIT.ARM7_ERAM), SNAPSHOT_OFS(ARM7_ERAM), size); return true; }
+	if (SNAPSHOT_IN(ARM7_WIRAM)) { snapshot_jit_clear(JIT.ARM7_WIRAM, ARRAY_SIZE(JIT.ARM7_WIRAM), SNAPSHOT_OFS(ARM7_WIRAM), size); return true; }
+	if (SNAPSHOT_IN(ARM9_LCD)) { snapshot_jit_clear(JIT.ARM9_LCDC, ARRAY_SIZE(JIT.ARM9_LCDC), SNAPSHOT_OFS(ARM9_LCD), size); return true; }
+
+	return true;
+#else
+	//everything else that code can run from is mirrored too many times to clear one page at a time
+	return !(SNAPSHOT_IN(ARM9_ITCM) || SNAPSHOT_IN(SWIRAM) || SNAPSHOT_IN(ARM7_BIOS) || SNAPSHOT_IN(ARM7_ERAM) || SNAPSHOT_IN(ARM7_WIRAM) || SNAPSHOT_IN(ARM9_LCD));
+#endif
+
+	#undef SNAPSHOT_OFS
+	#undef SNAPSHOT_IN
+}
+#endif
+
+savestate_snapshot* savestate_snapshot_create()
+{
+#ifdef HAVE_JIT
+	arm_jit_sync();
+#endif
+	gfx3d_WaitForGeometryThread();
+	gfx3d_PrepareSaveStateBufferWrite();
+
+	savestate_snapshot *snapshot = new savestate_snapshot;
+	snapshot->romCRC = gameInfo.crc;
+	snapshot->romSize = gameInfo.romsize;
+
+	for (size_t t = 0; snapshotTables[t] != NULL; t++)
+	{
+		for (const SFORMAT *sf = snapshotTables[t]; sf->v != NULL; sf++)
+		{
+			SnapshotRegion region;
+			region.mem = (u8 *)sf->v;
+			region.size = (size_t)sf->size * sf->count;
+			region.copy.assign(region.mem, region.mem + region.size);
+			snapshot->regions.push_back(region);
+		}
+	}
+
+	EMUFILE_MEMORY os(&snapshot->moduleState);
+	snapshot_writechunks(os);
+
+	return snapshot;
+}
+
+bool savestate_snapshot_restore(savestate_snapshot *snapshot)
+{
+	if ( (snapshot == NULL) || (snapshot->romCRC != gameInfo.crc) || (snapshot->romSize != gameInfo.romsize) )
+		return false;
+
+	gfx3d_WaitForGeometryThread();
+
+	bool willResetJIT = false;
+	bool didRestoreVRAM = false;
+
+	for (size_t i = 0; i < snapshot->regions.size(); i++)
+	{
+		SnapshotRegion &region = snapshot->regions[i];
+
+		for (size_t ofs = 0; ofs < region.size; ofs += SNAPSHOT_PAGE_SIZE)
+		{
+			const size_t pageSize = std::min<size_t>(SNAPSHOT_PAGE_SIZE, region.size - ofs);
+			u8 *page = region.mem + ofs;
+			if (memcmp(page, &region.copy[ofs], pageSize) == 0)
+				continue;
+
+			memcpy(page, &region.copy[ofs], pageSize);
+
+			if ( (page >= MMU.ARM9_LCD) && (page < MMU.ARM9_LCD + sizeof(MMU.ARM9_LCD)) )
+			{
+				MMU_VRAMPageMarkWritten((u32)(page - MMU.ARM9_LCD));
+				didRestoreVRAM = true;
+			}
+
+#ifdef HAVE_JIT
+			if (CommonSettings.use_jit && !willResetJIT)
+				willResetJIT = !snapshot_jit_invalidate(page, pageSize);
+#endif
+		}
+	}
+
+#ifdef HAVE_JIT
+	if (willResetJIT)
+		arm_jit_reset(true, true);
+#ifdef MAPPED_JIT_FUNCS
+	//the ARM7 sees VRAM through its own bank mapping, which isn't worth working out here
+	else if (CommonSettings.use_jit && didRestoreVRAM)
+		memset(JIT.ARM7_WRAM, 0, sizeof(JIT.ARM7_WRAM));
+#endif
+#endif
+
+	EMUFILE_MEMORY is(&snapshot->moduleState);
+	if (!ReadStateChunks(is, (s32)snapshot->moduleState.size()))
+		return false;
+
+	loadstate_regenerate();
+	return true;
+}
+
+void savestate_snapshot_free(savestate_snapshot *snapshot)
+{
+	delete snapshot;
+}
+
 bool savestate_load(const char *file_name)
 {
 	EMUFILE_FILE f(file_name,"rb");
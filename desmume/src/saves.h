@@ -67,4 +67,11 @@ void loadstate_slot(int num);
 bool savestate_load(class EMUFILE &is);
 bool savestate_save(class EMUFILE &outstream, int compressionLevel = Z_DEFAULT_COMPRESSION);
 
+//an in-memory copy of the emulator state, for going back to the same point over and over within
+//one session (same ROM) much faster than savestate_load() can
+struct savestate_snapshot;
+savestate_snapshot* savestate_snapshot_create();
+bool savestate_snapshot_restore(savestate_snapshot *snapshot);
+void savestate_snapshot_free(savestate_snapshot *snapshot);
+
 #endif
@@ -17,6 +17,7 @@
 	along with the this software.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <errno.h>
 #include <string.h>
 #include <algorithm>
 #include <assert.h>
@@ -29,6 +30,19 @@
 #include "gfx3d.h"
 #include "MMU.h"
 #include "NDSSystem.h"
+#include "utils/task.h"
+#include <rthreads/rthreads.h>
+
+#ifdef HOST_WINDOWS
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #if defined(ENABLE_AVX2)
 #include "./utils/colorspacehandler/colorspacehandler_AVX2.h"
@@ -144,7 +158,7 @@ public:
 };
 
 //creates a MemSpan in texture memory
-static MemSpan MemSpan_TexMem(u32 ofs, u32 len) 
+static MemSpan MemSpan_TexMem(u32 ofs, u32 len, bool silent) 
 {
 	MemSpan ret;
 	ret.size = len;
@@ -160,221 +174,1151 @@ static MemSpan MemSpan_TexMem(u32 ofs, u32 len)
 		currofs += curr.len;
 		u8* ptr = MMU.texInfo.textureSlotAddr[slot];
 		
-		if (ptr == MMU.blank_memory && !GPU->GetEngineMain()->IsMasterBrightMaxOrMin()) {
+		if (ptr == MMU.blank_memory && !GPU->GetEngineMain()->IsMasterBrightMaxOrMin() && !silent) {
 			PROGINFO("Tried to reference unmapped texture memory: slot %d\n",slot);
 		}
-		curr.ptr = ptr + curr.start;
+		curr.ptr = ptr + curr.start;
+	}
+	return ret;
+}
+
+//creates a MemSpan in texture palette memory
+static MemSpan MemSpan_TexPalette(u32 ofs, u32 len, bool silent) 
+{
+	MemSpan ret;
+	ret.size = len;
+	u32 currofs = 0;
+	while(len) {
+		MemSpan::Item &curr = ret.items[ret.numItems++];
+		curr.start = ofs&0x3FFF;
+		u32 slot = (ofs>>14)&7; //this masks to 8 slots, but there are really only 6
+		if(slot>5) {
+			if(!silent)
+				PROGINFO("Texture palette overruns texture memory. Wrapping at palette slot 0.\n");
+			slot -= 5;
+		}
+		curr.len = min(len,0x4000-curr.start);
+		curr.ofs = currofs;
+		len -= curr.len;
+		ofs += curr.len;
+		//if(len != 0) 
+			//here is an actual test case of bank spanning
+		currofs += curr.len;
+		u8* ptr = MMU.texInfo.texPalSlot[slot];
+		
+		if(ptr == MMU.blank_memory && !GPU->GetEngineMain()->IsMasterBrightMaxOrMin() && !silent) {
+			PROGINFO("Tried to reference unmapped texture palette memory: 16k slot #%d\n",slot);
+		}
+		curr.ptr = ptr + curr.start;
+	}
+	return ret;
+}
+
+//appends the physical vram pages (16KB pages of ARM9_LCD) covered by a MemSpan to pageList.
+//returns false if pageList would overflow.
+static bool MemSpan_AppendVRAMPages(const MemSpan &ms, u8 *pageList, size_t &pageCount, const size_t pageListCapacity)
+{
+	for (int i = 0; i < ms.numItems; i++)
+	{
+		const MemSpan::Item &item = ms.items[i];
+		if (item.len == 0)
+		{
+			continue;
+		}
+		
+		const size_t firstPage = (size_t)(item.ptr - MMU.ARM9_LCD) >> 14;
+		const size_t lastPage = ((size_t)(item.ptr - MMU.ARM9_LCD) + item.len - 1) >> 14;
+		
+		for (size_t page = firstPage; page <= lastPage; page++)
+		{
+			if (pageCount >= pageListCapacity)
+			{
+				return false;
+			}
+			
+			pageList[pageCount++] = (u8)page;
+		}
+	}
+	
+	return true;
+}
+
+static u64 VRAMPageListGeneration(const u8 *pageList, const size_t pageCount)
+{
+	//generations only ever increase, so the sum changes whenever any of the pages were written to
+	u64 generation = 0;
+	for (size_t i = 0; i < pageCount; i++)
+	{
+		generation += MMU.VRAMPageGeneration[pageList[i]];
+	}
+	
+	return generation;
+}
+
+TextureCacheMap::TextureCacheMap()
+{
+	_entry = NULL;
+	_capacity = 0;
+	_count = 0;
+}
+
+TextureCacheMap::~TextureCacheMap()
+{
+	free_aligned(this->_entry);
+}
+
+size_t TextureCacheMap::_HashKey(const TextureCacheKey key)
+{
+	// The low bits of the key are mostly VRAM offsets and the high bits are the palette
+	// offset, so mix everything together before masking down to the table size.
+	u64 h = key;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	
+	return (size_t)h;
+}
+
+void TextureCacheMap::_Resize(const size_t newCapacity)
+{
+	Entry *oldEntry = this->_entry;
+	const size_t oldCapacity = this->_capacity;
+	
+	this->_entry = (Entry *)malloc_alignedCacheLine(newCapacity * sizeof(Entry));
+	memset(this->_entry, 0, newCapacity * sizeof(Entry));
+	this->_capacity = newCapacity;
+	this->_count = 0;
+	
+	for (size_t i = 0; i < oldCapacity; i++)
+	{
+		if (oldEntry[i].texItem != NULL)
+		{
+			this->Insert(oldEntry[i].key, oldEntry[i].texItem);
+		}
+	}
+	
+	free_aligned(oldEntry);
+}
+
+size_t TextureCacheMap::GetCount() const
+{
+	return this->_count;
+}
+
+TextureStore* TextureCacheMap::Find(const TextureCacheKey key) const
+{
+	if (this->_count == 0)
+	{
+		return NULL;
+	}
+	
+	const size_t mask = this->_capacity - 1;
+	for (size_t i = TextureCacheMap::_HashKey(key) & mask; this->_entry[i].texItem != NULL; i = (i + 1) & mask)
+	{
+		if (this->_entry[i].key == key)
+		{
+			return this->_entry[i].texItem;
+		}
+	}
+	
+	return NULL;
+}
+
+void TextureCacheMap::Insert(const TextureCacheKey key, TextureStore *texItem)
+{
+	// Keep the load factor at or below 3/4 so that probe sequences stay short.
+	if ( ((this->_count + 1) * 4) > (this->_capacity * 3) )
+	{
+		this->_Resize( (this->_capacity == 0) ? 1024 : this->_capacity * 2 );
+	}
+	
+	const size_t mask = this->_capacity - 1;
+	size_t i = TextureCacheMap::_HashKey(key) & mask;
+	
+	for (; this->_entry[i].texItem != NULL; i = (i + 1) & mask)
+	{
+		if (this->_entry[i].key == key)
+		{
+			this->_entry[i].texItem = texItem;
+			return;
+		}
+	}
+	
+	this->_entry[i].key = key;
+	this->_entry[i].texItem = texItem;
+	this->_count++;
+}
+
+void TextureCacheMap::Erase(const TextureCacheKey key)
+{
+	if (this->_count == 0)
+	{
+		return;
+	}
+	
+	const size_t mask = this->_capacity - 1;
+	size_t i = TextureCacheMap::_HashKey(key) & mask;
+	
+	for (; this->_entry[i].key != key; i = (i + 1) & mask)
+	{
+		if (this->_entry[i].texItem == NULL)
+		{
+			return;
+		}
+	}
+	
+	if (this->_entry[i].texItem == NULL)
+	{
+		return;
+	}
+	
+	// Shift back any following entries in the same probe run that would no longer be
+	// reachable from their home position once this entry is emptied.
+	for (size_t j = (i + 1) & mask; this->_entry[j].texItem != NULL; j = (j + 1) & mask)
+	{
+		const size_t home = TextureCacheMap::_HashKey(this->_entry[j].key) & mask;
+		const bool isHomeBetween = (i <= j) ? ( (i < home) && (home <= j) ) : ( (i < home) || (home <= j) );
+		
+		if (!isHomeBetween)
+		{
+			this->_entry[i] = this->_entry[j];
+			i = j;
+		}
+	}
+	
+	this->_entry[i].key = 0;
+	this->_entry[i].texItem = NULL;
+	this->_count--;
+}
+
+void TextureCacheMap::Clear()
+{
+	if (this->_entry != NULL)
+	{
+		memset(this->_entry, 0, this->_capacity * sizeof(Entry));
+	}
+	
+	this->_count = 0;
+}
+
+TextureCache texCache;
+
+TextureCache::TextureCache()
+{
+	_texCacheMap.Clear();
+	_lruHead = NULL;
+	_lruTail = NULL;
+	_actualCacheSize = 0;
+	_cacheSizeThreshold = TEXCACHE_DEFAULT_THRESHOLD;
+	_cacheEpoch = 0;
+	memset(_paletteDump, 0, sizeof(_paletteDump));
+	memset(_paletteDumpPageList, 0xFF, sizeof(_paletteDumpPageList)); // No such page, so the palette dump is always checked the first time
+	_paletteDumpGeneration = 0;
+}
+
+void TextureCache::_LRUUnlink(TextureStore *texItem)
+{
+	if (texItem->_lruPrev != NULL)
+	{
+		texItem->_lruPrev->_lruNext = texItem->_lruNext;
+	}
+	else
+	{
+		this->_lruHead = texItem->_lruNext;
+	}
+	
+	if (texItem->_lruNext != NULL)
+	{
+		texItem->_lruNext->_lruPrev = texItem->_lruPrev;
+	}
+	else
+	{
+		this->_lruTail = texItem->_lruPrev;
+	}
+	
+	texItem->_lruPrev = NULL;
+	texItem->_lruNext = NULL;
+}
+
+void TextureCache::_LRUPushFront(TextureStore *texItem)
+{
+	texItem->_lruPrev = NULL;
+	texItem->_lruNext = this->_lruHead;
+	
+	if (this->_lruHead != NULL)
+	{
+		this->_lruHead->_lruPrev = texItem;
+	}
+	else
+	{
+		this->_lruTail = texItem;
+	}
+	
+	this->_lruHead = texItem;
+}
+
+size_t TextureCache::GetActualCacheSize() const
+{
+	return this->_actualCacheSize;
+}
+
+size_t TextureCache::GetCacheSizeThreshold() const
+{
+	return this->_cacheSizeThreshold;
+}
+
+void TextureCache::SetCacheSizeThreshold(size_t newThreshold)
+{
+	this->_cacheSizeThreshold = newThreshold;
+}
+
+size_t TextureCache::GetCacheEpoch() const
+{
+	return this->_cacheEpoch;
+}
+
+void TextureCache::Invalidate()
+{
+	//check whether the palette memory changed.
+	//we only need to compare against the palette dump if the palette slots now point at
+	//different physical pages, or if any of those pages were written to since the last dump.
+	MemSpan mspal = MemSpan_TexPalette(0, PALETTE_DUMP_SIZE, true);
+	u8 palPageList[sizeof(this->_paletteDumpPageList)];
+	size_t palPageCount = 0;
+	MemSpan_AppendVRAMPages(mspal, palPageList, palPageCount, sizeof(palPageList));
+	const u64 palGeneration = VRAMPageListGeneration(palPageList, palPageCount);
+	
+	bool paletteDirty = false;
+	if ( (palGeneration != this->_paletteDumpGeneration) || memcmp(palPageList, this->_paletteDumpPageList, sizeof(palPageList)) )
+	{
+		paletteDirty = (mspal.memcmp(this->_paletteDump) != 0);
+		if (paletteDirty)
+		{
+			mspal.dump(this->_paletteDump);
+		}
+		
+		memcpy(this->_paletteDumpPageList, palPageList, sizeof(palPageList));
+		this->_paletteDumpGeneration = palGeneration;
+	}
+	
+	for (TextureStore *theTexture = this->_lruHead; theTexture != NULL; theTexture = theTexture->_lruNext)
+	{
+		//textures whose vram pages are still mapped the same way and haven't been written to
+		//can be skipped, since their contents can't have changed
+		if (!theTexture->IsVRAMUnchanged())
+		{
+			theTexture->SetSuspectedInvalid();
+		}
+		
+		//when the palette changes, we assume all 4x4 textures are dirty.
+		//this is because each 4x4 item doesnt carry along with it a copy of the entire palette, for verification
+		//instead, we just use the one paletteDump for verifying of all 4x4 textures; and if paletteDirty is set, verification has failed
+		if( (theTexture->GetPackFormat() == TEXMODE_4X4) && paletteDirty )
+		{
+			theTexture->SetAssumedInvalid();
+		}
+	}
+}
+
+void TextureCache::Evict()
+{
+	//debug print
+	//printf("%d %d/%d\n",index.size(),cache_size/1024,target/1024);
+	
+	//every texture item gets one epoch older
+	this->_cacheEpoch++;
+	
+	//dont do anything unless we're over the target
+	if (this->_actualCacheSize <= this->_cacheSizeThreshold)
+	{
+		return;
+	}
+	
+	//aim at cutting the cache to half of the max size
+	size_t targetCacheSize = this->_cacheSizeThreshold / 2;
+	
+	// Textures are moved to the front of the LRU list whenever they are looked up, so the
+	// least recently used textures are always found at the back of the list.
+	while (this->_actualCacheSize > targetCacheSize)
+	{
+		if (this->_lruTail == NULL) break; //just in case.. doesnt seem possible, cache_size wouldve been 0
+		
+		TextureStore *item = this->_lruTail;
+		this->Remove(item);
+		
+		//printf("evicting! totalsize:%d\n",cache_size);
+		delete item;
+	}
+}
+
+void TextureCache::Reset()
+{
+	TextureStore *theTexture = this->_lruHead;
+	while (theTexture != NULL)
+	{
+		TextureStore *nextTexture = theTexture->_lruNext;
+		delete theTexture;
+		theTexture = nextTexture;
+	}
+	
+	this->_texCacheMap.Clear();
+	this->_lruHead = NULL;
+	this->_lruTail = NULL;
+	this->_actualCacheSize = 0;
+	memset(this->_paletteDump, 0, sizeof(this->_paletteDump));
+	memset(this->_paletteDumpPageList, 0xFF, sizeof(this->_paletteDumpPageList));
+	this->_paletteDumpGeneration = 0;
+}
+
+void TextureCache::ForceReloadAllTextures()
+{
+	for (TextureStore *theTexture = this->_lruHead; theTexture != NULL; theTexture = theTexture->_lruNext)
+	{
+		theTexture->SetLoadNeeded();
+	}
+}
+
+TextureStore* TextureCache::GetTexture(TEXIMAGE_PARAM texAttributes, u32 palAttributes)
+{
+	const TextureCacheKey key = TextureCache::GenerateKey(texAttributes, palAttributes);
+	TextureStore *theTexture = this->_texCacheMap.Find(key);
+	
+	if (theTexture == NULL)
+	{
+		return theTexture;
+	}
+	else
+	{
+		if (theTexture != this->_lruHead)
+		{
+			this->_LRUUnlink(theTexture);
+			this->_LRUPushFront(theTexture);
+		}
+		
+		if (theTexture->IsAssumedInvalid())
+		{
+			theTexture->Update();
+		}
+		else if (theTexture->IsSuspectedInvalid())
+		{
+			theTexture->VRAMCompareAndUpdate();
+		}
+	}
+	
+	return theTexture;
+}
+
+void TextureCache::Add(TextureStore *texItem)
+{
+	const TextureCacheKey key = texItem->GetCacheKey();
+	this->_texCacheMap.Insert(key, texItem);
+	this->_LRUPushFront(texItem);
+	texItem->ResetCacheAge();
+	this->_actualCacheSize += texItem->GetCacheSize();
+	//printf("allocating: up to %d with %d items\n", this->cache_size, this->cacheTable.size());
+}
+
+void TextureCache::Remove(TextureStore *texItem)
+{
+	const TextureCacheKey key = texItem->GetCacheKey();
+	this->_texCacheMap.Erase(key);
+	this->_LRUUnlink(texItem);
+	this->_actualCacheSize -= texItem->GetCacheSize();
+}
+
+TextureCacheKey TextureCache::GenerateKey(const TEXIMAGE_PARAM texAttributes, const u32 palAttributes)
+{
+	// Since the repeat, flip, and coordinate transformation modes are render settings
+	// and not data settings, we can mask out those bits to help reduce duplicate entries.
+	return (TextureCacheKey)( ((u64)palAttributes << 32) | (u64)(texAttributes.value & 0x3FF0FFFF) );
+}
+
+// Texture disk cache file layout:
+//   TextureDiskCacheFileHeader
+//   { TextureDiskCacheEntryHeader, texel data (width * height * sizeof(u32)) } ...
+// Entries are only ever appended. Several emulator instances may share the same file, so
+// every append happens at the current end of the file while holding an exclusive file lock.
+// A truncated entry at the end of the file (for example, if the emulator was killed
+// mid-write) is cut off the next time the cache is opened.
+#define TEXDISKCACHE_FILE_NAME		"texcache.dtc"
+#define TEXDISKCACHE_FILE_MAGIC		0x43544458 // "XDTC"
+#define TEXDISKCACHE_FILE_VERSION	1
+#define TEXDISKCACHE_BYTE_ORDER		0x01020304
+#define TEXDISKCACHE_ENTRY_MAGIC	0x59525445 // "ETRY"
+#define TEXDISKCACHE_MAX_FILE_SIZE	0x7FFFFFFF
+
+struct TextureDiskCacheFileHeader
+{
+	u32 magic;
+	u32 version;
+	u32 byteOrder;
+	u32 reserved;
+};
+
+struct TextureDiskCacheEntryHeader
+{
+	u32 magic;
+	u32 width;
+	u32 height;
+	u32 checksum;
+	u64 hash[2];
+};
+
+static FORCEINLINE u64 TextureDiskCache_Mix64(u64 h)
+{
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	
+	return h;
+}
+
+static u32 TextureDiskCache_Checksum(const u32 *data, const size_t count)
+{
+	u64 h = 0x84222325CBF29CE4ULL;
+	for (size_t i = 0; i < count; i++)
+	{
+		h = (h ^ data[i]) * 0x100000001B3ULL;
+	}
+	
+	h = TextureDiskCache_Mix64(h);
+	return (u32)(h ^ (h >> 32));
+}
+
+static void* TextureDiskCache_RunWorker(void *arg)
+{
+	TextureDiskCache *diskCache = (TextureDiskCache *)arg;
+	diskCache->WorkerLoop();
+	
+	return NULL;
+}
+
+TextureDiskCache textureDiskCache;
+
+TextureDiskCache::TextureDiskCache()
+{
+	_file = NULL;
+	_fileEndOffset = 0;
+	
+	_mappedData = NULL;
+	_mappedSize = 0;
+	
+	_pendingBytes = 0;
+	
+	for (size_t i = 0; i < TEXDISKCACHE_WORKER_COUNT; i++)
+	{
+		_workerTask[i] = NULL;
+	}
+	
+	_workerExit = false;
+	
+	_mutexIndex = slock_new();
+	_mutexFile = slock_new();
+	_condWork = scond_new();
+}
+
+TextureDiskCache::~TextureDiskCache()
+{
+	this->Close();
+	
+	scond_free(this->_condWork);
+	slock_free(this->_mutexFile);
+	slock_free(this->_mutexIndex);
+}
+
+TextureDiskCacheKey TextureDiskCache::MakeKey(const u32 *texels, const size_t texelCount, const u32 sizeS, const u32 sizeT, const NDSTextureFormat packFormat, const size_t scalingFactor, const bool useDeposterize)
+{
+	// Two independently seeded lanes give a 128-bit key, which keeps collisions out of the
+	// question even for a cache that is shared by every game that the user plays.
+	u64 h0 = 0x9E3779B97F4A7C15ULL;
+	u64 h1 = 0x243F6A8885A308D3ULL;
+	
+	const u64 params[2] = {
+		((u64)sizeS << 32) | (u64)sizeT,
+		((u64)packFormat << 32) | ((u64)scalingFactor << 1) | ((useDeposterize) ? 1 : 0)
+	};
+	
+	for (size_t i = 0; i < 2; i++)
+	{
+		h0 = (h0 ^ params[i]) * 0xFF51AFD7ED558CCDULL;
+		h1 = (h1 + params[i]) * 0xC4CEB9FE1A85EC53ULL;
+	}
+	
+	size_t i = 0;
+	for (; i + 2 <= texelCount; i += 2)
+	{
+		const u64 v = ((u64)texels[i+0] << 32) | (u64)texels[i+1];
+		
+		h0 = (h0 ^ v) * 0xFF51AFD7ED558CCDULL;
+		h0 ^= h0 >> 29;
+		
+		h1 = (h1 + v) * 0xC4CEB9FE1A85EC53ULL;
+		h1 ^= h1 >> 31;
+	}
+	
+	for (; i < texelCount; i++)
+	{
+		h0 = (h0 ^ texels[i]) * 0xFF51AFD7ED558CCDULL;
+		h1 = (h1 + texels[i]) * 0xC4CEB9FE1A85EC53ULL;
+	}
+	
+	TextureDiskCacheKey key;
+	key.hash[0] = TextureDiskCache_Mix64(h0 ^ (u64)texelCount);
+	key.hash[1] = TextureDiskCache_Mix64(h1 + (u64)texelCount);
+	
+	return key;
+}
+
+bool TextureDiskCache::_MapFile()
+{
+#ifdef HOST_WINDOWS
+	HANDLE fileHandle = CreateFileA(this->_filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	
+	LARGE_INTEGER fileSize;
+	if ( !GetFileSizeEx(fileHandle, &fileSize) || (fileSize.QuadPart < (LONGLONG)sizeof(TextureDiskCacheFileHeader)) || (fileSize.QuadPart > TEXDISKCACHE_MAX_FILE_SIZE) )
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+	
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(fileHandle);
+	
+	if (mappingHandle == NULL)
+	{
+		return false;
+	}
+	
+	void *mappedData = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mappingHandle);
+	
+	if (mappedData == NULL)
+	{
+		return false;
+	}
+	
+	this->_mappedData = (u8 *)mappedData;
+	this->_mappedSize = (size_t)fileSize.QuadPart;
+#else
+	const int fd = open(this->_filePath.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	
+	struct stat fileStat;
+	if ( (fstat(fd, &fileStat) != 0) || (fileStat.st_size < (off_t)sizeof(TextureDiskCacheFileHeader)) || (fileStat.st_size > TEXDISKCACHE_MAX_FILE_SIZE) )
+	{
+		close(fd);
+		return false;
+	}
+	
+	void *mappedData = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	
+	if (mappedData == MAP_FAILED)
+	{
+		return false;
+	}
+	
+	this->_mappedData = (u8 *)mappedData;
+	this->_mappedSize = (size_t)fileStat.st_size;
+#endif
+	
+	TextureDiskCacheFileHeader fileHeader;
+	memcpy(&fileHeader, this->_mappedData, sizeof(fileHeader));
+	
+	if ( (fileHeader.magic != TEXDISKCACHE_FILE_MAGIC) ||
+	     (fileHeader.version != TEXDISKCACHE_FILE_VERSION) ||
+	     (fileHeader.byteOrder != TEXDISKCACHE_BYTE_ORDER) )
+	{
+		this->_UnmapFile();
+		return false;
+	}
+	
+	return true;
+}
+
+void TextureDiskCache::_UnmapFile()
+{
+	if (this->_mappedData == NULL)
+	{
+		return;
+	}
+	
+#ifdef HOST_WINDOWS
+	UnmapViewOfFile(this->_mappedData);
+#else
+	munmap(this->_mappedData, this->_mappedSize);
+#endif
+	
+	this->_mappedData = NULL;
+	this->_mappedSize = 0;
+}
+
+bool TextureDiskCache::_LockFile()
+{
+#ifdef HOST_WINDOWS
+	// Windows file locks are mandatory, so lock a byte past the largest possible file instead
+	// of the data itself. Otherwise, other instances couldn't read the cache while it's locked.
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.OffsetHigh = 1;
+	
+	return (LockFileEx((HANDLE)_get_osfhandle(_fileno(this->_file)), LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped) != 0);
+#else
+	int result;
+	do
+	{
+		result = flock(fileno(this->_file), LOCK_EX);
+	} while ( (result != 0) && (errno == EINTR) );
+	
+	return (result == 0);
+#endif
+}
+
+void TextureDiskCache::_UnlockFile()
+{
+#ifdef HOST_WINDOWS
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.OffsetHigh = 1;
+	
+	UnlockFileEx((HANDLE)_get_osfhandle(_fileno(this->_file)), 0, 1, 0, &overlapped);
+#else
+	flock(fileno(this->_file), LOCK_UN);
+#endif
+}
+
+u64 TextureDiskCache::_GetFileSize()
+{
+	if (fseek(this->_file, 0, SEEK_END) != 0)
+	{
+		return 0;
+	}
+	
+	const long fileSize = ftell(this->_file);
+	return (fileSize > 0) ? (u64)fileSize : 0;
+}
+
+u64 TextureDiskCache::_ScanFileEntries(u64 offset, const u64 fileSize)
+{
+	// The file lock must be held, so that another instance can't be in the middle of
+	// appending the entry that is being read.
+	slock_lock(this->_mutexIndex);
+	
+	while (offset + sizeof(TextureDiskCacheEntryHeader) <= fileSize)
+	{
+		TextureDiskCacheEntryHeader entryHeader;
+		if ( (fseek(this->_file, (long)offset, SEEK_SET) != 0) || (fread(&entryHeader, sizeof(entryHeader), 1, this->_file) != 1) )
+		{
+			break;
+		}
+		
+		if ( (entryHeader.magic != TEXDISKCACHE_ENTRY_MAGIC) ||
+		     (entryHeader.width == 0) || (entryHeader.width > 4096) ||
+		     (entryHeader.height == 0) || (entryHeader.height > 4096) )
+		{
+			break;
+		}
+		
+		const u64 dataSize = (u64)entryHeader.width * (u64)entryHeader.height * sizeof(u32);
+		const u64 dataOffset = offset + sizeof(TextureDiskCacheEntryHeader);
+		if (dataOffset + dataSize > fileSize)
+		{
+			break;
+		}
+		
+		TextureDiskCacheKey key;
+		key.hash[0] = entryHeader.hash[0];
+		key.hash[1] = entryHeader.hash[1];
+		
+		TextureDiskCacheEntry &entry = this->_index[key];
+		entry.offset = dataOffset;
+		entry.width = entryHeader.width;
+		entry.height = entryHeader.height;
+		entry.checksum = entryHeader.checksum;
+		
+		offset = dataOffset + dataSize;
+	}
+	
+	slock_unlock(this->_mutexIndex);
+	
+	return offset;
+}
+
+bool TextureDiskCache::_TruncateFile(const u64 fileSize)
+{
+	fflush(this->_file);
+	
+#ifdef HOST_WINDOWS
+	return (_chsize_s(_fileno(this->_file), (__int64)fileSize) == 0);
+#else
+	return (ftruncate(fileno(this->_file), (off_t)fileSize) == 0);
+#endif
+}
+
+bool TextureDiskCache::Open(const char *directory)
+{
+	this->Close();
+	
+	this->_directory = (directory != NULL) ? directory : "";
+	if (this->_directory.empty())
+	{
+		return false;
+	}
+	
+	this->_filePath = this->_directory;
+	const char lastChar = this->_filePath[this->_filePath.length() - 1];
+	if ( (lastChar != '/') && (lastChar != '\\') )
+	{
+		this->_filePath += "/";
+	}
+	this->_filePath += TEXDISKCACHE_FILE_NAME;
+	
+	// Never open the file with "w", since truncating a file that another instance has mapped
+	// would crash that instance. Append mode creates the file if needed, and guarantees that
+	// writes always land at the current end of the file.
+	for (size_t attempt = 0; (attempt < 2) && (this->_file == NULL); attempt++)
+	{
+		this->_file = fopen(this->_filePath.c_str(), "a+b");
+		if (this->_file == NULL)
+		{
+			break;
+		}
+		
+		if (!this->_LockFile())
+		{
+			fclose(this->_file);
+			this->_file = NULL;
+			break;
+		}
+		
+		const u64 fileSize = this->_GetFileSize();
+		TextureDiskCacheFileHeader fileHeader;
+		
+		if (fileSize == 0)
+		{
+			fileHeader.magic = TEXDISKCACHE_FILE_MAGIC;
+			fileHeader.version = TEXDISKCACHE_FILE_VERSION;
+			fileHeader.byteOrder = TEXDISKCACHE_BYTE_ORDER;
+			fileHeader.reserved = 0;
+			
+			if ( (fwrite(&fileHeader, sizeof(fileHeader), 1, this->_file) != 1) || (fflush(this->_file) != 0) )
+			{
+				INFO("Texture disk cache: could not write %s\n", this->_filePath.c_str());
+				this->_UnlockFile();
+				fclose(this->_file);
+				this->_file = NULL;
+				return false;
+			}
+			
+			this->_fileEndOffset = sizeof(fileHeader);
+		}
+		else if ( (fseek(this->_file, 0, SEEK_SET) == 0) && (fread(&fileHeader, sizeof(fileHeader), 1, this->_file) == 1) &&
+		          (fileHeader.magic == TEXDISKCACHE_FILE_MAGIC) &&
+		          (fileHeader.version == TEXDISKCACHE_FILE_VERSION) &&
+		          (fileHeader.byteOrder == TEXDISKCACHE_BYTE_ORDER) )
+		{
+			this->_fileEndOffset = this->_ScanFileEntries(sizeof(fileHeader), fileSize);
+			
+			// Cut off a partially written entry, or else the entries that are appended after
+			// it could never be found again. Nobody reads past the last complete entry, so
+			// this is safe even if another instance has the file mapped.
+			if ( (this->_fileEndOffset < fileSize) && !this->_TruncateFile(this->_fileEndOffset) )
+			{
+				INFO("Texture disk cache: could not repair %s\n", this->_filePath.c_str());
+				this->_UnlockFile();
+				fclose(this->_file);
+				this->_file = NULL;
+				this->_index.clear();
+				return false;
+			}
+			
+			this->_MapFile();
+		}
+		else
+		{
+			// The file is from an incompatible version, or is corrupted. Unlink it rather than
+			// truncating it, so that any instance that still has it open keeps its own copy.
+			this->_UnlockFile();
+			fclose(this->_file);
+			this->_file = NULL;
+			remove(this->_filePath.c_str());
+			continue;
+		}
+		
+		this->_UnlockFile();
 	}
-	return ret;
+	
+	if (this->_file == NULL)
+	{
+		INFO("Texture disk cache: could not open %s\n", this->_filePath.c_str());
+		return false;
+	}
+	
+	this->_workerExit = false;
+	
+	for (size_t i = 0; i < TEXDISKCACHE_WORKER_COUNT; i++)
+	{
+		this->_workerTask[i] = new Task();
+		this->_workerTask[i]->start(false, 0, "Texture Disk Cache");
+		this->_workerTask[i]->execute(&TextureDiskCache_RunWorker, this);
+	}
+	
+	return true;
 }
 
-//creates a MemSpan in texture palette memory
-static MemSpan MemSpan_TexPalette(u32 ofs, u32 len, bool silent) 
+void TextureDiskCache::Close()
 {
-	MemSpan ret;
-	ret.size = len;
-	u32 currofs = 0;
-	while(len) {
-		MemSpan::Item &curr = ret.items[ret.numItems++];
-		curr.start = ofs&0x3FFF;
-		u32 slot = (ofs>>14)&7; //this masks to 8 slots, but there are really only 6
-		if(slot>5 && !silent) {
-			PROGINFO("Texture palette overruns texture memory. Wrapping at palette slot 0.\n");
-			slot -= 5;
-		}
-		curr.len = min(len,0x4000-curr.start);
-		curr.ofs = currofs;
-		len -= curr.len;
-		ofs += curr.len;
-		//if(len != 0) 
-			//here is an actual test case of bank spanning
-		currofs += curr.len;
-		u8* ptr = MMU.texInfo.texPalSlot[slot];
+	if (this->_workerTask[0] != NULL)
+	{
+		// Let the workers drain the write queue before they exit.
+		slock_lock(this->_mutexIndex);
+		this->_workerExit = true;
+		scond_broadcast(this->_condWork);
+		slock_unlock(this->_mutexIndex);
 		
-		if(ptr == MMU.blank_memory && !GPU->GetEngineMain()->IsMasterBrightMaxOrMin() && !silent) {
-			PROGINFO("Tried to reference unmapped texture palette memory: 16k slot #%d\n",slot);
+		for (size_t i = 0; i < TEXDISKCACHE_WORKER_COUNT; i++)
+		{
+			this->_workerTask[i]->finish();
+			this->_workerTask[i]->shutdown();
+			delete this->_workerTask[i];
+			this->_workerTask[i] = NULL;
 		}
-		curr.ptr = ptr + curr.start;
 	}
-	return ret;
-}
-
-static bool TextureLRUCompare(TextureStore *tex1, TextureStore *tex2)
-{
-	const size_t cacheAge1 = tex1->GetCacheAge();
-	const size_t cacheAge2 = tex2->GetCacheAge();
 	
-	if (cacheAge1 == cacheAge2)
+	if (this->_file != NULL)
 	{
-		return ( tex1->GetCacheUseCount() > tex2->GetCacheUseCount() );
+		fclose(this->_file);
+		this->_file = NULL;
 	}
 	
-	return (cacheAge1 < cacheAge2);
-}
-
-TextureCache texCache;
-
-TextureCache::TextureCache()
-{
-	_texCacheMap.clear();
-	_texCacheList.reserve(4096);
-	_actualCacheSize = 0;
-	_cacheSizeThreshold = TEXCACHE_DEFAULT_THRESHOLD;
-	memset(_paletteDump, 0, sizeof(_paletteDump));
-}
-
-size_t TextureCache::GetActualCacheSize() const
-{
-	return this->_actualCacheSize;
-}
-
-size_t TextureCache::GetCacheSizeThreshold() const
-{
-	return this->_cacheSizeThreshold;
+	this->_UnmapFile();
+	this->_index.clear();
+	this->_pendingKeys.clear();
+	this->_pendingBytes = 0;
+	this->_fileEndOffset = 0;
 }
 
-void TextureCache::SetCacheSizeThreshold(size_t newThreshold)
+bool TextureDiskCache::IsOpen() const
 {
-	this->_cacheSizeThreshold = newThreshold;
+	return (this->_file != NULL);
 }
 
-void TextureCache::Invalidate()
+void TextureDiskCache::SetDirectory(const char *directory)
 {
-	//check whether the palette memory changed
-	//TODO - we should handle this instead by setting dirty flags in the vram memory mapping and noting whether palette memory was dirty.
-	//but this will work for now
-	MemSpan mspal = MemSpan_TexPalette(0, PALETTE_DUMP_SIZE, true);
-	const bool paletteDirty = mspal.memcmp(this->_paletteDump);
-	if (paletteDirty)
+	if (directory == NULL)
 	{
-		mspal.dump(this->_paletteDump);
+		directory = "";
 	}
 	
-	for (TextureCacheMap::iterator it(this->_texCacheMap.begin()); it != this->_texCacheMap.end(); ++it)
+	// Only react to actual changes, so that a directory that can't be opened isn't retried
+	// every time the rendering settings are applied.
+	if (this->_directory == directory)
 	{
-		it->second->SetSuspectedInvalid();
-		
-		//when the palette changes, we assume all 4x4 textures are dirty.
-		//this is because each 4x4 item doesnt carry along with it a copy of the entire palette, for verification
-		//instead, we just use the one paletteDump for verifying of all 4x4 textures; and if paletteDirty is set, verification has failed
-		if( (it->second->GetPackFormat() == TEXMODE_4X4) && paletteDirty )
-		{
-			it->second->SetAssumedInvalid();
-		}
+		return;
+	}
+	
+	if (*directory == '\0')
+	{
+		this->Close();
+		this->_directory.clear();
+	}
+	else
+	{
+		this->Open(directory);
 	}
 }
 
-void TextureCache::Evict()
+bool TextureDiskCache::Read(const TextureDiskCacheKey &key, const u32 width, const u32 height, u32 *dstBuffer)
 {
-	//debug print
-	//printf("%d %d/%d\n",index.size(),cache_size/1024,target/1024);
+	if (!this->IsOpen())
+	{
+		return false;
+	}
 	
-	//dont do anything unless we're over the target
-	if (this->_actualCacheSize <= this->_cacheSizeThreshold)
+	slock_lock(this->_mutexIndex);
+	
+	std::map<TextureDiskCacheKey, TextureDiskCacheEntry>::const_iterator it = this->_index.find(key);
+	if ( (it == this->_index.end()) || (it->second.width != width) || (it->second.height != height) )
 	{
-		for (size_t i = 0; i < this->_texCacheList.size(); i++)
-		{
-			this->_texCacheList[i]->IncreaseCacheAge(1);
-		}
-		
-		return;
+		slock_unlock(this->_mutexIndex);
+		return false;
 	}
 	
-	//aim at cutting the cache to half of the max size
-	size_t targetCacheSize = this->_cacheSizeThreshold / 2;
+	const TextureDiskCacheEntry entry = it->second;
+	slock_unlock(this->_mutexIndex);
 	
-	// Sort the textures in cache by age and usage count. Textures that we want to keep in
-	// cache are placed in the front of the list, while textures we want to evict are sorted
-	// to the back of the list.
-	std::sort(this->_texCacheList.begin(), this->_texCacheList.end(), &TextureLRUCompare);
+	const size_t texelCount = (size_t)width * (size_t)height;
+	const size_t dataSize = texelCount * sizeof(u32);
+	bool didRead = false;
 	
-	while (this->_actualCacheSize > targetCacheSize)
+	if (entry.offset + dataSize <= this->_mappedSize)
 	{
-		if (this->_texCacheMap.size() == 0) break; //just in case.. doesnt seem possible, cache_size wouldve been 0
-		
-		TextureStore *item = this->_texCacheList.back();
-		this->Remove(item);
-		this->_texCacheList.pop_back();
-		
-		//printf("evicting! totalsize:%d\n",cache_size);
-		delete item;
+		memcpy(dstBuffer, this->_mappedData + entry.offset, dataSize);
+		didRead = true;
+	}
+	else
+	{
+		// Entries that were written during this session are past the end of the mapping.
+		slock_lock(this->_mutexFile);
+		didRead = (fseek(this->_file, (long)entry.offset, SEEK_SET) == 0) && (fread(dstBuffer, dataSize, 1, this->_file) == 1);
+		slock_unlock(this->_mutexFile);
 	}
 	
-	for (size_t i = 0; i < this->_texCacheList.size(); i++)
+	if (!didRead || (TextureDiskCache_Checksum(dstBuffer, texelCount) != entry.checksum))
 	{
-		this->_texCacheList[i]->IncreaseCacheAge(1);
+		slock_lock(this->_mutexIndex);
+		this->_index.erase(key);
+		slock_unlock(this->_mutexIndex);
+		return false;
 	}
+	
+	return true;
 }
 
-void TextureCache::Reset()
+void TextureDiskCache::Write(const TextureDiskCacheKey &key, const u32 width, const u32 height, const u32 *srcBuffer)
 {
-	for (size_t i = 0; i < this->_texCacheList.size(); i++)
+	if (!this->IsOpen())
 	{
-		delete this->_texCacheList[i];
+		return;
 	}
 	
-	this->_texCacheMap.clear();
-	this->_texCacheList.clear();
-	this->_actualCacheSize = 0;
-	memset(this->_paletteDump, 0, sizeof(this->_paletteDump));
-}
-
-void TextureCache::ForceReloadAllTextures()
-{
-	for (TextureCacheMap::iterator it(this->_texCacheMap.begin()); it != this->_texCacheMap.end(); ++it)
+	const size_t dataSize = (size_t)width * (size_t)height * sizeof(u32);
+	
+	slock_lock(this->_mutexIndex);
+	
+	if ( (this->_index.find(key) != this->_index.end()) ||
+	     (this->_pendingKeys.find(key) != this->_pendingKeys.end()) ||
+	     (this->_pendingBytes + dataSize > TEXDISKCACHE_MAX_PENDING_BYTES) )
 	{
-		it->second->SetLoadNeeded();
+		slock_unlock(this->_mutexIndex);
+		return;
 	}
+	
+	TextureDiskCacheWriteJob job;
+	job.key = key;
+	job.width = width;
+	job.height = height;
+	job.data = (u32 *)malloc(dataSize);
+	memcpy(job.data, srcBuffer, dataSize);
+	
+	this->_pendingKeys[key] = true;
+	this->_pendingBytes += dataSize;
+	this->_writeQueue.push_back(job);
+	
+	scond_signal(this->_condWork);
+	slock_unlock(this->_mutexIndex);
 }
 
-TextureStore* TextureCache::GetTexture(TEXIMAGE_PARAM texAttributes, u32 palAttributes)
+void TextureDiskCache::_WriteEntry(const TextureDiskCacheWriteJob &job)
 {
-	TextureStore *theTexture = NULL;
-	const TextureCacheKey key = TextureCache::GenerateKey(texAttributes, palAttributes);
-	const TextureCacheMap::iterator cachedTexture = this->_texCacheMap.find(key);
+	const size_t texelCount = (size_t)job.width * (size_t)job.height;
+	const size_t dataSize = texelCount * sizeof(u32);
+	
+	TextureDiskCacheEntryHeader entryHeader;
+	entryHeader.magic = TEXDISKCACHE_ENTRY_MAGIC;
+	entryHeader.width = job.width;
+	entryHeader.height = job.height;
+	entryHeader.checksum = TextureDiskCache_Checksum(job.data, texelCount);
+	entryHeader.hash[0] = job.key.hash[0];
+	entryHeader.hash[1] = job.key.hash[1];
+	
+	TextureDiskCacheEntry entry;
+	entry.width = job.width;
+	entry.height = job.height;
+	entry.checksum = entryHeader.checksum;
+	
+	slock_lock(this->_mutexFile);
 	
-	if (cachedTexture == this->_texCacheMap.end())
+	if (!this->_LockFile())
 	{
-		return theTexture;
+		slock_unlock(this->_mutexFile);
+		return;
 	}
-	else
+	
+	// Other instances may have appended entries since this one last looked, possibly
+	// including this very texture. Pick those up first, so that the index stays complete
+	// and the same texture isn't stored twice.
+	const u64 fileSize = this->_GetFileSize();
+	this->_fileEndOffset = this->_ScanFileEntries(this->_fileEndOffset, fileSize);
+	
+	slock_lock(this->_mutexIndex);
+	const bool isAlreadyStored = (this->_index.find(job.key) != this->_index.end());
+	slock_unlock(this->_mutexIndex);
+	
+	// The file is opened in append mode, so the entry lands at the current end of the file.
+	// If the scan stopped early, then the file is damaged, so leave it alone.
+	const u64 entryOffset = fileSize;
+	const u64 newEndOffset = entryOffset + sizeof(TextureDiskCacheEntryHeader) + dataSize;
+	bool didWrite = false;
+	
+	if ( !isAlreadyStored && (this->_fileEndOffset == fileSize) && (newEndOffset <= TEXDISKCACHE_MAX_FILE_SIZE) )
 	{
-		theTexture = cachedTexture->second;
-		
-		if (theTexture->IsAssumedInvalid())
-		{
-			theTexture->Update();
-		}
-		else if (theTexture->IsSuspectedInvalid())
+		// The scan may have just read from the stream, and stdio requires a seek between
+		// a read and a write on the same stream.
+		didWrite = (fseek(this->_file, 0, SEEK_END) == 0) &&
+		           (fwrite(&entryHeader, sizeof(entryHeader), 1, this->_file) == 1) &&
+		           (fwrite(job.data, dataSize, 1, this->_file) == 1) &&
+		           (fflush(this->_file) == 0);
+		
+		if (didWrite)
 		{
-			theTexture->VRAMCompareAndUpdate();
+			this->_fileEndOffset = newEndOffset;
 		}
 	}
 	
-	return theTexture;
-}
-
-void TextureCache::Add(TextureStore *texItem)
-{
-	const TextureCacheKey key = texItem->GetCacheKey();
-	this->_texCacheMap[key] = texItem;
-	this->_texCacheList.push_back(texItem);
-	this->_actualCacheSize += texItem->GetCacheSize();
-	//printf("allocating: up to %d with %d items\n", this->cache_size, this->cacheTable.size());
-}
-
-void TextureCache::Remove(TextureStore *texItem)
-{
-	const TextureCacheKey key = texItem->GetCacheKey();
-	this->_texCacheMap.erase(key);
-	this->_actualCacheSize -= texItem->GetCacheSize();
+	this->_UnlockFile();
+	slock_unlock(this->_mutexFile);
+	
+	if (didWrite)
+	{
+		entry.offset = entryOffset + sizeof(TextureDiskCacheEntryHeader);
+		
+		slock_lock(this->_mutexIndex);
+		this->_index[job.key] = entry;
+		slock_unlock(this->_mutexIndex);
+	}
 }
 
-TextureCacheKey TextureCache::GenerateKey(const TEXIMAGE_PARAM texAttributes, const u32 palAttributes)
+void TextureDiskCache::WorkerLoop()
 {
-	// Since the repeat, flip, and coordinate transformation modes are render settings
-	// and not data settings, we can mask out those bits to help reduce duplicate entries.
-	return (TextureCacheKey)( ((u64)palAttributes << 32) | (u64)(texAttributes.value & 0x3FF0FFFF) );
+	slock_lock(this->_mutexIndex);
+	
+	do
+	{
+		while (this->_writeQueue.empty() && !this->_workerExit)
+		{
+			scond_wait(this->_condWork, this->_mutexIndex);
+		}
+		
+		if (this->_writeQueue.empty())
+		{
+			break;
+		}
+		
+		TextureDiskCacheWriteJob job = this->_writeQueue.front();
+		this->_writeQueue.pop_front();
+		slock_unlock(this->_mutexIndex);
+		
+		this->_WriteEntry(job);
+		free(job.data);
+		
+		slock_lock(this->_mutexIndex);
+		this->_pendingKeys.erase(job.key);
+		this->_pendingBytes -= (size_t)job.width * (size_t)job.height * sizeof(u32);
+	} while (true);
+	
+	slock_unlock(this->_mutexIndex);
 }
 
 TextureStore::TextureStore()
@@ -407,9 +1351,16 @@ TextureStore::TextureStore()
 	_assumedInvalid = false;
 	_isLoadNeeded = false;
 	
+	_vramPageCount = 0;
+	_isVRAMPageListTracked = false;
+	_vramGeneration = 0;
+	
 	_cacheSize = 0;
-	_cacheAge = 0;
+	_cacheLastUseEpoch = 0;
 	_cacheUsageCount = 0;
+	
+	_lruPrev = NULL;
+	_lruNext = NULL;
 }
 
 TextureStore::TextureStore(const TEXIMAGE_PARAM texAttributes, const u32 palAttributes)
@@ -443,6 +1394,9 @@ TextureStore::TextureStore(const TEXIMAGE_PARAM texAttributes, const u32 palAttr
 	_paletteAddress = (_packFormat == TEXMODE_I2) ? palAttributes << 3 : palAttributes << 4;
 	_paletteSize = paletteSizeList[_packFormat] * sizeof(u16);
 	
+	MemSpan currentPackedTexIndexMS;
+	MemSpan currentPaletteMS;
+	
 	if (_packFormat == TEXMODE_4X4)
 	{
 		const u32 indexBase = ((texAttributes.VRAMOffset & 0xC000) == 0x8000) ? 0x30000 : 0x20000;
@@ -456,7 +1410,7 @@ TextureStore::TextureStore(const TEXIMAGE_PARAM texAttributes, const u32 palAttr
 		_packIndexData = _packData + _packSize;
 		_paletteColorTable = (u16 *)(_packData + _packSize + _packIndexSize);
 		
-		MemSpan currentPackedTexIndexMS = MemSpan_TexMem(_packIndexAddress, _packIndexSize);
+		currentPackedTexIndexMS = MemSpan_TexMem(_packIndexAddress, _packIndexSize, false);
 		currentPackedTexIndexMS.dump(_packIndexData, _packIndexSize);
 	}
 	else
@@ -476,7 +1430,7 @@ TextureStore::TextureStore(const TEXIMAGE_PARAM texAttributes, const u32 palAttr
 	
 	if (_paletteSize > 0)
 	{
-		MemSpan currentPaletteMS = MemSpan_TexPalette(_paletteAddress, _paletteSize, false);
+		currentPaletteMS = MemSpan_TexPalette(_paletteAddress, _paletteSize, false);
 		
 #ifdef MSB_FIRST
 		currentPaletteMS.dump16(_paletteColorTable);
@@ -489,17 +1443,22 @@ TextureStore::TextureStore(const TEXIMAGE_PARAM texAttributes, const u32 palAttr
 		_paletteColorTable = NULL;
 	}
 	
-	MemSpan currentPackedTexDataMS = MemSpan_TexMem(_packAddress, _packSize);
+	MemSpan currentPackedTexDataMS = MemSpan_TexMem(_packAddress, _packSize, false);
 	currentPackedTexDataMS.dump(_packData);
 	_packSizeFirstSlot = currentPackedTexDataMS.items[0].len;
 	
+	_UpdateVRAMPageList(currentPackedTexDataMS, currentPackedTexIndexMS, currentPaletteMS);
+	
 	_suspectedInvalid = false;
 	_assumedInvalid = false;
 	_isLoadNeeded = true;
 	
 	_cacheSize = _packTotalSize;
-	_cacheAge = 0;
+	_cacheLastUseEpoch = texCache.GetCacheEpoch();
 	_cacheUsageCount = 0;
+	
+	_lruPrev = NULL;
+	_lruNext = NULL;
 }
 
 TextureStore::~TextureStore()
@@ -700,6 +1659,57 @@ void TextureStore::SetAssumedInvalid()
 	this->_assumedInvalid = true;
 }
 
+void TextureStore::_UpdateVRAMPageList(const MemSpan &packedData, const MemSpan &packedIndexData, const MemSpan &packedPalette)
+{
+	this->_vramPageCount = 0;
+	this->_isVRAMPageListTracked = MemSpan_AppendVRAMPages(packedData, this->_vramPageList, this->_vramPageCount, TEXCACHE_MAX_TRACKED_VRAM_PAGES) &&
+	                               MemSpan_AppendVRAMPages(packedIndexData, this->_vramPageList, this->_vramPageCount, TEXCACHE_MAX_TRACKED_VRAM_PAGES) &&
+	                               MemSpan_AppendVRAMPages(packedPalette, this->_vramPageList, this->_vramPageCount, TEXCACHE_MAX_TRACKED_VRAM_PAGES);
+	
+	this->_vramGeneration = (this->_isVRAMPageListTracked) ? VRAMPageListGeneration(this->_vramPageList, this->_vramPageCount) : 0;
+}
+
+bool TextureStore::IsVRAMUnchanged() const
+{
+	if (!this->_isVRAMPageListTracked)
+	{
+		return false;
+	}
+	
+	// Check that the texture still maps to the same physical pages, in the same order.
+	MemSpan currentPaletteMS;
+	MemSpan currentPackedTexIndexMS;
+	MemSpan currentPackedTexDataMS = MemSpan_TexMem(this->_packAddress, this->_packSize, true);
+	
+	if (this->_packFormat == TEXMODE_4X4)
+	{
+		currentPackedTexIndexMS = MemSpan_TexMem(this->_packIndexAddress, this->_packIndexSize, true);
+	}
+	
+	if (this->_paletteSize > 0)
+	{
+		currentPaletteMS = MemSpan_TexPalette(this->_paletteAddress, this->_paletteSize, true);
+	}
+	
+	u8 currentPageList[TEXCACHE_MAX_TRACKED_VRAM_PAGES];
+	size_t currentPageCount = 0;
+	
+	if ( !MemSpan_AppendVRAMPages(currentPackedTexDataMS, currentPageList, currentPageCount, TEXCACHE_MAX_TRACKED_VRAM_PAGES) ||
+	     !MemSpan_AppendVRAMPages(currentPackedTexIndexMS, currentPageList, currentPageCount, TEXCACHE_MAX_TRACKED_VRAM_PAGES) ||
+	     !MemSpan_AppendVRAMPages(currentPaletteMS, currentPageList, currentPageCount, TEXCACHE_MAX_TRACKED_VRAM_PAGES) )
+	{
+		return false;
+	}
+	
+	if ( (currentPageCount != this->_vramPageCount) || memcmp(currentPageList, this->_vramPageList, currentPageCount) )
+	{
+		return false;
+	}
+	
+	// Then check that none of those pages were written to.
+	return (VRAMPageListGeneration(currentPageList, currentPageCount) == this->_vramGeneration);
+}
+
 void TextureStore::SetLoadNeeded()
 {
 	this->_isLoadNeeded = true;
@@ -727,17 +1737,17 @@ void TextureStore::SetCacheSize(size_t cacheSize)
 
 size_t TextureStore::GetCacheAge() const
 {
-	return this->_cacheAge;
+	return texCache.GetCacheEpoch() - this->_cacheLastUseEpoch;
 }
 
 void TextureStore::IncreaseCacheAge(const size_t ageAmount)
 {
-	this->_cacheAge += ageAmount;
+	this->_cacheLastUseEpoch -= ageAmount;
 }
 
 void TextureStore::ResetCacheAge()
 {
-	this->_cacheAge = 0;
+	this->_cacheLastUseEpoch = texCache.GetCacheEpoch();
 }
 
 size_t TextureStore::GetCacheUseCount() const
@@ -758,16 +1768,17 @@ void TextureStore::ResetCacheUsageCount()
 void TextureStore::Update()
 {
 	MemSpan currentPaletteMS = MemSpan_TexPalette(this->_paletteAddress, this->_paletteSize, false);
-	MemSpan currentPackedTexDataMS = MemSpan_TexMem(this->_packAddress, this->_packSize);
+	MemSpan currentPackedTexDataMS = MemSpan_TexMem(this->_packAddress, this->_packSize, false);
 	MemSpan currentPackedTexIndexMS;
 	
 	if (this->_packFormat == TEXMODE_4X4)
 	{
-		currentPackedTexIndexMS = MemSpan_TexMem(this->_packIndexAddress, this->_packIndexSize);
+		currentPackedTexIndexMS = MemSpan_TexMem(this->_packIndexAddress, this->_packIndexSize, false);
 	}
 	
 	this->SetTextureData(currentPackedTexDataMS, currentPackedTexIndexMS);
 	this->SetTexturePalette(currentPaletteMS);
+	this->_UpdateVRAMPageList(currentPackedTexDataMS, currentPackedTexIndexMS, currentPaletteMS);
 	
 	this->_assumedInvalid = false;
 	this->_suspectedInvalid = false;
@@ -777,7 +1788,7 @@ void TextureStore::Update()
 void TextureStore::VRAMCompareAndUpdate()
 {
 	MemSpan currentPaletteMS = MemSpan_TexPalette(this->_paletteAddress, this->_paletteSize, false);
-	MemSpan currentPackedTexDataMS = MemSpan_TexMem(this->_packAddress, this->_packSize);
+	MemSpan currentPackedTexDataMS = MemSpan_TexMem(this->_packAddress, this->_packSize, false);
 	MemSpan currentPackedTexIndexMS;
 	
 	currentPackedTexDataMS.dump(this->_workingData);
@@ -785,7 +1796,7 @@ void TextureStore::VRAMCompareAndUpdate()
 	
 	if (this->_packFormat == TEXMODE_4X4)
 	{
-		currentPackedTexIndexMS = MemSpan_TexMem(this->_packIndexAddress, this->_packIndexSize);
+		currentPackedTexIndexMS = MemSpan_TexMem(this->_packIndexAddress, this->_packIndexSize, false);
 		currentPackedTexIndexMS.dump(this->_workingData + this->_packSize);
 	}
 	
@@ -823,6 +1834,8 @@ void TextureStore::VRAMCompareAndUpdate()
 		this->_isLoadNeeded = true;
 	}
 	
+	this->_UpdateVRAMPageList(currentPackedTexDataMS, currentPackedTexIndexMS, currentPaletteMS);
+	
 	this->_assumedInvalid = false;
 	this->_suspectedInvalid = false;
 }
@@ -1388,9 +2401,52 @@ void NDSTextureUnpackI4(const size_t srcSize, const u8 *__restrict srcData, cons
 	}
 }
 
+#if defined(ENABLE_AVX2)
+
+template <TextureStoreUnpackFormat TEXCACHEFORMAT, bool ISPALZEROTRANSPARENT>
+void __NDSTextureUnpackI8_AVX2(const size_t texelCount, const u8 *__restrict srcData, const u16 *__restrict srcPal, u32 *__restrict dstBuffer)
+{
+	// A 256 color palette is too big for any register-based table lookup, so convert the
+	// whole palette up front and then gather the converted colors straight from memory.
+	CACHE_ALIGN u32 palColor[256];
+	for (size_t i = 0; i < 256; i++)
+	{
+		palColor[i] = CONVERT(srcPal[i] & 0x7FFF);
+	}
+	
+	if (ISPALZEROTRANSPARENT)
+	{
+		palColor[0] = 0;
+	}
+	
+	for (size_t i = 0; i < texelCount; i+=sizeof(v256u8), srcData+=sizeof(v256u8), dstBuffer+=sizeof(v256u8))
+	{
+		const v256u8 idx = _mm256_loadu_si256((v256u8 *)srcData);
+		const v128u8 idxLo = _mm256_castsi256_si128(idx);
+		const v128u8 idxHi = _mm256_extracti128_si256(idx, 1);
+		
+		_mm256_store_si256( (v256u32 *)dstBuffer + 0, _mm256_i32gather_epi32((const int *)palColor, _mm256_cvtepu8_epi32(idxLo), sizeof(u32)) );
+		_mm256_store_si256( (v256u32 *)dstBuffer + 1, _mm256_i32gather_epi32((const int *)palColor, _mm256_cvtepu8_epi32(_mm_srli_si128(idxLo, 8)), sizeof(u32)) );
+		_mm256_store_si256( (v256u32 *)dstBuffer + 2, _mm256_i32gather_epi32((const int *)palColor, _mm256_cvtepu8_epi32(idxHi), sizeof(u32)) );
+		_mm256_store_si256( (v256u32 *)dstBuffer + 3, _mm256_i32gather_epi32((const int *)palColor, _mm256_cvtepu8_epi32(_mm_srli_si128(idxHi, 8)), sizeof(u32)) );
+	}
+}
+
+#endif
+
 template <TextureStoreUnpackFormat TEXCACHEFORMAT>
 void NDSTextureUnpackI8(const size_t srcSize, const u8 *__restrict srcData, const u16 *__restrict srcPal, const bool isPalZeroTransparent, u32 *__restrict dstBuffer)
 {
+#if defined(ENABLE_AVX2)
+	if (isPalZeroTransparent)
+	{
+		__NDSTextureUnpackI8_AVX2<TEXCACHEFORMAT, true>(srcSize, srcData, srcPal, dstBuffer);
+	}
+	else
+	{
+		__NDSTextureUnpackI8_AVX2<TEXCACHEFORMAT, false>(srcSize, srcData, srcPal, dstBuffer);
+	}
+#else
 	if (isPalZeroTransparent)
 	{
 		for (size_t i = 0; i < srcSize; i++, srcData++)
@@ -1406,9 +2462,40 @@ void NDSTextureUnpackI8(const size_t srcSize, const u8 *__restrict srcData, cons
 			*dstBuffer++ = LE_TO_LOCAL_32( CONVERT(srcPal[*srcData] & 0x7FFF) );
 		}
 	}
+#endif
+}
+
+#if defined(ENABLE_AVX2)
+
+template <TextureStoreUnpackFormat TEXCACHEFORMAT>
+void __NDSTextureUnpackA3I5_AVX2(const size_t texelCount, const u8 *__restrict srcData, const u16 *__restrict srcPal, u32 *__restrict dstBuffer)
+{
+	// Convert the 32 color palette without its alpha up front, then gather the colors and
+	// merge in the alpha, which is looked up from an 8-entry table held in a register.
+	CACHE_ALIGN u32 palColor[32];
+	for (size_t i = 0; i < 32; i++)
+	{
+		palColor[i] = (TEXCACHEFORMAT == TexFormat_15bpp) ? COLOR555TO666(srcPal[i] & 0x7FFF) : COLOR555TO888(srcPal[i] & 0x7FFF);
+	}
+	
+	const v256u32 alpha_LUT = (TEXCACHEFORMAT == TexFormat_15bpp) ?
+		_mm256_setr_epi32(material_3bit_to_5bit[0] << 24, material_3bit_to_5bit[1] << 24, material_3bit_to_5bit[2] << 24, material_3bit_to_5bit[3] << 24,
+		                  material_3bit_to_5bit[4] << 24, material_3bit_to_5bit[5] << 24, material_3bit_to_5bit[6] << 24, material_3bit_to_5bit[7] << 24) :
+		_mm256_setr_epi32(material_3bit_to_8bit[0] << 24, material_3bit_to_8bit[1] << 24, material_3bit_to_8bit[2] << 24, material_3bit_to_8bit[3] << 24,
+		                  material_3bit_to_8bit[4] << 24, material_3bit_to_8bit[5] << 24, material_3bit_to_8bit[6] << 24, material_3bit_to_8bit[7] << 24);
+	
+	for (size_t i = 0; i < texelCount; i+=(sizeof(v256u32)/sizeof(u32)), srcData+=(sizeof(v256u32)/sizeof(u32)), dstBuffer+=(sizeof(v256u32)/sizeof(u32)))
+	{
+		const v256u32 bits = _mm256_cvtepu8_epi32( _mm_loadl_epi64((v128u8 *)srcData) );
+		
+		const v256u32 palColor0 = _mm256_i32gather_epi32( (const int *)palColor, _mm256_and_si256(bits, _mm256_set1_epi32(0x1F)), sizeof(u32) );
+		const v256u32 alpha = _mm256_permutevar8x32_epi32( alpha_LUT, _mm256_srli_epi32(bits, 5) );
+		
+		_mm256_store_si256( (v256u32 *)dstBuffer, _mm256_or_si256(palColor0, alpha) );
+	}
 }
 
-#if defined(ENABLE_NEON_A64)
+#elif defined(ENABLE_NEON_A64)
 
 template <TextureStoreUnpackFormat TEXCACHEFORMAT>
 void __NDSTextureUnpackA3I5_NEON(const size_t texelCount, const u8 *__restrict srcData, const u16 *__restrict srcPal, u32 *__restrict dstBuffer)
@@ -1509,7 +2596,11 @@ void NDSTextureUnpackA3I5(const size_t srcSize, const u8 *__restrict srcData, co
 {
 	const size_t texelCount = srcSize / sizeof(u8);
 	
-#if defined(ENABLE_NEON_A64)
+#if defined(ENABLE_AVX2)
+	// x86 has no register-based table lookup that spans the whole 64 byte palette, but AVX2
+	// can gather from a pre-converted copy of it.
+	__NDSTextureUnpackA3I5_AVX2<TEXCACHEFORMAT>(texelCount, srcData, srcPal, dstBuffer);
+#elif defined(ENABLE_NEON_A64)
 	// Only ARM NEON-A64 can perform register-based table lookups across 64 bytes, which just
 	// so happens to be the size of the palette table we need to search. As of this writing,
 	// no other SIMD instruction sets we're currently using have this capability.
@@ -1872,6 +2963,30 @@ void NDSTextureUnpack4x4(const size_t srcSize, const u32 *__restrict srcData, co
 			//TODO - this could be more precise for 32bpp mode (run it through the color separation table)
 			
 			//set all 16 texels
+#if defined(ENABLE_SSSE3) || defined(ENABLE_NEON_A64)
+			// Each row of the block is a byte holding four 2-bit color indices. Spread each
+			// index out to a byte offset into tmp_col, then pull out the whole row at once.
+	#if defined(ENABLE_SSSE3)
+			const v128u32 blockColor = _mm_load_si128((v128u32 *)tmp_col);
+	#else
+			const v128u8 blockColor = vreinterpretq_u8_u32( vld1q_u32(tmp_col) );
+	#endif
+			
+			for (size_t sy = 0; sy < 4; sy++)
+			{
+				const size_t currentPos = (x<<2) + tmpPos[sy];
+				const u32 currRow = (currBlock>>(sy<<3)) & 0xFF;
+				const u32 rowOffsets = ((currRow & 0x03) << 2) | ((currRow & 0x0C) << 8) | ((currRow & 0x30) << 14) | ((currRow & 0xC0) << 20);
+				
+	#if defined(ENABLE_SSSE3)
+				const v128u8 rowShuffle = _mm_add_epi8( _mm_shuffle_epi8(_mm_cvtsi32_si128(rowOffsets), _mm_setr_epi8(0,0,0,0, 1,1,1,1, 2,2,2,2, 3,3,3,3)), _mm_set1_epi32(0x03020100) );
+				_mm_store_si128( (v128u32 *)(dstBuffer + currentPos), _mm_shuffle_epi8(blockColor, rowShuffle) );
+	#else
+				const v128u8 rowShuffle = vaddq_u8( vqtbl1q_u8(vreinterpretq_u8_u32(vdupq_n_u32(rowOffsets)), ((v128u8){0,0,0,0, 1,1,1,1, 2,2,2,2, 3,3,3,3})), vreinterpretq_u8_u32(vdupq_n_u32(0x03020100)) );
+				vst1q_u32( dstBuffer + currentPos, vreinterpretq_u32_u8(vqtbl1q_u8(blockColor, rowShuffle)) );
+	#endif
+			}
+#else
 			for (size_t sy = 0; sy < 4; sy++)
 			{
 				// Texture offset
@@ -1883,6 +2998,7 @@ void NDSTextureUnpack4x4(const size_t srcSize, const u32 *__restrict srcData, co
 				dstBuffer[currentPos+2] = tmp_col[(currRow>>4)&3];
 				dstBuffer[currentPos+3] = tmp_col[(currRow>>6)&3];
 			}
+#endif
 		}
 	}
 }
@@ -20,8 +20,10 @@
 #ifndef _TEXCACHE_H_
 #define _TEXCACHE_H_
 
-#include <map>
 #include <vector>
+#include <map>
+#include <deque>
+#include <string>
 
 #include "types.h"
 #include "common.h"
@@ -40,6 +42,11 @@
 
 #define PALETTE_DUMP_SIZE ((64+16+16)*1024)
 
+// The number of 16KB VRAM pages that a texture's data, index, and palette may cover
+// while still having its pages tracked. Textures that cover more pages than this are
+// always compared against VRAM when the VRAM mapping changes.
+#define TEXCACHE_MAX_TRACKED_VRAM_PAGES 48
+
 enum TextureStoreUnpackFormat
 {
 	TexFormat_None    = 0, //used when nothing yet is cached
@@ -47,22 +54,71 @@ enum TextureStoreUnpackFormat
 	TexFormat_15bpp        //used by rasterizer
 };
 
+// Number of worker threads that write new entries into the texture disk cache.
+#define TEXDISKCACHE_WORKER_COUNT 2
+
+// Maximum amount of texel data that may be waiting to be written to the texture disk
+// cache. New entries are dropped while this much data is still queued up.
+#define TEXDISKCACHE_MAX_PENDING_BYTES (64*1024*1024)
+
 class MemSpan;
 class TextureStore;
+class Task;
+
+struct slock;
+typedef slock slock_t;
+struct scond;
+typedef scond scond_t;
 
 typedef u64 TextureCacheKey;
-typedef std::map<TextureCacheKey, TextureStore *> TextureCacheMap; // Key = A TextureCacheKey that includes a combination of the texture's NDS texture attributes and palette attributes; Value = Pointer to the texture item
-typedef std::vector<TextureStore *> TextureCacheList;
 //typedef u32 TextureFingerprint;
 
+// Hash table that maps a TextureCacheKey (a combination of the texture's NDS texture
+// attributes and palette attributes) to its texture item. This uses open addressing
+// with linear probing, and backward-shift deletion so that no tombstones are left behind.
+class TextureCacheMap
+{
+protected:
+	struct Entry
+	{
+		TextureCacheKey key;
+		TextureStore *texItem; // NULL if this entry is empty
+	};
+	
+	Entry *_entry;
+	size_t _capacity;
+	size_t _count;
+	
+	static size_t _HashKey(const TextureCacheKey key);
+	void _Resize(const size_t newCapacity);
+	
+public:
+	TextureCacheMap();
+	~TextureCacheMap();
+	
+	size_t GetCount() const;
+	TextureStore* Find(const TextureCacheKey key) const;
+	void Insert(const TextureCacheKey key, TextureStore *texItem);
+	void Erase(const TextureCacheKey key);
+	void Clear();
+};
+
 class TextureCache
 {
 protected:
 	TextureCacheMap _texCacheMap;		// Used to quickly find a texture item by using a key of type TextureCacheKey
-	TextureCacheList _texCacheList;		// Used to sort existing texture items for various operations
+	TextureStore *_lruHead;				// Most recently used texture item
+	TextureStore *_lruTail;				// Least recently used texture item, which is the first one to be evicted
 	size_t _actualCacheSize;
 	size_t _cacheSizeThreshold;
+	size_t _cacheEpoch;					// Incremented on every call to Evict(), used for tracking the age of texture items
+	
 	u8 _paletteDump[PALETTE_DUMP_SIZE];
+	u8 _paletteDumpPageList[PALETTE_DUMP_SIZE / (16*1024)];
+	u64 _paletteDumpGeneration;
+	
+	void _LRUUnlink(TextureStore *texItem);
+	void _LRUPushFront(TextureStore *texItem);
 	
 public:
 	TextureCache();
@@ -70,6 +126,7 @@ public:
 	size_t GetActualCacheSize() const;
 	size_t GetCacheSizeThreshold() const;
 	void SetCacheSizeThreshold(size_t newThreshold);
+	size_t GetCacheEpoch() const;
 	
 	void Invalidate();
 	void Evict();
@@ -86,6 +143,8 @@ public:
 
 class TextureStore
 {
+	friend class TextureCache;
+	
 protected:
 	TEXIMAGE_PARAM _textureAttributes;
 	u32 _paletteAttributes;
@@ -116,11 +175,23 @@ protected:
 	bool _isLoadNeeded;
 	u8 *_workingData;
 	
+	// The physical VRAM pages covered by the texture's data, index, and palette as of the
+	// last time the texture was read from VRAM, along with the sum of their write generations.
+	u8 _vramPageList[TEXCACHE_MAX_TRACKED_VRAM_PAGES];
+	size_t _vramPageCount;
+	bool _isVRAMPageListTracked;
+	u64 _vramGeneration;
+	
 	TextureCacheKey _cacheKey;
 	size_t _cacheSize;
-	size_t _cacheAge; // A value of 0 means the texture was just used. The higher this value, the older the texture.
+	size_t _cacheLastUseEpoch; // The cache age is the number of cache epochs that passed since this one.
 	size_t _cacheUsageCount;
 	
+	TextureStore *_lruPrev;
+	TextureStore *_lruNext;
+	
+	void _UpdateVRAMPageList(const MemSpan &packedData, const MemSpan &packedIndexData, const MemSpan &packedPalette);
+	
 public:
 	TextureStore();
 	TextureStore(const TEXIMAGE_PARAM texAttributes, const u32 palAttributes);
@@ -161,6 +232,8 @@ public:
 	bool IsAssumedInvalid() const;
 	void SetAssumedInvalid();
 	
+	bool IsVRAMUnchanged() const;
+	
 	void SetLoadNeeded();
 	bool IsLoadNeeded() const;
 	
@@ -190,6 +263,92 @@ template<TextureStoreUnpackFormat TEXCACHEFORMAT> void NDSTextureUnpackA5I3(cons
 template<TextureStoreUnpackFormat TEXCACHEFORMAT> void NDSTextureUnpack4x4(const size_t srcSize, const u32 *__restrict srcData, const u16 *__restrict srcIndex, const u32 palAddress, const u32 sizeX, const u32 sizeY, u32 *__restrict dstBuffer);
 template<TextureStoreUnpackFormat TEXCACHEFORMAT> void NDSTextureUnpackDirect16Bit(const size_t srcSize, const u16 *__restrict srcData, u32 *__restrict dstBuffer);
 
+struct TextureDiskCacheKey
+{
+	u64 hash[2];
+	
+	bool operator<(const TextureDiskCacheKey &other) const
+	{
+		return (this->hash[0] != other.hash[0]) ? (this->hash[0] < other.hash[0]) : (this->hash[1] < other.hash[1]);
+	}
+};
+
+struct TextureDiskCacheEntry
+{
+	u64 offset; // File offset of the entry's texel data
+	u32 width;
+	u32 height;
+	u32 checksum;
+};
+
+struct TextureDiskCacheWriteJob
+{
+	TextureDiskCacheKey key;
+	u32 width;
+	u32 height;
+	u32 *data;
+};
+
+// Persistent, content-addressed store for textures that are expensive to produce, such as
+// deposterized and xBRZ-upscaled textures. Entries are keyed by a hash of the unpacked
+// texels and the processing parameters, so the same texture is found again regardless of
+// where it lives in VRAM or which game run produced it.
+//
+// All entries live in a single pack file in the cache directory. The file is memory-mapped
+// when the cache is opened, while entries that are created during the session are appended
+// to the file by a pool of worker threads so that texture loading never waits on disk I/O.
+// The file may be shared by several emulator instances, which coordinate through a file lock.
+class TextureDiskCache
+{
+protected:
+	std::string _directory;
+	std::string _filePath;
+	
+	FILE *_file;
+	u64 _fileEndOffset; // End of the part of the file that has been indexed
+	
+	u8 *_mappedData;
+	size_t _mappedSize;
+	
+	std::map<TextureDiskCacheKey, TextureDiskCacheEntry> _index;
+	std::map<TextureDiskCacheKey, bool> _pendingKeys;
+	std::deque<TextureDiskCacheWriteJob> _writeQueue;
+	size_t _pendingBytes;
+	
+	Task *_workerTask[TEXDISKCACHE_WORKER_COUNT];
+	bool _workerExit;
+	
+	slock_t *_mutexIndex;
+	slock_t *_mutexFile;
+	scond_t *_condWork;
+	
+	bool _MapFile();
+	void _UnmapFile();
+	bool _LockFile();
+	void _UnlockFile();
+	u64 _GetFileSize();
+	u64 _ScanFileEntries(u64 offset, const u64 fileSize);
+	bool _TruncateFile(const u64 fileSize);
+	void _WriteEntry(const TextureDiskCacheWriteJob &job);
+	
+public:
+	TextureDiskCache();
+	~TextureDiskCache();
+	
+	static TextureDiskCacheKey MakeKey(const u32 *texels, const size_t texelCount, const u32 sizeS, const u32 sizeT, const NDSTextureFormat packFormat, const size_t scalingFactor, const bool useDeposterize);
+	
+	bool Open(const char *directory);
+	void Close();
+	bool IsOpen() const;
+	void SetDirectory(const char *directory);
+	
+	bool Read(const TextureDiskCacheKey &key, const u32 width, const u32 height, u32 *dstBuffer);
+	void Write(const TextureDiskCacheKey &key, const u32 width, const u32 height, const u32 *srcBuffer);
+	
+	void WorkerLoop();
+};
+
 extern TextureCache texCache;
+extern TextureDiskCache textureDiskCache;
 
 #endif
@@ -17,6 +17,8 @@
 
 #include <stdio.h>
 #include <time.h>
+#include <sys/stat.h>
+#include <algorithm>
 
 #define TIXML_USE_STL
 #include "tinyxml/tinyxml.h"
@@ -33,67 +35,158 @@ ADVANsCEne advsc;
 #define _ADVANsCEne_BASE_VERSION_MINOR 0
 #define _ADVANsCEne_BASE_NAME "ADVANsCEne Nintendo DS Collection"
 
+// serial(8) + crc32(4) + save_type(1) = 13 + reserved(8) = 21
+#define _ADVANsCEne_RECORD_SIZE 21
+
+static inline const u8* ADVANsCEne_Record(const u8 *records, u32 i)
+{
+	return records + ((size_t)i * _ADVANsCEne_RECORD_SIZE);
+}
+
+static inline u32 ADVANsCEne_RecordCRC(const u8 *records, u32 i)
+{
+	return LE_TO_LOCAL_32(*(u32*)(ADVANsCEne_Record(records, i) + 8));
+}
+
+struct ADVANsCEne_SerialLess
+{
+	const u8 *records;
+	bool operator()(u32 a, u32 b) const { return memcmp(ADVANsCEne_Record(records, a) + 4, ADVANsCEne_Record(records, b) + 4, 4) < 0; }
+};
+
+struct ADVANsCEne_CRCLess
+{
+	const u8 *records;
+	bool operator()(u32 a, u32 b) const { return ADVANsCEne_RecordCRC(records, a) < ADVANsCEne_RecordCRC(records, b); }
+};
+
+u64 ADVANsCEne::getDatabaseStamp() const
+{
+	struct stat st;
+	if (stat(database_path.c_str(), &st) != 0)
+		return 0;
+
+	return ((u64)st.st_mtime << 32) ^ (u64)st.st_size;
+}
+
+void ADVANsCEne::freeIndex()
+{
+	ROMReaderUnmapImage(dbImage);
+	dbRecords = NULL;
+	dbStamp = 0;
+	indexBySerial.clear();
+	indexByCRC.clear();
+}
+
+bool ADVANsCEne::buildIndex()
+{
+	const u64 stamp = getDatabaseStamp();
+	if (dbRecords != NULL && stamp == dbStamp)
+		return true;
+
+	freeIndex();
+	if (stamp == 0)
+		return false;
+
+	void *fp = STDROMReader.Init(database_path.c_str());
+	if (!fp) return false;
+	const bool mapped = ROMReaderMapImage(&STDROMReader, fp, dbImage);
+	STDROMReader.DeInit(fp);
+	if (!mapped) return false;
+
+	const size_t idLen = strlen(_ADVANsCEne_BASE_ID);
+	const size_t headerSize = idLen + 2 + 4 + sizeof(time_t);
+	if (dbImage.size < headerSize || memcmp(dbImage.data, _ADVANsCEne_BASE_ID, idLen) != 0)
+	{
+		freeIndex();
+		return false;
+	}
+
+	memcpy(&versionBase[0], dbImage.data + idLen, 2);
+	memcpy(&version[0], dbImage.data + idLen + 2, 4);
+	memcpy(&createTime, dbImage.data + idLen + 6, sizeof(time_t));
+
+	dbRecords = dbImage.data + headerSize;
+	const u32 count = (u32)((dbImage.size - headerSize) / _ADVANsCEne_RECORD_SIZE);
+	indexBySerial.resize(count);
+	indexByCRC.resize(count);
+	for (u32 i = 0; i < count; i++)
+		indexBySerial[i] = indexByCRC[i] = i;
+
+	//stable, so that among equal keys the record that comes first in the file sorts first
+	ADVANsCEne_SerialLess serialLess = { dbRecords };
+	ADVANsCEne_CRCLess crcLess = { dbRecords };
+	std::stable_sort(indexBySerial.begin(), indexBySerial.end(), serialLess);
+	std::stable_sort(indexByCRC.begin(), indexByCRC.end(), crcLess);
+
+	dbStamp = stamp;
+	return true;
+}
+
 u8 ADVANsCEne::checkDB(const char *ROMserial, u32 crc)
 {
 	loaded = false;
-	FILE *fp = fopen(database_path.c_str(), "rb");
-	if (fp)
+	if (!buildIndex())
+		return false;
+
+	const u32 count = (u32)indexBySerial.size();
+	u32 match = count;
+
+	size_t lo = 0, hi = count;
+	while (lo < hi)
 	{
-		char buf[64];
-		memset(buf, 0, sizeof(buf));
-		if (fread(buf, 1, strlen(_ADVANsCEne_BASE_ID), fp) == strlen(_ADVANsCEne_BASE_ID))
-		{
-			//printf("ID: %s\n", buf);
-			if (strcmp(buf, _ADVANsCEne_BASE_ID) == 0)
-			{
-				if (fread(&versionBase[0], 1, 2, fp) == 2)
-				{
-					//printf("Version base: %i.%i\n", versionBase[0], versionBase[1]);
-					if (fread(&version[0], 1, 4, fp) == 4)
-					{
-						//printf("Version: %c%c%c%c\n", version[3], version[2], version[1], version[0]);
-						if (fread(&createTime, 1, sizeof(time_t), fp) == sizeof(time_t))
-						{
-							memset(buf, 0,sizeof(buf));
-							// serial(8) + crc32(4) + save_type(1) = 13 + reserved(8) = 21
-							while (true)
-							{
-								if (fread(buf, 1, 21, fp) != 21) break;
-
-								bool serialFound = (memcmp(&buf[4], ROMserial, 4) == 0);
-								u32 dbcrc = LE_TO_LOCAL_32(*(u32*)(buf+8));
-								bool crcFound = (crc == dbcrc);
-
-								if(serialFound || crcFound)
-								{
-									foundAsCrc = crcFound;
-									foundAsSerial = serialFound;
-									memcpy(&crc32, &buf[8], 4);
-									memcpy(&serial[0], &buf[4], 4);
-									//printf("%s founded: crc32=%04X, save type %02X\n", ROMserial, crc32, buf[12]);
-									saveType = buf[12];
-									fclose(fp);
-									loaded = true;
-									return true;
-								}
-							}
-						}
-					}
-				}
-			}
-		}
-		fclose(fp);
+		const size_t mid = (lo + hi) / 2;
+		if (memcmp(ADVANsCEne_Record(dbRecords, indexBySerial[mid]) + 4, ROMserial, 4) < 0) lo = mid + 1;
+		else hi = mid;
 	}
-	return false;
+	if (lo < count && memcmp(ADVANsCEne_Record(dbRecords, indexBySerial[lo]) + 4, ROMserial, 4) == 0)
+		match = indexBySerial[lo];
+
+	lo = 0; hi = count;
+	while (lo < hi)
+	{
+		const size_t mid = (lo + hi) / 2;
+		if (ADVANsCEne_RecordCRC(dbRecords, indexByCRC[mid]) < crc) lo = mid + 1;
+		else hi = mid;
+	}
+	if (lo < count && ADVANsCEne_RecordCRC(dbRecords, indexByCRC[lo]) == crc && indexByCRC[lo] < match)
+		match = indexByCRC[lo];
+
+	//whichever record comes first in the file wins, same as scanning the file would
+	if (match == count)
+		return false;
+
+	const u8 *buf = ADVANsCEne_Record(dbRecords, match);
+	foundAsSerial = (memcmp(&buf[4], ROMserial, 4) == 0);
+	foundAsCrc = (crc == ADVANsCEne_RecordCRC(dbRecords, match));
+	memcpy(&crc32, &buf[8], 4);
+	memcpy(&serial[0], &buf[4], 4);
+	//printf("%s founded: crc32=%04X, save type %02X\n", ROMserial, crc32, buf[12]);
+	saveType = buf[12];
+	loaded = true;
+	return true;
+}
+
+void ADVANsCEne::setResult(bool found, const char *ROMserial, u32 crc, u8 save_type, bool asSerial, bool asCrc)
+{
+	loaded = found;
+	if (!found)
+		return;
+
+	memcpy(&serial[0], ROMserial, 4);
+	crc32 = crc;
+	saveType = save_type;
+	foundAsSerial = asSerial;
+	foundAsCrc = asCrc;
 }
 
- 
 void ADVANsCEne::setDatabase(const char *path)
 {
 	database_path = path;
 	
 	//i guess this means it needs (re)loading on account of the path having changed
 	loaded = false;
+	freeIndex();
 }
 
 bool ADVANsCEne::getXMLConfig(const char *in_filename)
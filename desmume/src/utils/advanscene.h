@@ -16,7 +16,9 @@
 */
 
 #include <string>
+#include <vector>
 #include "../types.h"
+#include "../ROMReader.h"
 
 class EMUFILE;
 
@@ -34,6 +36,16 @@ private:
 	bool			loaded;
 	bool foundAsCrc, foundAsSerial;
 
+	// the database mapped in place, with its records sorted by serial and by crc for binary search.
+	// rebuilt whenever the database path or file stamp changes.
+	ROMReaderImage	dbImage;
+	const u8		*dbRecords;
+	u64				dbStamp;
+	std::vector<u32> indexBySerial;
+	std::vector<u32> indexByCRC;
+	bool buildIndex();
+	void freeIndex();
+
 	// XML
 	std::string datName;
 	std::string datVersion;
@@ -45,20 +57,30 @@ public:
 	ADVANsCEne()
 		: saveType(0xFF),
 		crc32(0),
-		loaded(false)
+		loaded(false),
+		dbRecords(NULL),
+		dbStamp(0)
 	{
 		memset(versionBase, 0, sizeof(versionBase));
 		memset(version, 0, sizeof(version));
 		memset(serial, 0, sizeof(serial));
+		memset(&dbImage, 0, sizeof(dbImage));
 	}
+	~ADVANsCEne() { freeIndex(); }
 	void setDatabase(const char *path);
 	std::string getDatabase() const { return database_path; }
 	u32 convertDB(const char *in_filename, EMUFILE &output);
 	u8 checkDB(const char *ROMserial, u32 crc);
+	// size and modification time of the database file, 0 if there is none
+	u64 getDatabaseStamp() const;
+	// restores the result of an earlier checkDB() against the same database
+	void setResult(bool found, const char *ROMserial, u32 crc, u8 save_type, bool asSerial, bool asCrc);
 	u32 getSaveType() { return saveType; }
 	u32 getCRC32() { return crc32; }
 	char *getSerial() { return serial; }
 	bool isLoaded() { return loaded; }
+	bool isFoundAsSerial() { return foundAsSerial; }
+	bool isFoundAsCrc() { return foundAsCrc; }
 	const char* getIdMethod() { 
 		if(foundAsSerial && foundAsCrc) return "Serial/CRC";
 		if(foundAsSerial) return "Serial";
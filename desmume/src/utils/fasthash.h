@@ -0,0 +1,130 @@
+/*
+	Copyright (C) 2026 DeSmuME team
+
+	This file is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with the this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _FASTHASH_H_
+#define _FASTHASH_H_
+
+#include <string.h>
+#include "../types.h"
+
+//Non-cryptographic 64-bit hash for fingerprinting emulator state (RAM, framebuffers, etc.).
+//This is the xxHash64 algorithm, so results can be checked against other implementations.
+//It is meant for detecting changes, not for anything that needs to resist tampering.
+
+#define FASTHASH_PRIME1 0x9E3779B185EBCA87ULL
+#define FASTHASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define FASTHASH_PRIME3 0x165667B19E3779F9ULL
+#define FASTHASH_PRIME4 0x85EBCA77C2B2AE63ULL
+#define FASTHASH_PRIME5 0x27D4EB2F165667C5ULL
+
+static FORCEINLINE u64 FastHash_Rotl64(const u64 x, const int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static FORCEINLINE u64 FastHash_Read64(const u8 *p)
+{
+	u64 v;
+	memcpy(&v, p, sizeof(v));
+	return LE_TO_LOCAL_64(v);
+}
+
+static FORCEINLINE u32 FastHash_Read32(const u8 *p)
+{
+	u32 v;
+	memcpy(&v, p, sizeof(v));
+	return LE_TO_LOCAL_32(v);
+}
+
+static FORCEINLINE u64 FastHash_Round(u64 acc, const u64 input)
+{
+	acc += input * FASTHASH_PRIME2;
+	acc = FastHash_Rotl64(acc, 31);
+	return acc * FASTHASH_PRIME1;
+}
+
+static FORCEINLINE u64 FastHash_MergeRound(u64 acc, const u64 val)
+{
+	acc ^= FastHash_Round(0, val);
+	return acc * FASTHASH_PRIME1 + FASTHASH_PRIME4;
+}
+
+static inline u64 FastHash64(const void *data, const size_t len, const u64 seed = 0)
+{
+	const u8 *p = (const u8 *)data;
+	const u8 *const end = p + len;
+	u64 h;
+	
+	if (len >= 32)
+	{
+		// Four independent lanes, so the multiplies of each stripe can overlap.
+		const u8 *const limit = end - 32;
+		u64 v1 = seed + FASTHASH_PRIME1 + FASTHASH_PRIME2;
+		u64 v2 = seed + FASTHASH_PRIME2;
+		u64 v3 = seed;
+		u64 v4 = seed - FASTHASH_PRIME1;
+		
+		do
+		{
+			v1 = FastHash_Round(v1, FastHash_Read64(p));      p += 8;
+			v2 = FastHash_Round(v2, FastHash_Read64(p));      p += 8;
+			v3 = FastHash_Round(v3, FastHash_Read64(p));      p += 8;
+			v4 = FastHash_Round(v4, FastHash_Read64(p));      p += 8;
+		} while (p <= limit);
+		
+		h = FastHash_Rotl64(v1, 1) + FastHash_Rotl64(v2, 7) + FastHash_Rotl64(v3, 12) + FastHash_Rotl64(v4, 18);
+		h = FastHash_MergeRound(h, v1);
+		h = FastHash_MergeRound(h, v2);
+		h = FastHash_MergeRound(h, v3);
+		h = FastHash_MergeRound(h, v4);
+	}
+	else
+	{
+		h = seed + FASTHASH_PRIME5;
+	}
+	
+	h += (u64)len;
+	
+	for (; p + 8 <= end; p += 8)
+	{
+		h ^= FastHash_Round(0, FastHash_Read64(p));
+		h = FastHash_Rotl64(h, 27) * FASTHASH_PRIME1 + FASTHASH_PRIME4;
+	}
+	
+	if (p + 4 <= end)
+	{
+		h ^= (u64)FastHash_Read32(p) * FASTHASH_PRIME1;
+		h = FastHash_Rotl64(h, 23) * FASTHASH_PRIME2 + FASTHASH_PRIME3;
+		p += 4;
+	}
+	
+	for (; p < end; p++)
+	{
+		h ^= (*p) * FASTHASH_PRIME5;
+		h = FastHash_Rotl64(h, 11) * FASTHASH_PRIME1;
+	}
+	
+	h ^= h >> 33;
+	h *= FASTHASH_PRIME2;
+	h ^= h >> 29;
+	h *= FASTHASH_PRIME3;
+	h ^= h >> 32;
+	
+	return h;
+}
+
+#endif
@@ -27,6 +27,9 @@
 #include <driver.h>
 #include <registers.h>
 #include <rthreads/rthreads.h>
+#include <algorithm>
+#include <atomic>
+#include <time.h>
 
 #ifdef HOST_WINDOWS
 #include <winsock2.h>
@@ -44,6 +47,9 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <sched.h>
 #define socket_t    int
 #define sockaddr_t  struct sockaddr
 #define closesocket close
@@ -3296,6 +3302,15 @@ WifiCommInterface::~WifiCommInterface()
 	slock_free(this->_mutexRXThreadRunningFlag);
 }
 
+bool WifiCommInterface::IsRXThreadRunning()
+{
+	slock_lock(this->_mutexRXThreadRunningFlag);
+	const bool isRunning = this->_isRXThreadRunning;
+	slock_unlock(this->_mutexRXThreadRunningFlag);
+
+	return isRunning;
+}
+
 AdhocCommInterface::AdhocCommInterface()
 {
 	_commInterfaceID = WifiCommInterfaceID_AdHoc;
@@ -3534,6 +3549,726 @@ void AdhocCommInterface::RXPacketGet()
 	slock_unlock(this->_mutexRXThreadRunningFlag);
 }
 
+// Shared-memory layout of an ad-hoc link. All fields start out zeroed, which is already a
+// valid empty link, so whichever instance maps the segment first doesn't need to set it up.
+struct WifiAdhocLinkSlot
+{
+	std::atomic<u32> tag;			// Ring sequence number of the packet in this slot, or 0 while it is being written
+	u32 senderID;
+	u32 senderSequence;
+	u32 length;						// DesmumeFrameHeader plus the IEEE 802.11 frame
+	u64 timeStamp;					// Sender's emulated time (nds_timer) when the packet was sent
+	u8 data[sizeof(DesmumeFrameHeader) + MAX_PACKET_SIZE_80211];
+};
+
+struct WifiAdhocLinkSharedData
+{
+	std::atomic<u32> writeSequence;
+	std::atomic<u32> attachedMask;
+	std::atomic<u64> emulatedTime[WIFI_ADHOC_LINK_MAX_INSTANCES]; // Every packet an instance stamped up to this time is in the ring.
+	WifiAdhocLinkSlot slot[WIFI_ADHOC_LINK_SLOT_COUNT];
+};
+
+#define WIFI_ADHOC_LINK_CYCLES_PER_USEC 67 // Same as kWifiCycles in NDSSystem.cpp
+#define WIFI_ADHOC_LINK_STALL_TIMEOUT 10 // In seconds
+
+static void WIFI_AdhocLinkYield()
+{
+#ifdef HOST_WINDOWS
+	Sleep(0);
+#else
+	sched_yield();
+#endif
+}
+
+static bool WIFI_AdhocLinkPacketOrder(const WifiAdhocLinkPendingPacket& a, const WifiAdhocLinkPendingPacket& b)
+{
+	if(a.dueTime != b.dueTime)
+	{
+		return (a.dueTime < b.dueTime);
+	}
+
+	if(a.senderID != b.senderID)
+	{
+		return (a.senderID < b.senderID);
+	}
+
+	return ((s32)(a.senderSequence - b.senderSequence) < 0);
+}
+
+SharedMemoryAdhocCommInterface::SharedMemoryAdhocCommInterface()
+{
+	_commInterfaceID = WifiCommInterfaceID_AdHoc;
+
+	_linkName = "desmume-adhoc";
+	_instanceID = 0;
+	_isLockstep = false;
+	_latencyCycles = WIFI_ADHOC_LINK_DEFAULT_LATENCY * WIFI_ADHOC_LINK_CYCLES_PER_USEC;
+
+	_linkHandle = NULL;
+	_link = NULL;
+	_readSequence = 0;
+	_txSequence = 0;
+	_nextEventTime = 0;
+	memset(_peerTimeSeen, 0, sizeof(_peerTimeSeen));
+}
+
+SharedMemoryAdhocCommInterface::~SharedMemoryAdhocCommInterface()
+{
+	this->Stop();
+}
+
+void SharedMemoryAdhocCommInterface::SetLink(const char* linkName, u32 instanceID, bool isLockstep, u32 latencyUsec)
+{
+	if((linkName != NULL) && (*linkName != '\0'))
+	{
+		this->_linkName = linkName;
+	}
+
+	this->_instanceID = instanceID;
+	this->_isLockstep = isLockstep;
+	this->_latencyCycles = (u64)((latencyUsec == 0) ? WIFI_ADHOC_LINK_DEFAULT_LATENCY : latencyUsec) * WIFI_ADHOC_LINK_CYCLES_PER_USEC;
+}
+
+bool SharedMemoryAdhocCommInterface::IsLockstep() const
+{
+	return this->_isLockstep;
+}
+
+bool SharedMemoryAdhocCommInterface::_MapLink()
+{
+	const size_t linkSize = sizeof(WifiAdhocLinkSharedData);
+
+#ifdef HOST_WINDOWS
+	std::string mappingName = "Local\\" + this->_linkName;
+	HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)linkSize, mappingName.c_str());
+	if(mapping == NULL)
+	{
+		WIFI_LOG(1, "Ad-hoc link: Failed to create the file mapping \"%s\".\n", mappingName.c_str());
+		return false;
+	}
+
+	void* linkMemory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, linkSize);
+	if(linkMemory == NULL)
+	{
+		CloseHandle(mapping);
+		WIFI_LOG(1, "Ad-hoc link: Failed to map \"%s\".\n", mappingName.c_str());
+		return false;
+	}
+
+	this->_linkHandle = mapping;
+#else
+	// POSIX shared memory names need a leading slash. The segment is deliberately never
+	// unlinked, since other instances may still be attached to it.
+	std::string shmName = "/" + this->_linkName;
+	int shmFD = shm_open(shmName.c_str(), O_RDWR | O_CREAT, 0600);
+	if(shmFD < 0)
+	{
+		WIFI_LOG(1, "Ad-hoc link: Failed to open the shared memory \"%s\".\n", shmName.c_str());
+		return false;
+	}
+
+	if(ftruncate(shmFD, linkSize) < 0)
+	{
+		close(shmFD);
+		WIFI_LOG(1, "Ad-hoc link: Failed to size the shared memory \"%s\".\n", shmName.c_str());
+		return false;
+	}
+
+	void* linkMemory = mmap(NULL, linkSize, PROT_READ | PROT_WRITE, MAP_SHARED, shmFD, 0);
+	close(shmFD);
+
+	if(linkMemory == MAP_FAILED)
+	{
+		WIFI_LOG(1, "Ad-hoc link: Failed to map \"%s\".\n", shmName.c_str());
+		return false;
+	}
+#endif
+
+	this->_link = (WifiAdhocLinkSharedData*)linkMemory;
+	return true;
+}
+
+void SharedMemoryAdhocCommInterface::_UnmapLink()
+{
+	if(this->_link == NULL)
+	{
+		return;
+	}
+
+#ifdef HOST_WINDOWS
+	UnmapViewOfFile(this->_link);
+	CloseHandle((HANDLE)this->_linkHandle);
+	this->_linkHandle = NULL;
+#else
+	munmap(this->_link, sizeof(WifiAdhocLinkSharedData));
+#endif
+
+	this->_link = NULL;
+}
+
+bool SharedMemoryAdhocCommInterface::Start(WifiHandler* currentWifiHandler)
+{
+	if(this->_instanceID >= WIFI_ADHOC_LINK_MAX_INSTANCES)
+	{
+		WIFI_LOG(1, "Ad-hoc link: Instance ID %u is out of range (0-%i).\n", this->_instanceID, WIFI_ADHOC_LINK_MAX_INSTANCES - 1);
+		return false;
+	}
+
+	if(!this->_MapLink())
+	{
+		return false;
+	}
+
+	WifiAdhocLinkSharedData& link = *this->_link;
+	const u32 instanceBit = 1 << this->_instanceID;
+
+	// Peers in lockstep will wait for this instance to catch up from power-on.
+	link.emulatedTime[this->_instanceID].store(0, std::memory_order_release);
+	if(link.attachedMask.fetch_or(instanceBit, std::memory_order_acq_rel) & instanceBit)
+	{
+		WIFI_LOG(1, "Ad-hoc link: Instance %u was already attached to \"%s\"; taking it over.\n", this->_instanceID, this->_linkName.c_str());
+	}
+
+	// Only packets sent from now on are received.
+	this->_readSequence = link.writeSequence.load(std::memory_order_acquire);
+	this->_txSequence = 0;
+	this->_nextEventTime = 0;
+	memset(this->_peerTimeSeen, 0, sizeof(this->_peerTimeSeen));
+	this->_pendingPacket.clear();
+
+	this->_wifiHandler = currentWifiHandler;
+	this->_rawPacket = (RXRawPacketData*)calloc(1, sizeof(RXRawPacketData));
+
+	WIFI_LOG(1, "Ad-hoc link: Attached to \"%s\" as instance %u%s.\n", this->_linkName.c_str(), this->_instanceID, (this->_isLockstep) ? " in lockstep" : "");
+	return true;
+}
+
+void SharedMemoryAdhocCommInterface::Stop()
+{
+	if(this->_link != NULL)
+	{
+		this->_link->attachedMask.fetch_and(~(u32)(1 << this->_instanceID), std::memory_order_acq_rel);
+		this->_UnmapLink();
+	}
+
+	this->_pendingPacket.clear();
+
+	free(this->_rawPacket);
+	this->_rawPacket = NULL;
+	this->_wifiHandler = NULL;
+}
+
+size_t SharedMemoryAdhocCommInterface::TXPacketSend(u8* txTargetBuffer, size_t txLength)
+{
+	if((this->_link == NULL) || (txTargetBuffer == NULL) || (txLength == 0) || (txLength > sizeof(WifiAdhocLinkPendingPacket::data)))
+	{
+		return 0;
+	}
+
+	WifiAdhocLinkSharedData& link = *this->_link;
+
+	// Claim a slot. Sequence number 0 is reserved for marking a slot that is being written.
+	u32 sequence;
+	do
+	{
+		sequence = link.writeSequence.fetch_add(1, std::memory_order_acq_rel) + 1;
+	} while(sequence == 0);
+
+	WifiAdhocLinkSlot& slot = link.slot[sequence % WIFI_ADHOC_LINK_SLOT_COUNT];
+	slot.tag.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.senderID = this->_instanceID;
+	slot.senderSequence = this->_txSequence++;
+	slot.length = (u32)txLength;
+	slot.timeStamp = nds_timer;
+	memcpy(slot.data, txTargetBuffer, txLength);
+
+	slot.tag.store(sequence, std::memory_order_release);
+
+	WIFI_LOG(4, "Ad-hoc link: sent %i bytes of packet, frame control: %04X\n", (int)txLength, *(u16*)(txTargetBuffer + sizeof(DesmumeFrameHeader)));
+	return txLength;
+}
+
+void SharedMemoryAdhocCommInterface::_ReadRing()
+{
+	WifiAdhocLinkSharedData& link = *this->_link;
+
+	for(;;)
+	{
+		const u32 sequence = this->_readSequence + 1;
+		if(sequence == 0)
+		{
+			this->_readSequence = sequence; // Senders never use this one.
+			continue;
+		}
+
+		WifiAdhocLinkSlot& slot = link.slot[sequence % WIFI_ADHOC_LINK_SLOT_COUNT];
+		const u32 tag = slot.tag.load(std::memory_order_acquire);
+
+		if(tag != sequence)
+		{
+			if((tag == 0) || ((s32)(tag - sequence) < 0))
+			{
+				break; // Not written yet.
+			}
+
+			// A sender has lapped this instance, so the packets in between are gone.
+			const u32 newReadSequence = link.writeSequence.load(std::memory_order_acquire) - WIFI_ADHOC_LINK_SLOT_COUNT;
+			WIFI_LOG(1, "Ad-hoc link: Instance %u fell behind and dropped %u packets.\n", this->_instanceID, newReadSequence - this->_readSequence);
+			this->_readSequence = newReadSequence;
+			continue;
+		}
+
+		if(slot.senderID != this->_instanceID)
+		{
+			this->_pendingPacket.resize(this->_pendingPacket.size() + 1);
+			WifiAdhocLinkPendingPacket& newPacket = this->_pendingPacket.back();
+
+			newPacket.senderID = slot.senderID;
+			newPacket.senderSequence = slot.senderSequence;
+			newPacket.dueTime = (this->_isLockstep) ? slot.timeStamp + this->_latencyCycles : 0;
+			newPacket.length = std::min<u32>(slot.length, sizeof(newPacket.data));
+			memcpy(newPacket.data, slot.data, newPacket.length);
+
+			// If the slot was reused while it was being copied, the next pass takes the lapped path above.
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(slot.tag.load(std::memory_order_relaxed) != sequence)
+			{
+				this->_pendingPacket.pop_back();
+				continue;
+			}
+
+			const DesmumeFrameHeader& emulatorHeader = (DesmumeFrameHeader&)newPacket.data[0];
+			if((newPacket.length < sizeof(DesmumeFrameHeader)) || ((sizeof(DesmumeFrameHeader) + emulatorHeader.emuPacketSize) != newPacket.length))
+			{
+				this->_pendingPacket.pop_back();
+			}
+		}
+
+		this->_readSequence = sequence;
+	}
+}
+
+void SharedMemoryAdhocCommInterface::_DeliverPending(const u64 emulatedTime)
+{
+	if(this->_pendingPacket.empty())
+	{
+		return;
+	}
+
+	if(this->_isLockstep)
+	{
+		std::sort(this->_pendingPacket.begin(), this->_pendingPacket.end(), &WIFI_AdhocLinkPacketOrder);
+	}
+
+	size_t deliverCount = 0;
+	while((deliverCount < this->_pendingPacket.size()) && (this->_pendingPacket[deliverCount].dueTime <= emulatedTime))
+	{
+		deliverCount++;
+	}
+
+	RXRawPacketData& rawPacket = *this->_rawPacket;
+	rawPacket.writeLocation = 0;
+	rawPacket.count = 0;
+
+	for(size_t i = 0; i < deliverCount; i++)
+	{
+		const WifiAdhocLinkPendingPacket& packet = this->_pendingPacket[i];
+
+		if((rawPacket.writeLocation + packet.length) > sizeof(rawPacket.buffer))
+		{
+			this->_wifiHandler->RXPacketRawToQueue<false>(rawPacket);
+			rawPacket.writeLocation = 0;
+			rawPacket.count = 0;
+		}
+
+		memcpy(&rawPacket.buffer[rawPacket.writeLocation], packet.data, packet.length);
+		rawPacket.writeLocation += packet.length;
+		rawPacket.count++;
+	}
+
+	if(rawPacket.count > 0)
+	{
+		this->_wifiHandler->RXPacketRawToQueue<false>(rawPacket);
+	}
+
+	this->_pendingPacket.erase(this->_pendingPacket.begin(), this->_pendingPacket.begin() + deliverCount);
+}
+
+u64 SharedMemoryAdhocCommInterface::_WaitForPeers(const u64 emulatedTime)
+{
+	WifiAdhocLinkSharedData& link = *this->_link;
+	time_t stallStartTime = 0;
+
+	for(;;)
+	{
+		const u32 peerMask = link.attachedMask.load(std::memory_order_acquire) & ~(u32)(1 << this->_instanceID);
+		u64 horizon = ~(u64)0;
+		u32 laggingMask = 0;
+		bool didPeerAdvance = false;
+
+		for(u32 i = 0; i < WIFI_ADHOC_LINK_MAX_INSTANCES; i++)
+		{
+			if((peerMask & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			const u64 peerTime = link.emulatedTime[i].load(std::memory_order_acquire);
+			if(peerTime != this->_peerTimeSeen[i])
+			{
+				this->_peerTimeSeen[i] = peerTime;
+				didPeerAdvance = true;
+			}
+
+			// This instance may run until latency past where its slowest peer is, since any packet
+			// that peer sends from then on won't be due here before that.
+			const u64 peerHorizon = peerTime + this->_latencyCycles;
+			if(peerHorizon < horizon)
+			{
+				horizon = peerHorizon;
+			}
+
+			if(peerHorizon < emulatedTime)
+			{
+				laggingMask |= (1 << i);
+			}
+		}
+
+		if(laggingMask == 0)
+		{
+			return horizon;
+		}
+
+		// Drop peers that don't move at all for a long time, so that an instance that crashed
+		// without detaching can't hang the rest of the group.
+		const time_t currentTime = time(NULL);
+		if(didPeerAdvance || (stallStartTime == 0))
+		{
+			stallStartTime = currentTime;
+		}
+		else if((currentTime - stallStartTime) >= WIFI_ADHOC_LINK_STALL_TIMEOUT)
+		{
+			WIFI_LOG(1, "Ad-hoc link: Peers %08X stopped responding; detaching them from \"%s\".\n", laggingMask, this->_linkName.c_str());
+			link.attachedMask.fetch_and(~laggingMask, std::memory_order_acq_rel);
+			stallStartTime = 0;
+			continue;
+		}
+
+		WIFI_AdhocLinkYield();
+	}
+}
+
+void SharedMemoryAdhocCommInterface::Trigger(const u64 emulatedTime)
+{
+	if((this->_link == NULL) || (emulatedTime < this->_nextEventTime))
+	{
+		return;
+	}
+
+	// Without lockstep, just poll the ring once per latency period.
+	u64 nextEventTime = emulatedTime + this->_latencyCycles;
+
+	if(this->_isLockstep)
+	{
+		// Packets sent during this trigger get stamped with emulatedTime, so only the ones
+		// before it are known to be in the ring.
+		this->_link->emulatedTime[this->_instanceID].store((emulatedTime > 0) ? emulatedTime - 1 : 0, std::memory_order_release);
+
+		const u64 horizon = this->_WaitForPeers(emulatedTime);
+		if(horizon != ~(u64)0)
+		{
+			nextEventTime = horizon + 1;
+		}
+	}
+
+	this->_ReadRing();
+	this->_DeliverPending(emulatedTime);
+
+	if(!this->_pendingPacket.empty() && (this->_pendingPacket.front().dueTime < nextEventTime))
+	{
+		nextEventTime = this->_pendingPacket.front().dueTime;
+	}
+
+	this->_nextEventTime = nextEventTime;
+}
+
+void SharedMemoryAdhocCommInterface::RXPacketGet()
+{
+	if((this->_link == NULL) || (this->_rawPacket == NULL) || (this->_wifiHandler == NULL))
+	{
+		return;
+	}
+
+	this->_ReadRing();
+	this->_DeliverPending(nds_timer);
+}
+
+static u32 WIFI_CaptureRead32(u32 value, bool isByteSwapped)
+{
+	if(isByteSwapped)
+	{
+		return ((value & 0x000000FF) << 24) | ((value & 0x0000FF00) << 8) | ((value & 0x00FF0000) >> 8) | ((value & 0xFF000000) >> 24);
+	}
+
+	return value;
+}
+
+ReplayCommInterface::ReplayCommInterface()
+{
+	_commInterfaceID = WifiCommInterfaceID_Infrastructure;
+
+	_rxIndex = 0;
+	_txIndex = 0;
+	_txMatchCount = 0;
+	_txMismatchCount = 0;
+}
+
+ReplayCommInterface::~ReplayCommInterface()
+{
+	this->Stop();
+}
+
+const char* ReplayCommInterface::GetFileName() const
+{
+	return this->_fileName.c_str();
+}
+
+void ReplayCommInterface::SetFileName(const char* fileName)
+{
+	this->_fileName = (fileName != NULL) ? fileName : "";
+}
+
+size_t ReplayCommInterface::GetTXMatchCount() const
+{
+	return this->_txMatchCount;
+}
+
+size_t ReplayCommInterface::GetTXMismatchCount() const
+{
+	return this->_txMismatchCount;
+}
+
+size_t ReplayCommInterface::GetRXRemainingCount() const
+{
+	return this->_rxPacket.size() - this->_rxIndex;
+}
+
+bool ReplayCommInterface::_LoadCapture()
+{
+	this->_captureData.clear();
+	this->_rxPacket.clear();
+	this->_txPacket.clear();
+
+	FILE* captureFile = fopen(this->_fileName.c_str(), "rb");
+	if(captureFile == NULL)
+	{
+		WIFI_LOG(1, "Replay: Can't open capture file %s\n", this->_fileName.c_str());
+		return false;
+	}
+
+	// Global header: magic, version, time zone, timestamp accuracy, snapshot length, link type
+	u32 fileHeader[6];
+	if(fread(fileHeader, sizeof(u32), 6, captureFile) != 6)
+	{
+		fclose(captureFile);
+		WIFI_LOG(1, "Replay: %s is too short to be a capture file.\n", this->_fileName.c_str());
+		return false;
+	}
+
+	bool isByteSwapped = false;
+	bool isNanoseconds = false;
+
+	switch(fileHeader[0])
+	{
+		case 0xA1B2C3D4: break;
+		case 0xD4C3B2A1: isByteSwapped = true; break;
+		case 0xA1B23C4D: isNanoseconds = true; break;
+		case 0x4D3CB2A1: isByteSwapped = true; isNanoseconds = true; break;
+
+		default:
+			fclose(captureFile);
+			WIFI_LOG(1, "Replay: %s is not a libpcap capture file.\n", this->_fileName.c_str());
+			return false;
+	}
+
+	const u32 linkType = WIFI_CaptureRead32(fileHeader[5], isByteSwapped);
+	if(linkType != 0x00000001)
+	{
+		fclose(captureFile);
+		WIFI_LOG(1, "Replay: %s has link type %u, but only Ethernet captures can be replayed.\n", this->_fileName.c_str(), linkType);
+		return false;
+	}
+
+	// Record header: seconds, microseconds (or nanoseconds), captured length, original length
+	u32 recordHeader[4];
+	while(fread(recordHeader, sizeof(u32), 4, captureFile) == 4)
+	{
+		const u32 seconds = WIFI_CaptureRead32(recordHeader[0], isByteSwapped);
+		const u32 fraction = WIFI_CaptureRead32(recordHeader[1], isByteSwapped);
+		const size_t length = WIFI_CaptureRead32(recordHeader[2], isByteSwapped);
+
+		if(length > PACKET_SIZE)
+		{
+			WIFI_LOG(1, "Replay: %s has a corrupted record; ignoring the rest of the file.\n", this->_fileName.c_str());
+			break;
+		}
+
+		WifiReplayPacket newPacket;
+		newPacket.timeStamp = ((u64)seconds * 1000000) + ((isNanoseconds) ? fraction / 1000 : fraction);
+		newPacket.offset = this->_captureData.size();
+		newPacket.length = length;
+
+		this->_captureData.resize(newPacket.offset + length);
+		if((length > 0) && (fread(&this->_captureData[newPacket.offset], 1, length, captureFile) != length))
+		{
+			this->_captureData.resize(newPacket.offset);
+			break;
+		}
+
+		// Skip frames that are too small to use or too big to fit in an IEEE 802.11 frame.
+		if((length <= sizeof(EthernetFrameHeader)) ||
+		   ((length - sizeof(EthernetFrameHeader) + sizeof(WifiDataFrameHeaderDS2STA) + sizeof(WifiLLCSNAPHeader)) > MAX_PACKET_SIZE_80211))
+		{
+			this->_captureData.resize(newPacket.offset);
+			continue;
+		}
+
+		const EthernetFrameHeader& IEEE8023Header = (EthernetFrameHeader&)this->_captureData[newPacket.offset];
+		if(WIFI_compareMAC(IEEE8023Header.sendMAC, FW_Mac))
+		{
+			this->_txPacket.push_back(newPacket);
+		}
+		else
+		{
+			this->_rxPacket.push_back(newPacket);
+		}
+	}
+
+	fclose(captureFile);
+
+	// Our own captures use emulated time. Anything else carries wall-clock time, so start
+	// those from the beginning of the session instead.
+	const u64 firstTimeStamp = std::min<u64>((this->_rxPacket.empty()) ? ~(u64)0 : this->_rxPacket.front().timeStamp,
+	                                         (this->_txPacket.empty()) ? ~(u64)0 : this->_txPacket.front().timeStamp);
+	const u64 oneDay = (u64)24 * 60 * 60 * 1000000;
+
+	if((firstTimeStamp != ~(u64)0) && (firstTimeStamp >= oneDay))
+	{
+		for(size_t i = 0; i < this->_rxPacket.size(); i++)
+		{
+			this->_rxPacket[i].timeStamp -= firstTimeStamp;
+		}
+
+		for(size_t i = 0; i < this->_txPacket.size(); i++)
+		{
+			this->_txPacket[i].timeStamp -= firstTimeStamp;
+		}
+	}
+
+	return true;
+}
+
+bool ReplayCommInterface::Start(WifiHandler* currentWifiHandler)
+{
+	if(!this->_LoadCapture())
+	{
+		return false;
+	}
+
+	this->_rxIndex = 0;
+	this->_txIndex = 0;
+	this->_txMatchCount = 0;
+	this->_txMismatchCount = 0;
+
+	this->_wifiHandler = currentWifiHandler;
+	this->_rawPacket = (RXRawPacketData*)calloc(1, sizeof(RXRawPacketData));
+
+	WIFI_LOG(1, "Replay: Loaded %i RX and %i TX packets from %s\n", (int)this->_rxPacket.size(), (int)this->_txPacket.size(), this->_fileName.c_str());
+	return true;
+}
+
+void ReplayCommInterface::Stop()
+{
+	if(this->_wifiHandler != NULL)
+	{
+		WIFI_LOG(1, "Replay: %i of %i TX packets matched, %i did not; %i RX packets were not delivered.\n",
+			(int)this->_txMatchCount, (int)this->_txPacket.size(), (int)this->_txMismatchCount, (int)this->GetRXRemainingCount());
+	}
+
+	free(this->_rawPacket);
+	this->_rawPacket = NULL;
+	this->_wifiHandler = NULL;
+}
+
+size_t ReplayCommInterface::TXPacketSend(u8* txTargetBuffer, size_t txLength)
+{
+	if((this->_wifiHandler == NULL) || (txTargetBuffer == NULL) || (txLength == 0))
+	{
+		return 0;
+	}
+
+	if(this->_txIndex >= this->_txPacket.size())
+	{
+		this->_txMismatchCount++;
+		WIFI_LOG(1, "Replay: TX packet %i at %llu usec was not in the capture.\n", (int)this->_txIndex, (unsigned long long)this->_wifiHandler->GetWifiData().usecCounter);
+	}
+	else
+	{
+		const WifiReplayPacket& expectedPacket = this->_txPacket[this->_txIndex];
+
+		if((expectedPacket.length == txLength) && (memcmp(&this->_captureData[expectedPacket.offset], txTargetBuffer, txLength) == 0))
+		{
+			this->_txMatchCount++;
+		}
+		else
+		{
+			this->_txMismatchCount++;
+			WIFI_LOG(1, "Replay: TX packet %i at %llu usec doesn't match the capture (%i bytes, expected %i bytes at %llu usec).\n",
+				(int)this->_txIndex, (unsigned long long)this->_wifiHandler->GetWifiData().usecCounter,
+				(int)txLength, (int)expectedPacket.length, (unsigned long long)expectedPacket.timeStamp);
+		}
+	}
+
+	this->_txIndex++;
+
+	// The packet counts as sent either way, so the game carries on just like it did in the capture.
+	return txLength;
+}
+
+void ReplayCommInterface::RXPacketGet()
+{
+	if((this->_rawPacket == NULL) || (this->_wifiHandler == NULL))
+	{
+		return;
+	}
+
+	const u64 usecCounter = this->_wifiHandler->GetWifiData().usecCounter;
+
+	while((this->_rxIndex < this->_rxPacket.size()) && (this->_rxPacket[this->_rxIndex].timeStamp <= usecCounter))
+	{
+		const WifiReplayPacket& packet = this->_rxPacket[this->_rxIndex];
+		this->_rxIndex++;
+
+		// Go through the same path as frames received from libpcap.
+		pcap_pkthdr pktHeader;
+		memset(&pktHeader, 0, sizeof(pktHeader));
+		pktHeader.caplen = packet.length;
+		pktHeader.len = packet.length;
+
+		this->_rawPacket->writeLocation = 0;
+		this->_rawPacket->count = 0;
+
+		SoftAP_RXPacketGet_Callback((u_char*)this->_rawPacket, &pktHeader, &this->_captureData[packet.offset]);
+		if(this->_rawPacket->count > 0)
+		{
+			this->_wifiHandler->RXPacketRawToQueue<true>(*this->_rawPacket);
+		}
+	}
+}
+
 SoftAPCommInterface::SoftAPCommInterface()
 {
 	_commInterfaceID = WifiCommInterfaceID_Infrastructure;
@@ -3766,8 +4501,18 @@ WifiHandler::WifiHandler()
 	_selectedEmulationLevel = WifiEmulationLevel_Off;
 	_currentEmulationLevel = _selectedEmulationLevel;
 
-	_adhocCommInterface = new AdhocCommInterface;
+	_adhocSocketCommInterface = new AdhocCommInterface;
+	_adhocLinkCommInterface = new SharedMemoryAdhocCommInterface;
+	_adhocCommInterface = _adhocSocketCommInterface;
 	_softAPCommInterface = new SoftAPCommInterface;
+	_softAPReplayCommInterface = new ReplayCommInterface;
+	_infrastructureCommInterface = _softAPCommInterface;
+
+	_selectedSoftAPReplayFileName = "";
+	_isSoftAPReplayRunning = false;
+
+	_selectedAdhocTransport = WifiAdhocTransport_Socket;
+	_currentAdhocTransport = _selectedAdhocTransport;
 
 	_selectedBridgeDeviceIndex = 0;
 
@@ -3800,8 +4545,10 @@ WifiHandler::~WifiHandler()
 	free(this->_workingTXBuffer);
 	this->_workingTXBuffer = NULL;
 
-	delete this->_adhocCommInterface;
+	delete this->_adhocSocketCommInterface;
+	delete this->_adhocLinkCommInterface;
 	delete this->_softAPCommInterface;
+	delete this->_softAPReplayCommInterface;
 
 	slock_free(this->_mutexRXPacketQueue);
 }
@@ -4003,10 +4750,24 @@ const u8* WifiHandler::_RXPacketFilter(const u8* rxBuffer, const size_t rxBytes,
 	// Save ethernet packet into the PCAP file.
 	// Filter broadcast because of privacy. They aren't needed to study the protocol with the nintendo server
 	// and can include PC Discovery protocols
+	// The capture is Ethernet, like the TX side, so that ReplayCommInterface can play it back.
 	#if WIFI_SAVE_PCAP_TO_FILE
-	if(!WIFI_isBroadcastMAC(&packetIEEE80211HeaderPtr[destMACOffset]))
+	if(!WIFI_isBroadcastMAC(&packetIEEE80211HeaderPtr[destMACOffset]) &&
+	   (fc.Type == WifiFrameType_Data) && (fc.FromToState == WifiFCFromToState_DS2STA) &&
+	   (rxPacketSize > (sizeof(WifiDataFrameHeaderDS2STA) + sizeof(WifiLLCSNAPHeader))) &&
+	   WIFI_IsLLCSNAPHeader(packetIEEE80211HeaderPtr + sizeof(WifiDataFrameHeaderDS2STA)))
 	{
-		this->_PacketCaptureFileWrite(packetIEEE80211HeaderPtr, rxPacketSize, true, wifi.usecCounter);
+		const WifiLLCSNAPHeader& snapHeader = (WifiLLCSNAPHeader&)packetIEEE80211HeaderPtr[sizeof(WifiDataFrameHeaderDS2STA)];
+		const size_t bodySize = rxPacketSize - sizeof(WifiDataFrameHeaderDS2STA) - sizeof(WifiLLCSNAPHeader);
+
+		u8 IEEE8023Frame[sizeof(EthernetFrameHeader) + MAX_PACKET_SIZE_80211];
+		EthernetFrameHeader& IEEE8023Header = (EthernetFrameHeader&)IEEE8023Frame[0];
+		memcpy(IEEE8023Header.destMAC, &packetIEEE80211HeaderPtr[destMACOffset], 6);
+		memcpy(IEEE8023Header.sendMAC, &packetIEEE80211HeaderPtr[sendMACOffset], 6);
+		IEEE8023Header.ethertype = snapHeader.ethertype;
+		memcpy(IEEE8023Frame + sizeof(EthernetFrameHeader), packetIEEE80211HeaderPtr + sizeof(WifiDataFrameHeaderDS2STA) + sizeof(WifiLLCSNAPHeader), bodySize);
+
+		this->_PacketCaptureFileWrite(IEEE8023Frame, sizeof(EthernetFrameHeader) + bodySize, true, wifi.usecCounter);
 	}
 	#endif
 
@@ -4356,7 +5117,7 @@ bool WifiHandler::_SoftAPTrySendPacket(const TXPacketHeader& txHeader, const u8*
 						size_t sendPacketSize = WifiHandler::ConvertDataFrame80211To8023(IEEE80211PacketData, txHeader.length, this->_workingTXBuffer);
 						if(sendPacketSize > 0)
 						{
-							sendPacketSize = this->_softAPCommInterface->TXPacketSend(this->_workingTXBuffer, sendPacketSize);
+							sendPacketSize = this->_infrastructureCommInterface->TXPacketSend(this->_workingTXBuffer, sendPacketSize);
 							if(sendPacketSize > 0)
 							{
 								RXQueuedPacket newRXPacket = this->_GenerateSoftAPCtlACKFrame(IEEE80211FrameHeader, sendPacketSize);
@@ -4521,11 +5282,43 @@ void WifiHandler::SetBridgeDeviceIndex(int deviceIndex)
 	this->_selectedBridgeDeviceIndex = deviceIndex;
 }
 
+WifiAdhocTransport WifiHandler::GetSelectedAdhocTransport()
+{
+	return this->_selectedAdhocTransport;
+}
+
+void WifiHandler::SetAdhocTransport(WifiAdhocTransport adhocTransport)
+{
+	this->_selectedAdhocTransport = adhocTransport;
+}
+
+void WifiHandler::SetAdhocLink(const char* linkName, u32 instanceID, bool isLockstep, u32 latencyUsec)
+{
+	this->_adhocLinkCommInterface->SetLink(linkName, instanceID, isLockstep, latencyUsec);
+}
+
+const char* WifiHandler::GetSoftAPReplayFileName()
+{
+	return this->_selectedSoftAPReplayFileName.c_str();
+}
+
+void WifiHandler::SetSoftAPReplayFileName(const char* fileName)
+{
+	this->_selectedSoftAPReplayFileName = (fileName != NULL) ? fileName : "";
+}
+
+ReplayCommInterface* WifiHandler::GetSoftAPReplayCommInterface()
+{
+	return this->_softAPReplayCommInterface;
+}
+
 bool WifiHandler::CommStart()
 {
 	// Stop the current comm interfaces.
-	this->_adhocCommInterface->Stop();
+	this->_adhocSocketCommInterface->Stop();
+	this->_adhocLinkCommInterface->Stop();
 	this->_softAPCommInterface->Stop();
+	this->_softAPReplayCommInterface->Stop();
 
 	// Reset internal values.
 	this->_wifi.usecCounter = 0;
@@ -4546,6 +5339,12 @@ bool WifiHandler::CommStart()
 	this->_softAPStatus = APStatus_Disconnected;
 	this->_softAPSequenceNumber = 0;
 
+	this->_currentAdhocTransport = this->_selectedAdhocTransport;
+	this->_adhocCommInterface = (this->_currentAdhocTransport == WifiAdhocTransport_SharedMemory) ? (WifiCommInterface*)this->_adhocLinkCommInterface : (WifiCommInterface*)this->_adhocSocketCommInterface;
+
+	this->_isSoftAPReplayRunning = false;
+	this->_infrastructureCommInterface = this->_softAPCommInterface;
+
 	// Assign the pcap interface to SoftAP if pcap is available.
 	this->_softAPCommInterface->SetPCapInterface(this->_pcap);
 	this->_softAPCommInterface->SetBridgeDeviceIndex(this->_selectedBridgeDeviceIndex);
@@ -4557,7 +5356,7 @@ bool WifiHandler::CommStart()
 	else
 	{
 		// Start the new comm interfaces.
-		if(this->_isSocketsSupported)
+		if(this->_isSocketsSupported || (this->_currentAdhocTransport == WifiAdhocTransport_SharedMemory))
 		{
 			this->_adhocCommInterface->Start(this);
 		}
@@ -4566,7 +5365,14 @@ bool WifiHandler::CommStart()
 			WIFI_LOG(1, "Ad-hoc mode requires sockets, but sockets are not supported on this system.\n");
 		}
 
-		if(this->IsPCapSupported())
+		if(!this->_selectedSoftAPReplayFileName.empty())
+		{
+			// A replay stands in for the network, so it doesn't need libpcap.
+			this->_softAPReplayCommInterface->SetFileName(this->_selectedSoftAPReplayFileName.c_str());
+			this->_isSoftAPReplayRunning = this->_softAPReplayCommInterface->Start(this);
+			this->_infrastructureCommInterface = this->_softAPReplayCommInterface;
+		}
+		else if(this->IsPCapSupported())
 		{
 			this->_softAPCommInterface->Start(this);
 		}
@@ -4585,8 +5391,11 @@ void WifiHandler::CommStop()
 {
 	this->_PacketCaptureFileClose();
 
-	this->_adhocCommInterface->Stop();
+	this->_adhocSocketCommInterface->Stop();
+	this->_adhocLinkCommInterface->Stop();
 	this->_softAPCommInterface->Stop();
+	this->_softAPReplayCommInterface->Stop();
+	this->_isSoftAPReplayRunning = false;
 
 	this->_RXEmptyQueue();
 
@@ -4613,6 +5422,13 @@ void WifiHandler::CommTrigger()
 	WifiData& wifi = this->_wifi;
 	WIFI_IOREG_MAP& io = wifi.io;
 
+	// The shared-memory link keeps time with its peers even while WiFi is powered down,
+	// or lockstep peers would wait on this instance.
+	if(this->_currentAdhocTransport == WifiAdhocTransport_SharedMemory)
+	{
+		this->_adhocLinkCommInterface->Trigger(nds_timer);
+	}
+
 	if(io.POWER_US.Disable != 0)
 	{
 		return; // Don't do anything if WiFi isn't powered up.
@@ -4620,6 +5436,11 @@ void WifiHandler::CommTrigger()
 
 	wifi.usecCounter++;
 
+	if(this->_isSoftAPReplayRunning)
+	{
+		this->_softAPReplayCommInterface->RXPacketGet();
+	}
+
 	// a usec has passed
 	if(io.US_COUNTCNT.EnableCounter != 0)
 	{
@@ -4938,6 +5759,14 @@ bool WifiHandler::IsPCapSupported()
 	return ((this->_pcap != NULL) && (this->_pcap != &dummyPCapInterface));
 }
 
+bool WifiHandler::IsCommThreadRunning()
+{
+	return this->_adhocSocketCommInterface->IsRXThreadRunning() ||
+	       this->_adhocLinkCommInterface->IsRXThreadRunning() ||
+	       this->_softAPCommInterface->IsRXThreadRunning() ||
+	       this->_softAPReplayCommInterface->IsRXThreadRunning();
+}
+
 bool WifiHandler::IsSocketsSupported()
 {
 	return this->_isSocketsSupported;
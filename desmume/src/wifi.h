@@ -832,6 +832,12 @@ DESMUME_ENUM(s32, WifiCommInterfaceID)
 	WifiCommInterfaceID_Infrastructure = 1
 };
 
+DESMUME_ENUM(s32, WifiAdhocTransport)
+{
+	WifiAdhocTransport_Socket = 0,			// UDP broadcast on BASEPORT, one group per host
+	WifiAdhocTransport_SharedMemory = 1		// Named shared-memory packet ring between instances on the same host
+};
+
 typedef u16 IOREG_W_PADDING;
 
 typedef u16 IOREG_W_INTERNAL;
@@ -3292,6 +3298,8 @@ public:
 	virtual void Stop() = 0;
 	virtual size_t TXPacketSend(u8 *txTargetBuffer, size_t txLength) = 0;
 	virtual void RXPacketGet() = 0;
+	
+	bool IsRXThreadRunning();
 };
 
 class AdhocCommInterface : public WifiCommInterface
@@ -3312,6 +3320,112 @@ public:
 	virtual void RXPacketGet();
 };
 
+#define WIFI_ADHOC_LINK_MAX_INSTANCES 16
+#define WIFI_ADHOC_LINK_SLOT_COUNT 256
+#define WIFI_ADHOC_LINK_DEFAULT_LATENCY 64 // In microseconds
+
+struct WifiAdhocLinkSharedData;
+
+typedef struct
+{
+	u64 dueTime;
+	u32 senderID;
+	u32 senderSequence;
+	u32 length;
+	u8 data[sizeof(DesmumeFrameHeader) + MAX_PACKET_SIZE_80211];
+} WifiAdhocLinkPendingPacket;
+
+// Ad-hoc comm interface for emulator instances on the same host that share a named
+// memory segment holding a lock-free packet ring. Instances on different link names
+// are separate groups. The ring is polled from CommTrigger, so there is no RX thread.
+//
+// In lockstep mode, each packet is stamped with the sender's emulated time and is
+// delivered once the receiver's emulated time reaches the stamp plus a fixed latency,
+// in (time, sender, sequence) order. No instance is allowed to run further ahead of
+// its slowest peer than that latency, so every packet is already in the ring by the
+// time it is due. Given the same inputs from power-on, runs are reproducible.
+class SharedMemoryAdhocCommInterface : public WifiCommInterface
+{
+protected:
+	std::string _linkName;
+	u32 _instanceID;
+	bool _isLockstep;
+	u64 _latencyCycles;
+	
+	void *_linkHandle;
+	WifiAdhocLinkSharedData *_link;
+	u32 _readSequence;
+	u32 _txSequence;
+	u64 _nextEventTime;
+	u64 _peerTimeSeen[WIFI_ADHOC_LINK_MAX_INSTANCES];
+	
+	std::vector<WifiAdhocLinkPendingPacket> _pendingPacket;
+	
+	bool _MapLink();
+	void _UnmapLink();
+	u64 _WaitForPeers(const u64 emulatedTime);
+	void _ReadRing();
+	void _DeliverPending(const u64 emulatedTime);
+	
+public:
+	SharedMemoryAdhocCommInterface();
+	virtual ~SharedMemoryAdhocCommInterface();
+	
+	void SetLink(const char *linkName, u32 instanceID, bool isLockstep, u32 latencyUsec);
+	bool IsLockstep() const;
+	
+	void Trigger(const u64 emulatedTime);
+	
+	virtual bool Start(WifiHandler *currentWifiHandler);
+	virtual void Stop();
+	virtual size_t TXPacketSend(u8 *txTargetBuffer, size_t txLength);
+	virtual void RXPacketGet();
+};
+
+typedef struct
+{
+	u64 timeStamp;					// Emulated microseconds since CommStart (WifiData::usecCounter)
+	size_t offset;					// Location of the frame in the capture data
+	size_t length;
+} WifiReplayPacket;
+
+// Infrastructure comm interface that plays back a packet capture instead of using a real
+// network, so it needs neither sockets nor libpcap. The capture is a libpcap file of IEEE 802.3
+// frames, like the ones _PacketCaptureFileWrite() writes. Frames sent from the firmware MAC
+// address are what the game is expected to send, and every TX packet is checked against the next
+// one of them. All other frames go to the RX queue as soon as usecCounter reaches their timestamp,
+// regardless of what the game sends, so replays stay deterministic.
+class ReplayCommInterface : public WifiCommInterface
+{
+protected:
+	std::string _fileName;
+	std::vector<u8> _captureData;
+	std::vector<WifiReplayPacket> _rxPacket;
+	std::vector<WifiReplayPacket> _txPacket;
+	size_t _rxIndex;
+	size_t _txIndex;
+	size_t _txMatchCount;
+	size_t _txMismatchCount;
+	
+	bool _LoadCapture();
+	
+public:
+	ReplayCommInterface();
+	virtual ~ReplayCommInterface();
+	
+	const char* GetFileName() const;
+	void SetFileName(const char *fileName);
+	
+	size_t GetTXMatchCount() const;
+	size_t GetTXMismatchCount() const;
+	size_t GetRXRemainingCount() const;
+	
+	virtual bool Start(WifiHandler *currentWifiHandler);
+	virtual void Stop();
+	virtual size_t TXPacketSend(u8 *txTargetBuffer, size_t txLength);
+	virtual void RXPacketGet();
+};
+
 class SoftAPCommInterface : public WifiCommInterface
 {
 protected:
@@ -3343,8 +3457,18 @@ class WifiHandler
 protected:
 	WifiData _wifi;
 	
-	AdhocCommInterface *_adhocCommInterface;
+	WifiCommInterface *_adhocCommInterface;
+	AdhocCommInterface *_adhocSocketCommInterface;
+	SharedMemoryAdhocCommInterface *_adhocLinkCommInterface;
 	SoftAPCommInterface *_softAPCommInterface;
+	ReplayCommInterface *_softAPReplayCommInterface;
+	WifiCommInterface *_infrastructureCommInterface;
+	
+	std::string _selectedSoftAPReplayFileName;
+	bool _isSoftAPReplayRunning;
+	
+	WifiAdhocTransport _selectedAdhocTransport;
+	WifiAdhocTransport _currentAdhocTransport;
 	
 	WifiEmulationLevel _selectedEmulationLevel;
 	WifiEmulationLevel _currentEmulationLevel;
@@ -3406,11 +3530,20 @@ public:
 	int GetCurrentBridgeDeviceIndex();
 	void SetBridgeDeviceIndex(int deviceIndex);
 	
+	WifiAdhocTransport GetSelectedAdhocTransport();
+	void SetAdhocTransport(WifiAdhocTransport adhocTransport);
+	void SetAdhocLink(const char *linkName, u32 instanceID, bool isLockstep, u32 latencyUsec);
+	
+	const char* GetSoftAPReplayFileName();
+	void SetSoftAPReplayFileName(const char *fileName);
+	ReplayCommInterface* GetSoftAPReplayCommInterface();
+	
 	bool CommStart();
 	void CommStop();
 	void CommSendPacket(const TXPacketHeader &txHeader, const u8 *packetData);
 	void CommTrigger();
 	void CommEmptyRXQueue();
+	bool IsCommThreadRunning();
 	
 	template<bool WILLADVANCESEQNO> void RXPacketRawToQueue(const RXRawPacketData &rawPacket);
 	